@@ -0,0 +1,324 @@
+// Art-Net loopback harness: replays Art-Net into ArtNetReceiver over the
+// host's loopback interface at the original rate and measures what comes out
+// of the switcher.
+//
+//   artnet_loopback [--universes N] [--rate HZ] [--seconds S] [capture.pcap]
+//
+// With a capture, its ArtDmx packets (UDP port 6454, Ethernet, Linux cooked
+// or raw IPv4 link types) are replayed with their recorded spacing; without
+// one, N universes are generated at HZ each. Universe 0 is routed to the
+// CRMX sink and universes 1-3 back out of the artnet sink's ports, where
+// drain threads count what reaches them.
+#include "ArtNetReceiver.h"
+#include "DmxSwitcher.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Packet {
+  // Offset from the start of the replay.
+  std::chrono::microseconds at;
+  std::vector<uint8_t> data;
+};
+
+std::vector<uint8_t> make_art_dmx(const uint16_t port_address,
+                                  const uint8_t sequence, const uint32_t count,
+                                  const uint16_t length) {
+  std::vector<uint8_t> packet(sizeof(ArtDmxHeader) + length);
+  ArtDmxHeader header{};
+  memcpy(header.header.id, "Art-Net", 8);
+  header.header.op_code = artnet_op_dmx;
+  header.prot_ver_lo = artnet_protocol_version;
+  header.sequence = sequence;
+  header.sub_uni = port_address & 0xFF;
+  header.net = port_address >> 8;
+  header.length_hi = length >> 8;
+  header.length_lo = length & 0xFF;
+  memcpy(packet.data(), &header, sizeof(header));
+  // Stamp the frame so drains can check it arrived intact.
+  memcpy(packet.data() + sizeof(header), &count, sizeof(count));
+  for (size_t i = sizeof(count); i < length; i++) {
+    packet[sizeof(header) + i] = static_cast<uint8_t>(count + i);
+  }
+  return packet;
+}
+
+std::vector<Packet> generate(const int universes, const double rate_hz,
+                             const double seconds) {
+  std::vector<Packet> packets;
+  const auto period = std::chrono::microseconds(
+      static_cast<int64_t>(1e6 / rate_hz));
+  const uint32_t frames = static_cast<uint32_t>(seconds * rate_hz);
+  for (uint32_t f = 0; f < frames; f++) {
+    const uint8_t sequence = static_cast<uint8_t>(f % 255 + 1);
+    for (int u = 0; u < universes; u++) {
+      packets.push_back(Packet{
+          .at = period * f,
+          .data = make_art_dmx(static_cast<uint16_t>(u), sequence, f, 512),
+      });
+    }
+  }
+  return packets;
+}
+
+uint32_t read_u32(const uint8_t *p, const bool swap) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return swap ? __builtin_bswap32(v) : v;
+}
+
+// Classic pcap only. Returns an empty list if the file cannot be used.
+std::vector<Packet> load_pcap(const char *path) {
+  std::ifstream file(path, std::ios::binary);
+  std::vector<uint8_t> buf((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+  std::vector<Packet> packets;
+  if (buf.size() < 24) {
+    return packets;
+  }
+  const uint32_t magic = read_u32(buf.data(), false);
+  const bool swap = magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1;
+  const bool nanos = magic == 0xa1b23c4d || magic == 0x4d3cb2a1;
+  if (!swap && magic != 0xa1b2c3d4 && !nanos) {
+    return packets;
+  }
+  const uint32_t link_type = read_u32(buf.data() + 20, swap);
+  size_t link_len;
+  switch (link_type) {
+  case 1: // Ethernet
+    link_len = 14;
+    break;
+  case 113: // Linux cooked capture
+    link_len = 16;
+    break;
+  case 101: // Raw IP
+    link_len = 0;
+    break;
+  default:
+    fprintf(stderr, "Unsupported link type %" PRIu32 "\n", link_type);
+    return packets;
+  }
+
+  int64_t first_us = -1;
+  for (size_t pos = 24; pos + 16 <= buf.size();) {
+    const int64_t sec = read_u32(&buf[pos], swap);
+    const int64_t frac = read_u32(&buf[pos + 4], swap);
+    const uint32_t caplen = read_u32(&buf[pos + 8], swap);
+    pos += 16;
+    if (pos + caplen > buf.size()) {
+      break;
+    }
+    const uint8_t *frame = &buf[pos];
+    pos += caplen;
+
+    if (caplen < link_len + 28 || (frame[link_len] >> 4) != 4) {
+      continue;
+    }
+    const uint8_t *ip = frame + link_len;
+    const size_t ip_len = (ip[0] & 0xF) * 4;
+    if (ip[9] != 17 || caplen < link_len + ip_len + 8) {
+      continue;
+    }
+    const uint8_t *udp = ip + ip_len;
+    const uint16_t dst_port = udp[2] << 8 | udp[3];
+    const uint16_t udp_len = udp[4] << 8 | udp[5];
+    if (dst_port != artnet_port || udp_len < 8 ||
+        link_len + ip_len + udp_len > caplen) {
+      continue;
+    }
+
+    const int64_t t_us = sec * 1000000 + (nanos ? frac / 1000 : frac);
+    if (first_us < 0) {
+      first_us = t_us;
+    }
+    packets.push_back(Packet{
+        .at = std::chrono::microseconds(t_us - first_us),
+        .data = std::vector<uint8_t>(udp + 8, udp + udp_len),
+    });
+  }
+  return packets;
+}
+
+int open_socket(const char *bind_ip, const uint16_t port) {
+  const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  const int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  inet_pton(AF_INET, bind_ip, &addr.sin_addr);
+  if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    perror("bind");
+    exit(1);
+  }
+  return fd;
+}
+
+// Polls from 127.0.0.2, so the unicast reply does not land on the receiver's
+// own wildcard-bound socket.
+void check_poll() {
+  const int fd = open_socket("127.0.0.2", artnet_port);
+  const timeval timeout{.tv_sec = 1, .tv_usec = 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  uint8_t poll[14] = {'A', 'r', 't', '-', 'N', 'e', 't', 0,
+                      0,   0x20, 0,  14,  0,   0};
+  sockaddr_in to{};
+  to.sin_family = AF_INET;
+  to.sin_port = htons(artnet_port);
+  inet_pton(AF_INET, "127.0.0.1", &to.sin_addr);
+  sendto(fd, poll, sizeof(poll), 0, reinterpret_cast<sockaddr *>(&to),
+         sizeof(to));
+
+  ArtPollReply reply{};
+  const ssize_t len = recv(fd, &reply, sizeof(reply), 0);
+  if (len != sizeof(reply) || reply.header.op_code != artnet_op_poll_reply) {
+    printf("ArtPoll: no reply\n");
+  } else {
+    printf("ArtPoll: '%s' at %u.%u.%u.%u net %u sub-net %u, %u ports:",
+           reply.short_name, reply.ip[0], reply.ip[1], reply.ip[2],
+           reply.ip[3], reply.net_switch, reply.sub_switch,
+           reply.num_ports_lo);
+    for (size_t i = 0; i < reply.num_ports_lo; i++) {
+      printf(" %u", reply.sw_out[i]);
+    }
+    printf("\n");
+  }
+  close(fd);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int universes = 4;
+  double rate_hz = 44;
+  double seconds = 10;
+  const char *capture = nullptr;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--universes" && i + 1 < argc) {
+      universes = atoi(argv[++i]);
+    } else if (arg == "--rate" && i + 1 < argc) {
+      rate_hz = atof(argv[++i]);
+    } else if (arg == "--seconds" && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else {
+      capture = argv[i];
+    }
+  }
+
+  const std::vector<Packet> packets =
+      capture ? load_pcap(capture) : generate(universes, rate_hz, seconds);
+  if (packets.empty()) {
+    fprintf(stderr, "Nothing to replay\n");
+    return 1;
+  }
+
+  SettingsHandler::shared().init();
+  DmxSwitcher &switcher = DmxSwitcher::get_switcher();
+  switcher.init();
+  switcher.set_output_en(true);
+  switcher.set_src_sink(DmxSourceSink::artnet, DmxSourceSink::timo);
+  std::vector<DmxRoute> routes;
+  for (uint16_t u = 1; u < dmx_universe_max; u++) {
+    routes.push_back(DmxRoute{.src = DmxSourceSink::artnet,
+                              .src_universe = u,
+                              .sink = DmxSourceSink::artnet,
+                              .sink_universe = u});
+  }
+  switcher.set_routes(routes);
+
+  ArtNetReceiver &receiver = ArtNetReceiver::shared();
+  if (receiver.start(switcher.get_artnet_interface()) != ESP_OK) {
+    return 1;
+  }
+  vTaskDelay(pdMS_TO_TICKS(50));
+  check_poll();
+
+  // One drain per sink port, as the sink tasks would on target.
+  std::atomic<bool> done{false};
+  std::array<std::atomic<uint32_t>, dmx_universe_max> delivered{};
+  std::atomic<uint32_t> corrupt{0};
+  const bool stamped = capture == nullptr;
+  std::vector<std::thread> drains;
+  for (size_t port = 0; port < dmx_universe_max; port++) {
+    DmxInterface &sink = port == 0 ? switcher.get_timo_interface()
+                                   : switcher.get_artnet_interface();
+    drains.emplace_back([&, port, sink_ptr = &sink] {
+      while (!done) {
+        DmxFrameRef frame = sink_ptr->recieve(pdMS_TO_TICKS(20), port);
+        if (!frame) {
+          continue;
+        }
+        uint32_t count;
+        memcpy(&count, frame->full_packet.data.data(), sizeof(count));
+        if (stamped &&
+            frame->full_packet.data[100] != static_cast<uint8_t>(count + 100)) {
+          corrupt++;
+        }
+        delivered[port]++;
+        sink_ptr->complete(frame, port);
+      }
+    });
+  }
+
+  const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in to{};
+  to.sin_family = AF_INET;
+  to.sin_port = htons(artnet_port);
+  inet_pton(AF_INET, "127.0.0.1", &to.sin_addr);
+
+  const ArtNetReceiver::Stats before = receiver.get_stats();
+  const auto start = Clock::now();
+  for (const Packet &packet : packets) {
+    std::this_thread::sleep_until(start + packet.at);
+    sendto(fd, packet.data.data(), packet.data.size(), 0,
+           reinterpret_cast<sockaddr *>(&to), sizeof(to));
+  }
+  const double elapsed =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  vTaskDelay(pdMS_TO_TICKS(100));
+  done = true;
+  for (std::thread &drain : drains) {
+    drain.join();
+  }
+
+  const ArtNetReceiver::Stats stats = receiver.get_stats();
+  const uint32_t received = stats.packets - before.packets;
+  printf("sent %zu packets in %.2f s (%.1f pkt/s)\n", packets.size(), elapsed,
+         packets.size() / elapsed);
+  printf("received %" PRIu32 " (%.1f pkt/s), drop rate %.3f%%\n", received,
+         received / elapsed,
+         100.0 * (packets.size() - received) / packets.size());
+  printf("frames %" PRIu32 ", filtered %" PRIu32 ", out of order %" PRIu32
+         ", malformed %" PRIu32 ", no frame %" PRIu32 "\n",
+         stats.dmx_frames, stats.filtered, stats.out_of_order, stats.malformed,
+         stats.no_frame);
+  printf("parse time p50 %" PRIu32 " us, p99 %" PRIu32 " us, max %" PRIu32
+         " us\n",
+         stats.parse_time.p50_us, stats.parse_time.p99_us,
+         stats.parse_time.max_us);
+  for (size_t port = 0; port < dmx_universe_max; port++) {
+    printf("universe %zu: %" PRIu32 " frames delivered (%.1f/s)\n", port,
+           delivered[port].load(), delivered[port] / elapsed);
+  }
+  printf("corrupt frames %" PRIu32 ", unrouted %" PRIu32 "\n", corrupt.load(),
+         switcher.get_artnet_interface().get_unrouted_count());
+
+  close(fd);
+  receiver.stop();
+  return 0;
+}
@@ -0,0 +1,170 @@
+// Curve stage benchmark: times DmxCurveMap::apply, the per-channel table
+// gather, in cycles and nanoseconds per universe.
+//
+//   curve_gather [--iterations N]
+//
+// Maps timed:
+//   one curve   every channel on the same square-law dimmer curve
+//   16 curves   dmx_curve_max_tables - 1 distinct curves in 32-channel
+//               ranges, so consecutive channels hit different tables
+//   in place    16 curves with in and out the same buffer, as the switcher
+//               runs it after a patch
+// Cycles come from the time-stamp counter where the host has one; they are
+// host cycles, not S3 ones. Each map is checked against its rules first.
+#include "DmxCurves.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t slots = dmx_curve_channels;
+
+inline void clobber() { asm volatile("" : : : "memory"); }
+
+inline uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+DmxCurveRule make_rule(const uint16_t start, const uint16_t count,
+                       const DmxCurveType type, const uint8_t invert,
+                       const uint8_t min, const uint8_t max) {
+  return DmxCurveRule{.start = start,
+                      .count = count,
+                      .type = type,
+                      .invert = invert,
+                      .min = min,
+                      .max = max,
+                      .points = {}};
+}
+
+std::vector<DmxCurveRule> many_curves() {
+  // Vary the clamp so every range gets its own table.
+  std::vector<DmxCurveRule> rules;
+  for (size_t t = 0; t + 1 < dmx_curve_max_tables; t++) {
+    rules.push_back(make_rule(static_cast<uint16_t>(1 + t * 32), 32,
+                              t % 2 ? DmxCurveType::root : DmxCurveType::square,
+                              t % 3 == 0, static_cast<uint8_t>(t),
+                              static_cast<uint8_t>(255 - t)));
+  }
+  return rules;
+}
+
+// The level build_table() gives in for a square or root rule.
+uint8_t expected(const DmxCurveRule &rule, const uint8_t in) {
+  const float x = in / 255.0f;
+  const float y = rule.type == DmxCurveType::square ? x * x : sqrtf(x);
+  int out = static_cast<int>(lroundf(y * 255.0f));
+  if (rule.invert) {
+    out = UINT8_MAX - out;
+  }
+  return static_cast<uint8_t>(std::clamp<int>(out, rule.min, rule.max));
+}
+
+bool check(const char *name, const DmxCurveMap &map,
+           const std::vector<DmxCurveRule> &rules, const uint8_t *in) {
+  uint8_t out[slots];
+  map.apply(in, out, slots);
+  for (size_t i = 0; i < slots; i++) {
+    uint8_t want = in[i];
+    for (const DmxCurveRule &rule : rules) {
+      if (i + 1 >= rule.start && i + 1 < rule.start + rule.count) {
+        want = expected(rule, in[i]);
+      }
+    }
+    if (out[i] != want) {
+      printf("%s: channel %zu is %u, expected %u\n", name, i + 1, out[i],
+             want);
+      return false;
+    }
+  }
+  return true;
+}
+
+struct Timing {
+  double ns;
+  double cycles;
+};
+
+template <typename Pass> Timing time_pass(const int iterations, Pass &&pass) {
+  for (int i = 0; i < iterations / 10; i++) {
+    pass();
+    clobber();
+  }
+  const auto start = Clock::now();
+  const uint64_t start_cycles = cycles();
+  for (int i = 0; i < iterations; i++) {
+    pass();
+    clobber();
+  }
+  const uint64_t end_cycles = cycles();
+  const double ns =
+      std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+  return Timing{.ns = ns / iterations,
+                .cycles = static_cast<double>(end_cycles - start_cycles) /
+                          iterations};
+}
+
+void report(const char *name, const size_t tables, const Timing &t) {
+  printf("%-10s %2zu tables: %7.1f ns, %7.0f cycles per universe "
+         "(%.2f cycles/channel)\n",
+         name, tables, t.ns, t.cycles, t.cycles / slots);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int iterations = 1000000;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--iterations" && i + 1 < argc) {
+      iterations = std::max(1, atoi(argv[++i]));
+    }
+  }
+
+  const std::vector<DmxCurveRule> one = {
+      make_rule(1, slots, DmxCurveType::square, 0, 0, 255)};
+  const std::vector<DmxCurveRule> many = many_curves();
+  DmxCurveMap one_map;
+  DmxCurveMap many_map;
+  if (one_map.compile(one.data(), one.size()) != ESP_OK ||
+      many_map.compile(many.data(), many.size()) != ESP_OK) {
+    return 1;
+  }
+
+  std::mt19937 rng(1);
+  uint8_t in[slots];
+  uint8_t out[slots];
+  for (uint8_t &level : in) {
+    level = static_cast<uint8_t>(rng());
+  }
+  if (!check("one curve", one_map, one, in) ||
+      !check("16 curves", many_map, many, in)) {
+    return 1;
+  }
+
+  printf("%d passes over %zu channels%s\n", iterations, slots,
+         cycles() == 0 ? " (no cycle counter on this host)" : "");
+  report("one curve", one_map.get_table_count(),
+         time_pass(iterations, [&] { one_map.apply(in, out, slots); }));
+  report("16 curves", many_map.get_table_count(),
+         time_pass(iterations, [&] { many_map.apply(in, out, slots); }));
+  // Curves feed back into themselves here; only the timing matters.
+  memcpy(out, in, slots);
+  report("in place", many_map.get_table_count(),
+         time_pass(iterations, [&] { many_map.apply(out, out, slots); }));
+  return 0;
+}
@@ -0,0 +1,270 @@
+// Frame path benchmark: moves universes from a producer to a sink through the
+// three data plane hops, with frames shared from DmxFramePool, and against the
+// DmxPacket queues the interfaces used before.
+//
+//   frame_path [--iterations N] [--rate HZ] [--seconds S]
+//
+// Runs:
+//   hops      one thread walks N frames through the hops back to back and
+//             times each: send (producer into the source slot), dispatch
+//             (source slot to sink slot, as the switcher routes) and
+//             recieve (sink slot out). The baseline does the same with
+//             one-deep queues of the old by-value DmxPacket, xQueueOverwrite
+//             in and xQueueReceive out, after the producer fills a stack
+//             packet; every queue operation copies the whole packet.
+//   switcher  a producer thread sends HZ frames a second into the onboard
+//             interface and a sink thread receives them from the CRMX sink,
+//             through the switcher task. A frame counts as copied if the
+//             sink does not get the producer's own pool frame.
+#include "DmxSwitcher.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// DmxPacket as the interface queues carried it, by value.
+struct QueuedPacket {
+  DmxSourceSink source;
+  struct PACKED_ATTR {
+    uint8_t start_code;
+    std::array<uint8_t, dmx_packet_size> data;
+  } full_packet;
+};
+
+inline void clobber() { asm volatile("" : : : "memory"); }
+
+inline int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             Clock::now().time_since_epoch())
+      .count();
+}
+
+struct Hops {
+  const char *name;
+  // Nanoseconds summed over the run, per hop.
+  int64_t send_ns = 0;
+  int64_t dispatch_ns = 0;
+  int64_t recieve_ns = 0;
+  uint64_t copies = 0;
+  uint64_t frames = 0;
+  bool intact = true;
+};
+
+void fill(uint8_t *data, const uint32_t seq) {
+  memset(data, static_cast<uint8_t>(seq), dmx_packet_size);
+}
+
+Hops run_queues(const int iterations) {
+  Hops hops{.name = "queues"};
+  QueueHandle_t src_queue = xQueueCreate(1, sizeof(QueuedPacket));
+  QueueHandle_t sink_queue = xQueueCreate(1, sizeof(QueuedPacket));
+  for (int i = 0; i < iterations; i++) {
+    int64_t start = now_ns();
+    // The producer reads into a stack packet, then queues a copy of it.
+    QueuedPacket produced;
+    produced.source = DmxSourceSink::onboard;
+    produced.full_packet.start_code = 0;
+    fill(produced.full_packet.data.data(), i);
+    xQueueOverwrite(src_queue, &produced);
+    int64_t end = now_ns();
+    hops.send_ns += end - start;
+
+    start = end;
+    QueuedPacket routed;
+    xQueueReceive(src_queue, &routed, 0);
+    xQueueOverwrite(sink_queue, &routed);
+    end = now_ns();
+    hops.dispatch_ns += end - start;
+
+    start = end;
+    QueuedPacket received;
+    xQueueReceive(sink_queue, &received, 0);
+    clobber();
+    end = now_ns();
+    hops.recieve_ns += end - start;
+
+    hops.copies += 4;
+    hops.frames++;
+    hops.intact = hops.intact && received.full_packet.data[dmx_packet_size -
+                                                           1] ==
+                                     static_cast<uint8_t>(i);
+  }
+  vQueueDelete(src_queue);
+  vQueueDelete(sink_queue);
+  return hops;
+}
+
+Hops run_pool(const int iterations) {
+  Hops hops{.name = "frame pool"};
+  DmxFrameSlot src_slot;
+  DmxFrameSlot sink_slot;
+  src_slot.init();
+  sink_slot.init();
+  for (int i = 0; i < iterations; i++) {
+    int64_t start = now_ns();
+    // The producer fills a pool frame in place and publishes a reference.
+    DmxFrameRef produced = DmxFramePool::shared().acquire();
+    if (!produced) {
+      hops.intact = false;
+      break;
+    }
+    const DmxPacket *const frame = &*produced;
+    produced->source = DmxSourceSink::onboard;
+    produced->full_packet.start_code = 0;
+    fill(produced->full_packet.data.data(), i);
+    src_slot.publish(std::move(produced));
+    int64_t end = now_ns();
+    hops.send_ns += end - start;
+
+    start = end;
+    DmxFrameRef routed = src_slot.take(0);
+    sink_slot.publish(routed.share());
+    routed.reset();
+    end = now_ns();
+    hops.dispatch_ns += end - start;
+
+    start = end;
+    DmxFrameRef received = sink_slot.take(0);
+    clobber();
+    end = now_ns();
+    hops.recieve_ns += end - start;
+
+    hops.copies += &*received != frame;
+    hops.frames++;
+    hops.intact = hops.intact && received->full_packet.data[dmx_packet_size -
+                                                            1] ==
+                                     static_cast<uint8_t>(i);
+  }
+  src_slot.deinit();
+  sink_slot.deinit();
+  return hops;
+}
+
+void report(const Hops &hops, const size_t bytes) {
+  const double n = hops.frames ? static_cast<double>(hops.frames) : 1;
+  printf("%-10s send %6.1f ns, dispatch %6.1f ns, recieve %6.1f ns, total "
+         "%6.1f ns; %.2f copies/frame of %zu B, %s\n",
+         hops.name, hops.send_ns / n, hops.dispatch_ns / n,
+         hops.recieve_ns / n,
+         (hops.send_ns + hops.dispatch_ns + hops.recieve_ns) / n,
+         hops.copies / n, bytes, hops.intact ? "levels ok" : "LEVELS WRONG");
+}
+
+struct SwitcherRun {
+  uint32_t sent = 0;
+  uint32_t received = 0;
+  uint32_t copied = 0;
+  std::vector<uint32_t> latency_us;
+};
+
+SwitcherRun run_switcher(const double rate_hz, const double seconds) {
+  SettingsHandler &settings = SettingsHandler::shared();
+  settings.init();
+  DmxSwitcher &switcher = DmxSwitcher::get_switcher();
+  switcher.init();
+  switcher.on_settings_update(settings);
+  switcher.set_output_en(true);
+  switcher.set_src_sink(DmxSourceSink::onboard, DmxSourceSink::timo);
+
+  SwitcherRun run;
+  // Frames the producer sent, by sequence, to compare against what arrives.
+  std::vector<const DmxPacket *> sent_frames(
+      static_cast<size_t>(rate_hz * seconds) + 1, nullptr);
+  std::atomic<uint32_t> sent{0};
+  std::atomic<bool> done{false};
+
+  DmxInterface &sink = switcher.get_timo_interface();
+  std::thread drain([&] {
+    while (!done) {
+      DmxFrameRef frame = sink.recieve(pdMS_TO_TICKS(20));
+      if (!frame) {
+        continue;
+      }
+      const int64_t pickup_us = esp_timer_get_time();
+      uint32_t seq;
+      memcpy(&seq, frame->full_packet.data.data(), sizeof(seq));
+      if (seq >= sent.load() || &*frame != sent_frames[seq]) {
+        run.copied++;
+      }
+      run.latency_us.push_back(
+          static_cast<uint32_t>(pickup_us - frame->times.rx_us));
+      run.received++;
+      sink.complete(frame);
+    }
+  });
+
+  DmxInterface &source = switcher.get_onboard_interface();
+  const auto period =
+      std::chrono::microseconds(static_cast<int64_t>(1e6 / rate_hz));
+  const auto start = Clock::now();
+  for (uint32_t seq = 0; seq + 1 < sent_frames.size(); seq++) {
+    std::this_thread::sleep_until(start + period * seq);
+    DmxFrameRef frame = DmxFramePool::shared().acquire();
+    if (!frame) {
+      continue;
+    }
+    // The first slots carry the sequence, so the sink can tell which frame
+    // the producer filled for it.
+    sent_frames[seq] = &*frame;
+    frame->source = DmxSourceSink::onboard;
+    frame->universe = 0;
+    frame->slot_count = dmx_packet_size;
+    frame->times = DmxFrameTimes{};
+    frame->full_packet.start_code = 0;
+    fill(frame->full_packet.data.data(), seq);
+    memcpy(frame->full_packet.data.data(), &seq, sizeof(seq));
+    sent = seq + 1;
+    source.send(std::move(frame));
+    run.sent++;
+  }
+  vTaskDelay(pdMS_TO_TICKS(100));
+  done = true;
+  drain.join();
+  return run;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int iterations = 1000000;
+  double rate_hz = 1000;
+  double seconds = 3;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--iterations" && i + 1 < argc) {
+      iterations = std::max(1, atoi(argv[++i]));
+    } else if (arg == "--rate" && i + 1 < argc) {
+      rate_hz = atof(argv[++i]);
+    } else if (arg == "--seconds" && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    }
+  }
+
+  printf("%d frames through send, dispatch and recieve\n", iterations);
+  report(run_queues(iterations), sizeof(QueuedPacket));
+  report(run_pool(iterations), sizeof(DmxPacket));
+
+  SwitcherRun run = run_switcher(rate_hz, seconds);
+  std::sort(run.latency_us.begin(), run.latency_us.end());
+  const auto percentile = [&](const double p) -> uint32_t {
+    if (run.latency_us.empty()) {
+      return 0;
+    }
+    return run.latency_us[static_cast<size_t>(p * (run.latency_us.size() - 1))];
+  };
+  printf("switcher   %" PRIu32 " sent, %" PRIu32 " received, %.2f "
+         "copies/frame; send to pickup p50 %" PRIu32 " us, p99 %" PRIu32
+         " us, max %" PRIu32 " us\n",
+         run.sent, run.received,
+         run.received ? static_cast<double>(run.copied) / run.received : 0.0,
+         percentile(0.5), percentile(0.99), percentile(1));
+  return 0;
+}
@@ -0,0 +1,176 @@
+// Merge kernel benchmark: times dmx_merge_htp and dmx_merge_ltp over a full
+// universe against the plain per-byte loops they replace.
+//
+//   merge_kernel [--iterations N]
+//
+// Each kernel is first checked against its scalar reference on random levels,
+// at every byte offset so unaligned buffers are covered. Timings are the
+// average of N passes over 512 slots. The per-byte loops are timed twice: as
+// the host compiler vectorizes them with its SIMD unit, and with vectorizing
+// turned off, which is what the S3's toolchain makes of them. For LTP,
+// "sparse" has one channel in 64 changed against the previous frame, the
+// common case of a console nudging a few faders; "dense" changes every
+// channel.
+#include "DmxMerge.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <utility>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t slots = dmx_packet_size;
+// Room for every misalignment of a universe.
+constexpr size_t buf_size = slots + sizeof(uint32_t);
+
+// Keeps the compiler from dropping or hoisting passes whose result is unused.
+inline void clobber() { asm volatile("" : : : "memory"); }
+
+void scalar_htp(uint8_t *dst, const uint8_t *src, const size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    dst[i] = dst[i] > src[i] ? dst[i] : src[i];
+  }
+}
+
+void scalar_ltp(uint8_t *dst, const uint8_t *src, const uint8_t *prev,
+                const size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (src[i] != prev[i]) {
+      dst[i] = src[i];
+    }
+  }
+}
+
+// The same loops, one byte per iteration.
+__attribute__((noinline, optimize("no-tree-vectorize"))) void
+byte_htp(uint8_t *dst, const uint8_t *src, const size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    dst[i] = dst[i] > src[i] ? dst[i] : src[i];
+  }
+}
+
+__attribute__((noinline, optimize("no-tree-vectorize"))) void
+byte_ltp(uint8_t *dst, const uint8_t *src, const uint8_t *prev,
+         const size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (src[i] != prev[i]) {
+      dst[i] = src[i];
+    }
+  }
+}
+
+void fill_random(uint8_t *buf, const size_t len, std::mt19937 &rng) {
+  for (size_t i = 0; i < len; i++) {
+    buf[i] = static_cast<uint8_t>(rng());
+  }
+}
+
+bool verify(std::mt19937 &rng) {
+  uint8_t src[buf_size];
+  uint8_t prev[buf_size];
+  uint8_t base[buf_size];
+  uint8_t got[buf_size];
+  uint8_t want[buf_size];
+  for (size_t offset = 0; offset < sizeof(uint32_t); offset++) {
+    for (size_t len : {slots, slots - 1, size_t{3}, size_t{0}}) {
+      fill_random(src, buf_size, rng);
+      fill_random(base, buf_size, rng);
+      memcpy(prev, src, buf_size);
+      for (size_t i = 0; i < buf_size; i += 5) {
+        prev[i] ^= 0x5A;
+      }
+
+      memcpy(got, base, buf_size);
+      memcpy(want, base, buf_size);
+      dmx_merge_htp(got + offset, src + offset, len);
+      scalar_htp(want + offset, src + offset, len);
+      if (memcmp(got, want, buf_size) != 0) {
+        printf("HTP mismatch at offset %zu, length %zu\n", offset, len);
+        return false;
+      }
+
+      memcpy(got, base, buf_size);
+      memcpy(want, base, buf_size);
+      dmx_merge_ltp(got + offset, src + offset, prev + offset, len);
+      scalar_ltp(want + offset, src + offset, prev + offset, len);
+      if (memcmp(got, want, buf_size) != 0) {
+        printf("LTP mismatch at offset %zu, length %zu\n", offset, len);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+template <typename Pass> double time_ns(const int iterations, Pass &&pass) {
+  // Warm up caches and branch predictors.
+  for (int i = 0; i < iterations / 10; i++) {
+    pass();
+    clobber();
+  }
+  const auto start = Clock::now();
+  for (int i = 0; i < iterations; i++) {
+    pass();
+    clobber();
+  }
+  return std::chrono::duration<double, std::nano>(Clock::now() - start)
+             .count() /
+         iterations;
+}
+
+void report(const char *name, const double kernel_ns, const double byte_ns,
+            const double vector_ns) {
+  printf("%-11s kernel %6.1f ns (%5.3f ns/slot), per-byte %6.1f ns (%4.1fx), "
+         "host-vectorized %6.1f ns\n",
+         name, kernel_ns, kernel_ns / slots, byte_ns, byte_ns / kernel_ns,
+         vector_ns);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int iterations = 1000000;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--iterations" && i + 1 < argc) {
+      iterations = std::max(1, atoi(argv[++i]));
+    }
+  }
+
+  std::mt19937 rng(1);
+  if (!verify(rng)) {
+    return 1;
+  }
+  printf("kernels match the scalar reference at every alignment\n");
+
+  uint8_t dst[slots];
+  uint8_t src[slots];
+  uint8_t prev_sparse[slots];
+  uint8_t prev_dense[slots];
+  fill_random(dst, slots, rng);
+  fill_random(src, slots, rng);
+  memcpy(prev_sparse, src, slots);
+  for (size_t i = 0; i < slots; i += 64) {
+    prev_sparse[i] ^= 1;
+  }
+  for (size_t i = 0; i < slots; i++) {
+    prev_dense[i] = static_cast<uint8_t>(src[i] + 1);
+  }
+
+  printf("%d passes over %zu slots\n", iterations, slots);
+  report("HTP",
+         time_ns(iterations, [&] { dmx_merge_htp(dst, src, slots); }),
+         time_ns(iterations, [&] { byte_htp(dst, src, slots); }),
+         time_ns(iterations, [&] { scalar_htp(dst, src, slots); }));
+  for (const auto &[name, prev] : {std::pair{"LTP sparse", prev_sparse},
+                                   std::pair{"LTP dense", prev_dense}}) {
+    report(name,
+           time_ns(iterations, [&] { dmx_merge_ltp(dst, src, prev, slots); }),
+           time_ns(iterations, [&] { byte_ltp(dst, src, prev, slots); }),
+           time_ns(iterations, [&] { scalar_ltp(dst, src, prev, slots); }));
+  }
+  return 0;
+}
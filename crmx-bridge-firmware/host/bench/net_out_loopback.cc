@@ -0,0 +1,228 @@
+// Network output loopback harness: feeds frames through the switcher into the
+// artnet and sacn sinks and counts what NetworkSender puts on the wire.
+//
+//   net_out_loopback [--rate HZ] [--change-every N] [--seconds S]
+//                    [--static S]
+//
+// The onboard source sends HZ frames a second whose levels change every Nth
+// frame, for S seconds; then it keeps sending unchanged levels for the static
+// period, where only keep-alives should go out. The sender unicasts to
+// 127.0.0.1, where one socket per protocol counts packets and checks their
+// levels. Stopping the sender at the end should terminate the sACN stream.
+#include "DmxSwitcher.h"
+#include "NetworkSender.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Counts {
+  std::atomic<uint32_t> packets{0};
+  std::atomic<uint32_t> terminated{0};
+  // Packets whose levels do not match any look the source sent.
+  std::atomic<uint32_t> corrupt{0};
+  std::atomic<uint32_t> sequence_gaps{0};
+};
+
+int open_socket(const uint16_t port) {
+  const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  const int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  const timeval timeout{.tv_sec = 0, .tv_usec = 50 * 1000};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+  if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    perror("bind");
+    exit(1);
+  }
+  return fd;
+}
+
+// Every look fills all 512 slots with one value, so a packet is intact if its
+// slots all match the first.
+bool is_intact(const uint8_t *slots, const size_t count) {
+  for (size_t i = 1; i < count; i++) {
+    if (slots[i] != slots[0]) {
+      return false;
+    }
+  }
+  return count == dmx_packet_size;
+}
+
+void listen_artnet(const int fd, Counts &counts, std::atomic<bool> &done) {
+  uint8_t buf[1024];
+  uint8_t last_sequence = 0;
+  while (!done) {
+    const ssize_t len = recv(fd, buf, sizeof(buf), 0);
+    if (len < static_cast<ssize_t>(sizeof(ArtDmxHeader))) {
+      continue;
+    }
+    ArtDmxHeader header;
+    memcpy(&header, buf, sizeof(header));
+    counts.packets++;
+    if (last_sequence != 0 && header.sequence != last_sequence % 255 + 1) {
+      counts.sequence_gaps++;
+    }
+    last_sequence = header.sequence;
+    const size_t length = header.length_hi << 8 | header.length_lo;
+    if (!is_intact(buf + sizeof(header), length)) {
+      counts.corrupt++;
+    }
+  }
+}
+
+void listen_sacn(const int fd, Counts &counts, std::atomic<bool> &done) {
+  uint8_t buf[1024];
+  bool first = true;
+  uint8_t last_sequence = 0;
+  while (!done) {
+    const ssize_t len = recv(fd, buf, sizeof(buf), 0);
+    if (len < static_cast<ssize_t>(sizeof(SacnDataHeader))) {
+      continue;
+    }
+    SacnDataHeader header;
+    memcpy(&header, buf, sizeof(header));
+    counts.packets++;
+    if (!first && header.sequence != static_cast<uint8_t>(last_sequence + 1)) {
+      counts.sequence_gaps++;
+    }
+    first = false;
+    last_sequence = header.sequence;
+    if (header.options & sacn_options_terminated) {
+      counts.terminated++;
+    }
+    if (!is_intact(buf + sizeof(header), ntohs(header.property_count) - 1)) {
+      counts.corrupt++;
+    }
+  }
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  double rate_hz = 44;
+  int change_every = 10;
+  double seconds = 5;
+  double static_seconds = 5;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--rate" && i + 1 < argc) {
+      rate_hz = atof(argv[++i]);
+    } else if (arg == "--change-every" && i + 1 < argc) {
+      change_every = std::max(1, atoi(argv[++i]));
+    } else if (arg == "--seconds" && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else if (arg == "--static" && i + 1 < argc) {
+      static_seconds = atof(argv[++i]);
+    }
+  }
+
+  SettingsHandler &settings = SettingsHandler::shared();
+  settings.init();
+  settings.net_out_dest.write(0x7F000001);
+  DmxSwitcher &switcher = DmxSwitcher::get_switcher();
+  switcher.init();
+  switcher.set_output_en(true);
+  switcher.set_src_sink(DmxSourceSink::onboard, DmxSourceSink::artnet);
+  switcher.set_fanout(dmx_source_sink_bit(DmxSourceSink::sacn));
+
+  NetworkSender &sender = NetworkSender::shared();
+  if (sender.init(switcher.get_artnet_interface(),
+                  switcher.get_sacn_interface()) != ESP_OK) {
+    return 1;
+  }
+  sender.on_settings_update(settings);
+
+  std::atomic<bool> done{false};
+  Counts artnet;
+  Counts sacn;
+  const int artnet_fd = open_socket(artnet_port);
+  const int sacn_fd = open_socket(sacn_port);
+  std::thread artnet_listener(listen_artnet, artnet_fd, std::ref(artnet),
+                              std::ref(done));
+  std::thread sacn_listener(listen_sacn, sacn_fd, std::ref(sacn),
+                            std::ref(done));
+
+  if (sender.start() != ESP_OK) {
+    return 1;
+  }
+
+  DmxInterface &source = switcher.get_onboard_interface();
+  DmxPacket packet{};
+  packet.source = DmxSourceSink::onboard;
+  const auto period =
+      std::chrono::microseconds(static_cast<int64_t>(1e6 / rate_hz));
+  const uint32_t changing = static_cast<uint32_t>(seconds * rate_hz);
+  const uint32_t total =
+      changing + static_cast<uint32_t>(static_seconds * rate_hz);
+  uint32_t looks = 0;
+  uint32_t artnet_at_static = 0;
+  uint32_t sacn_at_static = 0;
+  const auto start = Clock::now();
+  for (uint32_t f = 0; f < total; f++) {
+    std::this_thread::sleep_until(start + period * f);
+    if (f == changing) {
+      // Let the last change go out before counting keep-alives.
+      vTaskDelay(pdMS_TO_TICKS(20));
+      artnet_at_static = artnet.packets;
+      sacn_at_static = sacn.packets;
+    }
+    if (f < changing && f % change_every == 0) {
+      packet.full_packet.data.fill(static_cast<uint8_t>(looks * 7 + 1));
+      looks++;
+    }
+    source.send(packet);
+  }
+  const double elapsed =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  vTaskDelay(pdMS_TO_TICKS(100));
+  const NetworkSender::Stats stats = sender.get_stats();
+
+  sender.stop();
+  vTaskDelay(pdMS_TO_TICKS(100));
+  done = true;
+  artnet_listener.join();
+  sacn_listener.join();
+
+  printf("fed %" PRIu32 " frames (%" PRIu32 " looks) in %.2f s\n", total,
+         looks, elapsed);
+  printf("sender: %" PRIu32 " frames, %" PRIu32 " unchanged, %" PRIu32
+         " changes, %" PRIu32 " keepalives, %" PRIu32 " busy, %" PRIu32
+         " send errors\n",
+         stats.frames, stats.unchanged, stats.changes, stats.keepalives,
+         stats.busy, stats.send_errors);
+  const uint32_t artnet_static = artnet_at_static == 0
+                                     ? 0
+                                     : artnet.packets - artnet_at_static;
+  const uint32_t sacn_static =
+      sacn_at_static == 0 ? 0 : sacn.packets - sacn_at_static - sacn.terminated;
+  printf("Art-Net: %" PRIu32 " packets (%" PRIu32 " in %.1f s static), %" PRIu32
+         " corrupt, %" PRIu32 " sequence gaps\n",
+         artnet.packets.load(), artnet_static, static_seconds,
+         artnet.corrupt.load(), artnet.sequence_gaps.load());
+  printf("sACN: %" PRIu32 " packets (%" PRIu32 " in %.1f s static), %" PRIu32
+         " terminated, %" PRIu32 " corrupt, %" PRIu32 " sequence gaps\n",
+         sacn.packets.load(), sacn_static, static_seconds,
+         sacn.terminated.load(), sacn.corrupt.load(),
+         sacn.sequence_gaps.load());
+  printf("packets per frame fed: Art-Net %.3f, sACN %.3f\n",
+         static_cast<double>(artnet.packets) / total,
+         static_cast<double>(sacn.packets) / total);
+
+  close(artnet_fd);
+  close(sacn_fd);
+  return 0;
+}
@@ -0,0 +1,187 @@
+// Patch stage benchmark: compiles typical and worst-case patches and times
+// DmxPatch::apply over a full universe, against a per-channel lookup table.
+//
+//   patch_apply [--iterations N]
+//
+// Patches timed:
+//   typical    a few block moves, an offset fixture and a blocked range
+//   max rules  dmx_patch_max_rules single-channel swaps spread over the
+//              universe, the most runs rules can produce
+//   scrambled  every output channel reading an unrelated input, one run per
+//              channel; more than the rule limit allows, loaded straight into
+//              the span table to bound the stage
+// Every compiled patch is checked against the per-channel map it came from.
+#include "DmxPatch.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t slots = dmx_patch_channels;
+// What the per-channel table stores for a blocked output.
+constexpr uint16_t blocked = UINT16_MAX;
+
+using ChannelMap = std::array<uint16_t, slots>;
+
+inline void clobber() { asm volatile("" : : : "memory"); }
+
+// Apply a per-channel table, the uncompiled form of a patch.
+__attribute__((noinline)) void apply_map(const ChannelMap &map,
+                                         const uint8_t *in, uint8_t *out) {
+  for (size_t i = 0; i < slots; i++) {
+    out[i] = map[i] == blocked ? 0 : in[map[i]];
+  }
+}
+
+// Resolves rules the way DmxPatch::compile documents them.
+ChannelMap resolve(const std::vector<DmxPatchRule> &rules) {
+  ChannelMap map;
+  for (size_t i = 0; i < slots; i++) {
+    map[i] = static_cast<uint16_t>(i);
+  }
+  for (const DmxPatchRule &rule : rules) {
+    for (size_t k = 0; k < rule.count; k++) {
+      map[rule.dst - 1 + k] =
+          rule.src == 0 ? blocked : static_cast<uint16_t>(rule.src - 1 + k);
+    }
+  }
+  return map;
+}
+
+// Loads a per-channel table as one span per channel, which compile() never
+// produces from dmx_patch_max_rules rules.
+class ScrambledPatch : public DmxPatch {
+public:
+  explicit ScrambledPatch(const ChannelMap &map) {
+    for (size_t i = 0; i < slots; i++) {
+      spans[i] = Span{.dst = static_cast<uint16_t>(i), .src = map[i], .len = 1};
+    }
+    span_count = slots;
+    identity = false;
+  }
+};
+
+std::vector<DmxPatchRule> typical_rules() {
+  return {
+      // Two fixtures moved up a block, one offset by a channel.
+      {.dst = 1, .src = 101, .count = 48},
+      {.dst = 49, .src = 201, .count = 48},
+      {.dst = 300, .src = 301, .count = 24},
+      // Hazer blocked.
+      {.dst = 500, .src = 0, .count = 13},
+  };
+}
+
+std::vector<DmxPatchRule> max_rules() {
+  // Each single-channel rule cuts the straight-through run in two.
+  std::vector<DmxPatchRule> rules;
+  for (size_t r = 0; r < dmx_patch_max_rules; r++) {
+    const uint16_t dst = static_cast<uint16_t>(1 + r * 16);
+    rules.push_back({.dst = dst,
+                     .src = static_cast<uint16_t>(slots - r * 16),
+                     .count = 1});
+  }
+  return rules;
+}
+
+bool check(const char *name, const DmxPatch &patch, const ChannelMap &map,
+           std::mt19937 &rng) {
+  uint8_t in[slots];
+  uint8_t got[slots];
+  uint8_t want[slots];
+  for (uint8_t &level : in) {
+    level = static_cast<uint8_t>(rng());
+  }
+  memset(got, 0xAA, slots);
+  patch.apply(in, got);
+  apply_map(map, in, want);
+  if (memcmp(got, want, slots) != 0) {
+    printf("%s: compiled patch differs from its channel map\n", name);
+    return false;
+  }
+  return true;
+}
+
+template <typename Pass> double time_ns(const int iterations, Pass &&pass) {
+  for (int i = 0; i < iterations / 10; i++) {
+    pass();
+    clobber();
+  }
+  const auto start = Clock::now();
+  for (int i = 0; i < iterations; i++) {
+    pass();
+    clobber();
+  }
+  return std::chrono::duration<double, std::nano>(Clock::now() - start)
+             .count() /
+         iterations;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int iterations = 1000000;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--iterations" && i + 1 < argc) {
+      iterations = std::max(1, atoi(argv[++i]));
+    }
+  }
+
+  std::mt19937 rng(1);
+
+  const std::vector<DmxPatchRule> typical = typical_rules();
+  const std::vector<DmxPatchRule> most = max_rules();
+  DmxPatch typical_patch;
+  DmxPatch most_patch;
+  if (typical_patch.compile(typical.data(), typical.size()) != ESP_OK ||
+      most_patch.compile(most.data(), most.size()) != ESP_OK) {
+    return 1;
+  }
+
+  ChannelMap scrambled_map;
+  for (size_t i = 0; i < slots; i++) {
+    scrambled_map[i] = static_cast<uint16_t>(i);
+  }
+  std::shuffle(scrambled_map.begin(), scrambled_map.end(), rng);
+  const ScrambledPatch scrambled_patch(scrambled_map);
+
+  struct Case {
+    const char *name;
+    const DmxPatch &patch;
+    ChannelMap map;
+  };
+  const Case cases[] = {
+      {"typical", typical_patch, resolve(typical)},
+      {"max rules", most_patch, resolve(most)},
+      {"scrambled", scrambled_patch, scrambled_map},
+  };
+
+  uint8_t in[slots];
+  uint8_t out[slots];
+  for (uint8_t &level : in) {
+    level = static_cast<uint8_t>(rng());
+  }
+
+  printf("%d applications of a %zu-slot universe\n", iterations, slots);
+  for (const Case &c : cases) {
+    if (!check(c.name, c.patch, c.map, rng)) {
+      return 1;
+    }
+    const double patch_ns =
+        time_ns(iterations, [&] { c.patch.apply(in, out); });
+    const double map_ns =
+        time_ns(iterations, [&] { apply_map(c.map, in, out); });
+    printf("%-10s %3zu runs: apply %7.1f ns, per-channel table %7.1f ns "
+           "(%4.1fx)\n",
+           c.name, c.patch.get_span_count(), patch_ns, map_ns,
+           map_ns / patch_ns);
+  }
+  return 0;
+}
@@ -0,0 +1,180 @@
+// RPC coalescing harness: drives DmxSwitcher::set_dmx_value the way a burst
+// of set_dmx_channel RPCs would and counts the frames that come out.
+//
+//   rpc_coalesce [--burst N] [--rate HZ] [--seconds S]
+//
+// The RPC universe is routed from the artnet source to the CRMX sink, where a
+// drain thread counts frames and keeps the last one. The run has three
+// phases: N updates back to back, updates paced at HZ for S seconds, and
+// isolated updates spaced well apart, each of which should still go out in a
+// frame of its own. After every phase the last frame out must carry the
+// latest level of every slot.
+#include "DmxSwitcher.h"
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Sink {
+  std::atomic<uint32_t> frames{0};
+  std::mutex mtx;
+  std::array<uint8_t, dmx_packet_size> last{};
+};
+
+struct Phase {
+  const char *name;
+  uint32_t updates;
+  uint32_t frames_out;
+  uint32_t frames_in;
+  double seconds;
+  bool latest;
+};
+
+class Bench {
+public:
+  Bench(DmxSwitcher &_switcher, Sink &_sink)
+      : switcher(_switcher), sink(_sink) {}
+
+  // Sets the next slot to a new level and remembers it.
+  void update() {
+    const int address = static_cast<int>(next % dmx_packet_size) + 1;
+    const uint8_t level = static_cast<uint8_t>(next * 7 + 1);
+    if (switcher.set_dmx_value(address, level) == ESP_OK) {
+      expected[address - 1] = level;
+    } else {
+      failed++;
+    }
+    next++;
+  }
+
+  template <typename Drive> Phase run(const char *name, Drive &&drive) {
+    const DmxSwitcher::Stats before = switcher.get_stats();
+    const uint32_t frames_before = sink.frames;
+    const auto start = Clock::now();
+    drive();
+    const double elapsed =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    // Let the last publish go out.
+    vTaskDelay(pdMS_TO_TICKS(100));
+    const DmxSwitcher::Stats after = switcher.get_stats();
+    std::lock_guard<std::mutex> lk(sink.mtx);
+    return Phase{.name = name,
+                 .updates = after.rpc_updates - before.rpc_updates,
+                 .frames_out = after.rpc_frames - before.rpc_frames,
+                 .frames_in = sink.frames - frames_before,
+                 .seconds = elapsed,
+                 .latest = sink.last == expected};
+  }
+
+  uint32_t failed = 0;
+
+private:
+  DmxSwitcher &switcher;
+  Sink &sink;
+  std::array<uint8_t, dmx_packet_size> expected{};
+  uint32_t next = 0;
+};
+
+// At most one frame per output period, plus one for the trailing edge.
+void print(const Phase &phase, const uint32_t period_us) {
+  const uint32_t bound =
+      static_cast<uint32_t>(phase.seconds * 1e6 / period_us) + 2;
+  printf("%-9s %7" PRIu32 " updates in %6.3f s -> %5" PRIu32
+         " frames out (bound %" PRIu32 "), %5" PRIu32
+         " at sink, %7.1f updates/frame, latest levels %s\n",
+         phase.name, phase.updates, phase.seconds, phase.frames_out, bound,
+         phase.frames_in,
+         phase.frames_out ? static_cast<double>(phase.updates) /
+                                phase.frames_out
+                          : 0.0,
+         phase.latest ? "ok" : "MISMATCH");
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  uint32_t burst = 20000;
+  double rate_hz = 1000;
+  double seconds = 3;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--burst" && i + 1 < argc) {
+      burst = static_cast<uint32_t>(atoi(argv[++i]));
+    } else if (arg == "--rate" && i + 1 < argc) {
+      rate_hz = atof(argv[++i]);
+    } else if (arg == "--seconds" && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    }
+  }
+
+  SettingsHandler &settings = SettingsHandler::shared();
+  settings.init();
+  DmxSwitcher &switcher = DmxSwitcher::get_switcher();
+  switcher.init();
+  switcher.on_settings_update(settings);
+  switcher.set_output_en(true);
+  switcher.set_src_sink(DmxSourceSink::artnet, DmxSourceSink::timo);
+
+  std::atomic<bool> done{false};
+  Sink sink;
+  DmxInterface &timo = switcher.get_timo_interface();
+  std::thread drain([&] {
+    while (!done) {
+      DmxFrameRef frame = timo.recieve(pdMS_TO_TICKS(20));
+      if (!frame) {
+        continue;
+      }
+      {
+        std::lock_guard<std::mutex> lk(sink.mtx);
+        sink.last = frame->full_packet.data;
+      }
+      sink.frames++;
+      timo.complete(frame);
+    }
+  });
+
+  Bench bench(switcher, sink);
+  const Phase back_to_back = bench.run("burst", [&] {
+    for (uint32_t i = 0; i < burst; i++) {
+      bench.update();
+    }
+  });
+
+  const Phase paced = bench.run("paced", [&] {
+    const auto period =
+        std::chrono::microseconds(static_cast<int64_t>(1e6 / rate_hz));
+    const uint32_t count = static_cast<uint32_t>(seconds * rate_hz);
+    const auto start = Clock::now();
+    for (uint32_t i = 0; i < count; i++) {
+      std::this_thread::sleep_until(start + period * i);
+      bench.update();
+    }
+  });
+
+  // Spaced by more than an output period, so nothing should coalesce.
+  const Phase isolated = bench.run("isolated", [&] {
+    for (int i = 0; i < 20; i++) {
+      bench.update();
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+  });
+
+  done = true;
+  drain.join();
+
+  const uint32_t period_us =
+      dmx_packet_time_us(dmx_packet_size, dmx_timing(settings.dmx_timing));
+  printf("output period %" PRIu32 " us (%.1f Hz)\n", period_us,
+         1e6 / period_us);
+  print(back_to_back, period_us);
+  print(paced, period_us);
+  print(isolated, period_us);
+  printf("%" PRIu32 " updates failed\n", bench.failed);
+  return 0;
+}
@@ -0,0 +1,264 @@
+// sACN loopback harness: sends E1.31 data into SacnReceiver over the host's
+// loopback interface and measures what comes out of the switcher.
+//
+//   sacn_loopback [--universes N] [--rate HZ] [--seconds S]
+//
+// sACN universe 1 is the primary input and feeds the CRMX sink; universes
+// 2..N are routed back out of the artnet sink's ports, where drain threads
+// count what reaches them. Every universe has two sources at priority 100
+// sending HZ frames each, and universe 1 also has one at priority 150.
+//
+// The run has three phases: all sources send, so frames should carry the
+// high-priority levels on universe 1 and the HTP merge elsewhere; the
+// high-priority source then terminates its stream and universe 1 falls back
+// to the merge; finally everything goes quiet and the remaining sources
+// should expire after the E1.31 timeout.
+#include "DmxSwitcher.h"
+#include "SacnReceiver.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr uint16_t primary_universe = 1;
+// Levels sent by the two equal sources and the high-priority one. The HTP
+// merge of the first two is 0x40 on even slots and 0xC0 on odd ones.
+constexpr uint8_t level_a = 0x40;
+constexpr uint8_t level_b_even = 0x20;
+constexpr uint8_t level_b_odd = 0xC0;
+constexpr uint8_t level_high = 0xFF;
+
+struct Sender {
+  uint16_t universe;
+  uint8_t priority;
+  uint8_t cid_tag;
+  uint8_t sequence;
+};
+
+uint16_t flags_length(const size_t length) {
+  return htons(0x7000 | static_cast<uint16_t>(length));
+}
+
+std::vector<uint8_t> make_data(Sender &sender, const uint8_t options) {
+  const size_t slots = dmx_packet_size;
+  std::vector<uint8_t> packet(sizeof(SacnDataHeader) + slots);
+  SacnDataHeader header{};
+  header.preamble_size = htons(0x0010);
+  memcpy(header.acn_id, "ASC-E1.17\0\0\0", 12);
+  header.root_flags_length = flags_length(packet.size() - 16);
+  header.root_vector = htonl(sacn_vector_root_data);
+  memset(header.cid, sender.cid_tag, sizeof(header.cid));
+  header.frame_flags_length = flags_length(packet.size() - 38);
+  header.frame_vector = htonl(sacn_vector_frame_data);
+  snprintf(header.source_name, sizeof(header.source_name), "bench %u",
+           sender.cid_tag);
+  header.priority = sender.priority;
+  header.sequence = sender.sequence++;
+  header.options = options;
+  header.universe = htons(sender.universe);
+  header.dmp_flags_length = flags_length(packet.size() - 115);
+  header.dmp_vector = sacn_vector_dmp_set_property;
+  header.address_data_type = 0xA1;
+  header.address_increment = htons(1);
+  header.property_count = htons(slots + 1);
+  header.start_code = 0;
+  memcpy(packet.data(), &header, sizeof(header));
+
+  uint8_t *levels = packet.data() + sizeof(header);
+  for (size_t i = 0; i < slots; i++) {
+    switch (sender.cid_tag % 3) {
+    case 0:
+      levels[i] = level_a;
+      break;
+    case 1:
+      levels[i] = i % 2 ? level_b_odd : level_b_even;
+      break;
+    default:
+      levels[i] = level_high;
+      break;
+    }
+  }
+  return packet;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int universes = 4;
+  double rate_hz = 44;
+  double seconds = 5;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--universes" && i + 1 < argc) {
+      universes = atoi(argv[++i]);
+    } else if (arg == "--rate" && i + 1 < argc) {
+      rate_hz = atof(argv[++i]);
+    } else if (arg == "--seconds" && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    }
+  }
+  if (universes < 1 || universes > static_cast<int>(dmx_universe_max)) {
+    fprintf(stderr, "--universes must be 1-%zu\n", dmx_universe_max);
+    return 1;
+  }
+
+  SettingsHandler &settings = SettingsHandler::shared();
+  settings.init();
+  settings.input.write(DmxSourceSink::sacn);
+  settings.sacn_universe.write(primary_universe);
+  DmxSwitcher &switcher = DmxSwitcher::get_switcher();
+  switcher.init();
+  switcher.set_output_en(true);
+  switcher.set_src_sink(DmxSourceSink::sacn, DmxSourceSink::timo);
+  std::vector<DmxRoute> routes;
+  for (uint16_t u = 1; u < universes; u++) {
+    routes.push_back(DmxRoute{.src = DmxSourceSink::sacn,
+                              .src_universe = static_cast<uint16_t>(
+                                  primary_universe + u),
+                              .sink = DmxSourceSink::artnet,
+                              .sink_universe = u});
+  }
+  switcher.set_routes(routes);
+
+  SacnReceiver &receiver = SacnReceiver::shared();
+  receiver.on_settings_update(settings);
+  if (receiver.start(switcher.get_sacn_interface()) != ESP_OK) {
+    return 1;
+  }
+  // Let the first membership check pick up the routes.
+  vTaskDelay(pdMS_TO_TICKS(500));
+
+  // Frames per port by what they carry.
+  std::atomic<bool> done{false};
+  std::array<std::atomic<uint32_t>, dmx_universe_max> high{};
+  std::array<std::atomic<uint32_t>, dmx_universe_max> merged{};
+  std::array<std::atomic<uint32_t>, dmx_universe_max> other{};
+  std::vector<std::thread> drains;
+  for (size_t port = 0; port < dmx_universe_max; port++) {
+    DmxInterface &sink = port == 0 ? switcher.get_timo_interface()
+                                   : switcher.get_artnet_interface();
+    drains.emplace_back([&, port, sink_ptr = &sink] {
+      while (!done) {
+        DmxFrameRef frame = sink_ptr->recieve(pdMS_TO_TICKS(20), port);
+        if (!frame) {
+          continue;
+        }
+        const auto &data = frame->full_packet.data;
+        if (data[100] == level_high && data[101] == level_high) {
+          high[port]++;
+        } else if (data[100] == level_a && data[101] == level_b_odd) {
+          merged[port]++;
+        } else {
+          other[port]++;
+        }
+        sink_ptr->complete(frame, port);
+      }
+    });
+  }
+
+  std::vector<Sender> senders;
+  for (int u = 0; u < universes; u++) {
+    const uint16_t number = static_cast<uint16_t>(primary_universe + u);
+    senders.push_back(Sender{number, 100, static_cast<uint8_t>(u * 3), 0});
+    senders.push_back(Sender{number, 100, static_cast<uint8_t>(u * 3 + 1), 0});
+  }
+  Sender high_sender{primary_universe, 150, 2, 0};
+
+  const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in to{};
+  to.sin_family = AF_INET;
+  to.sin_port = htons(sacn_port);
+  inet_pton(AF_INET, "127.0.0.1", &to.sin_addr);
+  auto send = [&](const std::vector<uint8_t> &packet) {
+    sendto(fd, packet.data(), packet.size(), 0,
+           reinterpret_cast<sockaddr *>(&to), sizeof(to));
+  };
+
+  // Phases 1 and 2, split at half time.
+  const SacnReceiver::Stats before = receiver.get_stats();
+  const auto period =
+      std::chrono::microseconds(static_cast<int64_t>(1e6 / rate_hz));
+  const uint32_t frames = static_cast<uint32_t>(seconds * rate_hz);
+  size_t sent = 0;
+  std::array<uint32_t, dmx_universe_max> high_at_switch{};
+  std::array<uint32_t, dmx_universe_max> merged_at_switch{};
+  const auto start = Clock::now();
+  for (uint32_t f = 0; f < frames; f++) {
+    std::this_thread::sleep_until(start + period * f);
+    if (f == frames / 2) {
+      // E1.31 asks for three terminated packets.
+      for (int i = 0; i < 3; i++) {
+        send(make_data(high_sender, sacn_options_terminated));
+        sent++;
+      }
+      vTaskDelay(pdMS_TO_TICKS(20));
+      for (size_t port = 0; port < dmx_universe_max; port++) {
+        high_at_switch[port] = high[port];
+        merged_at_switch[port] = merged[port];
+      }
+    }
+    if (f < frames / 2) {
+      send(make_data(high_sender, 0));
+      sent++;
+    }
+    for (Sender &sender : senders) {
+      send(make_data(sender, 0));
+      sent++;
+    }
+  }
+  const double elapsed =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  vTaskDelay(pdMS_TO_TICKS(100));
+  const SacnReceiver::Stats sending = receiver.get_stats();
+
+  // Phase 3: silence until the sources expire.
+  std::this_thread::sleep_for(std::chrono::microseconds(
+      sacn_source_timeout_us + 2 * 250 * 1000));
+  done = true;
+  for (std::thread &drain : drains) {
+    drain.join();
+  }
+
+  const SacnReceiver::Stats stats = receiver.get_stats();
+  const uint32_t received = sending.packets - before.packets;
+  printf("sent %zu packets in %.2f s (%.1f pkt/s)\n", sent, elapsed,
+         sent / elapsed);
+  printf("received %" PRIu32 " (%.1f pkt/s), drop rate %.3f%%\n", received,
+         received / elapsed, 100.0 * (sent - received) / sent);
+  printf("frames %" PRIu32 ", groups %" PRIu32 ", filtered %" PRIu32
+         ", out of order %" PRIu32 ", malformed %" PRIu32 ", ignored %" PRIu32
+         ", no frame %" PRIu32 "\n",
+         stats.dmx_frames, stats.groups_joined, stats.filtered,
+         stats.out_of_order, stats.malformed, stats.ignored, stats.no_frame);
+  printf("sources terminated %" PRIu32 ", expired %" PRIu32
+         ", rejected %" PRIu32 "\n",
+         stats.sources_terminated, stats.sources_expired,
+         stats.sources_rejected);
+  printf("parse time p50 %" PRIu32 " us, p99 %" PRIu32 " us, max %" PRIu32
+         " us\n",
+         stats.parse_time.p50_us, stats.parse_time.p99_us,
+         stats.parse_time.max_us);
+  for (int port = 0; port < universes; port++) {
+    printf("universe %d: before termination %" PRIu32 " high, %" PRIu32
+           " merged; after %" PRIu32 " high, %" PRIu32 " merged; %" PRIu32
+           " other\n",
+           primary_universe + port, high_at_switch[port],
+           merged_at_switch[port], high[port] - high_at_switch[port],
+           merged[port] - merged_at_switch[port], other[port].load());
+  }
+
+  close(fd);
+  receiver.stop();
+  return 0;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// Placement attributes have no meaning on the host.
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define WORD_ALIGNED_ATTR __attribute__((aligned(4)))
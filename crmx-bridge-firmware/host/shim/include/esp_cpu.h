@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t esp_cpu_cycle_count_t;
+
+// Emulates a 160 MHz cycle counter from the monotonic clock.
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,4 @@
+#pragma once
+
+// Interrupt allocation flags; the shim's ISRs ignore them.
+#define ESP_INTR_FLAG_IRAM (1 << 10)
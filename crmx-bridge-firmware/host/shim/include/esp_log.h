@@ -0,0 +1,39 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  ESP_LOG_NONE,
+  ESP_LOG_ERROR,
+  ESP_LOG_WARN,
+  ESP_LOG_INFO,
+  ESP_LOG_DEBUG,
+  ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+// Messages above this level are dropped. Defaults to ESP_LOG_INFO.
+extern esp_log_level_t host_log_level;
+
+void host_log_write(esp_log_level_t level, char letter, const char *tag,
+                    const char *format, ...)
+    __attribute__((format(printf, 4, 5)));
+
+#ifdef __cplusplus
+}
+#endif
+
+#define ESP_LOGE(tag, format, ...)                                             \
+  host_log_write(ESP_LOG_ERROR, 'E', tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)                                             \
+  host_log_write(ESP_LOG_WARN, 'W', tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)                                             \
+  host_log_write(ESP_LOG_INFO, 'I', tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)                                             \
+  host_log_write(ESP_LOG_DEBUG, 'D', tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...)                                             \
+  host_log_write(ESP_LOG_VERBOSE, 'V', tag, format, ##__VA_ARGS__)
@@ -0,0 +1,140 @@
+#pragma once
+
+/**
+ * Minimal FreeRTOS API shim for host (Linux) builds of the data plane.
+ *
+ * Tasks map onto std::thread, queues and semaphores onto a mutex/condvar pair
+ * and the tick counter onto a 1 kHz steady clock. Only the subset of the API
+ * used by the firmware is provided; semantics match ESP-IDF FreeRTOS closely
+ * enough for latency and throughput measurements, not for scheduling studies.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t StackType_t;
+
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(xTimeInMs)                                               \
+  ((TickType_t)(((TickType_t)(xTimeInMs) * (TickType_t)configTICK_RATE_HZ) /   \
+                (TickType_t)1000U))
+#define pdTICKS_TO_MS(xTicks)                                                  \
+  ((TickType_t)(((uint64_t)(xTicks) * 1000U) / configTICK_RATE_HZ))
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdFAIL (pdFALSE)
+#define pdPASS (pdTRUE)
+
+#define tskNO_AFFINITY ((BaseType_t)0x7fffffff)
+
+#define portYIELD_FROM_ISR(x) ((void)(x))
+#define portMUX_INITIALIZER_UNLOCKED {}
+
+typedef struct HostTask *TaskHandle_t;
+typedef struct HostQueue *QueueHandle_t;
+typedef struct HostQueue *SemaphoreHandle_t;
+typedef struct HostTimer *TimerHandle_t;
+
+typedef void (*TaskFunction_t)(void *);
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t);
+
+typedef enum {
+  eNoAction = 0,
+  eSetBits,
+  eIncrement,
+  eSetValueWithOverwrite,
+  eSetValueWithoutOverwrite,
+} eNotifyAction;
+
+// Tasks
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+                                   uint32_t stack_depth, void *params,
+                                   UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core_id);
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name,
+                       uint32_t stack_depth, void *params,
+                       UBaseType_t priority, TaskHandle_t *handle);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+BaseType_t xTaskDelayUntil(TickType_t *prev_wake, TickType_t increment);
+#define vTaskDelayUntil(prev, inc) ((void)xTaskDelayUntil((prev), (inc)))
+TickType_t xTaskGetTickCount(void);
+TickType_t xTaskGetTickCountFromISR(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+BaseType_t xTaskGenericNotify(TaskHandle_t task, uint32_t value,
+                              eNotifyAction action, uint32_t *prev_value);
+BaseType_t xTaskGenericNotifyFromISR(TaskHandle_t task, uint32_t value,
+                                     eNotifyAction action,
+                                     uint32_t *prev_value,
+                                     BaseType_t *higher_prio_woken);
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit,
+                           uint32_t *value, TickType_t timeout);
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t timeout);
+
+#define xTaskNotify(task, value, action)                                       \
+  xTaskGenericNotify((task), (value), (action), NULL)
+#define xTaskNotifyFromISR(task, value, action, woken)                         \
+  xTaskGenericNotifyFromISR((task), (value), (action), NULL, (woken))
+#define xTaskNotifyGive(task) xTaskGenericNotify((task), 0, eIncrement, NULL)
+#define vTaskNotifyGiveFromISR(task, woken)                                    \
+  ((void)xTaskGenericNotifyFromISR((task), 0, eIncrement, NULL, (woken)))
+
+// Queues
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item,
+                      TickType_t timeout);
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item,
+                             BaseType_t *higher_prio_woken);
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t timeout);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+#define xQueueSendToBack xQueueSend
+
+// Semaphores
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t init);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t timeout);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem,
+                                 BaseType_t *higher_prio_woken);
+#define vSemaphoreDelete(sem) vQueueDelete(sem)
+
+// Critical sections are process-wide on the host.
+typedef struct {
+  int unused;
+} portMUX_TYPE;
+void vHostEnterCritical(void);
+void vHostExitCritical(void);
+#define portENTER_CRITICAL(mux) vHostEnterCritical()
+#define portEXIT_CRITICAL(mux) vHostExitCritical()
+#define portENTER_CRITICAL_ISR(mux) vHostEnterCritical()
+#define portEXIT_CRITICAL_ISR(mux) vHostExitCritical()
+
+// Software timers
+TimerHandle_t xTimerCreate(const char *name, TickType_t period,
+                           UBaseType_t auto_reload, void *id,
+                           TimerCallbackFunction_t callback);
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t timeout);
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t timeout);
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t timeout);
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period,
+                              TickType_t timeout);
+void *pvTimerGetTimerID(TimerHandle_t timer);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+
+// The host, like the target, is little endian.
+#define lwip_htons(x) ((uint16_t)__builtin_bswap16(x))
+#define lwip_ntohs(x) ((uint16_t)__builtin_bswap16(x))
+#define lwip_htonl(x) ((uint32_t)__builtin_bswap32(x))
+#define lwip_ntohl(x) ((uint32_t)__builtin_bswap32(x))
+#define PP_HTONL(x) ((uint32_t)__builtin_bswap32(x))
+#define PP_HTONS(x) ((uint16_t)__builtin_bswap16(x))
+#define PP_NTOHS(x) ((uint16_t)__builtin_bswap16(x))
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int8_t err_t;
+
+#define ERR_OK 0
+#define ERR_MEM -1
+#define ERR_BUF -2
+#define ERR_RTE -4
+#define ERR_VAL -6
+#define ERR_USE -8
+#define ERR_ARG -16
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "lwip/err.h"
+#include "lwip/ip_addr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Memberships are taken on a host socket where the host allows it; loopback
+// generators can simply send unicast. Only call from the tcpip thread.
+err_t igmp_joingroup(const ip4_addr_t *ifaddr, const ip4_addr_t *groupaddr);
+err_t igmp_leavegroup(const ip4_addr_t *ifaddr, const ip4_addr_t *groupaddr);
+
+#ifdef __cplusplus
+}
+#endif
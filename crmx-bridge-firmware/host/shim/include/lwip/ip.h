@@ -0,0 +1,22 @@
+#pragma once
+
+#include "lwip/ip_addr.h"
+#include "lwip/netif.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SOF_REUSEADDR 0x04U
+#define SOF_BROADCAST 0x20U
+
+#define ip_set_option(pcb, opt)                                                \
+  ((pcb)->so_options = (u8_t)((pcb)->so_options | (opt)))
+
+// The loopback interface everything arrives on: 127.0.0.1 with a locally
+// administered MAC. Only valid inside a receive callback, as on target.
+struct netif *ip_current_input_netif(void);
+
+#ifdef __cplusplus
+}
+#endif
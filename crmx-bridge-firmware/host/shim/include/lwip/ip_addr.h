@@ -0,0 +1,61 @@
+#pragma once
+
+#include "lwip/def.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+
+// Addresses are kept in network byte order, as in lwIP. Only IPv4 exists.
+typedef struct ip4_addr {
+  u32_t addr;
+} ip4_addr_t;
+
+typedef struct ip_addr {
+  union {
+    ip4_addr_t ip4;
+  } u_addr;
+  u8_t type;
+} ip_addr_t;
+
+#define IPADDR_TYPE_V4 0U
+
+#define IPADDR4_INIT(u32val)                                                   \
+  {                                                                            \
+    {{u32val}}, IPADDR_TYPE_V4                                                 \
+  }
+
+#define LWIP_MAKEU32(a, b, c, d)                                               \
+  (((u32_t)((a) & 0xff) << 24) | ((u32_t)((b) & 0xff) << 16) |                 \
+   ((u32_t)((c) & 0xff) << 8) | (u32_t)((d) & 0xff))
+
+#define IP4_ADDR(ipaddr, a, b, c, d)                                           \
+  (ipaddr)->addr = PP_HTONL(LWIP_MAKEU32(a, b, c, d))
+#define IP_ADDR4(ipaddr, a, b, c, d)                                           \
+  do {                                                                         \
+    IP4_ADDR(&(ipaddr)->u_addr.ip4, a, b, c, d);                               \
+    (ipaddr)->type = IPADDR_TYPE_V4;                                           \
+  } while (0)
+#define ip4_addr_get_u32(src_ipaddr) ((src_ipaddr)->addr)
+#define ip4_addr_set_u32(dest_ipaddr, src_u32) ((dest_ipaddr)->addr = (src_u32))
+#define ip_2_ip4(ipaddr) (&((ipaddr)->u_addr.ip4))
+#define IP_IS_V4(ipaddr) ((ipaddr)->type == IPADDR_TYPE_V4)
+#define ip_addr_copy(dest, src) ((dest) = (src))
+#define ip_addr_cmp(addr1, addr2)                                              \
+  ((addr1)->u_addr.ip4.addr == (addr2)->u_addr.ip4.addr)
+
+extern const ip_addr_t ip_addr_any;
+extern const ip_addr_t ip_addr_broadcast;
+#define IP_ADDR_ANY (&ip_addr_any)
+#define IP4_ADDR_ANY (&ip_addr_any)
+#define IP4_ADDR_ANY4 (ip_2_ip4(&ip_addr_any))
+#define IP_ADDR_BROADCAST (&ip_addr_broadcast)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "lwip/ip_addr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NETIF_MAX_HWADDR_LEN 6U
+
+struct netif {
+  ip_addr_t ip_addr;
+  ip_addr_t netmask;
+  ip_addr_t gw;
+  u8_t hwaddr[NETIF_MAX_HWADDR_LEN];
+  u8_t hwaddr_len;
+};
+
+// The loopback interface described in lwip/ip.h, once the tcpip thread runs.
+extern struct netif *netif_default;
+
+#define netif_ip4_addr(netif)                                                  \
+  ((const ip4_addr_t *)ip_2_ip4(&((netif)->ip_addr)))
+
+#ifdef __cplusplus
+}
+#endif
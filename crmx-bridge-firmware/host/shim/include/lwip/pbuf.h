@@ -0,0 +1,51 @@
+#pragma once
+
+#include "lwip/err.h"
+#include "lwip/ip_addr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  PBUF_TRANSPORT,
+  PBUF_IP,
+  PBUF_LINK,
+  PBUF_RAW,
+} pbuf_layer;
+
+typedef enum {
+  PBUF_RAM,
+  PBUF_ROM,
+  PBUF_REF,
+  PBUF_POOL,
+} pbuf_type;
+
+// PBUF_POOL buffers are small enough that a full Art-Net or sACN frame
+// arrives as a chain, so parsers are exercised on chained pbufs.
+#define PBUF_POOL_BUFSIZE 256
+
+struct pbuf {
+  struct pbuf *next;
+  void *payload;
+  u16_t tot_len;
+  u16_t len;
+  u8_t type_internal;
+  u8_t flags;
+  u16_t ref;
+};
+
+struct pbuf *pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type);
+// Returns the number of pbufs freed, i.e. 0 while references remain.
+u8_t pbuf_free(struct pbuf *p);
+void pbuf_ref(struct pbuf *p);
+u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len,
+                        u16_t offset);
+u8_t pbuf_get_at(const struct pbuf *p, u16_t offset);
+err_t pbuf_take(struct pbuf *buf, const void *dataptr, u16_t len);
+err_t pbuf_take_at(struct pbuf *buf, const void *dataptr, u16_t len,
+                   u16_t offset);
+
+#ifdef __cplusplus
+}
+#endif
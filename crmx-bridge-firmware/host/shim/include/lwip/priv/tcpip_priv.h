@@ -0,0 +1,20 @@
+#pragma once
+
+#include "lwip/err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Callers embed this as the first member of their own call struct.
+struct tcpip_api_call_data {
+  err_t err;
+};
+typedef err_t (*tcpip_api_call_fn)(struct tcpip_api_call_data *call);
+
+// Runs fn on the tcpip thread and blocks until it has returned.
+err_t tcpip_api_call(tcpip_api_call_fn fn, struct tcpip_api_call_data *call);
+
+#ifdef __cplusplus
+}
+#endif
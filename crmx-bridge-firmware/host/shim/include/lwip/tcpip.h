@@ -0,0 +1,24 @@
+#pragma once
+
+#include "lwip/err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*tcpip_callback_fn)(void *ctx);
+
+// Runs function on the tcpip thread, which the shim starts on first use.
+err_t tcpip_callback(tcpip_callback_fn function, void *ctx);
+
+// Preallocated callback messages, for callers that post the same callback
+// often. A message must not be posted again before it has run.
+struct tcpip_callback_msg;
+struct tcpip_callback_msg *tcpip_callbackmsg_new(tcpip_callback_fn function,
+                                                 void *ctx);
+void tcpip_callbackmsg_delete(struct tcpip_callback_msg *msg);
+err_t tcpip_callbackmsg_trycallback(struct tcpip_callback_msg *msg);
+
+#ifdef __cplusplus
+}
+#endif
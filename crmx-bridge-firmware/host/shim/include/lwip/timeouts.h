@@ -0,0 +1,17 @@
+#pragma once
+
+#include "lwip/ip_addr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*sys_timeout_handler)(void *arg);
+
+// One-shot timers run on the tcpip thread. Only call from the tcpip thread.
+void sys_timeout(u32_t msecs, sys_timeout_handler handler, void *arg);
+void sys_untimeout(sys_timeout_handler handler, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
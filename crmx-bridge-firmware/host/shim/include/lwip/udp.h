@@ -0,0 +1,36 @@
+#pragma once
+
+#include "lwip/err.h"
+#include "lwip/ip.h"
+#include "lwip/ip_addr.h"
+#include "lwip/pbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct udp_pcb;
+
+typedef void (*udp_recv_fn)(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+                            const ip_addr_t *addr, u16_t port);
+
+// Backed by a host UDP socket. Like lwIP's raw API, these may only be called
+// from the tcpip thread, which is also where receive callbacks run.
+struct udp_pcb {
+  u8_t so_options;
+  int fd;
+  u16_t local_port;
+  udp_recv_fn recv;
+  void *recv_arg;
+};
+
+struct udp_pcb *udp_new(void);
+void udp_remove(struct udp_pcb *pcb);
+err_t udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port);
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg);
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *dst_ip,
+                 u16_t dst_port);
+
+#ifdef __cplusplus
+}
+#endif
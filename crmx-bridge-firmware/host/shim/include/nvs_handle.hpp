@@ -0,0 +1,63 @@
+#pragma once
+
+#include "nvs.h"
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+namespace nvs {
+
+enum class ItemType : uint8_t {
+  U8 = 0x01,
+  I8 = 0x11,
+  U16 = 0x02,
+  I16 = 0x12,
+  U32 = 0x04,
+  I32 = 0x14,
+  U64 = 0x08,
+  I64 = 0x18,
+  SZ = 0x21,
+  BLOB = 0x42,
+  ANY = 0xff,
+};
+
+/**
+ * In-memory stand-in for the ESP-IDF C++ NVS handle. Items are stored as raw
+ * bytes keyed by name; typed reads check the stored size.
+ */
+class NVSHandle {
+public:
+  virtual ~NVSHandle() = default;
+
+  template <typename T> esp_err_t set_item(const char *key, T value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    return set_blob(key, &value, sizeof(value));
+  }
+
+  template <typename T> esp_err_t get_item(const char *key, T &value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    size_t len = 0;
+    esp_err_t err = get_item_size(ItemType::ANY, key, len);
+    if (err != ESP_OK) {
+      return err;
+    }
+    if (len != sizeof(value)) {
+      return ESP_ERR_NVS_TYPE_MISMATCH;
+    }
+    return get_blob(key, &value, sizeof(value));
+  }
+
+  virtual esp_err_t set_blob(const char *key, const void *blob,
+                             size_t len) = 0;
+  virtual esp_err_t get_blob(const char *key, void *blob, size_t len) = 0;
+  virtual esp_err_t get_item_size(ItemType datatype, const char *key,
+                                  size_t &size) = 0;
+  virtual esp_err_t erase_item(const char *key) = 0;
+  virtual esp_err_t commit() = 0;
+};
+
+std::unique_ptr<NVSHandle> open_nvs_handle(const char *ns_name,
+                                           nvs_open_mode_t open_mode,
+                                           esp_err_t *err = nullptr);
+
+} // namespace nvs
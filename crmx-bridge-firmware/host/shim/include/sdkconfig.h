@@ -0,0 +1,4 @@
+#pragma once
+
+// The host build targets no chip, so no CONFIG_IDF_TARGET_* is defined and
+// target-specific paths fall back to their portable versions.
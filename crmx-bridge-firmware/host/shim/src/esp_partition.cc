@@ -0,0 +1,82 @@
+#include "esp_partition.h"
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace {
+constexpr uint32_t sector_size = 4096;
+
+struct HostPartition {
+  esp_partition_t info;
+  std::vector<uint8_t> data;
+};
+
+std::mutex partition_mutex;
+HostPartition dmxrec{
+    .info = {.type = ESP_PARTITION_TYPE_DATA,
+             .subtype = static_cast<esp_partition_subtype_t>(0x40),
+             .address = 0x210000,
+             .size = 8 * 1024 * 1024,
+             .erase_size = sector_size,
+             .label = "dmxrec",
+             .encrypted = false,
+             .readonly = false},
+    .data = {},
+};
+
+bool in_range(const esp_partition_t *partition, const size_t offset,
+              const size_t size) {
+  return partition == &dmxrec.info && offset <= partition->size &&
+         size <= partition->size - offset;
+}
+} // namespace
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type,
+                                                esp_partition_subtype_t subtype,
+                                                const char *label) {
+  if (type != dmxrec.info.type ||
+      (subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != dmxrec.info.subtype) ||
+      (label != nullptr && strcmp(label, dmxrec.info.label) != 0)) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lk(partition_mutex);
+  if (dmxrec.data.empty()) {
+    dmxrec.data.assign(dmxrec.info.size, 0xFF);
+  }
+  return &dmxrec.info;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition,
+                             size_t src_offset, void *dst, size_t size) {
+  if (!in_range(partition, src_offset, size)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  std::lock_guard<std::mutex> lk(partition_mutex);
+  memcpy(dst, dmxrec.data.data() + src_offset, size);
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition,
+                              size_t dst_offset, const void *src,
+                              size_t size) {
+  if (!in_range(partition, dst_offset, size)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  std::lock_guard<std::mutex> lk(partition_mutex);
+  const uint8_t *bytes = static_cast<const uint8_t *>(src);
+  for (size_t i = 0; i < size; i++) {
+    dmxrec.data[dst_offset + i] &= bytes[i];
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition,
+                                    size_t offset, size_t size) {
+  if (!in_range(partition, offset, size) || offset % sector_size != 0 ||
+      size % sector_size != 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lk(partition_mutex);
+  memset(dmxrec.data.data() + offset, 0xFF, size);
+  return ESP_OK;
+}
@@ -0,0 +1,93 @@
+#include "esp_cpu.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "nvs.h"
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <mutex>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+const Clock::time_point start_time = Clock::now();
+std::mutex log_mutex;
+} // namespace
+
+extern "C" {
+
+esp_log_level_t host_log_level = ESP_LOG_INFO;
+
+const char *esp_err_to_name(esp_err_t code) {
+  switch (code) {
+  case ESP_OK:
+    return "ESP_OK";
+  case ESP_FAIL:
+    return "ESP_FAIL";
+  case ESP_ERR_NO_MEM:
+    return "ESP_ERR_NO_MEM";
+  case ESP_ERR_INVALID_ARG:
+    return "ESP_ERR_INVALID_ARG";
+  case ESP_ERR_INVALID_STATE:
+    return "ESP_ERR_INVALID_STATE";
+  case ESP_ERR_INVALID_SIZE:
+    return "ESP_ERR_INVALID_SIZE";
+  case ESP_ERR_NOT_FOUND:
+    return "ESP_ERR_NOT_FOUND";
+  case ESP_ERR_NOT_SUPPORTED:
+    return "ESP_ERR_NOT_SUPPORTED";
+  case ESP_ERR_TIMEOUT:
+    return "ESP_ERR_TIMEOUT";
+  case ESP_ERR_INVALID_RESPONSE:
+    return "ESP_ERR_INVALID_RESPONSE";
+  case ESP_ERR_INVALID_CRC:
+    return "ESP_ERR_INVALID_CRC";
+  case ESP_ERR_INVALID_VERSION:
+    return "ESP_ERR_INVALID_VERSION";
+  case ESP_ERR_NOT_FINISHED:
+    return "ESP_ERR_NOT_FINISHED";
+  case ESP_ERR_NVS_NOT_INITIALIZED:
+    return "ESP_ERR_NVS_NOT_INITIALIZED";
+  case ESP_ERR_NVS_NOT_FOUND:
+    return "ESP_ERR_NVS_NOT_FOUND";
+  case ESP_ERR_NVS_TYPE_MISMATCH:
+    return "ESP_ERR_NVS_TYPE_MISMATCH";
+  case ESP_ERR_NVS_INVALID_HANDLE:
+    return "ESP_ERR_NVS_INVALID_HANDLE";
+  case ESP_ERR_NVS_INVALID_LENGTH:
+    return "ESP_ERR_NVS_INVALID_LENGTH";
+  default:
+    return "UNKNOWN ERROR";
+  }
+}
+
+void host_log_write(esp_log_level_t level, char letter, const char *tag,
+                    const char *format, ...) {
+  if (level > host_log_level) {
+    return;
+  }
+  std::lock_guard<std::mutex> lk(log_mutex);
+  fprintf(stderr, "%c (%u) %s: ", letter,
+          static_cast<unsigned>(xTaskGetTickCount()), tag);
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+int64_t esp_timer_get_time(void) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                               start_time)
+      .count();
+}
+
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void) {
+  const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         Clock::now() - start_time)
+                         .count();
+  return static_cast<esp_cpu_cycle_count_t>(ns * 160 / 1000);
+}
+
+} // extern "C"
@@ -0,0 +1,425 @@
+#include "freertos/FreeRTOS.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+const Clock::time_point start_time = Clock::now();
+
+Clock::time_point deadline_for(const TickType_t ticks) {
+  if (ticks == portMAX_DELAY) {
+    return Clock::time_point::max();
+  }
+  return Clock::now() + std::chrono::milliseconds(pdTICKS_TO_MS(ticks));
+}
+
+template <typename Pred>
+bool wait_until(std::condition_variable &cv, std::unique_lock<std::mutex> &lk,
+                const Clock::time_point deadline, Pred pred) {
+  if (deadline == Clock::time_point::max()) {
+    cv.wait(lk, pred);
+    return true;
+  }
+  // A zero-tick call polls, as on target; a timed wait that is already past
+  // its deadline still sleeps out the kernel's timer slack.
+  if (deadline <= Clock::now()) {
+    return pred();
+  }
+  return cv.wait_until(lk, deadline, pred);
+}
+} // namespace
+
+struct HostTask {
+  std::string name;
+  TaskFunction_t fn = nullptr;
+  void *params = nullptr;
+  std::thread thread;
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  uint32_t notify_value = 0;
+  bool notify_pending = false;
+};
+
+static thread_local HostTask *current_task = nullptr;
+
+extern "C" {
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+                                   uint32_t stack_depth, void *params,
+                                   UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core_id) {
+  (void)stack_depth;
+  (void)priority;
+  (void)core_id;
+  HostTask *task = new HostTask();
+  task->name = name ? name : "";
+  task->fn = fn;
+  task->params = params;
+  if (handle != nullptr) {
+    *handle = task;
+  }
+  task->thread = std::thread([task]() {
+    current_task = task;
+    task->fn(task->params);
+  });
+  // FreeRTOS tasks are never joined; the process owns them until exit.
+  task->thread.detach();
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name,
+                       uint32_t stack_depth, void *params,
+                       UBaseType_t priority, TaskHandle_t *handle) {
+  return xTaskCreatePinnedToCore(fn, name, stack_depth, params, priority,
+                                 handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  // Threads cannot be killed safely; deleting another task is a no-op and a
+  // task deleting itself parks forever.
+  if (task == nullptr || task == current_task) {
+    while (true) {
+      std::this_thread::sleep_for(std::chrono::hours(1));
+    }
+  }
+}
+
+TickType_t xTaskGetTickCount(void) {
+  return static_cast<TickType_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() -
+                                                            start_time)
+          .count());
+}
+
+TickType_t xTaskGetTickCountFromISR(void) { return xTaskGetTickCount(); }
+
+void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(pdTICKS_TO_MS(ticks)));
+}
+
+BaseType_t xTaskDelayUntil(TickType_t *prev_wake, TickType_t increment) {
+  const TickType_t wake = *prev_wake + increment;
+  const TickType_t now = xTaskGetTickCount();
+  *prev_wake = wake;
+  if (static_cast<int32_t>(wake - now) > 0) {
+    vTaskDelay(wake - now);
+    return pdTRUE;
+  }
+  return pdFALSE;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+  if (current_task == nullptr) {
+    // Threads not created through the shim (e.g. main) get a handle lazily.
+    current_task = new HostTask();
+    current_task->name = "host";
+  }
+  return current_task;
+}
+
+BaseType_t xTaskGenericNotify(TaskHandle_t task, uint32_t value,
+                              eNotifyAction action, uint32_t *prev_value) {
+  if (task == nullptr) {
+    return pdFAIL;
+  }
+  {
+    std::lock_guard<std::mutex> lk(task->mtx);
+    if (prev_value != nullptr) {
+      *prev_value = task->notify_value;
+    }
+    switch (action) {
+    case eSetBits:
+      task->notify_value |= value;
+      break;
+    case eIncrement:
+      task->notify_value++;
+      break;
+    case eSetValueWithOverwrite:
+      task->notify_value = value;
+      break;
+    case eSetValueWithoutOverwrite:
+      if (task->notify_pending) {
+        return pdFAIL;
+      }
+      task->notify_value = value;
+      break;
+    case eNoAction:
+    default:
+      break;
+    }
+    task->notify_pending = true;
+  }
+  task->cv.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xTaskGenericNotifyFromISR(TaskHandle_t task, uint32_t value,
+                                     eNotifyAction action,
+                                     uint32_t *prev_value,
+                                     BaseType_t *higher_prio_woken) {
+  if (higher_prio_woken != nullptr) {
+    *higher_prio_woken = pdFALSE;
+  }
+  return xTaskGenericNotify(task, value, action, prev_value);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit,
+                           uint32_t *value, TickType_t timeout) {
+  HostTask *task = xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> lk(task->mtx);
+  if (!task->notify_pending) {
+    task->notify_value &= ~clear_on_entry;
+  }
+  const bool got = wait_until(task->cv, lk, deadline_for(timeout),
+                              [task]() { return task->notify_pending; });
+  if (value != nullptr) {
+    *value = task->notify_value;
+  }
+  if (!got) {
+    return pdFALSE;
+  }
+  task->notify_pending = false;
+  task->notify_value &= ~clear_on_exit;
+  return pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t timeout) {
+  HostTask *task = xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> lk(task->mtx);
+  wait_until(task->cv, lk, deadline_for(timeout),
+             [task]() { return task->notify_value != 0; });
+  const uint32_t value = task->notify_value;
+  if (value != 0) {
+    task->notify_value = clear_on_exit ? 0 : value - 1;
+  }
+  task->notify_pending = false;
+  return value;
+}
+
+} // extern "C"
+
+// Queues and semaphores share one implementation, as in FreeRTOS.
+struct HostQueue {
+  UBaseType_t length;
+  UBaseType_t item_size;
+  std::deque<std::vector<uint8_t>> items;
+  std::mutex mtx;
+  std::condition_variable cv;
+};
+
+extern "C" {
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+  HostQueue *queue = new HostQueue();
+  queue->length = length;
+  queue->item_size = item_size;
+  return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) { delete queue; }
+
+static BaseType_t queue_push(QueueHandle_t queue, const void *item,
+                             TickType_t timeout, const bool overwrite) {
+  if (queue == nullptr) {
+    return pdFAIL;
+  }
+  std::unique_lock<std::mutex> lk(queue->mtx);
+  if (overwrite) {
+    queue->items.clear();
+  } else if (!wait_until(queue->cv, lk, deadline_for(timeout), [queue]() {
+               return queue->items.size() < queue->length;
+             })) {
+    return pdFAIL;
+  }
+  const uint8_t *bytes = static_cast<const uint8_t *>(item);
+  queue->items.emplace_back(bytes, bytes + (item ? queue->item_size : 0));
+  lk.unlock();
+  queue->cv.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item,
+                      TickType_t timeout) {
+  return queue_push(queue, item, timeout, false);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item,
+                             BaseType_t *higher_prio_woken) {
+  if (higher_prio_woken != nullptr) {
+    *higher_prio_woken = pdFALSE;
+  }
+  return queue_push(queue, item, 0, false);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item) {
+  return queue_push(queue, item, 0, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t timeout) {
+  if (queue == nullptr) {
+    return pdFAIL;
+  }
+  std::unique_lock<std::mutex> lk(queue->mtx);
+  if (!wait_until(queue->cv, lk, deadline_for(timeout),
+                  [queue]() { return !queue->items.empty(); })) {
+    return pdFAIL;
+  }
+  if (item != nullptr && queue->item_size > 0) {
+    memcpy(item, queue->items.front().data(), queue->item_size);
+  }
+  queue->items.pop_front();
+  lk.unlock();
+  queue->cv.notify_all();
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  std::lock_guard<std::mutex> lk(queue->mtx);
+  return queue->items.size();
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t init) {
+  HostQueue *sem = xQueueCreate(max, 0);
+  for (UBaseType_t i = 0; i < init; i++) {
+    sem->items.emplace_back();
+  }
+  return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+  return xSemaphoreCreateCounting(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+  return xSemaphoreCreateCounting(1, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t timeout) {
+  return xQueueReceive(sem, nullptr, timeout);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+  return queue_push(sem, nullptr, 0, false);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem,
+                                 BaseType_t *higher_prio_woken) {
+  if (higher_prio_woken != nullptr) {
+    *higher_prio_woken = pdFALSE;
+  }
+  return xSemaphoreGive(sem);
+}
+
+static std::recursive_mutex critical_mutex;
+
+void vHostEnterCritical(void) { critical_mutex.lock(); }
+void vHostExitCritical(void) { critical_mutex.unlock(); }
+
+} // extern "C"
+
+struct HostTimer {
+  std::string name;
+  TickType_t period;
+  bool auto_reload;
+  void *id;
+  TimerCallbackFunction_t callback;
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::thread thread;
+  bool running = false;
+  bool deleted = false;
+  uint32_t generation = 0;
+};
+
+extern "C" {
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period,
+                           UBaseType_t auto_reload, void *id,
+                           TimerCallbackFunction_t callback) {
+  HostTimer *timer = new HostTimer();
+  timer->name = name ? name : "";
+  timer->period = period;
+  timer->auto_reload = auto_reload;
+  timer->id = id;
+  timer->callback = callback;
+  timer->thread = std::thread([timer]() {
+    std::unique_lock<std::mutex> lk(timer->mtx);
+    while (!timer->deleted) {
+      timer->cv.wait(lk, [timer]() { return timer->running || timer->deleted; });
+      const uint32_t generation = timer->generation;
+      const auto deadline = deadline_for(timer->period);
+      if (timer->cv.wait_until(lk, deadline, [timer, generation]() {
+            return timer->deleted || !timer->running ||
+                   timer->generation != generation;
+          })) {
+        continue;
+      }
+      timer->running = timer->auto_reload;
+      lk.unlock();
+      timer->callback(timer);
+      lk.lock();
+    }
+  });
+  timer->thread.detach();
+  return timer;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t timeout) {
+  (void)timeout;
+  {
+    std::lock_guard<std::mutex> lk(timer->mtx);
+    timer->running = true;
+    timer->generation++;
+  }
+  timer->cv.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t timeout) {
+  (void)timeout;
+  {
+    std::lock_guard<std::mutex> lk(timer->mtx);
+    timer->running = false;
+  }
+  timer->cv.notify_all();
+  return pdPASS;
+}
+
+// Like FreeRTOS, also (re)starts the timer.
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period,
+                              TickType_t timeout) {
+  (void)timeout;
+  {
+    std::lock_guard<std::mutex> lk(timer->mtx);
+    timer->period = period;
+    timer->running = true;
+    timer->generation++;
+  }
+  timer->cv.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t timeout) {
+  (void)timeout;
+  {
+    std::lock_guard<std::mutex> lk(timer->mtx);
+    timer->deleted = true;
+  }
+  timer->cv.notify_all();
+  // The timer thread still references the object; leak it deliberately.
+  return pdPASS;
+}
+
+void *pvTimerGetTimerID(TimerHandle_t timer) { return timer->id; }
+
+} // extern "C"
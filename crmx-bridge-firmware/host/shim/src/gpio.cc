@@ -0,0 +1,168 @@
+#include "driver/gpio.h"
+#include <array>
+#include <mutex>
+
+namespace {
+struct PinState {
+  gpio_mode_t mode = GPIO_MODE_DISABLE;
+  gpio_int_type_t intr_type = GPIO_INTR_DISABLE;
+  bool intr_enabled = false;
+  int level = 1;
+  gpio_isr_t isr = nullptr;
+  void *isr_arg = nullptr;
+};
+
+std::array<PinState, GPIO_NUM_MAX> pins;
+std::mutex pins_mutex;
+bool isr_service_installed = false;
+
+bool valid(const gpio_num_t gpio_num) {
+  return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX;
+}
+} // namespace
+
+extern "C" {
+
+esp_err_t gpio_config(const gpio_config_t *config) {
+  if (config == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lk(pins_mutex);
+  for (int i = 0; i < GPIO_NUM_MAX; i++) {
+    if (config->pin_bit_mask & (1ULL << i)) {
+      pins[i].mode = config->mode;
+      pins[i].intr_type = config->intr_type;
+      pins[i].intr_enabled = config->intr_type != GPIO_INTR_DISABLE;
+    }
+  }
+  return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+  if (!valid(gpio_num)) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lk(pins_mutex);
+  return pins[gpio_num].level;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+  if (!valid(gpio_num)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lk(pins_mutex);
+  pins[gpio_num].level = level ? 1 : 0;
+  return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type) {
+  if (!valid(gpio_num)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lk(pins_mutex);
+  pins[gpio_num].intr_type = intr_type;
+  return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num) {
+  if (!valid(gpio_num)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lk(pins_mutex);
+  pins[gpio_num].intr_enabled = true;
+  return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio_num) {
+  if (!valid(gpio_num)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lk(pins_mutex);
+  pins[gpio_num].intr_enabled = false;
+  return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags) {
+  (void)intr_alloc_flags;
+  std::lock_guard<std::mutex> lk(pins_mutex);
+  if (isr_service_installed) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  isr_service_installed = true;
+  return ESP_OK;
+}
+
+void gpio_uninstall_isr_service(void) {
+  std::lock_guard<std::mutex> lk(pins_mutex);
+  isr_service_installed = false;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler,
+                               void *args) {
+  if (!valid(gpio_num)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lk(pins_mutex);
+  if (!isr_service_installed) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  pins[gpio_num].isr = isr_handler;
+  pins[gpio_num].isr_arg = args;
+  return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num) {
+  if (!valid(gpio_num)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lk(pins_mutex);
+  pins[gpio_num].isr = nullptr;
+  pins[gpio_num].isr_arg = nullptr;
+  return ESP_OK;
+}
+
+void host_gpio_drive_input(gpio_num_t gpio_num, int level) {
+  if (!valid(gpio_num)) {
+    return;
+  }
+  gpio_isr_t isr = nullptr;
+  void *isr_arg = nullptr;
+  {
+    std::lock_guard<std::mutex> lk(pins_mutex);
+    PinState &pin = pins[gpio_num];
+    const int prev = pin.level;
+    pin.level = level ? 1 : 0;
+    const bool rising = prev == 0 && pin.level == 1;
+    const bool falling = prev == 1 && pin.level == 0;
+    bool fire = false;
+    switch (pin.intr_type) {
+    case GPIO_INTR_POSEDGE:
+      fire = rising;
+      break;
+    case GPIO_INTR_NEGEDGE:
+      fire = falling;
+      break;
+    case GPIO_INTR_ANYEDGE:
+      fire = rising || falling;
+      break;
+    case GPIO_INTR_LOW_LEVEL:
+      fire = pin.level == 0;
+      break;
+    case GPIO_INTR_HIGH_LEVEL:
+      fire = pin.level == 1;
+      break;
+    case GPIO_INTR_DISABLE:
+    default:
+      break;
+    }
+    if (fire && pin.intr_enabled && isr_service_installed) {
+      isr = pin.isr;
+      isr_arg = pin.isr_arg;
+    }
+  }
+  if (isr != nullptr) {
+    isr(isr_arg);
+  }
+}
+
+} // extern "C"
@@ -0,0 +1,462 @@
+#include "lwip/igmp.h"
+#include "lwip/ip.h"
+#include "lwip/pbuf.h"
+#include "lwip/priv/tcpip_priv.h"
+#include "lwip/tcpip.h"
+#include "lwip/timeouts.h"
+#include "lwip/udp.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+const ip_addr_t ip_addr_any = {.u_addr = {.ip4 = {.addr = 0}},
+                               .type = IPADDR_TYPE_V4};
+const ip_addr_t ip_addr_broadcast = {.u_addr = {.ip4 = {.addr = 0xffffffff}},
+                                     .type = IPADDR_TYPE_V4};
+struct netif *netif_default = nullptr;
+
+struct tcpip_callback_msg {
+  tcpip_callback_fn function;
+  void *ctx;
+};
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Callback {
+  tcpip_callback_fn function;
+  void *ctx;
+};
+
+struct Timeout {
+  Clock::time_point due;
+  sys_timeout_handler handler;
+  void *arg;
+};
+
+// One thread stands in for lwIP's tcpip thread: it runs queued callbacks and
+// timeouts, and polls the sockets behind bound pcbs.
+class TcpipThread {
+public:
+  static TcpipThread &shared() {
+    static TcpipThread thread;
+    return thread;
+  }
+
+  void post(const Callback callback) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      callbacks.push_back(callback);
+    }
+    const uint8_t wake = 0;
+    (void)!write(wake_pipe[1], &wake, 1);
+  }
+
+  // Only called on the tcpip thread.
+  void add(udp_pcb *pcb) { pcbs.push_back(pcb); }
+  void remove(udp_pcb *pcb) {
+    pcbs.erase(std::remove(pcbs.begin(), pcbs.end(), pcb), pcbs.end());
+  }
+  void add_timeout(const Timeout timeout) { timeouts.push_back(timeout); }
+  void remove_timeout(const sys_timeout_handler handler, void *arg) {
+    timeouts.erase(std::remove_if(timeouts.begin(), timeouts.end(),
+                                  [&](const Timeout &timeout) {
+                                    return timeout.handler == handler &&
+                                           timeout.arg == arg;
+                                  }),
+                   timeouts.end());
+  }
+  // Socket multicast memberships are taken on; created on first use.
+  int membership_fd() {
+    if (igmp_fd < 0) {
+      igmp_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    }
+    return igmp_fd;
+  }
+
+  netif loopback{};
+
+protected:
+  TcpipThread() {
+    IP_ADDR4(&loopback.ip_addr, 127, 0, 0, 1);
+    IP_ADDR4(&loopback.netmask, 255, 0, 0, 0);
+    const uint8_t mac[NETIF_MAX_HWADDR_LEN] = {0x02, 0, 0, 0, 0, 0x01};
+    memcpy(loopback.hwaddr, mac, sizeof(mac));
+    loopback.hwaddr_len = NETIF_MAX_HWADDR_LEN;
+    netif_default = &loopback;
+
+    if (pipe(wake_pipe) != 0) {
+      abort();
+    }
+    std::thread(&TcpipThread::run, this).detach();
+  }
+
+  void run() {
+    std::vector<pollfd> fds;
+    while (true) {
+      fds.clear();
+      fds.push_back(pollfd{.fd = wake_pipe[0], .events = POLLIN, .revents = 0});
+      for (udp_pcb *pcb : pcbs) {
+        fds.push_back(pollfd{.fd = pcb->fd, .events = POLLIN, .revents = 0});
+      }
+      if (poll(fds.data(), fds.size(), poll_timeout_ms()) < 0) {
+        continue;
+      }
+      run_timeouts();
+
+      if (fds[0].revents & POLLIN) {
+        uint8_t drain[64];
+        (void)!read(wake_pipe[0], drain, sizeof(drain));
+        run_callbacks();
+      }
+      // Callbacks may have removed pcbs; only service those still bound.
+      for (size_t i = 1; i < fds.size(); i++) {
+        if (!(fds[i].revents & POLLIN)) {
+          continue;
+        }
+        auto it = std::find_if(pcbs.begin(), pcbs.end(), [&](udp_pcb *pcb) {
+          return pcb->fd == fds[i].fd;
+        });
+        if (it != pcbs.end()) {
+          receive(*it);
+        }
+      }
+    }
+  }
+
+  int poll_timeout_ms() const {
+    if (timeouts.empty()) {
+      return -1;
+    }
+    const Clock::time_point next =
+        std::min_element(timeouts.begin(), timeouts.end(),
+                         [](const Timeout &a, const Timeout &b) {
+                           return a.due < b.due;
+                         })
+            ->due;
+    const auto wait = std::chrono::ceil<std::chrono::milliseconds>(
+        next - Clock::now());
+    return std::max<int>(0, wait.count());
+  }
+
+  void run_timeouts() {
+    const Clock::time_point now = Clock::now();
+    std::vector<Timeout> due;
+    for (auto it = timeouts.begin(); it != timeouts.end();) {
+      if (it->due <= now) {
+        due.push_back(*it);
+        it = timeouts.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    // Handlers may re-arm themselves.
+    for (const Timeout &timeout : due) {
+      timeout.handler(timeout.arg);
+    }
+  }
+
+  void run_callbacks() {
+    std::deque<Callback> pending;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending.swap(callbacks);
+    }
+    for (const Callback &callback : pending) {
+      callback.function(callback.ctx);
+    }
+  }
+
+  void receive(udp_pcb *pcb) {
+    uint8_t datagram[2048];
+    sockaddr_in from{};
+    socklen_t from_len = sizeof(from);
+    const ssize_t len =
+        recvfrom(pcb->fd, datagram, sizeof(datagram), MSG_DONTWAIT,
+                 reinterpret_cast<sockaddr *>(&from), &from_len);
+    if (len < 0 || pcb->recv == nullptr) {
+      return;
+    }
+    pbuf *p = pbuf_alloc(PBUF_TRANSPORT, static_cast<u16_t>(len), PBUF_POOL);
+    if (p == nullptr) {
+      return;
+    }
+    pbuf_take(p, datagram, static_cast<u16_t>(len));
+
+    ip_addr_t addr{};
+    addr.u_addr.ip4.addr = from.sin_addr.s_addr;
+    addr.type = IPADDR_TYPE_V4;
+    pcb->recv(pcb->recv_arg, pcb, p, &addr, ntohs(from.sin_port));
+  }
+
+  int wake_pipe[2] = {-1, -1};
+  std::mutex mutex;
+  std::deque<Callback> callbacks;
+  std::vector<udp_pcb *> pcbs;
+  std::vector<Timeout> timeouts;
+  int igmp_fd = -1;
+};
+
+pbuf *alloc_one(const u16_t len) {
+  auto *p = static_cast<pbuf *>(malloc(sizeof(pbuf) + len));
+  if (p == nullptr) {
+    return nullptr;
+  }
+  *p = pbuf{.next = nullptr,
+            .payload = reinterpret_cast<uint8_t *>(p) + sizeof(pbuf),
+            .tot_len = len,
+            .len = len,
+            .type_internal = 0,
+            .flags = 0,
+            .ref = 1};
+  return p;
+}
+} // namespace
+
+err_t tcpip_callback(tcpip_callback_fn function, void *ctx) {
+  TcpipThread::shared().post(Callback{.function = function, .ctx = ctx});
+  return ERR_OK;
+}
+
+err_t tcpip_api_call(tcpip_api_call_fn fn, struct tcpip_api_call_data *call) {
+  struct Blocking {
+    tcpip_api_call_fn fn;
+    tcpip_api_call_data *call;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done = false;
+  } blocking{.fn = fn, .call = call};
+  tcpip_callback(
+      [](void *ctx) {
+        Blocking &b = *static_cast<Blocking *>(ctx);
+        b.call->err = b.fn(b.call);
+        std::lock_guard<std::mutex> lock(b.mutex);
+        b.done = true;
+        b.cv.notify_one();
+      },
+      &blocking);
+  std::unique_lock<std::mutex> lock(blocking.mutex);
+  blocking.cv.wait(lock, [&] { return blocking.done; });
+  return call->err;
+}
+
+struct tcpip_callback_msg *tcpip_callbackmsg_new(tcpip_callback_fn function,
+                                                 void *ctx) {
+  return new tcpip_callback_msg{.function = function, .ctx = ctx};
+}
+
+void tcpip_callbackmsg_delete(struct tcpip_callback_msg *msg) { delete msg; }
+
+err_t tcpip_callbackmsg_trycallback(struct tcpip_callback_msg *msg) {
+  return tcpip_callback(msg->function, msg->ctx);
+}
+
+void sys_timeout(u32_t msecs, sys_timeout_handler handler, void *arg) {
+  TcpipThread::shared().add_timeout(Timeout{
+      .due = Clock::now() + std::chrono::milliseconds(msecs),
+      .handler = handler,
+      .arg = arg,
+  });
+}
+
+void sys_untimeout(sys_timeout_handler handler, void *arg) {
+  TcpipThread::shared().remove_timeout(handler, arg);
+}
+
+static void set_membership(const int option, const ip4_addr_t *ifaddr,
+                           const ip4_addr_t *groupaddr) {
+  ip_mreq mreq{};
+  mreq.imr_multiaddr.s_addr = groupaddr->addr;
+  mreq.imr_interface.s_addr = ifaddr->addr;
+  setsockopt(TcpipThread::shared().membership_fd(), IPPROTO_IP, option, &mreq,
+             sizeof(mreq));
+}
+
+err_t igmp_joingroup(const ip4_addr_t *ifaddr, const ip4_addr_t *groupaddr) {
+  set_membership(IP_ADD_MEMBERSHIP, ifaddr, groupaddr);
+  return ERR_OK;
+}
+
+err_t igmp_leavegroup(const ip4_addr_t *ifaddr, const ip4_addr_t *groupaddr) {
+  set_membership(IP_DROP_MEMBERSHIP, ifaddr, groupaddr);
+  return ERR_OK;
+}
+
+struct netif *ip_current_input_netif(void) {
+  return &TcpipThread::shared().loopback;
+}
+
+struct pbuf *pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type) {
+  (void)layer;
+  if (type != PBUF_POOL) {
+    return alloc_one(length);
+  }
+
+  pbuf *head = nullptr;
+  pbuf **tail = &head;
+  u16_t remaining = length;
+  do {
+    const u16_t len = std::min<u16_t>(remaining, PBUF_POOL_BUFSIZE);
+    pbuf *p = alloc_one(len);
+    if (p == nullptr) {
+      pbuf_free(head);
+      return nullptr;
+    }
+    p->tot_len = remaining;
+    *tail = p;
+    tail = &p->next;
+    remaining -= len;
+  } while (remaining > 0);
+  return head;
+}
+
+u8_t pbuf_free(struct pbuf *p) {
+  u8_t count = 0;
+  while (p != nullptr) {
+    if (--p->ref > 0) {
+      break;
+    }
+    pbuf *next = p->next;
+    free(p);
+    count++;
+    p = next;
+  }
+  return count;
+}
+
+void pbuf_ref(struct pbuf *p) { p->ref++; }
+
+u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len,
+                        u16_t offset) {
+  u16_t copied = 0;
+  for (; p != nullptr && len > 0; p = p->next) {
+    if (offset >= p->len) {
+      offset -= p->len;
+      continue;
+    }
+    const u16_t n = std::min<u16_t>(p->len - offset, len);
+    memcpy(static_cast<uint8_t *>(dataptr) + copied,
+           static_cast<const uint8_t *>(p->payload) + offset, n);
+    copied += n;
+    len -= n;
+    offset = 0;
+  }
+  return copied;
+}
+
+u8_t pbuf_get_at(const struct pbuf *p, u16_t offset) {
+  for (; p != nullptr; p = p->next) {
+    if (offset < p->len) {
+      return static_cast<const uint8_t *>(p->payload)[offset];
+    }
+    offset -= p->len;
+  }
+  return 0;
+}
+
+err_t pbuf_take_at(struct pbuf *buf, const void *dataptr, u16_t len,
+                   u16_t offset) {
+  if (buf == nullptr || offset + len > buf->tot_len) {
+    return ERR_ARG;
+  }
+  const auto *src = static_cast<const uint8_t *>(dataptr);
+  for (pbuf *p = buf; p != nullptr && len > 0; p = p->next) {
+    if (offset >= p->len) {
+      offset -= p->len;
+      continue;
+    }
+    const u16_t n = std::min<u16_t>(p->len - offset, len);
+    memcpy(static_cast<uint8_t *>(p->payload) + offset, src, n);
+    src += n;
+    len -= n;
+    offset = 0;
+  }
+  return ERR_OK;
+}
+
+err_t pbuf_take(struct pbuf *buf, const void *dataptr, u16_t len) {
+  return pbuf_take_at(buf, dataptr, len, 0);
+}
+
+struct udp_pcb *udp_new(void) {
+  auto *pcb = new udp_pcb{};
+  pcb->fd = -1;
+  return pcb;
+}
+
+void udp_remove(struct udp_pcb *pcb) {
+  if (pcb->fd >= 0) {
+    TcpipThread::shared().remove(pcb);
+    close(pcb->fd);
+  }
+  delete pcb;
+}
+
+static bool open_socket(udp_pcb *pcb) {
+  if (pcb->fd >= 0) {
+    return true;
+  }
+  pcb->fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (pcb->fd < 0) {
+    return false;
+  }
+  const int on = 1;
+  setsockopt(pcb->fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  setsockopt(pcb->fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+  return true;
+}
+
+err_t udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port) {
+  if (!open_socket(pcb)) {
+    return ERR_MEM;
+  }
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = ipaddr->u_addr.ip4.addr;
+  addr.sin_port = htons(port);
+  if (bind(pcb->fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    return ERR_USE;
+  }
+  pcb->local_port = port;
+  TcpipThread::shared().add(pcb);
+  return ERR_OK;
+}
+
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg) {
+  pcb->recv = recv;
+  pcb->recv_arg = recv_arg;
+}
+
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *dst_ip,
+                 u16_t dst_port) {
+  if (!open_socket(pcb)) {
+    return ERR_MEM;
+  }
+  uint8_t datagram[2048];
+  if (p->tot_len > sizeof(datagram)) {
+    return ERR_VAL;
+  }
+  const u16_t len = pbuf_copy_partial(p, datagram, p->tot_len, 0);
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = dst_ip->u_addr.ip4.addr;
+  addr.sin_port = htons(dst_port);
+  if (sendto(pcb->fd, datagram, len, 0, reinterpret_cast<sockaddr *>(&addr),
+             sizeof(addr)) < 0) {
+    return ERR_RTE;
+  }
+  return ERR_OK;
+}
@@ -0,0 +1,94 @@
+#include "nvs_flash.h"
+#include "nvs_handle.hpp"
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+using Namespace = std::map<std::string, std::vector<uint8_t>>;
+
+std::mutex store_mutex;
+std::map<std::string, Namespace> store;
+std::atomic<uint32_t> commit_count{0};
+
+class HostNVSHandle : public nvs::NVSHandle {
+public:
+  explicit HostNVSHandle(const std::string &_ns) : ns(_ns) {}
+
+  esp_err_t set_blob(const char *key, const void *blob, size_t len) override {
+    std::lock_guard<std::mutex> lk(store_mutex);
+    const uint8_t *bytes = static_cast<const uint8_t *>(blob);
+    store[ns][key] = std::vector<uint8_t>(bytes, bytes + len);
+    return ESP_OK;
+  }
+
+  esp_err_t get_blob(const char *key, void *blob, size_t len) override {
+    std::lock_guard<std::mutex> lk(store_mutex);
+    auto &items = store[ns];
+    auto it = items.find(key);
+    if (it == items.end()) {
+      return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (len < it->second.size()) {
+      return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(blob, it->second.data(), it->second.size());
+    return ESP_OK;
+  }
+
+  esp_err_t get_item_size(nvs::ItemType datatype, const char *key,
+                          size_t &size) override {
+    (void)datatype;
+    std::lock_guard<std::mutex> lk(store_mutex);
+    auto &items = store[ns];
+    auto it = items.find(key);
+    if (it == items.end()) {
+      return ESP_ERR_NVS_NOT_FOUND;
+    }
+    size = it->second.size();
+    return ESP_OK;
+  }
+
+  esp_err_t erase_item(const char *key) override {
+    std::lock_guard<std::mutex> lk(store_mutex);
+    return store[ns].erase(key) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+  }
+
+  esp_err_t commit() override {
+    commit_count++;
+    return ESP_OK;
+  }
+
+private:
+  const std::string ns;
+};
+} // namespace
+
+extern "C" {
+
+esp_err_t nvs_flash_init(void) { return ESP_OK; }
+
+esp_err_t nvs_flash_erase(void) {
+  std::lock_guard<std::mutex> lk(store_mutex);
+  store.clear();
+  return ESP_OK;
+}
+
+uint32_t host_nvs_commit_count(void) { return commit_count.load(); }
+
+} // extern "C"
+
+namespace nvs {
+std::unique_ptr<NVSHandle> open_nvs_handle(const char *ns_name,
+                                           nvs_open_mode_t open_mode,
+                                           esp_err_t *err) {
+  (void)open_mode;
+  if (err != nullptr) {
+    *err = ESP_OK;
+  }
+  return std::make_unique<HostNVSHandle>(ns_name);
+}
+} // namespace nvs
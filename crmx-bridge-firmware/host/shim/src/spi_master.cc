@@ -0,0 +1,232 @@
+#include "driver/spi_master.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Model {
+  host_spi_transfer_fn fn = nullptr;
+  void *ctx = nullptr;
+};
+
+std::mutex models_mutex;
+std::map<int, Model> models;
+
+// Serialises transfers on the (single) simulated bus.
+std::mutex bus_mutex;
+} // namespace
+
+struct spi_device_t {
+  spi_host_device_t host;
+  spi_device_interface_config_t cfg;
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::deque<spi_transaction_t *> pending;
+  std::deque<spi_transaction_t *> done;
+  bool stopping = false;
+  std::thread worker;
+
+  void run(spi_transaction_t *t) {
+    const size_t len_bytes = (t->length + 7) / 8;
+    std::vector<uint8_t> tx(len_bytes, 0);
+    std::vector<uint8_t> rx(len_bytes, 0);
+    const uint8_t *tx_src = (t->flags & SPI_TRANS_USE_TXDATA)
+                                ? t->tx_data
+                                : static_cast<const uint8_t *>(t->tx_buffer);
+    if (tx_src != nullptr) {
+      std::copy(tx_src, tx_src + len_bytes, tx.begin());
+    }
+
+    Model model;
+    {
+      std::lock_guard<std::mutex> lk(models_mutex);
+      auto it = models.find(cfg.spics_io_num);
+      if (it != models.end()) {
+        model = it->second;
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lk(bus_mutex);
+      // Hold the bus for the time the clock would take to shift the bits.
+      const auto bus_time = std::chrono::nanoseconds(
+          cfg.clock_speed_hz > 0
+              ? static_cast<int64_t>(t->length) * 1000000000LL /
+                    cfg.clock_speed_hz
+              : 0);
+      const auto end = Clock::now() + bus_time;
+      if (model.fn != nullptr) {
+        model.fn(model.ctx, tx.data(), rx.data(), len_bytes);
+      }
+      while (Clock::now() < end) {
+      }
+    }
+
+    uint8_t *rx_dst = (t->flags & SPI_TRANS_USE_RXDATA)
+                          ? t->rx_data
+                          : static_cast<uint8_t *>(t->rx_buffer);
+    if (rx_dst != nullptr) {
+      const size_t rx_len =
+          t->rxlength ? (t->rxlength + 7) / 8 : len_bytes;
+      std::copy(rx.begin(), rx.begin() + std::min(rx_len, len_bytes), rx_dst);
+    }
+  }
+};
+
+extern "C" {
+
+esp_err_t spi_bus_initialize(spi_host_device_t host_id,
+                             const spi_bus_config_t *bus_config,
+                             spi_common_dma_t dma_chan) {
+  (void)host_id;
+  (void)bus_config;
+  (void)dma_chan;
+  return ESP_OK;
+}
+
+esp_err_t spi_bus_free(spi_host_device_t host_id) {
+  (void)host_id;
+  return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host_id,
+                             const spi_device_interface_config_t *dev_config,
+                             spi_device_handle_t *handle) {
+  if (dev_config == nullptr || handle == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  spi_device_t *dev = new spi_device_t();
+  dev->host = host_id;
+  dev->cfg = *dev_config;
+  dev->worker = std::thread([dev]() {
+    std::unique_lock<std::mutex> lk(dev->mtx);
+    while (true) {
+      dev->cv.wait(lk, [dev]() { return dev->stopping || !dev->pending.empty(); });
+      if (dev->stopping) {
+        return;
+      }
+      spi_transaction_t *t = dev->pending.front();
+      lk.unlock();
+      dev->run(t);
+      lk.lock();
+      dev->pending.pop_front();
+      dev->done.push_back(t);
+      dev->cv.notify_all();
+    }
+  });
+  *handle = dev;
+  return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle) {
+  if (handle == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  {
+    std::lock_guard<std::mutex> lk(handle->mtx);
+    if (!handle->pending.empty() || !handle->done.empty()) {
+      return ESP_ERR_INVALID_STATE;
+    }
+    handle->stopping = true;
+  }
+  handle->cv.notify_all();
+  handle->worker.join();
+  delete handle;
+  return ESP_OK;
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle,
+                                 spi_transaction_t *trans_desc,
+                                 TickType_t ticks_to_wait) {
+  if (handle == nullptr || trans_desc == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::unique_lock<std::mutex> lk(handle->mtx);
+  const size_t depth = handle->cfg.queue_size > 0 ? handle->cfg.queue_size : 1;
+  auto has_room = [handle, depth]() {
+    return handle->pending.size() + handle->done.size() < depth;
+  };
+  if (ticks_to_wait == portMAX_DELAY) {
+    handle->cv.wait(lk, has_room);
+  } else if (!handle->cv.wait_for(
+                 lk, std::chrono::milliseconds(pdTICKS_TO_MS(ticks_to_wait)),
+                 has_room)) {
+    return ESP_ERR_TIMEOUT;
+  }
+  handle->pending.push_back(trans_desc);
+  handle->cv.notify_all();
+  return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle,
+                                      spi_transaction_t **trans_desc,
+                                      TickType_t ticks_to_wait) {
+  if (handle == nullptr || trans_desc == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::unique_lock<std::mutex> lk(handle->mtx);
+  auto has_done = [handle]() { return !handle->done.empty(); };
+  if (ticks_to_wait == portMAX_DELAY) {
+    handle->cv.wait(lk, has_done);
+  } else if (!handle->cv.wait_for(
+                 lk, std::chrono::milliseconds(pdTICKS_TO_MS(ticks_to_wait)),
+                 has_done)) {
+    return ESP_ERR_TIMEOUT;
+  }
+  *trans_desc = handle->done.front();
+  handle->done.pop_front();
+  handle->cv.notify_all();
+  return ESP_OK;
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t handle,
+                              spi_transaction_t *trans_desc) {
+  esp_err_t ret = spi_device_queue_trans(handle, trans_desc, portMAX_DELAY);
+  if (ret != ESP_OK) {
+    return ret;
+  }
+  spi_transaction_t *done = nullptr;
+  return spi_device_get_trans_result(handle, &done, portMAX_DELAY);
+}
+
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle,
+                                      spi_transaction_t *trans_desc) {
+  if (handle == nullptr || trans_desc == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  handle->run(trans_desc);
+  return ESP_OK;
+}
+
+esp_err_t spi_device_acquire_bus(spi_device_handle_t device, TickType_t wait) {
+  (void)device;
+  (void)wait;
+  return ESP_OK;
+}
+
+void spi_device_release_bus(spi_device_handle_t dev) { (void)dev; }
+
+esp_err_t spi_device_get_actual_freq(spi_device_handle_t handle,
+                                    int *freq_khz) {
+  if (handle == nullptr || freq_khz == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  // The simulated bus runs at exactly the requested clock.
+  *freq_khz = handle->cfg.clock_speed_hz / 1000;
+  return ESP_OK;
+}
+
+void host_spi_attach_model(int spics_io_num, host_spi_transfer_fn fn,
+                           void *ctx) {
+  std::lock_guard<std::mutex> lk(models_mutex);
+  models[spics_io_num] = Model{.fn = fn, .ctx = ctx};
+}
+
+} // extern "C"
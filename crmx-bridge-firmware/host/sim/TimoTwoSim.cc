@@ -0,0 +1,250 @@
+#include "TimoTwoSim.h"
+#include "driver/spi_master.h"
+#include <algorithm>
+
+using namespace TIMO;
+
+namespace {
+// Command bytes, see TimoInterface::SpiCmd.
+constexpr uint8_t cmd_type_mask = 0b11000000;
+constexpr uint8_t cmd_read_reg = 0b00000000;
+constexpr uint8_t cmd_write_reg = 0b01000000;
+constexpr uint8_t cmd_read_dmx = 0b10000001;
+constexpr uint8_t cmd_write_dmx = 0b10010001;
+constexpr uint8_t cmd_nop = 0b11111111;
+
+// Registers the host cannot write.
+constexpr std::array<uint8_t, 8> read_only_regs = {
+    STATUS::address,  IRQ_FLAGS::address,         LINK_QUALITY::address,
+    VERSION::address, EXTENDED_IRQ_FLAGS::address, RXTX_STATUS::address,
+    BATTERY::address, PRODUCT_ID::address,
+};
+
+// Writing these makes the module reboot when the value changes.
+bool reboots_on_change(const uint8_t addr) {
+  return addr == CONFIG::address || addr == RF_PROTOCOL::address;
+}
+
+// Interrupt sources in IRQ_FLAGS; the top bit is SPI_DEVICE_BUSY.
+constexpr uint8_t irq_source_mask =
+    static_cast<uint8_t>(~IRQ_FLAGS::SPI_DEVICE_BUSY.mask);
+} // namespace
+
+TimoTwoSim::TimoTwoSim(const int _spics_io_num, const gpio_num_t _nirq_pin)
+    : TimoTwoSim(_spics_io_num, _nirq_pin, Timing{}) {}
+
+TimoTwoSim::TimoTwoSim(const int _spics_io_num, const gpio_num_t _nirq_pin,
+                       const Timing &_timing)
+    : spics_io_num(_spics_io_num), nirq_pin(_nirq_pin), timing(_timing),
+      stopping(false), state(State::idle), active_cmd(cmd_nop), ready_at(),
+      busy_until(), booted_at(), last_dmx_write(), drop_commands(0), regs(),
+      dmx_gen_buffer(), dmx_write_cursor(0), dmx_output(), dmx_rx(), stats() {
+  power_on();
+  host_spi_attach_model(spics_io_num, &TimoTwoSim::transfer_trampoline, this);
+  worker = std::thread([this] { run(); });
+}
+
+TimoTwoSim::~TimoTwoSim() {
+  host_spi_attach_model(spics_io_num, nullptr, nullptr);
+  {
+    std::lock_guard<std::mutex> lk(mtx);
+    stopping = true;
+  }
+  cv.notify_all();
+  worker.join();
+}
+
+void TimoTwoSim::power_on() {
+  std::lock_guard<std::mutex> lk(mtx);
+  start_reboot(Clock::now(), timing.boot_ms);
+}
+
+void TimoTwoSim::drop_next_commands(const uint32_t count) {
+  std::lock_guard<std::mutex> lk(mtx);
+  drop_commands = count;
+}
+
+void TimoTwoSim::receive_dmx(const std::array<uint8_t, 512> &data) {
+  {
+    std::lock_guard<std::mutex> lk(mtx);
+    dmx_rx = data;
+    irq_flags() |= IRQ_FLAGS::RX_DMX_IRQ.mask;
+    regs[STATUS::address][0] |= STATUS::DMX.mask;
+    update_nirq(Clock::now());
+  }
+  cv.notify_all();
+}
+
+std::array<uint8_t, 512> TimoTwoSim::get_dmx_output() {
+  std::lock_guard<std::mutex> lk(mtx);
+  return dmx_output;
+}
+
+TimoTwoSim::Stats TimoTwoSim::get_stats() {
+  std::lock_guard<std::mutex> lk(mtx);
+  return stats;
+}
+
+void TimoTwoSim::transfer_trampoline(void *ctx, const uint8_t *tx, uint8_t *rx,
+                                     size_t len) {
+  static_cast<TimoTwoSim *>(ctx)->transfer(tx, rx, len);
+}
+
+void TimoTwoSim::transfer(const uint8_t *tx, uint8_t *rx, const size_t len) {
+  if (len == 0) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lk(mtx);
+    const Clock::time_point now = Clock::now();
+
+    if (rebooting(now)) {
+      // Nobody home: MISO floats, nIRQ stays high.
+      stats.dropped_commands++;
+    } else if (state == State::awaiting_payload) {
+      handle_payload(tx, rx, len, now);
+    } else {
+      // A command while one is still pending restarts the transaction.
+      rx[0] = irq_flags();
+      handle_cmd(tx[0], now);
+    }
+    update_nirq(now);
+  }
+  cv.notify_all();
+}
+
+void TimoTwoSim::handle_cmd(const uint8_t cmd, const Clock::time_point now) {
+  stats.commands++;
+  if (drop_commands > 0) {
+    drop_commands--;
+    stats.dropped_commands++;
+    state = State::idle;
+    return;
+  }
+
+  // NOP only clocks out IRQ_FLAGS.
+  if (cmd == cmd_nop) {
+    state = State::idle;
+    return;
+  }
+
+  active_cmd = cmd;
+  state = State::cmd_pending;
+  ready_at = std::max(now, busy_until) +
+             std::chrono::microseconds(timing.cmd_response_us);
+}
+
+void TimoTwoSim::handle_payload(const uint8_t *tx, uint8_t *rx,
+                                const size_t len, const Clock::time_point now) {
+  rx[0] = irq_flags();
+  const uint8_t *data_in = tx + 1;
+  uint8_t *data_out = rx + 1;
+  const size_t data_len = len - 1;
+  state = State::idle;
+
+  if ((active_cmd & cmd_type_mask) == cmd_read_reg) {
+    const uint8_t addr = active_cmd & TIMO_REG_ADDR_MAX;
+    std::copy_n(regs[addr].begin(), std::min(data_len, regs[addr].size()),
+                data_out);
+    if (addr == IRQ_FLAGS::address) {
+      irq_flags() &= static_cast<uint8_t>(~irq_source_mask);
+    }
+    stats.reg_reads++;
+    return;
+  }
+
+  if ((active_cmd & cmd_type_mask) == cmd_write_reg) {
+    const uint8_t addr = active_cmd & TIMO_REG_ADDR_MAX;
+    if (std::find(read_only_regs.begin(), read_only_regs.end(), addr) !=
+        read_only_regs.end()) {
+      return;
+    }
+    const size_t n = std::min(data_len, regs[addr].size());
+    const bool changed = !std::equal(data_in, data_in + n, regs[addr].begin());
+    std::copy_n(data_in, n, regs[addr].begin());
+    stats.reg_writes++;
+    busy_until = now + std::chrono::microseconds(timing.reg_write_busy_us);
+    if (changed && reboots_on_change(addr)) {
+      stats.reboots++;
+      start_reboot(now, timing.reboot_ms);
+    }
+    return;
+  }
+
+  switch (active_cmd) {
+  case cmd_write_dmx: {
+    if (dmx_write_cursor >= dmx_gen_buffer.size() ||
+        now - last_dmx_write >
+            std::chrono::microseconds(timing.dmx_frame_gap_us)) {
+      dmx_write_cursor = 0;
+    }
+    if (dmx_write_cursor == 0) {
+      stats.dmx_frames_written++;
+    }
+    const size_t n =
+        std::min(data_len, dmx_gen_buffer.size() - dmx_write_cursor);
+    std::copy_n(data_in, n, dmx_gen_buffer.begin() + dmx_write_cursor);
+    dmx_write_cursor += n;
+    dmx_output = dmx_gen_buffer;
+    stats.dmx_blocks_written++;
+    last_dmx_write = now;
+    busy_until = now + std::chrono::microseconds(timing.dmx_write_busy_us);
+    break;
+  }
+  case cmd_read_dmx: {
+    const auto &window = regs[DMX_WINDOW::address];
+    const size_t size = (window[0] << 8) | window[1];
+    const size_t start = std::min<size_t>((window[2] << 8) | window[3], 512);
+    const size_t n = std::min({data_len, size, dmx_rx.size() - start});
+    std::copy_n(dmx_rx.begin() + start, n, data_out);
+    irq_flags() &= static_cast<uint8_t>(~IRQ_FLAGS::RX_DMX_IRQ.mask);
+    stats.dmx_reads++;
+    break;
+  }
+  default:
+    // Commands beyond the DMX path are accepted and ignored.
+    break;
+  }
+}
+
+void TimoTwoSim::start_reboot(const Clock::time_point now,
+                              const uint32_t duration_ms) {
+  booted_at = now + std::chrono::milliseconds(duration_ms);
+  state = State::idle;
+  irq_flags() = 0;
+  dmx_gen_buffer.fill(0);
+  dmx_output.fill(0);
+  dmx_write_cursor = 0;
+  update_nirq(now);
+}
+
+void TimoTwoSim::update_nirq(const Clock::time_point now) {
+  bool asserted = false;
+  if (!rebooting(now)) {
+    const uint8_t pending =
+        irq_flags() & regs[IRQ_MASK::address][0] & irq_source_mask;
+    asserted = state == State::awaiting_payload ||
+               (state == State::idle && pending != 0);
+  }
+  host_gpio_drive_input(nirq_pin, asserted ? 0 : 1);
+}
+
+void TimoTwoSim::run() {
+  std::unique_lock<std::mutex> lk(mtx);
+  while (!stopping) {
+    const Clock::time_point now = Clock::now();
+    if (state == State::cmd_pending && now >= ready_at) {
+      state = State::awaiting_payload;
+    }
+    update_nirq(now);
+
+    // Sleep until the next time the level can change on its own.
+    if (state == State::cmd_pending) {
+      cv.wait_until(lk, ready_at);
+    } else if (rebooting(now)) {
+      cv.wait_until(lk, booted_at);
+    } else {
+      cv.wait(lk);
+    }
+  }
+}
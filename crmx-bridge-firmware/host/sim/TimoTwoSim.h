@@ -0,0 +1,141 @@
+#pragma once
+
+#include "TimoReg.h"
+#include "driver/gpio.h"
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief Software model of a TimoTwo on the host SPI/GPIO shim.
+ *
+ * Attaches to a chip-select pin with host_spi_attach_model() and drives the
+ * nIRQ input with host_gpio_drive_input(), so TimoInterface runs against it
+ * unmodified. The model follows the SPI protocol TimoInterface implements: a
+ * one byte command, nIRQ low once the device is ready, then a payload whose
+ * first byte on MISO is IRQ_FLAGS.
+ *
+ * Covered: the register file (every address in TimoReg.h, read-only flags
+ * cleared on read), IRQ_MASK gating of nIRQ, WRITE_DMX filling the generation
+ * buffer in command order, READ_DMX over DMX_WINDOW, a reboot when CONFIG or
+ * RF_PROTOCOL changes, configurable busy times and dropped commands for fault
+ * injection.
+ */
+class TimoTwoSim {
+public:
+  struct Timing {
+    // Command byte to nIRQ asserted.
+    uint32_t cmd_response_us = 20;
+    // Device busy after each payload; a command arriving sooner is answered
+    // once this has elapsed.
+    uint32_t reg_write_busy_us = 50;
+    uint32_t dmx_write_busy_us = 100;
+    // Unresponsive after power-on and after a reboot-triggering write.
+    uint32_t boot_ms = 300;
+    uint32_t reboot_ms = 300;
+    // A WRITE_DMX more than this long after the previous one, or after a
+    // full universe, starts a new frame at slot 0.
+    uint32_t dmx_frame_gap_us = 1000;
+  };
+
+  struct Stats {
+    uint32_t commands;
+    uint32_t dropped_commands;
+    uint32_t reg_reads;
+    uint32_t reg_writes;
+    uint32_t reboots;
+    uint32_t dmx_blocks_written;
+    uint32_t dmx_frames_written;
+    uint32_t dmx_reads;
+  };
+
+  TimoTwoSim(const int spics_io_num, const gpio_num_t nirq_pin);
+  TimoTwoSim(const int spics_io_num, const gpio_num_t nirq_pin,
+             const Timing &timing);
+  ~TimoTwoSim();
+
+  TimoTwoSim(const TimoTwoSim &) = delete;
+  TimoTwoSim &operator=(const TimoTwoSim &) = delete;
+
+  // Restart the boot timer, as if power was just applied.
+  void power_on();
+
+  // Fault injection: ignore the next count commands entirely, so the host
+  // times out waiting for nIRQ.
+  void drop_next_commands(const uint32_t count);
+
+  // RX mode: a universe arrived over the air. Sets RX_DMX in IRQ_FLAGS.
+  void receive_dmx(const std::array<uint8_t, 512> &data);
+
+  // Last universe completed by WRITE_DMX.
+  std::array<uint8_t, 512> get_dmx_output();
+
+  template <uint8_t addr, typename T, size_t len>
+  void get_reg(Register<addr, T, len> &reg) {
+    std::lock_guard<std::mutex> lk(mtx);
+    memcpy(reg.raw(), regs[addr].data(), reg.raw_len());
+  }
+
+  template <uint8_t addr, typename T, size_t len>
+  void set_reg(const Register<addr, T, len> &reg) {
+    std::lock_guard<std::mutex> lk(mtx);
+    memcpy(regs[addr].data(), reg.raw(), reg.raw_len());
+  }
+
+  Stats get_stats();
+
+protected:
+  using Clock = std::chrono::steady_clock;
+
+  enum class State {
+    idle,
+    // Command received, nIRQ not yet asserted.
+    cmd_pending,
+    // nIRQ asserted, waiting for the payload.
+    awaiting_payload,
+  };
+
+  static void transfer_trampoline(void *ctx, const uint8_t *tx, uint8_t *rx,
+                                  size_t len);
+  void transfer(const uint8_t *tx, uint8_t *rx, const size_t len);
+  void handle_cmd(const uint8_t cmd, const Clock::time_point now);
+  void handle_payload(const uint8_t *tx, uint8_t *rx, const size_t len,
+                      const Clock::time_point now);
+  void start_reboot(const Clock::time_point now, const uint32_t duration_ms);
+
+  // Present the nIRQ level for the current state. Called with mtx held so
+  // edges reach the host in order.
+  void update_nirq(const Clock::time_point now);
+  void run();
+
+  bool rebooting(const Clock::time_point now) const { return now < booted_at; }
+  uint8_t &irq_flags() { return regs[TIMO::IRQ_FLAGS::address][0]; }
+
+  const int spics_io_num;
+  const gpio_num_t nirq_pin;
+  const Timing timing;
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool stopping;
+  std::thread worker;
+
+  State state;
+  uint8_t active_cmd;
+  Clock::time_point ready_at;
+  Clock::time_point busy_until;
+  Clock::time_point booted_at;
+  Clock::time_point last_dmx_write;
+  uint32_t drop_commands;
+
+  std::array<std::array<uint8_t, 32>, TIMO_REG_ADDR_MAX + 1> regs;
+  std::array<uint8_t, 512> dmx_gen_buffer;
+  size_t dmx_write_cursor;
+  std::array<uint8_t, 512> dmx_output;
+  std::array<uint8_t, 512> dmx_rx;
+  Stats stats;
+};
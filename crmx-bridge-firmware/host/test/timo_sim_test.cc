@@ -0,0 +1,180 @@
+// Drives TimoInterface against TimoTwoSim and checks the properties the
+// driver's register shadow and DMX path promise:
+//
+//   - re-applying an unchanged software config costs no SPI transactions,
+//   - a full universe goes out within the per-universe budget,
+//   - after commands are dropped and the module reboots, the driver
+//     recovers and the module ends up with the config and levels it was sent.
+//
+// Exits non-zero if any check fails, so ctest reports it.
+#include "TimoInterface.h"
+#include "TimoTwoSim.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace TIMO;
+
+namespace {
+constexpr spi_host_device_t spi_bus = SPI2_HOST;
+constexpr gpio_num_t nirq_pin = GPIO_NUM_9;
+constexpr int cs_pin = GPIO_NUM_10;
+
+// The TimoTwo refreshes a full universe about every 23 ms; a write has to
+// leave the TX task well inside that.
+constexpr uint32_t universe_budget_us = 4000;
+
+constexpr TimoHardwareConfig hw_config = {
+    .nirq_pin = nirq_pin,
+    .spi_devcfg =
+        {
+            .mode = 0,
+            .cs_ena_pretrans = 6,
+            .clock_speed_hz = 2 * 1000 * 1000,
+            .spics_io_num = cs_pin,
+            .queue_size = TimoInterface::spi_queue_size,
+        },
+};
+
+int failures = 0;
+
+#define CHECK(cond, ...)                                                       \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("FAIL %s:%d: %s: ", __FILE__, __LINE__, #cond);                   \
+      printf(__VA_ARGS__);                                                     \
+      printf("\n");                                                            \
+      failures++;                                                              \
+      return;                                                                  \
+    }                                                                          \
+  } while (0)
+
+TimoSoftwareConfig make_config(const RF_PROTOCOL::TX_PROTOCOL_T protocol) {
+  return TimoSoftwareConfig{
+      .radio_en = true,
+      .tx_rx_mode = CONFIG::RADIO_TX_RX_MODE_T::TX,
+      .rf_protocol = protocol,
+      .dmx_source = DMX_SOURCE::DATA_SOURCE_T::NO_DATA,
+      .rf_power = RF_POWER::OUTPUT_POWER_T::PWR_40_MW,
+      .universe_color = RGBColor{.red = 10, .green = 20, .blue = 30},
+      .device_name = "timo_sim_test",
+  };
+}
+
+std::array<uint8_t, 512> make_universe(const uint8_t seed) {
+  std::array<uint8_t, 512> data;
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<uint8_t>(seed + i * 13);
+  }
+  return data;
+}
+
+void test_repeated_config(TimoInterface &timo, TimoTwoSim &sim) {
+  const TimoSoftwareConfig config =
+      make_config(RF_PROTOCOL::TX_PROTOCOL_T::CRMX);
+  CHECK(timo.set_sw_config(config) == ESP_OK, "first set_sw_config");
+
+  const uint32_t commands = sim.get_stats().commands;
+  CHECK(timo.set_sw_config(config) == ESP_OK, "repeated set_sw_config");
+  const uint32_t repeated = sim.get_stats().commands - commands;
+  CHECK(repeated == 0, "%" PRIu32 " SPI commands for an unchanged config",
+        repeated);
+  printf("ok   repeated set_sw_config: 0 SPI commands\n");
+}
+
+void test_universe_time(TimoInterface &timo, TimoTwoSim &sim) {
+  // Every slot changes every frame, so every block is sent each time.
+  constexpr size_t frames = 200;
+  std::vector<uint32_t> times_us;
+  std::array<uint8_t, 512> data;
+  for (size_t f = 0; f < frames; f++) {
+    data = make_universe(static_cast<uint8_t>(f));
+    const int64_t start = esp_timer_get_time();
+    CHECK(timo.write_dmx(data) == ESP_OK, "write_dmx frame %zu", f);
+    times_us.push_back(static_cast<uint32_t>(esp_timer_get_time() - start));
+  }
+  CHECK(sim.get_dmx_output() == data, "module output differs from last frame");
+
+  // The shim holds the bus for the clocked bit time, so this is mostly the
+  // 2 MHz transfer itself. Any frame can still be stretched by the host
+  // descheduling a thread, so the budget applies to the median; a driver
+  // that sleeps or stalls per block still pushes that far over it.
+  std::sort(times_us.begin(), times_us.end());
+  const uint32_t p50_us = times_us[frames / 2];
+  const uint32_t p95_us = times_us[frames * 95 / 100];
+  const uint32_t max_us = times_us.back();
+  CHECK(p50_us < universe_budget_us,
+        "median universe took %" PRIu32 " us, budget %" PRIu32 " us", p50_us,
+        universe_budget_us);
+  printf("ok   write_dmx: p50 %" PRIu32 " us, p95 %" PRIu32 " us, max %" PRIu32
+         " us per universe (budget %" PRIu32 " us)\n",
+         p50_us, p95_us, max_us, universe_budget_us);
+}
+
+void test_reboot_recovery(TimoInterface &timo, TimoTwoSim &sim) {
+  // Lose the commands of a protocol change that reboots the module, so the
+  // driver times out partway through.
+  const TimoSoftwareConfig changed =
+      make_config(RF_PROTOCOL::TX_PROTOCOL_T::W_DMX_G3);
+  sim.drop_next_commands(2);
+  const esp_err_t failed = timo.set_sw_config(changed);
+  CHECK(failed != ESP_OK, "set_sw_config succeeded with dropped commands");
+
+  // Then the module power cycles on its own.
+  sim.power_on();
+  CHECK(timo.read_back_state() == ESP_OK, "read_back_state after reboot");
+  CHECK(timo.set_sw_config(changed) == ESP_OK, "set_sw_config after reboot");
+
+  RF_PROTOCOL rf_protocol;
+  sim.get_reg(rf_protocol);
+  CHECK(rf_protocol.get(RF_PROTOCOL::TX_PROTOCOL) ==
+            static_cast<uint8_t>(RF_PROTOCOL::TX_PROTOCOL_T::W_DMX_G3),
+        "module did not take the new protocol");
+
+  // The reboot cleared the module's buffer; the next frame must be whole.
+  const std::array<uint8_t, 512> data = make_universe(0x55);
+  CHECK(timo.write_dmx(data) == ESP_OK, "write_dmx after reboot");
+  CHECK(sim.get_dmx_output() == data, "module output differs after reboot");
+
+  const uint32_t commands = sim.get_stats().commands;
+  CHECK(timo.set_sw_config(changed) == ESP_OK, "repeated set_sw_config");
+  CHECK(sim.get_stats().commands == commands,
+        "shadow not re-learned after reboot");
+  printf("ok   reboot after dropped commands: recovered\n");
+}
+} // namespace
+
+int main() {
+  TimoTwoSim::Timing timing;
+  timing.boot_ms = 50;
+  timing.reboot_ms = 50;
+  // Every frame here is a full universe, so frames are told apart by the
+  // cursor wrapping. A host thread can be descheduled for longer than the
+  // default 1 ms between two blocks, which would restart a frame midway.
+  timing.dmx_frame_gap_us = 50 * 1000;
+  TimoTwoSim sim(cs_pin, nirq_pin, timing);
+
+  const spi_bus_config_t bus_config = {
+      .mosi_io_num = -1,
+      .miso_io_num = -1,
+      .sclk_io_num = -1,
+      .quadwp_io_num = -1,
+      .quadhd_io_num = -1,
+      .max_transfer_sz = 0,
+  };
+  TimoInterface timo{hw_config};
+  if (spi_bus_initialize(spi_bus, &bus_config, SPI_DMA_CH_AUTO) != ESP_OK ||
+      timo.init(spi_bus) != ESP_OK || timo.read_back_state() != ESP_OK) {
+    printf("FAIL: could not bring up the driver against the simulator\n");
+    return 1;
+  }
+
+  test_repeated_config(timo, sim);
+  test_universe_time(timo, sim);
+  test_reboot_recovery(timo, sim);
+
+  printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+  return failures == 0 ? 0 : 1;
+}
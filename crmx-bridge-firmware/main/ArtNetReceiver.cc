@@ -0,0 +1,239 @@
+#include "ArtNetReceiver.h"
+#include "DmxSwitcher.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/ip.h"
+#include "tcpip_call.h"
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+static const char *TAG = "ARTNET";
+
+// A sequence this far behind the last one is a restarted sender, not a
+// reordered packet.
+static constexpr int8_t artnet_sequence_window = 20;
+
+static ArtNetReceiver artnet_receiver;
+
+ArtNetReceiver &ArtNetReceiver::shared() { return artnet_receiver; }
+
+esp_err_t ArtNetReceiver::start(DmxInterface &_interface) {
+  if (interface != nullptr) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  interface = &_interface;
+
+  const err_t err = call_on_tcpip(*this, start_cb);
+  if (err != ERR_OK) {
+    ESP_LOGE(TAG, "Could not bind port %" PRIu16 ": %d", artnet_port, err);
+    interface = nullptr;
+    return ESP_FAIL;
+  }
+  ESP_LOGI(TAG, "Listening on port %" PRIu16, artnet_port);
+  return ESP_OK;
+}
+
+void ArtNetReceiver::stop() {
+  if (interface == nullptr) {
+    return;
+  }
+  // Once this returns no callback can still be using the interface.
+  call_on_tcpip(*this, stop_cb);
+  interface = nullptr;
+}
+
+err_t ArtNetReceiver::start_cb(ArtNetReceiver &self) {
+  self.pcb = udp_new();
+  if (self.pcb == nullptr) {
+    return ERR_MEM;
+  }
+  ip_set_option(self.pcb, SOF_BROADCAST);
+  const err_t err = udp_bind(self.pcb, IP_ADDR_ANY, artnet_port);
+  if (err != ERR_OK) {
+    udp_remove(self.pcb);
+    self.pcb = nullptr;
+    return err;
+  }
+  udp_recv(self.pcb, recv_cb, &self);
+  return ERR_OK;
+}
+
+err_t ArtNetReceiver::stop_cb(ArtNetReceiver &self) {
+  if (self.pcb != nullptr) {
+    udp_remove(self.pcb);
+    self.pcb = nullptr;
+  }
+  return ERR_OK;
+}
+
+esp_err_t ArtNetReceiver::set_address(const uint8_t net,
+                                      const uint8_t subnet) {
+  if (net > 0x7F || subnet > 0xF) {
+    ESP_LOGE(TAG, "Invalid net %" PRIu8 " / sub-net %" PRIu8, net, subnet);
+    return ESP_ERR_INVALID_ARG;
+  }
+  base_address.store(static_cast<uint16_t>(net << 8 | subnet << 4),
+                     std::memory_order_relaxed);
+  return ESP_OK;
+}
+
+void ArtNetReceiver::on_settings_update(const SettingsHandler &settings) {
+  set_address(settings.artnet_net, settings.artnet_subnet);
+}
+
+ArtNetReceiver::Stats ArtNetReceiver::get_stats() const {
+  return Stats{
+      .packets = packets,
+      .dmx_frames = dmx_frames,
+      .polls = polls,
+      .filtered = filtered,
+      .out_of_order = out_of_order,
+      .malformed = malformed,
+      .no_frame = no_frame,
+      .parse_time = parse_time.summarize(),
+  };
+}
+
+void ArtNetReceiver::recv_cb(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+                             const ip_addr_t *addr, u16_t port) {
+  ArtNetReceiver &self = *static_cast<ArtNetReceiver *>(arg);
+  const int64_t start_us = esp_timer_get_time();
+  self.packets.fetch_add(1, std::memory_order_relaxed);
+
+  ArtNetHeader header;
+  if (pbuf_copy_partial(p, &header, sizeof(header), 0) != sizeof(header) ||
+      memcmp(header.id, artnet_id, sizeof(artnet_id)) != 0) {
+    self.malformed.fetch_add(1, std::memory_order_relaxed);
+  } else if (header.op_code == artnet_op_dmx) {
+    self.handle_dmx(p, start_us);
+  } else if (header.op_code == artnet_op_poll) {
+    self.handle_poll(addr);
+  }
+  pbuf_free(p);
+}
+
+void ArtNetReceiver::handle_dmx(const struct pbuf *p, const int64_t start_us) {
+  ArtDmxHeader dmx;
+  if (pbuf_copy_partial(p, &dmx, sizeof(dmx), 0) != sizeof(dmx)) {
+    malformed.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  const uint16_t length = dmx.length_hi << 8 | dmx.length_lo;
+  const uint16_t prot_ver = dmx.prot_ver_hi << 8 | dmx.prot_ver_lo;
+  if (prot_ver < artnet_protocol_version || length == 0 ||
+      length > dmx_packet_size || p->tot_len < sizeof(dmx) + length) {
+    malformed.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  const uint16_t port_address = (dmx.net & 0x7F) << 8 | dmx.sub_uni;
+  const uint16_t base = base_address.load(std::memory_order_relaxed);
+  const uint16_t universe = port_address - base;
+  if (port_address < base || universe >= artnet_subnet_universes ||
+      !interface->is_src_routed(universe)) {
+    filtered.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  if (dmx.sequence != 0) {
+    uint8_t &last = last_sequence[universe];
+    const int8_t ahead = static_cast<int8_t>(dmx.sequence - last);
+    if (last != 0 && ahead <= 0 && ahead > -artnet_sequence_window) {
+      out_of_order.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    last = dmx.sequence;
+  }
+
+  DmxFrameRef frame = DmxFramePool::shared().acquire();
+  if (!frame) {
+    no_frame.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  frame->source = DmxSourceSink::artnet;
+  frame->universe = universe;
+  frame->slot_count = length;
+  frame->times = DmxFrameTimes{.rx_us = start_us, .dispatch_us = 0};
+  frame->full_packet.start_code = 0;
+  uint8_t *data = frame->full_packet.data.data();
+  pbuf_copy_partial(p, data, length, sizeof(dmx));
+  memset(data + length, 0, dmx_packet_size - length);
+
+  interface->send(std::move(frame));
+  dmx_frames.fetch_add(1, std::memory_order_relaxed);
+  parse_time.record(esp_timer_get_time() - start_us);
+}
+
+void ArtNetReceiver::handle_poll(const ip_addr_t *addr) {
+  polls.fetch_add(1, std::memory_order_relaxed);
+
+  struct pbuf *reply_buf =
+      pbuf_alloc(PBUF_TRANSPORT, sizeof(ArtPollReply), PBUF_RAM);
+  if (reply_buf == nullptr) {
+    ESP_LOGW(TAG, "No pbuf for ArtPollReply");
+    return;
+  }
+  ArtPollReply reply{};
+  fill_poll_reply(reply);
+  pbuf_take(reply_buf, &reply, sizeof(reply));
+
+  // Art-Net 4 replies go straight back to the controller that polled.
+  const err_t err = udp_sendto(pcb, reply_buf, addr, artnet_port);
+  if (err != ERR_OK) {
+    ESP_LOGW(TAG, "ArtPollReply failed: %d", err);
+  }
+  pbuf_free(reply_buf);
+}
+
+void ArtNetReceiver::fill_poll_reply(ArtPollReply &reply) const {
+  memcpy(reply.header.id, artnet_id, sizeof(artnet_id));
+  reply.header.op_code = artnet_op_poll_reply;
+
+  const struct netif *netif = ip_current_input_netif();
+  if (netif != nullptr) {
+    const uint32_t ip = ip4_addr_get_u32(netif_ip4_addr(netif));
+    memcpy(reply.ip, &ip, sizeof(reply.ip));
+    memcpy(reply.bind_ip, &ip, sizeof(reply.bind_ip));
+    memcpy(reply.mac, netif->hwaddr, sizeof(reply.mac));
+  }
+  reply.port = artnet_port;
+
+  const uint16_t base = base_address.load(std::memory_order_relaxed);
+  reply.net_switch = base >> 8;
+  reply.sub_switch = (base >> 4) & 0xF;
+  // Unregistered OEM and manufacturer codes.
+  reply.oem_hi = 0x00;
+  reply.oem_lo = 0xFF;
+  reply.esta_man = 0x0000;
+  // Indicators normal, port address set from the front panel.
+  reply.status1 = 0xD0;
+  strncpy(reply.short_name, "CRMXBridge", sizeof(reply.short_name) - 1);
+  strncpy(reply.long_name, "CRMX Bridge Art-Net to DMX/CRMX",
+          sizeof(reply.long_name) - 1);
+  snprintf(reply.node_report, sizeof(reply.node_report),
+           "#0001 [%04" PRIu32 "] %" PRIu32 " frames",
+           polls.load(std::memory_order_relaxed) % 10000,
+           dmx_frames.load(std::memory_order_relaxed));
+
+  // One output port per routed universe, in port order.
+  size_t num_ports = 0;
+  for (size_t port = 0; port < interface->get_port_count() &&
+                        num_ports < sizeof(reply.sw_out);
+       port++) {
+    const uint16_t universe = interface->get_src_universe(port);
+    if (universe >= artnet_subnet_universes) {
+      continue;
+    }
+    // Can output DMX512 from Art-Net.
+    reply.port_types[num_ports] = 0x80;
+    // Data is being output.
+    reply.good_output_a[num_ports] = 0x80;
+    reply.sw_out[num_ports] = universe;
+    num_ports++;
+  }
+  reply.num_ports_lo = num_ports;
+  reply.bind_index = 1;
+  // 15-bit port addresses, DHCP capable and in use.
+  reply.status2 = 0x0E;
+}
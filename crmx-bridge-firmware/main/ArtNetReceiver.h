@@ -0,0 +1,158 @@
+#pragma once
+
+#include "DmxLatency.h"
+#include "SettingsHandler.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "lwip/ip_addr.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class DmxInterface;
+
+static constexpr char artnet_id[8] = {'A', 'r', 't', '-', 'N', 'e', 't', '\0'};
+static constexpr uint16_t artnet_port = 6454;
+static constexpr uint16_t artnet_op_poll = 0x2000;
+static constexpr uint16_t artnet_op_poll_reply = 0x2100;
+static constexpr uint16_t artnet_op_dmx = 0x5000;
+static constexpr uint16_t artnet_protocol_version = 14;
+// Universes per sub-net; the low nibble of a port address.
+static constexpr size_t artnet_subnet_universes = 16;
+
+// Fields are little endian unless named _hi/_lo.
+struct __attribute__((packed)) ArtNetHeader {
+  char id[8];
+  uint16_t op_code;
+};
+
+struct __attribute__((packed)) ArtDmxHeader {
+  ArtNetHeader header;
+  uint8_t prot_ver_hi;
+  uint8_t prot_ver_lo;
+  uint8_t sequence;
+  uint8_t physical;
+  // Sub-net in the high nibble, universe in the low one.
+  uint8_t sub_uni;
+  uint8_t net;
+  uint8_t length_hi;
+  uint8_t length_lo;
+};
+static_assert(sizeof(ArtDmxHeader) == 18);
+
+struct __attribute__((packed)) ArtPollReply {
+  ArtNetHeader header;
+  uint8_t ip[4];
+  uint16_t port;
+  uint8_t vers_info_hi;
+  uint8_t vers_info_lo;
+  uint8_t net_switch;
+  uint8_t sub_switch;
+  uint8_t oem_hi;
+  uint8_t oem_lo;
+  uint8_t ubea_version;
+  uint8_t status1;
+  uint16_t esta_man;
+  char short_name[18];
+  char long_name[64];
+  char node_report[64];
+  uint8_t num_ports_hi;
+  uint8_t num_ports_lo;
+  uint8_t port_types[4];
+  uint8_t good_input[4];
+  uint8_t good_output_a[4];
+  uint8_t sw_in[4];
+  uint8_t sw_out[4];
+  uint8_t acn_priority;
+  uint8_t sw_macro;
+  uint8_t sw_remote;
+  uint8_t spare[3];
+  uint8_t style;
+  uint8_t mac[6];
+  uint8_t bind_ip[4];
+  uint8_t bind_index;
+  uint8_t status2;
+  uint8_t good_output_b[4];
+  uint8_t status3;
+  uint8_t default_resp_uid[6];
+  uint8_t user_hi;
+  uint8_t user_lo;
+  uint8_t refresh_rate_hi;
+  uint8_t refresh_rate_lo;
+  uint8_t filler[11];
+};
+static_assert(sizeof(ArtPollReply) == 239);
+
+/**
+ * @brief Art-Net receiver feeding the artnet DmxInterface.
+ *
+ * Runs on lwIP's raw UDP API, so packets are handled in the tcpip thread
+ * straight from the pbufs the driver delivered: no socket mailbox and no task
+ * switch per packet. An ArtDmx payload is copied once, from the pbuf into a
+ * pool frame, which is then published to the switcher by reference.
+ *
+ * The node listens on one net and sub-net. Its universes 0-15 become the
+ * artnet interface's universes, so universe 0 feeds the primary route and the
+ * routing table picks up the rest. Universes nothing routes are dropped
+ * before a frame is taken from the pool, and ArtPollReply advertises the
+ * routed ones as output ports.
+ */
+class ArtNetReceiver : public SettingsChangeDelegate {
+public:
+  struct Stats {
+    uint32_t packets;
+    uint32_t dmx_frames;
+    uint32_t polls;
+    // ArtDmx for another net, sub-net or an unrouted universe.
+    uint32_t filtered;
+    // ArtDmx whose sequence number is older than the last one seen.
+    uint32_t out_of_order;
+    uint32_t malformed;
+    uint32_t no_frame;
+    // Time from the callback being entered to the frame being published.
+    LatencyHistogram::Summary parse_time;
+  };
+
+  static ArtNetReceiver &shared();
+
+  // Binds the Art-Net port. The network stack must be initialised.
+  esp_err_t start(DmxInterface &_interface);
+  void stop();
+
+  // Thread-safe.
+  esp_err_t set_address(const uint8_t net, const uint8_t subnet);
+  Stats get_stats() const;
+
+  void on_settings_update(const SettingsHandler &settings) override;
+
+protected:
+  static err_t start_cb(ArtNetReceiver &self);
+  static err_t stop_cb(ArtNetReceiver &self);
+  static void recv_cb(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+                      const ip_addr_t *addr, u16_t port);
+
+  // Only called on the tcpip thread.
+  void handle_dmx(const struct pbuf *p, const int64_t start_us);
+  void handle_poll(const ip_addr_t *addr);
+  void fill_poll_reply(ArtPollReply &reply) const;
+
+  DmxInterface *interface = nullptr;
+  struct udp_pcb *pcb = nullptr;
+  // Port address of universe 0, i.e. net << 8 | sub-net << 4.
+  std::atomic<uint16_t> base_address{0};
+
+  // Only touched by the tcpip thread. 0 means no sequence seen yet.
+  std::array<uint8_t, artnet_subnet_universes> last_sequence{};
+
+  std::atomic<uint32_t> packets{0};
+  std::atomic<uint32_t> dmx_frames{0};
+  std::atomic<uint32_t> polls{0};
+  std::atomic<uint32_t> filtered{0};
+  std::atomic<uint32_t> out_of_order{0};
+  std::atomic<uint32_t> malformed{0};
+  std::atomic<uint32_t> no_frame{0};
+  LatencyHistogram parse_time;
+};
@@ -0,0 +1,98 @@
+#include "DmxCrossfade.h"
+#include "esp_log.h"
+#include <array>
+#include <cstring>
+
+static const char *TAG = "DMX_XFADE";
+
+namespace {
+constexpr uint32_t even_bytes = 0x00FF00FF;
+
+inline uint32_t load_word(const uint8_t *p) {
+  uint32_t word;
+  memcpy(&word, p, sizeof(word));
+  return word;
+}
+
+inline void store_word(uint8_t *p, const uint32_t word) {
+  memcpy(p, &word, sizeof(word));
+}
+
+// Bytes are split into two 16-bit lanes each. a * (full - level) + b * level
+// is at most 255 * 256, so neither lane overflows into the next.
+inline uint32_t mix_u8x4(const uint32_t a, const uint32_t b,
+                         const uint32_t level) {
+  const uint32_t inv = dmx_crossfade_full - level;
+  const uint32_t even =
+      ((a & even_bytes) * inv + (b & even_bytes) * level) >> 8;
+  const uint32_t odd =
+      ((a >> 8) & even_bytes) * inv + ((b >> 8) & even_bytes) * level;
+  return (even & even_bytes) | (odd & ~even_bytes);
+}
+} // namespace
+
+void dmx_crossfade(uint8_t *dst, const uint8_t *a, const uint8_t *b,
+                   const uint32_t level, const size_t len) {
+  size_t i = 0;
+  for (; i + sizeof(uint32_t) <= len; i += sizeof(uint32_t)) {
+    store_word(dst + i,
+               mix_u8x4(load_word(a + i), load_word(b + i), level));
+  }
+  const uint32_t inv = dmx_crossfade_full - level;
+  for (; i < len; i++) {
+    dst[i] = static_cast<uint8_t>((a[i] * inv + b[i] * level) >>
+                                  dmx_crossfade_shift);
+  }
+}
+
+void DmxCrossfade::set_source(const DmxSourceSink src, const int64_t now) {
+  if (src == source) {
+    return;
+  }
+  // A change during a fade restarts it from the source being faded in.
+  if (duration_us > 0 && latest && source != DmxSourceSink::none) {
+    from = std::move(latest);
+    from_source = source;
+    start_us = now;
+    fading = true;
+    ESP_LOGI(TAG, "Crossfading over %lld ms",
+             static_cast<long long>(duration_us / 1000));
+  }
+  latest.reset();
+  source = src;
+}
+
+bool DmxCrossfade::is_fading(const int64_t now) {
+  if (fading && now - start_us >= duration_us) {
+    fading = false;
+    from.reset();
+    from_source = DmxSourceSink::none;
+  }
+  return fading;
+}
+
+DmxFrameRef DmxCrossfade::render(const int64_t now) {
+  DmxFrameRef out = DmxFramePool::shared().acquire();
+  if (!out) {
+    ESP_LOGW(TAG, "No free DMX frame for crossfade");
+    return out;
+  }
+  const uint32_t level = static_cast<uint32_t>(
+      (now - start_us) * dmx_crossfade_full / duration_us);
+  // A side with no frame yet fades from or to black.
+  static const std::array<uint8_t, dmx_packet_size> black{};
+  const uint8_t *a = from ? from->full_packet.data.data() : black.data();
+  const uint8_t *b = latest ? latest->full_packet.data.data() : black.data();
+  dmx_crossfade(out->full_packet.data.data(), a, b, level, dmx_packet_size);
+  // As long as the longer side; both have zeroed tails.
+  const uint16_t a_slots = from ? from->slot_count : 0;
+  const uint16_t b_slots = latest ? latest->slot_count : 0;
+  out->slot_count = a_slots > b_slots ? a_slots : b_slots;
+  if (out->slot_count == 0) {
+    out->slot_count = dmx_packet_size;
+  }
+  out->source = source;
+  out->times = latest ? latest->times : DmxFrameTimes{.rx_us = now};
+  out->full_packet.start_code = 0;
+  return out;
+}
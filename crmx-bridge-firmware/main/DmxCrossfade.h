@@ -0,0 +1,66 @@
+#pragma once
+
+#include "DmxFramePool.h"
+#include "util.h"
+#include <cstddef>
+#include <cstdint>
+
+// Crossfade levels are fixed point; dmx_crossfade_full is all b.
+static constexpr uint32_t dmx_crossfade_shift = 8;
+static constexpr uint32_t dmx_crossfade_full = 1 << dmx_crossfade_shift;
+
+// dst[i] = (a[i] * (full - level) + b[i] * level) >> shift, for level in
+// [0, dmx_crossfade_full]. Works two channels per 32-bit word half like the
+// merge kernels; buffers may be unaligned and dst may be a or b.
+void dmx_crossfade(uint8_t *dst, const uint8_t *a, const uint8_t *b,
+                   const uint32_t level, const size_t len);
+
+/**
+ * @brief Crossfades the routed universe from the old source to the new one
+ * when the route changes.
+ *
+ * Keeps a reference to the latest frame of the routed source. When the
+ * source changes, that becomes the outgoing look, and every output frame
+ * until the fade time is up mixes the latest frames of both sources. A
+ * source with no frame yet counts as black. Not thread-safe; owned by the
+ * switcher task.
+ */
+class DmxCrossfade {
+public:
+  // 0 cuts straight to the new source.
+  void set_duration_ms(const uint32_t ms) {
+    duration_us = static_cast<int64_t>(ms) * 1000;
+    if (duration_us == 0) {
+      latest.reset();
+    }
+  }
+
+  // The source frames are routed from now on. Starts a fade if it changed.
+  void set_source(const DmxSourceSink src, const int64_t now);
+  DmxSourceSink get_source() const { return source; }
+  DmxSourceSink get_from() const { return from_source; }
+
+  // The latest frame of the routed source. Not kept while fades are off.
+  void update(const DmxFrameRef &frame) {
+    if (duration_us > 0) {
+      latest = frame.share();
+    }
+  }
+  // The latest frame of the source being faded out.
+  void update_from(DmxFrameRef &&frame) { from = std::move(frame); }
+
+  // Whether the fade still runs at now; releases the outgoing look once done.
+  bool is_fading(const int64_t now);
+  // Mix the two latest frames into a fresh frame, or return an empty
+  // reference if the pool ran out.
+  DmxFrameRef render(const int64_t now);
+
+protected:
+  int64_t duration_us = 0;
+  DmxSourceSink source = DmxSourceSink::none;
+  DmxSourceSink from_source = DmxSourceSink::none;
+  DmxFrameRef latest;
+  DmxFrameRef from;
+  int64_t start_us = 0;
+  bool fading = false;
+};
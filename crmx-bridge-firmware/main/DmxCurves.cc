@@ -0,0 +1,117 @@
+#include "DmxCurves.h"
+#include "esp_log.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const char *TAG = "DMX_CURVE";
+
+bool DmxCurveMap::is_straight(const DmxCurveRule &rule) {
+  return rule.type == DmxCurveType::linear && !rule.invert && rule.min == 0 &&
+         rule.max == UINT8_MAX;
+}
+
+bool DmxCurveMap::same_curve(const DmxCurveRule &a, const DmxCurveRule &b) {
+  if (a.type != b.type || a.invert != b.invert || a.min != b.min ||
+      a.max != b.max) {
+    return false;
+  }
+  return a.type != DmxCurveType::custom || a.points == b.points;
+}
+
+void DmxCurveMap::build_table(const DmxCurveRule &rule, uint8_t *table) {
+  for (size_t in = 0; in < 256; in++) {
+    const float x = in / 255.0f;
+    float y;
+    switch (rule.type) {
+    case DmxCurveType::square:
+      y = x * x;
+      break;
+    case DmxCurveType::root:
+      y = sqrtf(x);
+      break;
+    case DmxCurveType::s_curve:
+      y = x * x * (3.0f - 2.0f * x);
+      break;
+    case DmxCurveType::custom: {
+      const float pos = x * (dmx_curve_points - 1);
+      const size_t seg = pos >= dmx_curve_points - 1
+                             ? dmx_curve_points - 2
+                             : static_cast<size_t>(pos);
+      const float frac = pos - seg;
+      y = (rule.points[seg] + (rule.points[seg + 1] - rule.points[seg]) * frac) /
+          255.0f;
+      break;
+    }
+    case DmxCurveType::linear:
+    default:
+      y = x;
+      break;
+    }
+
+    int out = static_cast<int>(lroundf(y * 255.0f));
+    if (rule.invert) {
+      out = UINT8_MAX - out;
+    }
+    out = out < rule.min ? rule.min : out;
+    out = out > rule.max ? rule.max : out;
+    table[in] = static_cast<uint8_t>(out);
+  }
+}
+
+esp_err_t DmxCurveMap::compile(const DmxCurveRule *rules, const size_t count) {
+  // Validate and assign tables first so a bad rule set leaves the map as is.
+  // Rule r uses table rule_tables[r]; table 0 is straight through.
+  std::array<uint8_t, dmx_curve_max_rules> rule_tables{};
+  std::array<size_t, dmx_curve_max_tables> table_rules{};
+  size_t tables_used = 1;
+  if (count > dmx_curve_max_rules) {
+    ESP_LOGE(TAG, "Too many curve rules: %zu", count);
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (size_t r = 0; r < count; r++) {
+    const DmxCurveRule &rule = rules[r];
+    const size_t end = static_cast<size_t>(rule.start) + rule.count - 1;
+    if (rule.start < 1 || rule.count == 0 || end > dmx_curve_channels ||
+        rule.type > DmxCurveType::custom || rule.min > rule.max) {
+      ESP_LOGE(TAG, "Invalid curve rule %zu: %u x %u", r, rule.start,
+               rule.count);
+      return ESP_ERR_INVALID_ARG;
+    }
+    if (is_straight(rule)) {
+      rule_tables[r] = 0;
+      continue;
+    }
+    size_t t = 1;
+    while (t < tables_used && !same_curve(rules[table_rules[t]], rule)) {
+      t++;
+    }
+    if (t == tables_used) {
+      if (tables_used == dmx_curve_max_tables) {
+        ESP_LOGE(TAG, "More than %zu distinct curves", dmx_curve_max_tables);
+        return ESP_ERR_NO_MEM;
+      }
+      table_rules[tables_used++] = r;
+    }
+    rule_tables[r] = static_cast<uint8_t>(t);
+  }
+
+  for (size_t in = 0; in < 256; in++) {
+    tables[in] = static_cast<uint8_t>(in);
+  }
+  for (size_t t = 1; t < tables_used; t++) {
+    build_table(rules[table_rules[t]], &tables[t * 256]);
+  }
+  channel_offsets.fill(0);
+  for (size_t r = 0; r < count; r++) {
+    const uint16_t offset = rule_tables[r] * 256;
+    for (size_t k = 0; k < rules[r].count; k++) {
+      channel_offsets[rules[r].start - 1 + k] = offset;
+    }
+  }
+
+  table_count = tables_used;
+  identity = std::all_of(channel_offsets.begin(), channel_offsets.end(),
+                         [](const uint16_t offset) { return offset == 0; });
+  return ESP_OK;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "esp_err.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+static constexpr size_t dmx_curve_max_rules = 32;
+static constexpr size_t dmx_curve_max_tables = 16;
+static constexpr size_t dmx_curve_channels = 512;
+static constexpr size_t dmx_curve_points = 9;
+
+enum class DmxCurveType : uint8_t {
+  linear,
+  // out = in^2, for dimmers that should fade like incandescents.
+  square,
+  // out = sqrt(in)
+  root,
+  // Smoothstep: slow at both ends.
+  s_curve,
+  // Piecewise linear through points, evenly spaced over the input range.
+  custom,
+};
+
+/**
+ * One user curve rule: channels start..start+count-1 (1-based) go through the
+ * curve, then are optionally inverted, then clamped to [min, max]. Later rules
+ * win where ranges overlap; unassigned channels pass straight through.
+ */
+struct DmxCurveRule {
+  uint16_t start;
+  uint16_t count;
+  DmxCurveType type;
+  uint8_t invert;
+  uint8_t min;
+  uint8_t max;
+  // Only used by DmxCurveType::custom.
+  std::array<uint8_t, dmx_curve_points> points;
+};
+
+/**
+ * @brief Per-channel response curves compiled into shared 256-entry lookup
+ * tables.
+ *
+ * Rules with the same curve share one table, and each channel stores just the
+ * offset of its table, so applying a universe is one table gather per channel.
+ */
+class DmxCurveMap {
+public:
+  DmxCurveMap() { compile(nullptr, 0); }
+
+  // Returns ESP_ERR_INVALID_ARG for a rule outside the universe, or
+  // ESP_ERR_NO_MEM if the rules need more than dmx_curve_max_tables distinct
+  // curves. The map is left unchanged on error.
+  esp_err_t compile(const DmxCurveRule *rules, const size_t count);
+
+  // Every channel passes straight through; the switcher skips the stage.
+  bool is_identity() const { return identity; }
+  size_t get_table_count() const { return table_count; }
+
+  // Applies the first len channels; in and out may be the same buffer.
+  void apply(const uint8_t *in, uint8_t *out, const size_t len) const {
+    for (size_t i = 0; i < len; i++) {
+      out[i] = tables[channel_offsets[i] + in[i]];
+    }
+  }
+
+protected:
+  static bool is_straight(const DmxCurveRule &rule);
+  static bool same_curve(const DmxCurveRule &a, const DmxCurveRule &b);
+  static void build_table(const DmxCurveRule &rule, uint8_t *table);
+
+  // Table 0 is the straight-through table.
+  std::array<uint8_t, 256 * dmx_curve_max_tables> tables;
+  std::array<uint16_t, dmx_curve_channels> channel_offsets{};
+  size_t table_count = 0;
+  bool identity = true;
+};
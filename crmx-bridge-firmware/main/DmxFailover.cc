@@ -0,0 +1,66 @@
+#include "DmxFailover.h"
+#include "esp_log.h"
+#include <algorithm>
+
+static const char *TAG = "DMX_FAILOVER";
+
+void DmxFailover::set_sources(const DmxSourceEntry *_entries,
+                              const size_t _count) {
+  count = std::min(_count, dmx_source_list_max);
+  std::copy(_entries, _entries + count, entries.begin());
+  last_rx_us.fill(0);
+  live_since_us.fill(0);
+  current = no_source;
+}
+
+void DmxFailover::on_frame(const size_t i, const int64_t rx_us) {
+  if (!is_live(i, rx_us)) {
+    live_since_us[i] = rx_us;
+  }
+  last_rx_us[i] = rx_us;
+}
+
+size_t DmxFailover::select(const int64_t now) {
+  size_t best = no_source;
+  for (size_t i = 0; i < count; i++) {
+    if (is_live(i, now)) {
+      best = i;
+      break;
+    }
+  }
+
+  const bool current_live = current != no_source && is_live(current, now);
+  size_t next = current;
+  if (best == no_source) {
+    // Nothing live; keep the current source so its frames route as soon as
+    // it is back, and let the loss policy take over meanwhile.
+  } else if (!current_live) {
+    next = best;
+  } else if (best < current &&
+             now - live_since_us[best] >= dmx_failover_holdoff_us) {
+    next = best;
+  }
+
+  account_time(best == no_source || current == no_source
+                   ? DmxSourceSink::none
+                   : entries[current].src,
+               now);
+  if (next != current) {
+    if (current != no_source) {
+      switchover_count.fetch_add(1, std::memory_order_relaxed);
+      ESP_LOGW(TAG, "Switching from list entry %zu to %zu", current, next);
+    }
+    current = next;
+  }
+  return current;
+}
+
+void DmxFailover::account_time(const DmxSourceSink src, const int64_t now) {
+  if (accounted_us != 0) {
+    const size_t i = static_cast<size_t>(src);
+    source_time_us[i] += now - accounted_us;
+    source_time_s[i].store(static_cast<uint32_t>(source_time_us[i] / 1000000),
+                           std::memory_order_relaxed);
+  }
+  accounted_us = now;
+}
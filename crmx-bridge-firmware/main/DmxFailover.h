@@ -0,0 +1,78 @@
+#pragma once
+
+#include "util.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+static constexpr size_t dmx_source_list_max = dmx_source_sink_count - 1;
+// A higher priority source must stay live this long before it is switched
+// back to.
+static constexpr int64_t dmx_failover_holdoff_us = 3 * 1000 * 1000;
+
+// One entry of the prioritised source list.
+struct DmxSourceEntry {
+  DmxSourceSink src;
+  // No frame from src for this long makes it stale.
+  uint32_t timeout_ms;
+
+  bool operator==(const DmxSourceEntry &other) const = default;
+};
+
+/**
+ * @brief Picks the live source to route from an ordered source list.
+ *
+ * The switcher reports every frame it takes from a listed source, and asks
+ * which one to route. A stale source is left for the next live one straight
+ * away; a higher priority source is only switched back to once it has been
+ * live for dmx_failover_holdoff_us. Nothing here touches settings, so
+ * switching costs no more than a dispatch. Not thread-safe apart from the
+ * counters; owned by the switcher task.
+ */
+class DmxFailover {
+public:
+  static constexpr size_t no_source = SIZE_MAX;
+
+  // Forgets liveness, keeps the counters.
+  void set_sources(const DmxSourceEntry *entries, const size_t count);
+  bool is_active() const { return count > 0; }
+  size_t get_count() const { return count; }
+  DmxSourceSink get_source(const size_t i) const { return entries[i].src; }
+
+  // A frame received at rx_us was taken from entry i.
+  void on_frame(const size_t i, const int64_t rx_us);
+  // Returns the entry to route from, or no_source before any has been live.
+  size_t select(const int64_t now);
+  bool is_live(const size_t i, const int64_t now) const {
+    return last_rx_us[i] != 0 &&
+           now - last_rx_us[i] < static_cast<int64_t>(entries[i].timeout_ms) *
+                                     1000;
+  }
+
+  // Safe to read from any task.
+  uint32_t get_switchover_count() const {
+    return switchover_count.load(std::memory_order_relaxed);
+  }
+  // Seconds spent routing each source; DmxSourceSink::none is the time with
+  // no listed source live.
+  uint32_t get_source_time_s(const DmxSourceSink src) const {
+    return source_time_s[static_cast<size_t>(src)].load(
+        std::memory_order_relaxed);
+  }
+
+protected:
+  void account_time(const DmxSourceSink src, const int64_t now);
+
+  std::array<DmxSourceEntry, dmx_source_list_max> entries{};
+  size_t count = 0;
+  std::array<int64_t, dmx_source_list_max> last_rx_us{};
+  // When each source last came back after being stale.
+  std::array<int64_t, dmx_source_list_max> live_since_us{};
+  size_t current = no_source;
+
+  int64_t accounted_us = 0;
+  std::array<int64_t, dmx_source_sink_count> source_time_us{};
+  std::atomic<uint32_t> switchover_count{0};
+  std::array<std::atomic<uint32_t>, dmx_source_sink_count> source_time_s{};
+};
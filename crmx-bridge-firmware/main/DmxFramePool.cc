@@ -0,0 +1,125 @@
+#include "DmxFramePool.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+
+static const char *TAG = "DMX_POOL";
+
+static DmxFramePool frame_pool{};
+
+DmxFramePool &DmxFramePool::shared() { return frame_pool; }
+
+DmxFrameRef DmxFramePool::acquire() {
+  for (uint32_t i = 0; i < pool_size; i++) {
+    uint32_t expected = 0;
+    if (entries[i].refs.compare_exchange_strong(expected, 1,
+                                                std::memory_order_acquire)) {
+      acquired_count.fetch_add(1, std::memory_order_relaxed);
+      entries[i].packet.universe = 0;
+      entries[i].packet.slot_count = dmx_packet_size;
+      entries[i].packet.times = DmxFrameTimes{};
+      return DmxFrameRef{i};
+    }
+  }
+  exhausted_count.fetch_add(1, std::memory_order_relaxed);
+  return DmxFrameRef{};
+}
+
+DmxFramePool::Stats DmxFramePool::get_stats() const {
+  uint32_t in_use = 0;
+  for (const Entry &entry : entries) {
+    if (entry.refs.load(std::memory_order_relaxed) != 0) {
+      in_use++;
+    }
+  }
+  return Stats{
+      .acquired = acquired_count.load(std::memory_order_relaxed),
+      .exhausted = exhausted_count.load(std::memory_order_relaxed),
+      .in_use = in_use,
+  };
+}
+
+DmxFrameRef IRAM_ATTR DmxFrameRef::share() const {
+  if (index == invalid_index) {
+    return DmxFrameRef{};
+  }
+  frame_pool.retain(index);
+  return DmxFrameRef{index};
+}
+
+void IRAM_ATTR DmxFrameRef::reset() {
+  if (index != invalid_index) {
+    frame_pool.release(index);
+    index = invalid_index;
+  }
+}
+
+bool IRAM_ATTR DmxFrameRef::is_unique() const {
+  return index != invalid_index && frame_pool.get_refs(index) == 1;
+}
+
+IRAM_ATTR DmxPacket &DmxFrameRef::operator*() const {
+  return frame_pool.packet(index);
+}
+
+esp_err_t DmxFrameSlot::init() {
+  ready = xSemaphoreCreateBinary();
+  if (ready == nullptr) {
+    ESP_LOGE(TAG, "Could not create frame slot semaphore");
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+void DmxFrameSlot::deinit() {
+  // Drop any parked frame back into the pool.
+  DmxFrameRef{index.exchange(DmxFrameRef::invalid_index)};
+  if (ready != nullptr) {
+    vSemaphoreDelete(ready);
+    ready = nullptr;
+  }
+}
+
+void IRAM_ATTR DmxFrameSlot::publish(DmxFrameRef &&frame) {
+  if (!frame || ready == nullptr) {
+    return;
+  }
+  const uint32_t previous = index.exchange(frame.release_index());
+  if (previous != DmxFrameRef::invalid_index) {
+    // The consumer never saw the previous frame; release it.
+    DmxFrameRef{previous};
+    dropped_count.fetch_add(1, std::memory_order_relaxed);
+  }
+  xSemaphoreGive(ready);
+
+  TaskHandle_t task = listener;
+  if (task != nullptr) {
+    xTaskNotify(task, listener_bits, eSetBits);
+  }
+}
+
+DmxFrameRef IRAM_ATTR DmxFrameSlot::take(const TickType_t timeout) {
+  if (ready == nullptr) {
+    return DmxFrameRef{};
+  }
+  const TickType_t start = xTaskGetTickCount();
+  while (true) {
+    const uint32_t taken = index.exchange(DmxFrameRef::invalid_index);
+    if (taken != DmxFrameRef::invalid_index) {
+      return DmxFrameRef{taken};
+    }
+
+    // The semaphore can be left given by a frame that was already taken, so
+    // an empty slot after waking means wait again for what time is left.
+    TickType_t remaining = timeout;
+    if (timeout != portMAX_DELAY) {
+      const TickType_t elapsed = xTaskGetTickCount() - start;
+      if (elapsed >= timeout) {
+        return DmxFrameRef{};
+      }
+      remaining = timeout - elapsed;
+    }
+    if (xSemaphoreTake(ready, remaining) != pdTRUE) {
+      return DmxFrameRef{};
+    }
+  }
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "util.h"
+#include <array>
+#include <atomic>
+
+static constexpr size_t dmx_packet_size = 512;
+// Universes one interface can carry at once, i.e. its ports per direction.
+// Sizes the frame pool, the interface slots and the routing table.
+static constexpr size_t dmx_universe_max = 4;
+
+// esp_timer times at which a frame passed each hop; 0 if it has not yet. A
+// routed frame may be shared by several sinks, so sink-side times are kept by
+// each sink's DmxInterface rather than in the frame.
+struct DmxFrameTimes {
+  // Source finished receiving the frame.
+  int64_t rx_us;
+  // Switcher took the frame from its source, or made it. Written by the
+  // switcher task before any sink can see the frame.
+  int64_t dispatch_us;
+};
+
+struct DmxPacket {
+  DmxSourceSink source;
+  // Universe as the source numbers it; 0 for single-universe sources.
+  uint16_t universe;
+  // Data slots in use after the start code. Producers zero the slots past
+  // it, so stages may always work on the whole array.
+  uint16_t slot_count = dmx_packet_size;
+  DmxFrameTimes times;
+  struct PACKED_ATTR {
+    uint8_t start_code;
+    std::array<uint8_t, dmx_packet_size> data;
+    static constexpr size_t size() { return dmx_packet_size + 1; }
+  } full_packet;
+};
+static_assert(sizeof(decltype(DmxPacket::full_packet)) == dmx_packet_size + 1);
+
+/**
+ * @brief Owning reference to a frame in the shared DmxFramePool.
+ *
+ * Frames are handed between producers, the switcher and sinks by moving these
+ * references around, so a universe is written once by its producer and read in
+ * place by its consumer. Move-only: use share() to take an extra reference.
+ * The frame returns to the pool when its last reference is dropped.
+ */
+class DmxFrameRef {
+public:
+  static constexpr uint32_t invalid_index = UINT32_MAX;
+
+  DmxFrameRef() = default;
+  DmxFrameRef(DmxFrameRef &&other) noexcept : index(other.release_index()) {}
+  DmxFrameRef &operator=(DmxFrameRef &&other) noexcept {
+    if (this != &other) {
+      reset();
+      index = other.release_index();
+    }
+    return *this;
+  }
+  DmxFrameRef(const DmxFrameRef &) = delete;
+  DmxFrameRef &operator=(const DmxFrameRef &) = delete;
+  ~DmxFrameRef() { reset(); }
+
+  DmxFrameRef share() const;
+  void reset();
+  // No other reference exists, so nobody else can be reading the frame.
+  bool is_unique() const;
+
+  explicit operator bool() const { return index != invalid_index; }
+  DmxPacket &operator*() const;
+  DmxPacket *operator->() const { return &**this; }
+
+protected:
+  explicit DmxFrameRef(const uint32_t _index) : index(_index) {}
+  uint32_t release_index() {
+    const uint32_t released = index;
+    index = invalid_index;
+    return released;
+  }
+
+  uint32_t index = invalid_index;
+
+  friend class DmxFramePool;
+  friend class DmxFrameSlot;
+};
+
+/**
+ * @brief Fixed pool of reference-counted DMX frames shared by the data plane.
+ *
+ * Sized to cover one frame being filled by each producer, one parked in each
+ * interface slot, one being drained by each consumer and one held per source
+ * by the merger, plus the frames the recorder and player hold, with headroom.
+ * Every further universe port of the Art-Net and sACN interfaces parks a frame
+ * in its slot and has one in flight, in each direction.
+ */
+class DmxFramePool {
+public:
+  static constexpr size_t pool_size = 31 + 2 * 4 * (dmx_universe_max - 1);
+
+  struct Stats {
+    uint32_t acquired;
+    uint32_t exhausted;
+    uint32_t in_use;
+  };
+
+  static DmxFramePool &shared();
+
+  // Returns an empty reference if every frame is in use.
+  DmxFrameRef acquire();
+
+  Stats get_stats() const;
+
+protected:
+  struct Entry {
+    DmxPacket packet;
+    std::atomic<uint32_t> refs;
+  };
+
+  void retain(const uint32_t index) {
+    entries[index].refs.fetch_add(1, std::memory_order_relaxed);
+  }
+  void release(const uint32_t index) {
+    entries[index].refs.fetch_sub(1, std::memory_order_acq_rel);
+  }
+  uint32_t get_refs(const uint32_t index) const {
+    return entries[index].refs.load(std::memory_order_acquire);
+  }
+  DmxPacket &packet(const uint32_t index) { return entries[index].packet; }
+
+  std::array<Entry, pool_size> entries;
+  std::atomic<uint32_t> acquired_count;
+  std::atomic<uint32_t> exhausted_count;
+
+  friend class DmxFrameRef;
+};
+
+/**
+ * @brief Single-entry, latest-value mailbox for frame references.
+ *
+ * Publishing replaces (and releases) any frame the consumer has not picked up
+ * yet, matching the old xQueueOverwrite semantics without copying the frame.
+ * A consumer either blocks in take(), or registers a listener task that gets
+ * notification bits set on every publish and then calls take(0).
+ */
+class DmxFrameSlot {
+public:
+  esp_err_t init();
+  void deinit();
+
+  void publish(DmxFrameRef &&frame);
+  DmxFrameRef take(const TickType_t timeout);
+
+  // Pass nullptr to stop notifying.
+  void set_listener(TaskHandle_t task, const uint32_t notify_bits) {
+    listener_bits = notify_bits;
+    listener = task;
+  }
+
+  uint32_t get_dropped_count() const { return dropped_count; }
+
+protected:
+  std::atomic<uint32_t> index{DmxFrameRef::invalid_index};
+  std::atomic<uint32_t> dropped_count{0};
+  std::atomic<TaskHandle_t> listener{nullptr};
+  std::atomic<uint32_t> listener_bits{0};
+  SemaphoreHandle_t ready = nullptr;
+};
@@ -0,0 +1,111 @@
+#include "DmxLatency.h"
+
+static DmxLatencyTracker latency_tracker{};
+
+size_t LatencyHistogram::bucket_for(const uint32_t us) {
+  if (us < sub_buckets) {
+    return us;
+  }
+  // Bucket by the leading bit, then by the next sub_bucket_bits bits.
+  const size_t msb = 31 - __builtin_clz(us);
+  const size_t shift = msb - sub_bucket_bits;
+  const size_t sub = (us >> shift) & (sub_buckets - 1);
+  const size_t bucket = sub_buckets + shift * sub_buckets + sub;
+  return bucket < num_buckets ? bucket : num_buckets - 1;
+}
+
+uint32_t LatencyHistogram::bucket_limit(const size_t bucket) {
+  if (bucket < sub_buckets) {
+    return bucket;
+  }
+  const size_t shift = (bucket - sub_buckets) / sub_buckets;
+  const size_t sub = (bucket - sub_buckets) % sub_buckets;
+  return (static_cast<uint32_t>(sub_buckets + sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(const int64_t latency_us) {
+  const uint32_t us =
+      latency_us < 0 ? 0
+                     : (latency_us > UINT32_MAX ? UINT32_MAX
+                                                : static_cast<uint32_t>(
+                                                      latency_us));
+  buckets[bucket_for(us)].fetch_add(1, std::memory_order_relaxed);
+  count.fetch_add(1, std::memory_order_relaxed);
+  uint32_t prev_max = max_us.load(std::memory_order_relaxed);
+  while (us > prev_max && !max_us.compare_exchange_weak(
+                              prev_max, us, std::memory_order_relaxed)) {
+  }
+}
+
+uint32_t LatencyHistogram::percentile(const uint32_t total,
+                                      const uint32_t permille) const {
+  // Rank of the sample at this percentile, rounded up.
+  const uint64_t rank = (static_cast<uint64_t>(total) * permille + 999) / 1000;
+  uint64_t seen = 0;
+  for (size_t bucket = 0; bucket < num_buckets; bucket++) {
+    seen += buckets[bucket].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      return bucket_limit(bucket);
+    }
+  }
+  return bucket_limit(num_buckets - 1);
+}
+
+LatencyHistogram::Summary LatencyHistogram::summarize() const {
+  // Buckets may move on while we read them; the summary is approximate.
+  const uint32_t total = count.load(std::memory_order_relaxed);
+  const uint32_t max = max_us.load(std::memory_order_relaxed);
+  if (total == 0) {
+    return Summary{};
+  }
+  const uint32_t p50 = percentile(total, 500);
+  const uint32_t p99 = percentile(total, 990);
+  return Summary{
+      .count = total,
+      .p50_us = p50 < max ? p50 : max,
+      .p99_us = p99 < max ? p99 : max,
+      .max_us = max,
+  };
+}
+
+DmxLatencyTracker &DmxLatencyTracker::shared() { return latency_tracker; }
+
+void DmxLatencyTracker::record(const DmxFrameTimes &times,
+                               const int64_t pickup_us,
+                               const int64_t complete_us,
+                               const DmxSourceSink source,
+                               const DmxSourceSink sink) {
+  // Frames sent without passing through the switcher have no dispatch stamp.
+  if (times.rx_us == 0 || complete_us == 0) {
+    return;
+  }
+  if (times.dispatch_us != 0) {
+    rx_to_dispatch[index(source)].record(times.dispatch_us - times.rx_us);
+    if (pickup_us != 0) {
+      dispatch_to_pickup[index(sink)].record(pickup_us - times.dispatch_us);
+    }
+  }
+  if (pickup_us != 0) {
+    pickup_to_complete[index(sink)].record(complete_us - pickup_us);
+  }
+  paths[index(source)][index(sink)].record(complete_us - times.rx_us);
+}
+
+LatencyHistogram::Summary
+DmxLatencyTracker::get_hop(const Hop hop, const DmxSourceSink io) const {
+  switch (hop) {
+  case Hop::rx_to_dispatch:
+    return rx_to_dispatch[index(io)].summarize();
+  case Hop::dispatch_to_pickup:
+    return dispatch_to_pickup[index(io)].summarize();
+  case Hop::pickup_to_complete:
+  default:
+    return pickup_to_complete[index(io)].summarize();
+  }
+}
+
+LatencyHistogram::Summary
+DmxLatencyTracker::get_path(const DmxSourceSink source,
+                            const DmxSourceSink sink) const {
+  return paths[index(source)][index(sink)].summarize();
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "DmxFramePool.h"
+#include "util.h"
+#include <array>
+#include <atomic>
+
+/**
+ * @brief Lock-free log-linear histogram of latencies in microseconds.
+ *
+ * Each power of two is split into four buckets, so percentiles are accurate
+ * to within 25% from 4 us up to about two seconds. record() is safe to call
+ * from any task concurrently with summarize().
+ */
+class LatencyHistogram {
+public:
+  static constexpr size_t sub_bucket_bits = 2;
+  static constexpr size_t sub_buckets = 1 << sub_bucket_bits;
+  static constexpr size_t num_buckets = 80;
+
+  struct Summary {
+    uint32_t count;
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+  };
+
+  void record(const int64_t latency_us);
+  Summary summarize() const;
+
+protected:
+  static size_t bucket_for(const uint32_t us);
+  // Largest latency that lands in the bucket.
+  static uint32_t bucket_limit(const size_t bucket);
+  uint32_t percentile(const uint32_t count, const uint32_t permille) const;
+
+  std::array<std::atomic<uint32_t>, num_buckets> buckets{};
+  std::atomic<uint32_t> count{0};
+  std::atomic<uint32_t> max_us{0};
+};
+
+/**
+ * @brief Per-hop and per-path DMX frame latency, fed from DmxFrameTimes when a
+ * sink finishes writing a frame out.
+ *
+ * Hops: rx (source receive complete) to dispatch (switcher routed it),
+ * dispatch to pickup (sink task took it), pickup to complete (sink finished
+ * writing). Each hop is tracked once per source or sink; the rx to complete
+ * total is tracked per source/sink path.
+ */
+class DmxLatencyTracker {
+public:
+  enum class Hop {
+    rx_to_dispatch,
+    dispatch_to_pickup,
+    pickup_to_complete,
+  };
+
+  static DmxLatencyTracker &shared();
+
+  // Call once the sink has finished with the frame.
+  void record(const DmxFrameTimes &times, const int64_t pickup_us,
+              const int64_t complete_us, const DmxSourceSink source,
+              const DmxSourceSink sink);
+
+  // rx_to_dispatch is keyed by source, the other hops by sink.
+  LatencyHistogram::Summary get_hop(const Hop hop,
+                                    const DmxSourceSink io) const;
+  LatencyHistogram::Summary get_path(const DmxSourceSink source,
+                                     const DmxSourceSink sink) const;
+
+protected:
+  static size_t index(const DmxSourceSink io) {
+    const size_t i = static_cast<size_t>(io);
+    return i < dmx_source_sink_count ? i : 0;
+  }
+
+  std::array<LatencyHistogram, dmx_source_sink_count> rx_to_dispatch;
+  std::array<LatencyHistogram, dmx_source_sink_count> dispatch_to_pickup;
+  std::array<LatencyHistogram, dmx_source_sink_count> pickup_to_complete;
+  std::array<std::array<LatencyHistogram, dmx_source_sink_count>,
+             dmx_source_sink_count>
+      paths;
+};
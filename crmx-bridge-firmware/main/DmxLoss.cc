@@ -0,0 +1,82 @@
+#include "DmxLoss.h"
+#include "esp_log.h"
+
+static const char *TAG = "DMX_LOSS";
+
+// Fade levels are fixed point, fade_full is unity gain.
+static constexpr uint32_t fade_shift = 8;
+static constexpr uint32_t fade_full = 1 << fade_shift;
+
+void DmxLossHandler::on_routed(const DmxFrameRef &frame, const int64_t now) {
+  last_look = frame.share();
+  last_live_us = now;
+  if (lost) {
+    ESP_LOGI(TAG, "Source back after loss");
+  }
+  lost = false;
+  fade_frame.reset();
+}
+
+void DmxLossHandler::mark_lost() {
+  if (lost) {
+    return;
+  }
+  lost = true;
+  loss_count.fetch_add(1, std::memory_order_relaxed);
+  fade_level = fade_full;
+  ESP_LOGW(TAG, "Source lost");
+}
+
+DmxFrameRef DmxLossHandler::get_loss_frame(const int64_t now) {
+  if (!last_look || !is_lost(now)) {
+    return DmxFrameRef{};
+  }
+  mark_lost();
+
+  if (config.policy != DmxLossPolicy::fade) {
+    return last_look.share();
+  }
+
+  const int64_t lost_for_us = now - last_live_us - timeout_us();
+  const int64_t fading_us =
+      lost_for_us - static_cast<int64_t>(config.hold_ms) * 1000;
+  if (fading_us < 0) {
+    return last_look.share();
+  }
+
+  const int64_t fade_us = static_cast<int64_t>(config.fade_ms) * 1000;
+  const uint32_t level =
+      fading_us >= fade_us
+          ? 0
+          : static_cast<uint32_t>(fade_full - fading_us * fade_full / fade_us);
+  if (fade_frame && level == fade_level) {
+    return fade_frame.share();
+  }
+  DmxFrameRef next = make_fade_frame(level, now);
+  if (!next) {
+    return DmxFrameRef{};
+  }
+  fade_frame = std::move(next);
+  fade_level = level;
+  return fade_frame.share();
+}
+
+DmxFrameRef DmxLossHandler::make_fade_frame(const uint32_t level,
+                                            const int64_t now) {
+  DmxFrameRef out = DmxFramePool::shared().acquire();
+  if (!out) {
+    ESP_LOGW(TAG, "No free DMX frame for fade");
+    return out;
+  }
+  // Scale the last look straight into the new frame.
+  const uint8_t *in = last_look->full_packet.data.data();
+  uint8_t *data = out->full_packet.data.data();
+  for (size_t i = 0; i < dmx_packet_size; i++) {
+    data[i] = static_cast<uint8_t>((in[i] * level) >> fade_shift);
+  }
+  out->source = last_look->source;
+  out->slot_count = last_look->slot_count;
+  out->times = DmxFrameTimes{.rx_us = now, .dispatch_us = now};
+  out->full_packet.start_code = last_look->full_packet.start_code;
+  return out;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "DmxFramePool.h"
+#include "util.h"
+#include <atomic>
+#include <cstdint>
+
+// How often the switcher is ticked to re-publish or fade a lost route.
+static constexpr uint32_t dmx_loss_tick_ms = 25;
+
+struct DmxLossConfig {
+  DmxLossPolicy policy;
+  // No frame from the route for this long counts as a loss.
+  uint32_t timeout_ms;
+  // fade: hold the last look this long after the loss, then fade to black
+  // over fade_ms.
+  uint32_t hold_ms;
+  uint32_t fade_ms;
+
+  bool operator==(const DmxLossConfig &other) const = default;
+};
+
+/**
+ * @brief Decides what a route outputs once its sources go quiet.
+ *
+ * The switcher reports every frame it routes, and on every loss tick asks for
+ * a loss frame. It only runs the loss timer while it is past the loss
+ * deadline. While lost, the last look is re-published by reference
+ * (hold), or scaled towards black into one fresh frame per fade step (fade).
+ * Failing over to a backup source is DmxFailover's job; the loss policy only
+ * applies once no source is left. Not thread-safe apart from the counter;
+ * owned by the switcher task.
+ */
+class DmxLossHandler {
+public:
+  void set_config(const DmxLossConfig &_config) { config = _config; }
+  const DmxLossConfig &get_config() const { return config; }
+
+  // A live frame was routed to the sinks.
+  void on_routed(const DmxFrameRef &frame, const int64_t now);
+
+  bool is_lost(const int64_t now) const {
+    return last_live_us != 0 && now - last_live_us >= timeout_us();
+  }
+
+  // When the route counts as lost unless another frame is routed, or 0 while
+  // there is no last look to hold.
+  int64_t get_loss_deadline_us() const {
+    return last_look ? last_live_us + timeout_us() : 0;
+  }
+
+  // Returns the frame to re-publish at this tick, or an empty reference.
+  DmxFrameRef get_loss_frame(const int64_t now);
+
+  // Safe to read from any task.
+  uint32_t get_loss_count() const {
+    return loss_count.load(std::memory_order_relaxed);
+  }
+
+protected:
+  int64_t timeout_us() const {
+    return static_cast<int64_t>(config.timeout_ms) * 1000;
+  }
+  void mark_lost();
+  DmxFrameRef make_fade_frame(const uint32_t level, const int64_t now);
+
+  DmxLossConfig config{};
+  DmxFrameRef last_look;
+  // The latest fade step; re-published as is once the fade is done.
+  DmxFrameRef fade_frame;
+  uint32_t fade_level = 0;
+  int64_t last_live_us = 0;
+  bool lost = false;
+  std::atomic<uint32_t> loss_count{0};
+};
@@ -0,0 +1,252 @@
+#include "DmxMerge.h"
+#include "esp_attr.h"
+#include "sdkconfig.h"
+#include <cstdint>
+#include <cstring>
+
+namespace {
+constexpr uint32_t even_bytes = 0x00FF00FF;
+constexpr uint32_t lane_carry = 0x01000100;
+constexpr uint32_t low_bits = 0x7F7F7F7F;
+constexpr uint32_t high_bits = 0x80808080;
+
+inline uint32_t load_word(const uint8_t *p) {
+  uint32_t word;
+  memcpy(&word, p, sizeof(word));
+  return word;
+}
+
+inline void store_word(uint8_t *p, const uint32_t word) {
+  memcpy(p, &word, sizeof(word));
+}
+
+// Per-byte unsigned max. Bytes are split into two 16-bit lanes each, so the
+// subtraction's borrow into bit 8 of a lane says which side is larger.
+inline uint32_t max_u8x4(const uint32_t a, const uint32_t b) {
+  const uint32_t a_even = a & even_bytes;
+  const uint32_t b_even = b & even_bytes;
+  const uint32_t a_odd = (a >> 8) & even_bytes;
+  const uint32_t b_odd = (b >> 8) & even_bytes;
+
+  const uint32_t ge_even = (((a_even | lane_carry) - b_even) & lane_carry) >> 8;
+  const uint32_t ge_odd = (((a_odd | lane_carry) - b_odd) & lane_carry) >> 8;
+  const uint32_t mask_even = ge_even * 0xFF;
+  const uint32_t mask_odd = ge_odd * 0xFF;
+
+  const uint32_t max_even = (a_even & mask_even) | (b_even & ~mask_even);
+  const uint32_t max_odd = (a_odd & mask_odd) | (b_odd & ~mask_odd);
+  return max_even | ((max_odd & even_bytes) << 8);
+}
+
+// 0xFF in every byte where a and b differ.
+inline uint32_t ne_mask_u8x4(const uint32_t a, const uint32_t b) {
+  const uint32_t diff = a ^ b;
+  const uint32_t nonzero = (((diff & low_bits) + low_bits) | diff) & high_bits;
+  return (nonzero >> 7) * 0xFF;
+}
+
+#if CONFIG_IDF_TARGET_ESP32S3
+// The S3's PIE works 16 channels per instruction on q registers. Its loads
+// and stores drop the low four address bits, so dst must be aligned; src and
+// prev are frame data behind the start code and never are, so they go
+// through EE.LD.128.USAR.IP, which records the misalignment, and EE.SRC.Q,
+// which shifts the two aligned blocks around them into place.
+constexpr size_t pie_block = 16;
+
+bool pie_aligned(const uint8_t *dst) {
+  return (reinterpret_cast<uintptr_t>(dst) & (pie_block - 1)) == 0;
+}
+
+// EE.VMAX.S8 is a signed max. Flipping the top bit of every byte maps 0..255
+// onto -128..127 in the same order, so the signed max of the flipped bytes,
+// flipped back, is the unsigned max.
+DRAM_ATTR alignas(pie_block) const uint8_t sign_bits[pie_block] = {
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+};
+
+void IRAM_ATTR merge_htp_pie(uint8_t *dst, const uint8_t *src,
+                             size_t blocks) {
+  const uint8_t *bias = sign_bits;
+  asm volatile("ee.vld.128.ip q7, %[bias], 0\n"
+               "1:\n"
+               "ee.ld.128.usar.ip q0, %[src], 16\n"
+               "ee.ld.128.usar.ip q1, %[src], 0\n"
+               "ee.src.q q0, q0, q1\n"
+               "ee.vld.128.ip q2, %[dst], 0\n"
+               "ee.xorq q0, q0, q7\n"
+               "ee.xorq q2, q2, q7\n"
+               "ee.vmax.s8 q2, q2, q0\n"
+               "ee.xorq q2, q2, q7\n"
+               "ee.vst.128.ip q2, %[dst], 16\n"
+               "addi %[blocks], %[blocks], -1\n"
+               "bnez %[blocks], 1b\n"
+               : [dst] "+r"(dst), [src] "+r"(src), [blocks] "+r"(blocks),
+                 [bias] "+r"(bias)
+               :
+               : "memory");
+}
+
+void IRAM_ATTR merge_ltp_pie(uint8_t *dst, const uint8_t *src,
+                             const uint8_t *prev, size_t blocks) {
+  // src and prev may be misaligned differently, and there is one shift
+  // amount, so each is loaded and shifted before the other is touched.
+  asm volatile("1:\n"
+               "ee.ld.128.usar.ip q0, %[src], 16\n"
+               "ee.ld.128.usar.ip q1, %[src], 0\n"
+               "ee.src.q q0, q0, q1\n"
+               "ee.ld.128.usar.ip q3, %[prev], 16\n"
+               "ee.ld.128.usar.ip q1, %[prev], 0\n"
+               "ee.src.q q3, q3, q1\n"
+               "ee.vcmp.eq.s8 q4, q0, q3\n"
+               "ee.notq q5, q4\n"
+               "ee.vld.128.ip q2, %[dst], 0\n"
+               "ee.andq q2, q2, q4\n"
+               "ee.andq q0, q0, q5\n"
+               "ee.orq q2, q2, q0\n"
+               "ee.vst.128.ip q2, %[dst], 16\n"
+               "addi %[blocks], %[blocks], -1\n"
+               "bnez %[blocks], 1b\n"
+               : [dst] "+r"(dst), [src] "+r"(src), [prev] "+r"(prev),
+                 [blocks] "+r"(blocks)
+               :
+               : "memory");
+}
+#endif
+} // namespace
+
+void IRAM_ATTR dmx_merge_htp(uint8_t *dst, const uint8_t *src, const size_t len) {
+  size_t i = 0;
+#if CONFIG_IDF_TARGET_ESP32S3
+  if (len >= pie_block && pie_aligned(dst)) {
+    i = len & ~(pie_block - 1);
+    merge_htp_pie(dst, src, i / pie_block);
+  }
+#endif
+  for (; i + sizeof(uint32_t) <= len; i += sizeof(uint32_t)) {
+    store_word(dst + i, max_u8x4(load_word(dst + i), load_word(src + i)));
+  }
+  for (; i < len; i++) {
+    dst[i] = dst[i] > src[i] ? dst[i] : src[i];
+  }
+}
+
+void IRAM_ATTR dmx_merge_ltp(uint8_t *dst, const uint8_t *src, const uint8_t *prev,
+                   const size_t len) {
+  size_t i = 0;
+#if CONFIG_IDF_TARGET_ESP32S3
+  if (len >= pie_block && pie_aligned(dst)) {
+    i = len & ~(pie_block - 1);
+    merge_ltp_pie(dst, src, prev, i / pie_block);
+  }
+#endif
+  for (; i + sizeof(uint32_t) <= len; i += sizeof(uint32_t)) {
+    const uint32_t next = load_word(src + i);
+    const uint32_t changed = ne_mask_u8x4(next, load_word(prev + i));
+    if (changed != 0) {
+      store_word(dst + i, (load_word(dst + i) & ~changed) | (next & changed));
+    }
+  }
+  for (; i < len; i++) {
+    if (src[i] != prev[i]) {
+      dst[i] = src[i];
+    }
+  }
+}
+
+void DmxMerger::set_mode(const DmxMergeMode _mode) {
+  if (_mode != mode) {
+    reset();
+    mode = _mode;
+  }
+}
+
+void DmxMerger::update(const DmxSourceSink src, DmxFrameRef &&frame,
+                       const int64_t now) {
+  if (!frame) {
+    return;
+  }
+  const size_t i = index(src);
+  const uint8_t *data = frame->full_packet.data.data();
+
+  if (mode == DmxMergeMode::ltp) {
+    if (latest[i]) {
+      dmx_merge_ltp(merged.data(), data, latest[i]->full_packet.data.data(),
+                    merged.size());
+    } else {
+      // A source joining takes every channel it sends.
+      memcpy(merged.data(), data, frame->slot_count);
+    }
+  }
+
+  latest[i] = std::move(frame);
+  last_seen_us[i] = now;
+  live_mask |= 1u << i;
+  last_source = src;
+  last_times = latest[i]->times;
+
+  if (mode == DmxMergeMode::htp) {
+    recompute_htp();
+  }
+}
+
+bool DmxMerger::expire(const int64_t now, const uint32_t src_mask) {
+  bool expired = false;
+  for (size_t i = 0; i < dmx_source_sink_count; i++) {
+    if ((live_mask & (1u << i)) == 0) {
+      continue;
+    }
+    const bool timed_out =
+        timeouts_us[i] != 0 && now - last_seen_us[i] >= timeouts_us[i];
+    if (!timed_out && (src_mask & (1u << i)) != 0) {
+      continue;
+    }
+    latest[i].reset();
+    live_mask &= ~(1u << i);
+    expired = true;
+  }
+  // LTP channels hold their last value; HTP drops the lost source's levels.
+  if (expired && mode == DmxMergeMode::htp) {
+    recompute_htp();
+  }
+  return expired;
+}
+
+void DmxMerger::reset() {
+  for (DmxFrameRef &frame : latest) {
+    frame.reset();
+  }
+  live_mask = 0;
+  last_source = DmxSourceSink::none;
+  last_times = DmxFrameTimes{};
+  merged.fill(0);
+}
+
+void DmxMerger::recompute_htp() {
+  merged.fill(0);
+  for (const DmxFrameRef &frame : latest) {
+    if (frame) {
+      dmx_merge_htp(merged.data(), frame->full_packet.data.data(),
+                    merged.size());
+    }
+  }
+}
+
+void DmxMerger::render(DmxPacket &out) const {
+  // As long as the longest live source; a longer one that went away may have
+  // left LTP values past that, which must not leak into the zeroed tail.
+  size_t slot_count = 0;
+  for (const DmxFrameRef &frame : latest) {
+    if (frame && frame->slot_count > slot_count) {
+      slot_count = frame->slot_count;
+    }
+  }
+  out.source = last_source;
+  out.slot_count = static_cast<uint16_t>(slot_count);
+  out.times = last_times;
+  out.times.dispatch_us = 0;
+  out.full_packet.start_code = 0;
+  memcpy(out.full_packet.data.data(), merged.data(), slot_count);
+  memset(out.full_packet.data.data() + slot_count, 0,
+         merged.size() - slot_count);
+}
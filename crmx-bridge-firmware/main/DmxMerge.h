@@ -0,0 +1,79 @@
+#pragma once
+
+#include "DmxFramePool.h"
+#include "util.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Per-channel merge kernels. On the S3 they run 16 channels at a time on the
+ * PIE SIMD unit when dst is 16-byte aligned; elsewhere, and for the tail,
+ * they work a 32-bit word (four channels) at a time with plain integer ops.
+ * src and prev may be unaligned.
+ */
+
+// dst[i] = max(dst[i], src[i])
+void dmx_merge_htp(uint8_t *dst, const uint8_t *src, const size_t len);
+
+// dst[i] = src[i] wherever src[i] != prev[i]
+void dmx_merge_ltp(uint8_t *dst, const uint8_t *src, const uint8_t *prev,
+                   const size_t len);
+
+/**
+ * @brief Combines the latest frame from several sources into one universe.
+ *
+ * HTP: every channel is the highest value any live source has for it.
+ * LTP: every channel follows whichever source last changed it, and keeps its
+ * value when that source goes away.
+ *
+ * Holds a reference to each source's latest frame rather than a copy. A source
+ * that has not sent a frame within its timeout is dropped from the merge; a
+ * timeout of 0 never expires. Not thread-safe; owned by the switcher task.
+ */
+class DmxMerger {
+public:
+  static constexpr int64_t default_timeout_us = 1000 * 1000;
+
+  void set_mode(const DmxMergeMode mode);
+  void set_timeout(const DmxSourceSink src, const int64_t timeout_us) {
+    timeouts_us[index(src)] = timeout_us;
+  }
+
+  // Take over a new frame from src and fold it into the merged universe.
+  void update(const DmxSourceSink src, DmxFrameRef &&frame, const int64_t now);
+  // Drop sources that timed out or are no longer in src_mask (a mask of
+  // dmx_source_sink_bit). Returns true if any were dropped.
+  bool expire(const int64_t now, const uint32_t src_mask);
+  // Release every held frame and clear the merged universe.
+  void reset();
+
+  bool has_sources() const { return live_mask != 0; }
+  // The source whose frame was merged most recently.
+  DmxSourceSink get_last_source() const { return last_source; }
+
+  // Fill out with the merged universe, timed from the last merged frame.
+  void render(DmxPacket &out) const;
+
+protected:
+  static size_t index(const DmxSourceSink src) {
+    const size_t i = static_cast<size_t>(src);
+    return i < dmx_source_sink_count ? i : 0;
+  }
+
+  void recompute_htp();
+
+  DmxMergeMode mode = DmxMergeMode::none;
+  std::array<DmxFrameRef, dmx_source_sink_count> latest;
+  std::array<int64_t, dmx_source_sink_count> last_seen_us{};
+  // The artnet interface is also fed by one-shot RPC writes, so it never
+  // expires unless set_merge_timeout gives a live Art-Net stream a timeout.
+  std::array<int64_t, dmx_source_sink_count> timeouts_us{
+      0, default_timeout_us, default_timeout_us, 0, default_timeout_us,
+      default_timeout_us};
+  uint32_t live_mask = 0;
+  DmxSourceSink last_source = DmxSourceSink::none;
+  DmxFrameTimes last_times{};
+  // Aligned for the PIE kernels.
+  alignas(16) std::array<uint8_t, dmx_packet_size> merged{};
+};
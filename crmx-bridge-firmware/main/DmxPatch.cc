@@ -0,0 +1,78 @@
+#include "DmxPatch.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include <algorithm>
+#include <cstring>
+
+static const char *TAG = "DMX_PATCH";
+
+esp_err_t DmxPatch::compile(const DmxPatchRule *rules, const size_t count) {
+  // Resolve the rules into an input channel per output channel first.
+  std::array<uint16_t, dmx_patch_channels> map;
+  for (size_t i = 0; i < map.size(); i++) {
+    map[i] = static_cast<uint16_t>(i);
+  }
+  for (size_t r = 0; r < count; r++) {
+    const DmxPatchRule &rule = rules[r];
+    const size_t dst_end = static_cast<size_t>(rule.dst) + rule.count - 1;
+    const size_t src_end = static_cast<size_t>(rule.src) + rule.count - 1;
+    const bool dst_ok = rule.dst >= 1 && dst_end <= dmx_patch_channels;
+    const bool src_ok = rule.src == 0 || src_end <= dmx_patch_channels;
+    if (rule.count == 0 || !dst_ok || !src_ok) {
+      ESP_LOGE(TAG, "Invalid patch rule %zu: %u -> %u x %u", r, rule.src,
+               rule.dst, rule.count);
+      return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t k = 0; k < rule.count; k++) {
+      map[rule.dst - 1 + k] =
+          rule.src == 0 ? blocked : static_cast<uint16_t>(rule.src - 1 + k);
+    }
+  }
+
+  // Then merge neighbouring channels that read neighbouring inputs.
+  size_t n = 0;
+  for (size_t i = 0; i < map.size(); i++) {
+    if (n > 0) {
+      Span &last = spans[n - 1];
+      const bool extends =
+          last.src == blocked ? map[i] == blocked
+                              : map[i] != blocked && map[i] == last.src + last.len;
+      if (extends) {
+        last.len++;
+        continue;
+      }
+    }
+    spans[n++] = Span{.dst = static_cast<uint16_t>(i), .src = map[i], .len = 1};
+  }
+  span_count = n;
+  identity = n == 1 && spans[0].src == 0;
+  return ESP_OK;
+}
+
+size_t DmxPatch::get_slot_count(const size_t in_slots) const {
+  size_t out_slots = 1;
+  for (size_t i = 0; i < span_count; i++) {
+    const Span &span = spans[i];
+    if (span.src == blocked || span.src >= in_slots) {
+      continue;
+    }
+    const size_t len = std::min<size_t>(span.len, in_slots - span.src);
+    out_slots = std::max<size_t>(out_slots, span.dst + len);
+  }
+  return out_slots;
+}
+
+void IRAM_ATTR DmxPatch::apply(const uint8_t *in, uint8_t *out) const {
+  for (size_t i = 0; i < span_count; i++) {
+    const Span &span = spans[i];
+    if (span.src == blocked) {
+      memset(out + span.dst, 0, span.len);
+    } else if (span.len == 1) {
+      // Scattered patches are mostly single channels; a call per byte would
+      // cost more than the copy.
+      out[span.dst] = in[span.src];
+    } else {
+      memcpy(out + span.dst, in + span.src, span.len);
+    }
+  }
+}
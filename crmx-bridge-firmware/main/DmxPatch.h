@@ -0,0 +1,59 @@
+#pragma once
+
+#include "esp_err.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+static constexpr size_t dmx_patch_max_rules = 32;
+static constexpr size_t dmx_patch_channels = 512;
+
+/**
+ * One user patch rule: output channels dst..dst+count-1 take input channels
+ * src..src+count-1. Channels are 1-based; src 0 blocks the output channels
+ * instead. Rules apply in order on top of a straight-through patch, so later
+ * rules win and an input channel may feed several outputs.
+ */
+struct DmxPatchRule {
+  uint16_t dst;
+  uint16_t src;
+  uint16_t count;
+};
+
+/**
+ * @brief A patch compiled into runs of contiguous channels.
+ *
+ * Applying it is one memcpy (or memset, for blocked channels) per run, so a
+ * typical block-move patch costs a handful of copies; only a fully scrambled
+ * patch degrades to one run per channel.
+ */
+class DmxPatch {
+public:
+  // Returns ESP_ERR_INVALID_ARG and leaves the patch unchanged if a rule
+  // falls outside the universe.
+  esp_err_t compile(const DmxPatchRule *rules, const size_t count);
+
+  // Straight through; the switcher skips the stage entirely.
+  bool is_identity() const { return identity; }
+  size_t get_span_count() const { return span_count; }
+  // Slots of the output when the input has in_slots, at least 1. Output
+  // channels that read past in_slots only ever see its zeroed tail.
+  size_t get_slot_count(const size_t in_slots) const;
+
+  // in and out must not overlap.
+  void apply(const uint8_t *in, uint8_t *out) const;
+
+protected:
+  static constexpr uint16_t blocked = UINT16_MAX;
+
+  struct Span {
+    uint16_t dst;
+    uint16_t src;
+    uint16_t len;
+  };
+
+  std::array<Span, dmx_patch_channels> spans{
+      Span{.dst = 0, .src = 0, .len = dmx_patch_channels}};
+  size_t span_count = 1;
+  bool identity = true;
+};
@@ -0,0 +1,503 @@
+#include "DmxRecorder.h"
+#include "DmxSwitcher.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <cinttypes>
+#include <cstring>
+
+static const char *TAG = "DMX_REC";
+
+// Custom data subtype of the dmxrec partition in partitions.csv.
+static constexpr auto dmx_rec_partition_subtype =
+    static_cast<esp_partition_subtype_t>(0x40);
+
+static DmxRecorder dmx_recorder{};
+
+DmxRecorder &DmxRecorder::shared() { return dmx_recorder; }
+
+size_t dmx_rec_encode(const uint8_t *cur, const uint8_t *prev, uint8_t *out) {
+  auto delta = [cur, prev](const size_t i) -> uint8_t {
+    return prev == nullptr ? cur[i] : cur[i] ^ prev[i];
+  };
+
+  size_t len = 0;
+  size_t i = 0;
+  while (i < dmx_packet_size) {
+    size_t run = 0;
+    while (i + run < dmx_packet_size && run < 128 && delta(i + run) == 0) {
+      run++;
+    }
+    if (run > 0) {
+      // Trailing zeros need no token; the decoder leaves them as they are.
+      if (i + run == dmx_packet_size) {
+        break;
+      }
+      out[len++] = static_cast<uint8_t>(run - 1);
+      i += run;
+      continue;
+    }
+    // A single zero between literals is cheaper kept in the literal run.
+    size_t lit = 0;
+    while (i + lit < dmx_packet_size && lit < 128 &&
+           (delta(i + lit) != 0 ||
+            (i + lit + 1 < dmx_packet_size && delta(i + lit + 1) != 0))) {
+      lit++;
+    }
+    out[len++] = static_cast<uint8_t>(0x7F + lit);
+    for (size_t k = 0; k < lit; k++) {
+      out[len++] = delta(i + k);
+    }
+    i += lit;
+  }
+  return len;
+}
+
+bool dmx_rec_decode(const uint8_t *in, const size_t len, uint8_t *data) {
+  size_t pos = 0;
+  size_t i = 0;
+  while (pos < len) {
+    const uint8_t c = in[pos++];
+    if (c < 0x80) {
+      i += c + 1;
+      if (i > dmx_packet_size) {
+        return false;
+      }
+      continue;
+    }
+    const size_t lit = c - 0x7F;
+    if (i + lit > dmx_packet_size || pos + lit > len) {
+      return false;
+    }
+    for (size_t k = 0; k < lit; k++) {
+      data[i + k] ^= in[pos + k];
+    }
+    i += lit;
+    pos += lit;
+  }
+  return true;
+}
+
+esp_err_t DmxRecorder::init(DmxInterface &_playback) {
+  playback = &_playback;
+
+  partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                       dmx_rec_partition_subtype, "dmxrec");
+  if (partition == nullptr) {
+    ESP_LOGE(TAG, "No dmxrec partition");
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  if (rec_slot.init() != ESP_OK) {
+    ESP_LOGE(TAG, "Could not create recorder slot");
+    return ESP_ERR_NO_MEM;
+  }
+
+  command_mutex = xSemaphoreCreateMutex();
+  if (command_mutex == nullptr) {
+    ESP_LOGE(TAG, "Could not create mutex!");
+    return ESP_ERR_NO_MEM;
+  }
+
+  // Below the data plane tasks, so encoding only uses idle time. Erases and
+  // page programs still disable the flash cache on both cores whatever the
+  // caller's priority; until they finish only IRAM interrupts run, which
+  // covers the DMX UART, SPI and TIMO nIRQ handlers.
+  bool success =
+      xTaskCreate(task_entry, "dmx_recorder", 4096, this, 1, &task);
+  if (!success || task == nullptr) {
+    ESP_LOGE(TAG, "Could not create dmx recorder task");
+    return ESP_ERR_INVALID_STATE;
+  }
+  rec_slot.set_listener(task, notify_frame);
+
+  ESP_LOGI(TAG, "%" PRIu32 " KiB for recordings", partition->size / 1024);
+  return ESP_OK;
+}
+
+esp_err_t DmxRecorder::start_recording(DmxInterface &source) {
+  if (task == nullptr) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (xSemaphoreTake(command_mutex, pdMS_TO_TICKS(2)) != pdTRUE) {
+    return ESP_ERR_TIMEOUT;
+  }
+  pending = Command::record;
+  pending_source = &source;
+  xSemaphoreGive(command_mutex);
+  xTaskNotify(task, notify_command, eSetBits);
+  return ESP_OK;
+}
+
+esp_err_t DmxRecorder::start_playback(const uint32_t seek_ms,
+                                      const bool loop) {
+  if (task == nullptr) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (xSemaphoreTake(command_mutex, pdMS_TO_TICKS(2)) != pdTRUE) {
+    return ESP_ERR_TIMEOUT;
+  }
+  pending = Command::play;
+  pending_seek_ms = seek_ms;
+  pending_loop = loop;
+  xSemaphoreGive(command_mutex);
+  xTaskNotify(task, notify_command, eSetBits);
+  return ESP_OK;
+}
+
+esp_err_t DmxRecorder::stop() {
+  if (task == nullptr) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (xSemaphoreTake(command_mutex, pdMS_TO_TICKS(2)) != pdTRUE) {
+    return ESP_ERR_TIMEOUT;
+  }
+  pending = Command::stop;
+  xSemaphoreGive(command_mutex);
+  xTaskNotify(task, notify_command, eSetBits);
+  return ESP_OK;
+}
+
+DmxRecorder::Stats DmxRecorder::get_stats() const {
+  return Stats{
+      .recorded_frames = recorded_frames,
+      .dropped_frames = rec_slot.get_dropped_count(),
+      .recorded_bytes = recorded_bytes,
+      .pages_written = pages_written,
+      .played_frames = played_frames,
+      .encode_time = encode_time.summarize(),
+      .program_time = program_time.summarize(),
+      .erase_time = erase_time.summarize(),
+      .playback_lateness = playback_lateness.summarize(),
+  };
+}
+
+void DmxRecorder::task_entry(void *param) {
+  static_cast<DmxRecorder *>(param)->run();
+}
+
+void DmxRecorder::run() {
+  TickType_t wait = portMAX_DELAY;
+  while (true) {
+    uint32_t notified = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &notified, wait);
+    if (notified & notify_command) {
+      handle_command();
+    }
+
+    wait = portMAX_DELAY;
+    if (state == State::recording) {
+      DmxFrameRef frame = rec_slot.take(0);
+      if (frame) {
+        record(frame);
+      }
+    } else if (state == State::playing) {
+      wait = play_next();
+    }
+  }
+}
+
+void DmxRecorder::handle_command() {
+  xSemaphoreTake(command_mutex, portMAX_DELAY);
+  const Command command = pending;
+  DmxInterface *const _source = pending_source;
+  const uint32_t seek_ms = pending_seek_ms;
+  const bool _loop = pending_loop;
+  pending = Command::none;
+  xSemaphoreGive(command_mutex);
+
+  if (command == Command::none) {
+    return;
+  }
+  // Recording and playback share the partition.
+  if (state == State::recording) {
+    end_recording();
+  }
+  if (state == State::playing) {
+    prev.reset();
+    state = State::idle;
+    ESP_LOGI(TAG, "Playback stopped");
+  }
+
+  switch (command) {
+  case Command::record:
+    begin_recording(_source);
+    break;
+  case Command::play:
+    begin_playback(seek_ms, _loop);
+    break;
+  default:
+    break;
+  }
+}
+
+void DmxRecorder::begin_recording(DmxInterface *_source) {
+  DmxRecBlockHeader header;
+  // Block 0 always belongs to the latest recording.
+  session = read_header(0, header) && header.magic == dmx_rec_magic
+                ? header.session + 1
+                : 1;
+  block_index = 0;
+  block_fill = 0;
+  pages_done = 0;
+  start_us = 0;
+  prev.reset();
+
+  source = _source;
+  rec_slot.take(0);
+  source->set_tap(&rec_slot);
+  state = State::recording;
+  ESP_LOGI(TAG, "Recording session %" PRIu32, session);
+}
+
+void DmxRecorder::end_recording() {
+  source->set_tap(nullptr);
+  program_pages(true);
+  prev.reset();
+  state = State::idle;
+  ESP_LOGI(TAG, "Recorded %" PRIu32 " blocks in session %" PRIu32,
+           block_fill == 0 ? block_index : block_index + 1, session);
+}
+
+void DmxRecorder::record(const DmxFrameRef &frame) {
+  if (frame->full_packet.start_code != 0) {
+    return;
+  }
+  const int64_t start = esp_timer_get_time();
+  if (start_us == 0) {
+    start_us = frame->times.rx_us;
+  }
+  const uint32_t time_ms =
+      static_cast<uint32_t>((frame->times.rx_us - start_us) / 1000);
+  const uint8_t *cur = frame->full_packet.data.data();
+
+  bool keyframe = block_fill == 0;
+  size_t len = dmx_rec_encode(
+      cur, keyframe ? nullptr : prev->full_packet.data.data(), payload.data());
+  if (!keyframe &&
+      block_fill + sizeof(DmxRecRecordHeader) + len > dmx_rec_block_size) {
+    program_pages(true);
+    block_index++;
+    block_fill = 0;
+    keyframe = true;
+    len = dmx_rec_encode(cur, nullptr, payload.data());
+  }
+  encode_time.record(esp_timer_get_time() - start);
+
+  if (keyframe && !open_block(time_ms)) {
+    end_recording();
+    return;
+  }
+  append(keyframe ? dmx_rec_keyframe : dmx_rec_delta, time_ms, payload.data(),
+         len);
+  prev = frame.share();
+  program_pages(false);
+}
+
+void DmxRecorder::append(const uint8_t type, const uint32_t time_ms,
+                         const uint8_t *data, const size_t len) {
+  const DmxRecRecordHeader header{
+      .type = type,
+      .time_ms = time_ms,
+      .len = static_cast<uint16_t>(len),
+  };
+  memcpy(&block[block_fill], &header, sizeof(header));
+  memcpy(&block[block_fill + sizeof(header)], data, len);
+  block_fill += sizeof(header) + len;
+  recorded_frames.fetch_add(1, std::memory_order_relaxed);
+  recorded_bytes.fetch_add(sizeof(header) + len, std::memory_order_relaxed);
+}
+
+bool DmxRecorder::open_block(const uint32_t start_ms) {
+  const size_t offset = block_index * dmx_rec_block_size;
+  if (offset + dmx_rec_block_size > partition->size) {
+    ESP_LOGW(TAG, "Recording partition full");
+    return false;
+  }
+
+  const int64_t start = esp_timer_get_time();
+  const esp_err_t err =
+      esp_partition_erase_range(partition, offset, dmx_rec_block_size);
+  erase_time.record(esp_timer_get_time() - start);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Erasing block %" PRIu32 " failed: %s", block_index,
+             esp_err_to_name(err));
+    return false;
+  }
+
+  block.fill(dmx_rec_end);
+  const DmxRecBlockHeader header{
+      .magic = dmx_rec_magic,
+      .session = session,
+      .seq = block_index,
+      .start_ms = start_ms,
+  };
+  memcpy(block.data(), &header, sizeof(header));
+  block_fill = sizeof(header);
+  pages_done = 0;
+  return true;
+}
+
+void DmxRecorder::program_pages(const bool flush) {
+  const size_t end = flush ? block_fill + dmx_rec_page_size - 1 : block_fill;
+  const size_t offset = block_index * dmx_rec_block_size;
+  while ((pages_done + 1) * dmx_rec_page_size <= end &&
+         pages_done * dmx_rec_page_size < block_fill) {
+    const size_t page_offset = pages_done * dmx_rec_page_size;
+    const int64_t start = esp_timer_get_time();
+    const esp_err_t err =
+        esp_partition_write(partition, offset + page_offset,
+                            &block[page_offset], dmx_rec_page_size);
+    program_time.record(esp_timer_get_time() - start);
+    if (err != ESP_OK) {
+      ESP_LOGE(TAG, "Programming page failed: %s", esp_err_to_name(err));
+    }
+    pages_done++;
+    pages_written.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+bool DmxRecorder::read_header(const uint32_t index,
+                              DmxRecBlockHeader &header) {
+  const size_t offset = index * dmx_rec_block_size;
+  if (offset + dmx_rec_block_size > partition->size) {
+    return false;
+  }
+  return esp_partition_read(partition, offset, &header, sizeof(header)) ==
+         ESP_OK;
+}
+
+uint32_t DmxRecorder::count_blocks(const uint32_t _session) {
+  // Blocks of one recording are written in order from block 0, so the valid
+  // ones are a prefix of the partition.
+  auto valid = [this, _session](const uint32_t index) {
+    DmxRecBlockHeader header;
+    return read_header(index, header) && header.magic == dmx_rec_magic &&
+           header.session == _session && header.seq == index;
+  };
+  uint32_t lo = 1;
+  uint32_t hi = partition->size / dmx_rec_block_size;
+  while (lo < hi) {
+    const uint32_t mid = lo + (hi - lo + 1) / 2;
+    if (valid(mid - 1)) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return lo;
+}
+
+bool DmxRecorder::load_block(const uint32_t index) {
+  block_index = index;
+  read_pos = sizeof(DmxRecBlockHeader);
+  prev.reset();
+  return esp_partition_read(partition, index * dmx_rec_block_size,
+                            block.data(), dmx_rec_block_size) == ESP_OK;
+}
+
+void DmxRecorder::begin_playback(const uint32_t seek_ms, const bool _loop) {
+  DmxRecBlockHeader header;
+  if (!read_header(0, header) || header.magic != dmx_rec_magic) {
+    ESP_LOGW(TAG, "No recording to play");
+    return;
+  }
+  session = header.session;
+  block_count = count_blocks(session);
+
+  // The last block whose keyframe is at or before seek_ms.
+  uint32_t lo = 0;
+  uint32_t hi = block_count - 1;
+  while (lo < hi) {
+    const uint32_t mid = lo + (hi - lo + 1) / 2;
+    if (read_header(mid, header) && header.start_ms <= seek_ms) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  if (!read_header(lo, header) || !load_block(lo)) {
+    ESP_LOGE(TAG, "Could not read block %" PRIu32, lo);
+    return;
+  }
+
+  base_ms = header.start_ms;
+  start_us = esp_timer_get_time();
+  loop = _loop;
+  state = State::playing;
+  ESP_LOGI(TAG, "Playing session %" PRIu32 " (%" PRIu32 " blocks) from %" PRIu32
+           " ms",
+           session, block_count, base_ms);
+}
+
+TickType_t DmxRecorder::play_next() {
+  while (true) {
+    DmxRecRecordHeader header;
+    if (read_pos + sizeof(header) > dmx_rec_block_size ||
+        block[read_pos] == dmx_rec_end) {
+      uint32_t next = block_index + 1;
+      if (next >= block_count) {
+        if (!loop) {
+          state = State::idle;
+          prev.reset();
+          ESP_LOGI(TAG, "Playback finished");
+          return portMAX_DELAY;
+        }
+        next = 0;
+        base_ms = 0;
+        start_us = esp_timer_get_time();
+      }
+      if (!load_block(next)) {
+        ESP_LOGE(TAG, "Could not read block %" PRIu32, next);
+        state = State::idle;
+        return portMAX_DELAY;
+      }
+      continue;
+    }
+
+    memcpy(&header, &block[read_pos], sizeof(header));
+    const int64_t due_us =
+        start_us + (static_cast<int64_t>(header.time_ms) - base_ms) * 1000;
+    const int64_t now = esp_timer_get_time();
+    const TickType_t ticks = pdMS_TO_TICKS((due_us - now) / 1000);
+    if (due_us > now && ticks > 0) {
+      return ticks;
+    }
+
+    const size_t payload_pos = read_pos + sizeof(header);
+    if (payload_pos + header.len > dmx_rec_block_size ||
+        (header.type != dmx_rec_keyframe && header.type != dmx_rec_delta) ||
+        (header.type == dmx_rec_delta && !prev)) {
+      ESP_LOGE(TAG, "Bad record in block %" PRIu32, block_index);
+      state = State::idle;
+      prev.reset();
+      return portMAX_DELAY;
+    }
+
+    DmxFrameRef frame = DmxFramePool::shared().acquire();
+    if (!frame) {
+      ESP_LOGW(TAG, "No free DMX frame for playback");
+      return 1;
+    }
+    uint8_t *data = frame->full_packet.data.data();
+    if (header.type == dmx_rec_keyframe) {
+      memset(data, 0, dmx_packet_size);
+    } else {
+      memcpy(data, prev->full_packet.data.data(), dmx_packet_size);
+    }
+    if (!dmx_rec_decode(&block[payload_pos], header.len, data)) {
+      ESP_LOGE(TAG, "Bad payload in block %" PRIu32, block_index);
+      state = State::idle;
+      prev.reset();
+      return portMAX_DELAY;
+    }
+    read_pos = payload_pos + header.len;
+
+    frame->source = DmxSourceSink::playback;
+    frame->times.rx_us = now;
+    frame->full_packet.start_code = 0;
+    playback_lateness.record(now > due_us ? now - due_us : 0);
+    prev = frame.share();
+    playback->send(std::move(frame));
+    played_frames.fetch_add(1, std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "DmxFramePool.h"
+#include "DmxLatency.h"
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "util.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class DmxInterface;
+
+/**
+ * Recording format. The partition is a sequence of 4 KiB blocks, one flash
+ * sector each. A block starts with a DmxRecBlockHeader and a keyframe, so
+ * every block decodes on its own and seeking only has to find a block. The
+ * records that follow are deltas against the frame before them. A record is
+ * a DmxRecRecordHeader and its payload; a record type of 0xFF (erased flash)
+ * ends the block.
+ *
+ * Payloads are run-length coded XOR deltas: a keyframe against an all-zero
+ * universe, a delta against the previous frame. Control byte c < 0x80 is a
+ * run of c + 1 zero bytes, otherwise c - 0x7F literal bytes follow. A frame
+ * identical to the one before it has an empty payload.
+ */
+static constexpr uint32_t dmx_rec_magic = 0x31435244; // "DRC1"
+static constexpr size_t dmx_rec_block_size = 4096;
+// Flash is programmed a page at a time as records fill the block.
+static constexpr size_t dmx_rec_page_size = 256;
+static constexpr uint8_t dmx_rec_keyframe = 'K';
+static constexpr uint8_t dmx_rec_delta = 'D';
+static constexpr uint8_t dmx_rec_end = 0xFF;
+// Worst case: every channel in a literal run.
+static constexpr size_t dmx_rec_payload_max =
+    dmx_packet_size + (dmx_packet_size + 127) / 128;
+
+struct __attribute__((packed)) DmxRecBlockHeader {
+  uint32_t magic;
+  // Blocks left over from an older recording have a different session.
+  uint32_t session;
+  uint32_t seq;
+  // Time of the block's keyframe, in ms since the recording started.
+  uint32_t start_ms;
+};
+
+struct __attribute__((packed)) DmxRecRecordHeader {
+  uint8_t type;
+  uint32_t time_ms;
+  uint16_t len;
+};
+
+// Encode cur XOR prev (prev may be nullptr for all zeros) into out, which
+// holds at least dmx_rec_payload_max bytes. Returns the encoded length.
+size_t dmx_rec_encode(const uint8_t *cur, const uint8_t *prev, uint8_t *out);
+// XOR a payload into data. Returns false if it is malformed.
+bool dmx_rec_decode(const uint8_t *in, const size_t len, uint8_t *data);
+
+/**
+ * @brief Records one DmxInterface's source stream into the dmxrec flash
+ * partition, and plays recordings back as the playback source.
+ *
+ * The recorder taps the source interface, so the switcher is never held up:
+ * frames reach the recorder task through a latest-value slot, by reference.
+ * Records are built in a RAM block and each page is programmed as soon as it
+ * is full. Recording and playback share the partition, so starting one stops
+ * the other.
+ */
+class DmxRecorder {
+public:
+  struct Stats {
+    uint32_t recorded_frames;
+    // Frames the source sent while the recorder was still busy.
+    uint32_t dropped_frames;
+    uint32_t recorded_bytes;
+    uint32_t pages_written;
+    uint32_t played_frames;
+    LatencyHistogram::Summary encode_time;
+    LatencyHistogram::Summary program_time;
+    LatencyHistogram::Summary erase_time;
+    // How late played frames were sent against their recorded timing.
+    LatencyHistogram::Summary playback_lateness;
+  };
+
+  static DmxRecorder &shared();
+
+  esp_err_t init(DmxInterface &_playback);
+
+  // These functions are thread-safe.
+  esp_err_t start_recording(DmxInterface &source);
+  // Play from the keyframe at or before seek_ms.
+  esp_err_t start_playback(const uint32_t seek_ms, const bool loop);
+  // Stops recording or playback.
+  esp_err_t stop();
+
+  bool is_recording() const { return state == State::recording; }
+  bool is_playing() const { return state == State::playing; }
+  Stats get_stats() const;
+
+protected:
+  enum class State : uint32_t { idle, recording, playing };
+  enum class Command : uint32_t { none, record, play, stop };
+
+  static constexpr uint32_t notify_frame = 0b01;
+  static constexpr uint32_t notify_command = 0b10;
+
+  static void task_entry(void *param);
+  void run();
+  void handle_command();
+
+  // Recording
+  void begin_recording(DmxInterface *source);
+  void end_recording();
+  void record(const DmxFrameRef &frame);
+  void append(const uint8_t type, const uint32_t time_ms,
+              const uint8_t *payload, const size_t len);
+  bool open_block(const uint32_t start_ms);
+  void program_pages(const bool flush);
+
+  // Playback
+  bool read_header(const uint32_t block, DmxRecBlockHeader &header);
+  uint32_t count_blocks(const uint32_t session);
+  bool load_block(const uint32_t block);
+  void begin_playback(const uint32_t seek_ms, const bool _loop);
+  // Sends the next frame if it is due; returns ticks until the one after.
+  TickType_t play_next();
+
+  const esp_partition_t *partition = nullptr;
+  TaskHandle_t task = nullptr;
+  DmxInterface *playback = nullptr;
+  DmxFrameSlot rec_slot;
+
+  SemaphoreHandle_t command_mutex = nullptr;
+  Command pending = Command::none;
+  DmxInterface *pending_source = nullptr;
+  uint32_t pending_seek_ms = 0;
+  bool pending_loop = false;
+
+  // Only touched by the recorder task.
+  std::atomic<State> state{State::idle};
+  DmxInterface *source = nullptr;
+  uint32_t session = 0;
+  uint32_t block_index = 0;
+  uint32_t block_count = 0;
+  size_t block_fill = 0;
+  size_t pages_done = 0;
+  int64_t start_us = 0;
+  DmxFrameRef prev;
+  alignas(4) std::array<uint8_t, dmx_rec_block_size> block{};
+  std::array<uint8_t, dmx_rec_payload_max> payload{};
+
+  size_t read_pos = 0;
+  bool loop = false;
+  uint32_t base_ms = 0;
+
+  std::atomic<uint32_t> recorded_frames{0};
+  std::atomic<uint32_t> recorded_bytes{0};
+  std::atomic<uint32_t> pages_written{0};
+  std::atomic<uint32_t> played_frames{0};
+  LatencyHistogram encode_time;
+  LatencyHistogram program_time;
+  LatencyHistogram erase_time;
+  LatencyHistogram playback_lateness;
+};
@@ -0,0 +1,103 @@
+#include "DmxRouting.h"
+#include "esp_log.h"
+#include <cinttypes>
+
+static const char *TAG = "DMX_ROUTE";
+
+// Find the port carrying universe, or give it a free one. Universe 0 is
+// always port 0. Returns dmx_universe_max if the interface is out of ports.
+static size_t assign_port(std::array<uint16_t, dmx_universe_max> &ports,
+                          const size_t port_count, const uint16_t universe) {
+  if (universe == 0) {
+    return 0;
+  }
+  for (size_t p = 1; p < port_count; p++) {
+    if (ports[p] == universe) {
+      return p;
+    }
+  }
+  for (size_t p = 1; p < port_count; p++) {
+    if (ports[p] == dmx_universe_none) {
+      ports[p] = universe;
+      return p;
+    }
+  }
+  return dmx_universe_max;
+}
+
+esp_err_t DmxRoutingTable::compile(
+    const DmxRoute *routes, const size_t _count,
+    const std::array<size_t, dmx_source_sink_count> &port_counts) {
+  if (_count > dmx_route_max) {
+    ESP_LOGE(TAG, "Too many routes: %zu", _count);
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  std::array<Entry, dmx_route_max> compiled{};
+  PortUniverses srcs = default_universes();
+  PortUniverses sinks = default_universes();
+  std::array<uint32_t, dmx_source_sink_count> sink_ports_used{};
+  uint32_t _src_mask = 0;
+  uint32_t _sink_mask = 0;
+  uint32_t _input_mask = 0;
+  uint32_t _output_mask = 0;
+
+  for (size_t r = 0; r < _count; r++) {
+    const DmxRoute &route = routes[r];
+    const size_t si = static_cast<size_t>(route.src);
+    const size_t ki = static_cast<size_t>(route.sink);
+    const bool valid = route.src != DmxSourceSink::none &&
+                       route.sink != DmxSourceSink::none &&
+                       si < dmx_source_sink_count &&
+                       ki < dmx_source_sink_count &&
+                       route.src_universe != dmx_universe_none &&
+                       route.sink_universe != dmx_universe_none;
+    if (!valid) {
+      ESP_LOGE(TAG, "Invalid route %zu", r);
+      return ESP_ERR_INVALID_ARG;
+    }
+
+    const size_t src_port =
+        assign_port(srcs[si], port_counts[si], route.src_universe);
+    const size_t sink_port =
+        assign_port(sinks[ki], port_counts[ki], route.sink_universe);
+    if (src_port == dmx_universe_max || sink_port == dmx_universe_max) {
+      ESP_LOGE(TAG,
+               "Route %zu: universe %" PRIu16 " -> %" PRIu16
+               " needs more ports than the interfaces have",
+               r, route.src_universe, route.sink_universe);
+      return ESP_ERR_INVALID_ARG;
+    }
+    if (sink_ports_used[ki] & (1u << sink_port)) {
+      ESP_LOGE(TAG, "Route %zu: sink universe %" PRIu16 " is already routed",
+               r, route.sink_universe);
+      return ESP_ERR_INVALID_ARG;
+    }
+    sink_ports_used[ki] |= 1u << sink_port;
+
+    compiled[r] = Entry{
+        .src = route.src,
+        .src_port = static_cast<uint8_t>(src_port),
+        .sink = route.sink,
+        .sink_port = static_cast<uint8_t>(sink_port),
+    };
+    if (src_port == 0) {
+      _src_mask |= dmx_source_sink_bit(route.src);
+    }
+    if (sink_port == 0) {
+      _sink_mask |= dmx_source_sink_bit(route.sink);
+    }
+    _input_mask |= dmx_source_sink_bit(route.src);
+    _output_mask |= dmx_source_sink_bit(route.sink);
+  }
+
+  entries = compiled;
+  count = _count;
+  src_universes = srcs;
+  sink_universes = sinks;
+  src_mask = _src_mask;
+  sink_mask = _sink_mask;
+  input_mask = _input_mask;
+  output_mask = _output_mask;
+  return ESP_OK;
+}
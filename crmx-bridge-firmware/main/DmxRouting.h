@@ -0,0 +1,97 @@
+#pragma once
+
+#include "DmxFramePool.h"
+#include "esp_err.h"
+#include "util.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+static constexpr size_t dmx_route_max = 8;
+// Marks a port that carries no universe.
+static constexpr uint16_t dmx_universe_none = UINT16_MAX;
+
+/**
+ * One routing table entry: frames of src_universe from src go out of sink as
+ * sink_universe. Sources that only carry one universe (the wired port, CRMX,
+ * playback) call it universe 0.
+ */
+struct DmxRoute {
+  DmxSourceSink src;
+  uint16_t src_universe;
+  DmxSourceSink sink;
+  uint16_t sink_universe;
+
+  bool operator==(const DmxRoute &other) const = default;
+};
+
+/**
+ * @brief A routing table compiled into interface ports.
+ *
+ * Every interface has up to dmx_universe_max ports per direction, each with
+ * its own frame slot. Port 0 carries universe 0 and is the one the primary
+ * route (set_src_sink and everything layered on it) reads and writes; the
+ * table gives every other universe a port of its own. A sink port the table
+ * writes is no longer fed by the primary route.
+ */
+class DmxRoutingTable {
+public:
+  struct Entry {
+    DmxSourceSink src;
+    uint8_t src_port;
+    DmxSourceSink sink;
+    uint8_t sink_port;
+  };
+
+  // port_counts holds the ports each interface has, indexed by DmxSourceSink.
+  // Returns ESP_ERR_INVALID_ARG and leaves the table unchanged if a route
+  // names a missing interface, needs more ports than it has, or writes a sink
+  // universe another route already writes.
+  esp_err_t
+  compile(const DmxRoute *routes, const size_t count,
+          const std::array<size_t, dmx_source_sink_count> &port_counts);
+
+  size_t get_count() const { return count; }
+  const Entry &get(const size_t i) const { return entries[i]; }
+
+  // The universe each port carries, or dmx_universe_none.
+  uint16_t get_src_universe(const DmxSourceSink src, const size_t port) const {
+    return src_universes[static_cast<size_t>(src)][port];
+  }
+  uint16_t get_sink_universe(const DmxSourceSink sink,
+                             const size_t port) const {
+    return sink_universes[static_cast<size_t>(sink)][port];
+  }
+  // Masks of dmx_source_sink_bit: sources the table reads from port 0, and
+  // sinks whose port 0 it writes.
+  uint32_t get_src_mask() const { return src_mask; }
+  uint32_t get_sink_mask() const { return sink_mask; }
+  bool is_input(const DmxSourceSink src) const {
+    return (input_mask & dmx_source_sink_bit(src)) != 0;
+  }
+  bool is_output(const DmxSourceSink sink) const {
+    return (output_mask & dmx_source_sink_bit(sink)) != 0;
+  }
+
+protected:
+  using PortUniverses =
+      std::array<std::array<uint16_t, dmx_universe_max>, dmx_source_sink_count>;
+
+  static constexpr PortUniverses default_universes() {
+    PortUniverses universes{};
+    for (auto &ports : universes) {
+      ports.fill(dmx_universe_none);
+      ports[0] = 0;
+    }
+    return universes;
+  }
+
+  std::array<Entry, dmx_route_max> entries{};
+  size_t count = 0;
+  PortUniverses src_universes = default_universes();
+  PortUniverses sink_universes = default_universes();
+  uint32_t src_mask = 0;
+  uint32_t sink_mask = 0;
+  uint32_t input_mask = 0;
+  uint32_t output_mask = 0;
+};
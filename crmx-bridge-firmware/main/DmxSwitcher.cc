@@ -1,5 +1,7 @@
 #include "DmxSwitcher.h"
 #include "esp_log.h"
+#include <algorithm>
+#include <cinttypes>
 
 static const char *TAG = "DMX_SWITCH";
 
@@ -20,35 +22,49 @@ static void dmx_switcher_task(void *pvParameters) {
     return;
   }
 
-  TickType_t xLastWakeTime;
-
-  // Initialise the xLastWakeTime variable with the current time.
-  xLastWakeTime = xTaskGetTickCount();
+  TickType_t wait = portMAX_DELAY;
   while (true) {
-    _switcher->dispatch();
-    // Wait for the next cycle.
-    vTaskDelayUntil(&xLastWakeTime, dmx_switcher_period_min);
+    // Sleep until a source publishes a frame, the route changes, the loss
+    // timer ticks, or the route is due to count as lost.
+    uint32_t notified = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &notified, wait);
+    wait = _switcher->dispatch(notified);
   }
 }
 }
 
+void DmxSwitcher::on_loss_tick(TimerHandle_t timer) {
+  TaskHandle_t task = static_cast<TaskHandle_t>(pvTimerGetTimerID(timer));
+  xTaskNotify(task, notify_tick, eSetBits);
+}
+
+void DmxSwitcher::on_rpc_publish(TimerHandle_t timer) {
+  static_cast<DmxSwitcher *>(pvTimerGetTimerID(timer))->publish_rpc_universe();
+}
+
 esp_err_t DmxInterface::init() {
-  tx_queue = xQueueCreate(dmx_queue_size, sizeof(DmxPacket));
-  if (tx_queue == nullptr) {
-    ESP_LOGE(TAG, "Could not create TX queue");
-    return ESP_ERR_NO_MEM;
-  }
-  rx_queue = xQueueCreate(dmx_queue_size, sizeof(DmxPacket));
-  if (rx_queue == nullptr) {
-    ESP_LOGE(TAG, "Could not create RX queue");
-    return ESP_ERR_NO_MEM;
+  for (size_t port = 0; port < port_count; port++) {
+    if (tx_slots[port].init() != ESP_OK) {
+      ESP_LOGE(TAG, "Could not create TX slot");
+      return ESP_ERR_NO_MEM;
+    }
+    if (rx_slots[port].init() != ESP_OK) {
+      ESP_LOGE(TAG, "Could not create RX slot");
+      return ESP_ERR_NO_MEM;
+    }
+    // Port 0 always carries universe 0; the rest wait for the routing table.
+    const uint16_t universe = port == 0 ? 0 : dmx_universe_none;
+    src_universes[port].store(universe, std::memory_order_relaxed);
+    sink_universes[port].store(universe, std::memory_order_relaxed);
   }
   return ESP_OK;
 }
 
 void DmxInterface::deinit() {
-  vQueueDelete(tx_queue);
-  vQueueDelete(rx_queue);
+  for (size_t port = 0; port < port_count; port++) {
+    tx_slots[port].deinit();
+    rx_slots[port].deinit();
+  }
 }
 
 esp_err_t DmxSwitcher::init() {
@@ -68,6 +84,16 @@ esp_err_t DmxSwitcher::init() {
     return ESP_ERR_NO_MEM;
   }
 
+  ret = ESP_ERROR_CHECK_WITHOUT_ABORT(playback_interface.init());
+  if (ret != ESP_OK) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  ret = ESP_ERROR_CHECK_WITHOUT_ABORT(sacn_interface.init());
+  if (ret != ESP_OK) {
+    return ESP_ERR_NO_MEM;
+  }
+
   inout_mutex = xSemaphoreCreateMutex();
   if (inout_mutex == nullptr) {
     ESP_LOGE(TAG, "Could not create mutex!");
@@ -91,16 +117,37 @@ esp_err_t DmxSwitcher::init() {
     return ESP_ERR_INVALID_STATE;
   }
 
+  // Only wakes the switcher, which then re-publishes or fades a lost route.
+  // The switcher starts it when a route is lost and stops it again once the
+  // route is live, so an idle switcher never wakes.
+  loss_timer = xTimerCreate("dmx_loss", pdMS_TO_TICKS(dmx_loss_tick_ms),
+                            pdTRUE, switcher_task, on_loss_tick);
+  if (loss_timer == nullptr) {
+    ESP_LOGE(TAG, "Could not create DMX loss timer");
+    return ESP_ERR_NO_MEM;
+  }
+
+  // One-shot; its period is set to the wait each time it is armed.
+  rpc_timer = xTimerCreate("dmx_rpc", 1, pdFALSE, this, on_rpc_publish);
+  if (rpc_timer == nullptr) {
+    ESP_LOGE(TAG, "Could not create RPC publish timer");
+    return ESP_ERR_NO_MEM;
+  }
+
   SettingsHandler::shared().add_delegate(this);
 
   return ESP_OK;
 }
 
 void DmxSwitcher::deinit() {
+  xTimerDelete(loss_timer, pdMS_TO_TICKS(10));
+  xTimerDelete(rpc_timer, pdMS_TO_TICKS(10));
   vTaskDelete(switcher_task);
   timo_interface.deinit();
   onboard_interface.deinit();
   artnet_interface.deinit();
+  playback_interface.deinit();
+  sacn_interface.deinit();
   SettingsHandler::shared().remove_delegate(this);
   
   if (rpc_dmx_mutex) {
@@ -108,22 +155,403 @@ void DmxSwitcher::deinit() {
   }
 }
 
-void DmxSwitcher::dispatch() {
+TickType_t DmxSwitcher::dispatch(const uint32_t notified) {
+  wakeup_count.fetch_add(1, std::memory_order_relaxed);
 
   xSemaphoreTake(inout_mutex, dmx_switcher_period_max);
-  QueueHandle_t src_queue = get_src_queue();
-  QueueHandle_t sink_queue = get_sink_queue();
+  const DmxSourceSink _active_src = active_src;
+  const uint32_t sink_mask = get_sink_mask();
   bool _output_en = output_en;
+  const DmxMergeMode _merge_mode = merge_mode;
+  const uint32_t src_mask = get_src_mask();
+  for (size_t i = 0; i < dmx_source_sink_count; i++) {
+    if (merge_timeouts_dirty & (1u << i)) {
+      merger.set_timeout(static_cast<DmxSourceSink>(i),
+                         static_cast<int64_t>(merge_timeouts_ms[i]) * 1000);
+    }
+  }
+  merge_timeouts_dirty = 0;
+  if (patch_dirty) {
+    patch = pending_patch;
+    patch_dirty = false;
+  }
+  if (curves_dirty) {
+    curves = pending_curves;
+    curves_dirty = false;
+  }
+  if (loss_dirty) {
+    loss.set_config(loss_config);
+    loss_dirty = false;
+  }
+  if (sources_dirty) {
+    failover.set_sources(source_list.data(), source_list.size());
+    sources_dirty = false;
+  }
+  crossfade.set_duration_ms(crossfade_ms);
+  if (routes_dirty) {
+    routing = pending_routing;
+    routes_dirty = false;
+  }
   xSemaphoreGive(inout_mutex);
 
-  if (src_queue == nullptr || sink_queue == nullptr) {
+  const int64_t now = esp_timer_get_time();
+  const bool tick = (notified & notify_tick) != 0;
+  if (_output_en) {
+    dispatch_routes();
+  }
+
+  TickType_t wait = portMAX_DELAY;
+  bool routed = _output_en && sink_mask != 0;
+  merger.set_mode(_merge_mode);
+  if (_merge_mode != DmxMergeMode::none) {
+    if (!dispatch_merged(sink_mask, src_mask, _output_en, now) && routed) {
+      dispatch_loss(sink_mask, tick, now);
+    }
+    wait = dmx_merge_poll_period;
+  } else {
+    routed = routed && (get_src_slot(_active_src) != nullptr ||
+                        failover.is_active());
+    dispatch_single(_active_src, sink_mask, _output_en, tick, now);
+  }
+  release_taken();
+  return std::min(wait, update_loss_timer(routed, now));
+}
+
+TickType_t DmxSwitcher::update_loss_timer(const bool routed,
+                                          const int64_t now) {
+  const int64_t deadline = routed ? loss.get_loss_deadline_us() : 0;
+  const bool lost = deadline != 0 && now >= deadline;
+  const bool ticking = routed && (lost || crossfade.is_fading(now));
+  if (ticking != loss_ticking) {
+    const BaseType_t ok = ticking ? xTimerStart(loss_timer, pdMS_TO_TICKS(10))
+                                  : xTimerStop(loss_timer, pdMS_TO_TICKS(10));
+    if (ok == pdPASS) {
+      loss_ticking = ticking;
+    } else {
+      ESP_LOGE(TAG, "Could not %s DMX loss timer",
+               ticking ? "start" : "stop");
+    }
+  }
+  if (ticking && !loss_ticking) {
+    // Poll at the tick rate until the timer can be started.
+    return pdMS_TO_TICKS(dmx_loss_tick_ms);
+  }
+  if (deadline == 0 || lost) {
+    return portMAX_DELAY;
+  }
+  // A live route is watched without the timer: sleep until it would count as
+  // lost, one tick late so the deadline has passed on waking.
+  return pdMS_TO_TICKS((deadline - now + 999) / 1000) + 1;
+}
+
+void DmxSwitcher::dispatch_single(const DmxSourceSink _active_src,
+                                  const uint32_t sink_mask,
+                                  const bool _output_en, const bool tick,
+                                  const int64_t now) {
+  if ((get_src_slot(_active_src) == nullptr && !failover.is_active()) ||
+      sink_mask == 0) {
     return;
   }
 
-  DmxPacket packet;
-  if (xQueueReceive(src_queue, &packet, dmx_switcher_period_max) &&
-      _output_en) {
-    xQueueOverwrite(sink_queue, &packet);
+  DmxSourceSink src = _active_src;
+  DmxFrameRef frame;
+  if (failover.is_active()) {
+    src = crossfade.get_source();
+    frame = take_failover(now, src);
+  } else {
+    frame = std::move(take_src(_active_src));
+  }
+  if (!_output_en) {
+    return;
+  }
+
+  crossfade.set_source(src, now);
+  if (frame) {
+    crossfade.update(frame);
+  }
+  bool owned = false;
+  if (crossfade.is_fading(now)) {
+    // The outgoing source no longer wakes the switcher; pick up its latest
+    // frame as we go.
+    DmxFrameRef from = std::move(take_src(crossfade.get_from()));
+    if (from) {
+      crossfade.update_from(std::move(from));
+    }
+    // Ticks keep the fade moving when the sources are slow.
+    if (frame || tick) {
+      const int64_t start = esp_timer_get_time();
+      frame = crossfade.render(now);
+      owned = true;
+      crossfade_time.record(esp_timer_get_time() - start);
+    }
+  }
+  if (frame) {
+    frame = apply_stages(std::move(frame), owned);
+  }
+  if (frame) {
+    // A frame a stage or the crossfade made is only stamped here; one that
+    // is shared keeps the stamp take_src gave it.
+    if (frame.is_unique()) {
+      frame->times.dispatch_us = now;
+    }
+    loss.on_routed(frame, now);
+    publish_to_sinks(std::move(frame), sink_mask);
+  } else {
+    dispatch_loss(sink_mask, tick, now);
+  }
+}
+
+void DmxSwitcher::dispatch_routes() {
+  // Routes only pass frame references on; a source universe routed to several
+  // sinks shares one frame between them.
+  for (size_t r = 0; r < routing.get_count(); r++) {
+    const DmxRoutingTable::Entry &route = routing.get(r);
+    DmxFrameRef &frame = take_src(route.src, route.src_port);
+    DmxFrameSlot *sink_slot = get_sink_slot(route.sink, route.sink_port);
+    if (!frame || sink_slot == nullptr) {
+      continue;
+    }
+    sink_slot->publish(frame.share());
+    dispatch_count.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+DmxFrameRef &DmxSwitcher::take_src(const DmxSourceSink src,
+                                   const size_t port) {
+  const size_t i = static_cast<size_t>(src);
+  DmxFrameRef &frame = taken[i][port];
+  if ((taken_ports[i] & (1u << port)) == 0) {
+    taken_ports[i] |= 1u << port;
+    DmxFrameSlot *slot = get_src_slot(src, port);
+    if (slot != nullptr) {
+      frame = slot->take(0);
+    }
+    // Stamped before the switcher shares the frame with the crossfade, the
+    // loss handler or a sink. A recording tap may hold it already, but taps
+    // never read the dispatch time.
+    if (frame) {
+      frame->times.dispatch_us = esp_timer_get_time();
+    }
+  }
+  return frame;
+}
+
+void DmxSwitcher::release_taken() {
+  for (size_t i = 0; i < dmx_source_sink_count; i++) {
+    for (size_t port = 0; port < dmx_universe_max; port++) {
+      if (taken_ports[i] & (1u << port)) {
+        taken[i][port].reset();
+      }
+    }
+    taken_ports[i] = 0;
+  }
+}
+
+DmxFrameRef DmxSwitcher::take_failover(const int64_t now,
+                                       DmxSourceSink &src) {
+  // Frames from the sources not routed are dropped unless one is being faded
+  // out; they only keep those sources live. Each listed source wakes the
+  // switcher, so a backup takes over with its first frame after the routed
+  // source goes stale.
+  std::array<DmxFrameRef, dmx_source_list_max> frames;
+  for (size_t i = 0; i < failover.get_count(); i++) {
+    frames[i] = std::move(take_src(failover.get_source(i)));
+    if (frames[i]) {
+      failover.on_frame(i, frames[i]->times.rx_us);
+    }
+  }
+  const size_t i = failover.select(now);
+  // A mailbox keeps its last frame however old it is.
+  if (i == DmxFailover::no_source || !failover.is_live(i, now)) {
+    return DmxFrameRef{};
+  }
+  src = failover.get_source(i);
+  for (size_t j = 0; j < failover.get_count(); j++) {
+    if (j != i && frames[j] &&
+        failover.get_source(j) == crossfade.get_from()) {
+      crossfade.update_from(std::move(frames[j]));
+    }
+  }
+  return std::move(frames[i]);
+}
+
+void DmxSwitcher::dispatch_loss(const uint32_t sink_mask, const bool tick,
+                                const int64_t now) {
+  // Throttle re-publishing to the loss timer's rate.
+  if (!tick || !loss.is_lost(now)) {
+    return;
+  }
+  DmxFrameRef frame = loss.get_loss_frame(now);
+  if (frame) {
+    publish_to_sinks(std::move(frame), sink_mask);
+  }
+}
+
+void DmxSwitcher::publish_to_sinks(DmxFrameRef &&frame,
+                                   const uint32_t sink_mask) {
+  // Only frame references move; the universe itself is never copied here.
+  // Every sink gets the same frame through its own latest-value slot, so a
+  // slow sink just skips frames without holding up the others. The frame may
+  // be a re-published one already held by the sinks, so it is not touched.
+  DmxFrameSlot *last_slot = nullptr;
+  for (size_t i = 0; i < dmx_source_sink_count; i++) {
+    const DmxSourceSink sink = static_cast<DmxSourceSink>(i);
+    if ((sink_mask & dmx_source_sink_bit(sink)) == 0) {
+      continue;
+    }
+    DmxFrameSlot *sink_slot = get_sink_slot(sink);
+    if (sink_slot == nullptr) {
+      continue;
+    }
+    if (last_slot != nullptr) {
+      last_slot->publish(frame.share());
+    }
+    last_slot = sink_slot;
+  }
+  if (last_slot != nullptr) {
+    last_slot->publish(std::move(frame));
+    dispatch_count.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+bool DmxSwitcher::dispatch_merged(const uint32_t sink_mask,
+                                  const uint32_t src_mask,
+                                  const bool _output_en, const int64_t now) {
+  const int64_t start = now;
+
+  bool changed = false;
+  for (size_t i = 0; i < dmx_source_sink_count; i++) {
+    const DmxSourceSink src = static_cast<DmxSourceSink>(i);
+    if ((src_mask & dmx_source_sink_bit(src)) == 0) {
+      continue;
+    }
+    DmxFrameRef frame = std::move(take_src(src));
+    if (frame) {
+      merger.update(src, std::move(frame), start);
+      changed = true;
+    }
+  }
+  if (merger.expire(start, src_mask)) {
+    merge_expiry_count.fetch_add(1, std::memory_order_relaxed);
+    changed = true;
+  }
+
+  if (!changed || !merger.has_sources() || sink_mask == 0 || !_output_en) {
+    return false;
+  }
+
+  DmxFrameRef out = DmxFramePool::shared().acquire();
+  if (!out) {
+    ESP_LOGW(TAG, "No free DMX frame for merged output");
+    return false;
+  }
+  merger.render(*out);
+  merge_time.record(esp_timer_get_time() - start);
+  out = apply_stages(std::move(out), true);
+  if (!out) {
+    return false;
+  }
+  out->times.dispatch_us = esp_timer_get_time();
+  loss.on_routed(out, now);
+  publish_to_sinks(std::move(out), sink_mask);
+  return true;
+}
+
+// Frames a source handed over may still be referenced elsewhere, so a stage
+// writes into a fresh frame unless an earlier stage already made one.
+static DmxFrameRef copy_header(const DmxFrameRef &frame) {
+  DmxFrameRef out = DmxFramePool::shared().acquire();
+  if (!out) {
+    ESP_LOGW(TAG, "No free DMX frame for processed output");
+    return out;
+  }
+  out->source = frame->source;
+  out->universe = frame->universe;
+  out->slot_count = frame->slot_count;
+  out->times = frame->times;
+  out->full_packet.start_code = frame->full_packet.start_code;
+  return out;
+}
+
+DmxFrameRef DmxSwitcher::apply_stages(DmxFrameRef &&frame, bool owned) {
+  if (!patch.is_identity()) {
+    const int64_t start = esp_timer_get_time();
+    // The patch moves channels around, so it can never work in place.
+    DmxFrameRef out = copy_header(frame);
+    if (!out) {
+      return out;
+    }
+    patch.apply(frame->full_packet.data.data(), out->full_packet.data.data());
+    out->slot_count =
+        static_cast<uint16_t>(patch.get_slot_count(frame->slot_count));
+    frame = std::move(out);
+    owned = true;
+    patch_time.record(esp_timer_get_time() - start);
+  }
+
+  if (!curves.is_identity()) {
+    const int64_t start = esp_timer_get_time();
+    DmxFrameRef out = owned ? std::move(frame) : copy_header(frame);
+    if (!out) {
+      return out;
+    }
+    const uint8_t *in = owned ? out->full_packet.data.data()
+                              : frame->full_packet.data.data();
+    // Curves may map 0 elsewhere, so only the slots in use go through them
+    // and a fresh frame's tail is zeroed.
+    const size_t len = out->slot_count;
+    curves.apply(in, out->full_packet.data.data(), len);
+    if (!owned) {
+      memset(out->full_packet.data.data() + len, 0, dmx_packet_size - len);
+    }
+    frame = std::move(out);
+    curve_time.record(esp_timer_get_time() - start);
+  }
+
+  return std::move(frame);
+}
+
+void DmxSwitcher::update_src_listeners(const uint32_t old_mask) {
+  const uint32_t new_mask = get_listen_mask();
+  for (size_t i = 0; i < dmx_source_sink_count; i++) {
+    const DmxSourceSink src = static_cast<DmxSourceSink>(i);
+    const uint32_t bit = dmx_source_sink_bit(src);
+    if ((old_mask & bit) == (new_mask & bit)) {
+      continue;
+    }
+    DmxFrameSlot *slot = get_src_slot(src);
+    if (slot == nullptr) {
+      continue;
+    }
+    if (new_mask & bit) {
+      slot->set_listener(switcher_task, notify_frame);
+    } else {
+      slot->set_listener(nullptr, 0);
+    }
+  }
+}
+
+void DmxSwitcher::update_ports() {
+  for (size_t i = 0; i < dmx_source_sink_count; i++) {
+    const DmxSourceSink io = static_cast<DmxSourceSink>(i);
+    DmxInterface *interface = get_interface(io);
+    if (interface == nullptr) {
+      continue;
+    }
+    // Port 0 is left to update_src_listeners.
+    for (size_t port = 1; port < interface->port_count; port++) {
+      const uint16_t universe = pending_routing.get_src_universe(io, port);
+      interface->src_universes[port].store(universe,
+                                           std::memory_order_relaxed);
+      if (universe == dmx_universe_none) {
+        interface->tx_slots[port].set_listener(nullptr, 0);
+      } else {
+        interface->tx_slots[port].set_listener(switcher_task, notify_frame);
+      }
+      interface->sink_universes[port].store(
+          pending_routing.get_sink_universe(io, port),
+          std::memory_order_relaxed);
+    }
   }
 }
 
@@ -131,8 +559,10 @@ esp_err_t DmxSwitcher::set_src_sink(const DmxSourceSink src,
                                     const DmxSourceSink sink) {
   bool taken = xSemaphoreTake(inout_mutex, pdMS_TO_TICKS(2));
   if (taken) {
+    const uint32_t old_mask = get_listen_mask();
     active_src = src;
     active_sink = sink;
+    update_src_listeners(old_mask);
     if (xSemaphoreGive(inout_mutex) != pdPASS) {
       return ESP_FAIL;
     }
@@ -140,6 +570,9 @@ esp_err_t DmxSwitcher::set_src_sink(const DmxSourceSink src,
     return ESP_ERR_TIMEOUT;
   }
 
+  // Forward anything the new source already has waiting.
+  xTaskNotify(switcher_task, notify_route, eSetBits);
+
   return ESP_OK;
 }
 
@@ -157,7 +590,216 @@ esp_err_t DmxSwitcher::set_output_en(const bool en) {
   return ESP_OK;
 }
 
+esp_err_t DmxSwitcher::set_fanout(const uint32_t sinks) {
+  bool taken = xSemaphoreTake(inout_mutex, pdMS_TO_TICKS(2));
+  if (taken) {
+    fanout_sinks = sinks;
+    if (xSemaphoreGive(inout_mutex) != pdPASS) {
+      return ESP_FAIL;
+    }
+  } else {
+    return ESP_ERR_TIMEOUT;
+  }
+
+  return ESP_OK;
+}
+
+esp_err_t DmxSwitcher::set_patch(const std::vector<DmxPatchRule> &rules) {
+  bool taken = xSemaphoreTake(inout_mutex, pdMS_TO_TICKS(2));
+  if (taken) {
+    const esp_err_t err = pending_patch.compile(rules.data(), rules.size());
+    if (err == ESP_OK) {
+      patch_dirty = true;
+      ESP_LOGI(TAG, "Patch of %zu rules compiled to %zu spans", rules.size(),
+               pending_patch.get_span_count());
+    }
+    if (xSemaphoreGive(inout_mutex) != pdPASS) {
+      return ESP_FAIL;
+    }
+    if (err != ESP_OK) {
+      return err;
+    }
+  } else {
+    return ESP_ERR_TIMEOUT;
+  }
+
+  return ESP_OK;
+}
+
+esp_err_t DmxSwitcher::set_curves(const std::vector<DmxCurveRule> &rules) {
+  bool taken = xSemaphoreTake(inout_mutex, pdMS_TO_TICKS(2));
+  if (taken) {
+    const esp_err_t err = pending_curves.compile(rules.data(), rules.size());
+    if (err == ESP_OK) {
+      curves_dirty = true;
+      ESP_LOGI(TAG, "Curves of %zu rules compiled to %zu tables", rules.size(),
+               pending_curves.get_table_count());
+    }
+    if (xSemaphoreGive(inout_mutex) != pdPASS) {
+      return ESP_FAIL;
+    }
+    if (err != ESP_OK) {
+      return err;
+    }
+  } else {
+    return ESP_ERR_TIMEOUT;
+  }
+
+  return ESP_OK;
+}
+
+esp_err_t DmxSwitcher::set_loss_config(const DmxLossConfig &config) {
+  if (config.policy > DmxLossPolicy::fade) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  bool taken = xSemaphoreTake(inout_mutex, pdMS_TO_TICKS(2));
+  if (taken) {
+    loss_config = config;
+    loss_dirty = true;
+    if (xSemaphoreGive(inout_mutex) != pdPASS) {
+      return ESP_FAIL;
+    }
+  } else {
+    return ESP_ERR_TIMEOUT;
+  }
+
+  return ESP_OK;
+}
+
+esp_err_t DmxSwitcher::set_crossfade(const uint32_t ms) {
+  bool taken = xSemaphoreTake(inout_mutex, pdMS_TO_TICKS(2));
+  if (taken) {
+    crossfade_ms = ms;
+    if (xSemaphoreGive(inout_mutex) != pdPASS) {
+      return ESP_FAIL;
+    }
+  } else {
+    return ESP_ERR_TIMEOUT;
+  }
+
+  return ESP_OK;
+}
+
+esp_err_t DmxSwitcher::set_sources(
+    const std::vector<DmxSourceEntry> &entries) {
+  if (entries.size() > dmx_source_list_max) {
+    ESP_LOGE(TAG, "Too many failover sources: %zu", entries.size());
+    return ESP_ERR_INVALID_ARG;
+  }
+  uint32_t seen = 0;
+  for (const DmxSourceEntry &entry : entries) {
+    const uint32_t bit = dmx_source_sink_bit(entry.src);
+    if (entry.src == DmxSourceSink::none ||
+        static_cast<size_t>(entry.src) >= dmx_source_sink_count ||
+        (seen & bit) != 0 || entry.timeout_ms == 0) {
+      ESP_LOGE(TAG, "Invalid failover source %" PRIu32,
+               underlying(entry.src));
+      return ESP_ERR_INVALID_ARG;
+    }
+    seen |= bit;
+  }
+
+  bool taken = xSemaphoreTake(inout_mutex, pdMS_TO_TICKS(2));
+  if (taken) {
+    // Settings updates pass the list again on every change; only a new list
+    // restarts the selection.
+    if (entries != source_list) {
+      const uint32_t old_mask = get_listen_mask();
+      source_list = entries;
+      sources_dirty = true;
+      update_src_listeners(old_mask);
+    }
+    if (xSemaphoreGive(inout_mutex) != pdPASS) {
+      return ESP_FAIL;
+    }
+  } else {
+    return ESP_ERR_TIMEOUT;
+  }
+
+  xTaskNotify(switcher_task, notify_route, eSetBits);
+
+  return ESP_OK;
+}
+
+esp_err_t DmxSwitcher::set_routes(const std::vector<DmxRoute> &routes) {
+  std::array<size_t, dmx_source_sink_count> port_counts{};
+  for (size_t i = 0; i < dmx_source_sink_count; i++) {
+    DmxInterface *interface = get_interface(static_cast<DmxSourceSink>(i));
+    port_counts[i] = interface == nullptr ? 0 : interface->get_port_count();
+  }
+
+  bool taken = xSemaphoreTake(inout_mutex, pdMS_TO_TICKS(2));
+  if (taken) {
+    esp_err_t err = ESP_OK;
+    if (routes != route_list) {
+      const uint32_t old_mask = get_listen_mask();
+      err = pending_routing.compile(routes.data(), routes.size(), port_counts);
+      if (err == ESP_OK) {
+        route_list = routes;
+        routes_dirty = true;
+        update_ports();
+        update_src_listeners(old_mask);
+        ESP_LOGI(TAG, "Routing table of %zu routes", routes.size());
+      }
+    }
+    if (xSemaphoreGive(inout_mutex) != pdPASS) {
+      return ESP_FAIL;
+    }
+    if (err != ESP_OK) {
+      return err;
+    }
+  } else {
+    return ESP_ERR_TIMEOUT;
+  }
+
+  xTaskNotify(switcher_task, notify_route, eSetBits);
+
+  return ESP_OK;
+}
+
+esp_err_t DmxSwitcher::set_merge(const DmxMergeMode mode,
+                                 const uint32_t srcs) {
+  bool taken = xSemaphoreTake(inout_mutex, pdMS_TO_TICKS(2));
+  if (taken) {
+    const uint32_t old_mask = get_listen_mask();
+    merge_mode = mode;
+    merge_srcs = srcs;
+    update_src_listeners(old_mask);
+    if (xSemaphoreGive(inout_mutex) != pdPASS) {
+      return ESP_FAIL;
+    }
+  } else {
+    return ESP_ERR_TIMEOUT;
+  }
+
+  xTaskNotify(switcher_task, notify_route, eSetBits);
+
+  return ESP_OK;
+}
+
+esp_err_t DmxSwitcher::set_merge_timeout(const DmxSourceSink src,
+                                         const uint32_t ms) {
+  const size_t i = static_cast<size_t>(src);
+  if (i >= dmx_source_sink_count) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  bool taken = xSemaphoreTake(inout_mutex, pdMS_TO_TICKS(2));
+  if (taken) {
+    merge_timeouts_ms[i] = ms;
+    merge_timeouts_dirty |= 1u << i;
+    if (xSemaphoreGive(inout_mutex) != pdPASS) {
+      return ESP_FAIL;
+    }
+  } else {
+    return ESP_ERR_TIMEOUT;
+  }
+
+  return ESP_OK;
+}
+
 void DmxSwitcher::on_settings_update(const SettingsHandler &settings) {
+  rpc_period_us =
+      dmx_packet_time_us(dmx_packet_size, dmx_timing(settings.dmx_timing));
   esp_err_t err = set_src_sink(settings.input, settings.output);
   if (err != ESP_OK) {
     ESP_LOGE(TAG, "Failed to set source/sink on settings update.");
@@ -166,6 +808,38 @@ void DmxSwitcher::on_settings_update(const SettingsHandler &settings) {
   if (err != ESP_OK) {
     ESP_LOGE(TAG, "Failed to set output enable on settings update.");
   }
+  err = set_fanout(settings.fanout_sinks);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to set fan-out on settings update.");
+  }
+  err = set_merge(settings.merge_mode, settings.merge_srcs);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to set merge on settings update.");
+  }
+  err = set_patch(settings.patch);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to set patch on settings update.");
+  }
+  err = set_curves(settings.curves);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to set curves on settings update.");
+  }
+  err = set_loss_config(settings.get_loss_config());
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to set loss policy on settings update.");
+  }
+  err = set_sources(settings.source_list);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to set failover sources on settings update.");
+  }
+  err = set_crossfade(settings.crossfade_ms);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to set crossfade on settings update.");
+  }
+  err = set_routes(settings.routes);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to set routing table on settings update.");
+  }
 }
 
 esp_err_t DmxSwitcher::set_dmx_value(int dmx_address, int value) {
@@ -180,29 +854,66 @@ esp_err_t DmxSwitcher::set_dmx_value(int dmx_address, int value) {
     return ESP_ERR_INVALID_ARG;
   }
   
-  // Update the RPC DMX universe state
-  bool taken = xSemaphoreTake(rpc_dmx_mutex, pdMS_TO_TICKS(10));
-  if (!taken) {
-    ESP_LOGE(TAG, "Failed to take RPC DMX mutex");
-    return ESP_ERR_TIMEOUT;
+  // DMX addresses are 1-based, the array is 0-based
+  esp_err_t err = update_rpc_universe(
+      [&](std::array<uint8_t, dmx_packet_size> &slots) {
+        slots[dmx_address - 1] = static_cast<uint8_t>(value);
+        return true;
+      });
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "RPC: Failed to update DMX universe: %s",
+             esp_err_to_name(err));
+    return err;
   }
-  
-  // Set the requested address (DMX addresses are 1-based, array is 0-based)
-  rpc_dmx_universe[dmx_address - 1] = static_cast<uint8_t>(value);
-  
-  // Create a full DMX packet with current state
-  DmxPacket packet;
-  packet.source = DmxSourceSink::artnet; // Mark as coming from RPC/network
-  packet.full_packet.start_code = 0;
-  
-  // Copy current universe state
-  memcpy(packet.full_packet.data.data(), rpc_dmx_universe.data(), rpc_dmx_universe.size());
-  
-  xSemaphoreGive(rpc_dmx_mutex);
-  
-  // Send to the artnet interface (so it can be switched to output)
-  artnet_interface.send(packet);
-  
-  ESP_LOGI(TAG, "RPC: Set DMX address %d to value %d", dmx_address, value);
+
+  ESP_LOGD(TAG, "RPC: Set DMX address %d to value %d", dmx_address, value);
   return ESP_OK;
 }
+
+void DmxSwitcher::schedule_rpc_publish(const int64_t wait_us) {
+  if (wait_us <= 0) {
+    publish_rpc_universe();
+    return;
+  }
+  const TickType_t ticks =
+      std::max<TickType_t>(1, pdMS_TO_TICKS((wait_us + 999) / 1000));
+  // Changing the period also starts the timer.
+  if (xTimerChangePeriod(rpc_timer, ticks, 0) != pdPASS) {
+    ESP_LOGW(TAG, "RPC: Publish timer busy, publishing early");
+    publish_rpc_universe();
+  }
+}
+
+void DmxSwitcher::publish_rpc_universe() {
+  // Runs in the timer service task, which must not block; an update holding
+  // the mutex only delays the publish to the next period.
+  if (xSemaphoreTake(rpc_dmx_mutex, 0) != pdTRUE) {
+    retry_rpc_publish();
+    return;
+  }
+  if (!rpc_dmx_dirty) {
+    xSemaphoreGive(rpc_dmx_mutex);
+    return;
+  }
+  DmxFrameRef frame = DmxFramePool::shared().acquire();
+  if (!frame) {
+    xSemaphoreGive(rpc_dmx_mutex);
+    retry_rpc_publish();
+    return;
+  }
+  frame->full_packet.data = rpc_dmx_universe;
+  rpc_dmx_dirty = false;
+  rpc_last_publish_us = esp_timer_get_time();
+  xSemaphoreGive(rpc_dmx_mutex);
+
+  frame->source = DmxSourceSink::artnet;
+  frame->full_packet.start_code = 0;
+  artnet_interface.send(std::move(frame));
+  rpc_frame_count++;
+}
+
+void DmxSwitcher::retry_rpc_publish() {
+  // Leave the universe dirty and try again next period.
+  rpc_retry_count++;
+  xTimerChangePeriod(rpc_timer, pdMS_TO_TICKS(rpc_period_us / 1000 + 1), 0);
+}
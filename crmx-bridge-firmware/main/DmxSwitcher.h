@@ -1,52 +1,151 @@
 #pragma once
 
+#include "DmxCrossfade.h"
+#include "DmxCurves.h"
+#include "DmxFailover.h"
+#include "DmxFramePool.h"
+#include "DmxLatency.h"
+#include "DmxLoss.h"
+#include "DmxMerge.h"
+#include "DmxPatch.h"
+#include "DmxRouting.h"
 #include "SettingsHandler.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
+#include "freertos/timers.h"
 #include "util.h"
 #include <array>
+#include <vector>
 
 void dmx_switcher_task();
 
-static constexpr size_t dmx_packet_size = 512;
-static constexpr TickType_t dmx_switcher_period_min = pdMS_TO_TICKS(1);
 static constexpr TickType_t dmx_switcher_period_max = pdMS_TO_TICKS(5);
-
-struct DmxPacket {
-  DmxSourceSink source;
-  struct PACKED_ATTR {
-    uint8_t start_code;
-    std::array<uint8_t, dmx_packet_size> data;
-    static constexpr size_t size() { return dmx_packet_size + 1; }
-  } full_packet;
-};
-static_assert(sizeof(decltype(DmxPacket::full_packet)) == dmx_packet_size + 1);
+// While merging, wake at least this often to time out silent sources.
+static constexpr TickType_t dmx_merge_poll_period = pdMS_TO_TICKS(100);
 
 class DmxSwitcher;
 
 class DmxInterface {
 public:
-  static constexpr size_t dmx_queue_size = 1;
+  explicit DmxInterface(const DmxSourceSink _id, const size_t _port_count = 1)
+      : id(_id), port_count(_port_count) {}
 
+  // Publish a frame from this interface's source into the switcher. Producers
+  // that know when reception actually finished stamp times.rx_us themselves.
+  // Frames of a universe nothing routes are dropped here.
+  void send(DmxFrameRef &&frame) {
+    if (frame->times.rx_us == 0) {
+      frame->times.rx_us = esp_timer_get_time();
+    }
+    const size_t port = get_src_port(frame->universe);
+    if (port == dmx_universe_max) {
+      unrouted_count.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    DmxFrameSlot *_tap = tap.load(std::memory_order_acquire);
+    if (port == 0 && _tap != nullptr) {
+      _tap->publish(frame.share());
+    }
+    tx_slots[port].publish(std::move(frame));
+  }
+  // Convenience for producers that do not fill pool frames directly. Costs
+  // one copy into a pool frame.
   void send(const DmxPacket &packet) {
-    if (tx_queue == nullptr) {
+    DmxFrameRef frame = DmxFramePool::shared().acquire();
+    if (!frame) {
       return;
     }
-    xQueueOverwrite(tx_queue, &packet);
+    *frame = packet;
+    send(std::move(frame));
   }
-  bool recieve(DmxPacket &packet, const TickType_t timeout) {
-    if (rx_queue == nullptr) {
-      return false;
+  // Pick up the latest frame routed to port of this interface's sink. The
+  // returned reference is empty on timeout.
+  DmxFrameRef recieve(const TickType_t timeout, const size_t port = 0) {
+    DmxFrameRef frame = rx_slots[port].take(timeout);
+    if (frame) {
+      pickup_us[port] = esp_timer_get_time();
+    }
+    return frame;
+  }
+  // The sink has finished writing out the frame it last picked up from port;
+  // records its per-hop latencies. Routed frames are shared between sinks, so
+  // they must be treated as read-only here. A frame the switcher re-published
+  // while its source was lost is only recorded the first time.
+  void complete(const DmxFrameRef &frame, const size_t port = 0) {
+    if (frame->times.dispatch_us != 0 &&
+        frame->times.dispatch_us == last_dispatch_us[port]) {
+      return;
+    }
+    last_dispatch_us[port] = frame->times.dispatch_us;
+    DmxLatencyTracker::shared().record(frame->times, pickup_us[port],
+                                       esp_timer_get_time(), frame->source, id);
+  }
+
+  // Also hand every universe 0 frame this interface's source sends to slot,
+  // e.g. for recording. The frame is shared, not copied. Pass nullptr to stop.
+  void set_tap(DmxFrameSlot *slot) {
+    tap.store(slot, std::memory_order_release);
+  }
+
+  // Have the sink task woken with notify_bits set whenever a frame is routed
+  // to any of its ports, instead of blocking in recieve().
+  void set_sink_listener(TaskHandle_t task, const uint32_t notify_bits) {
+    for (size_t port = 0; port < port_count; port++) {
+      rx_slots[port].set_listener(task, notify_bits);
     }
-    return xQueueReceive(rx_queue, &packet, timeout) == pdTRUE;
   }
 
   esp_err_t init();
   void deinit();
 
+  DmxSourceSink get_id() const { return id; }
+  size_t get_port_count() const { return port_count; }
+  // The universe the switcher routes to port of this interface's sink, or
+  // dmx_universe_none.
+  uint16_t get_sink_universe(const size_t port) const {
+    return sink_universes[port].load(std::memory_order_relaxed);
+  }
+  // The universe the switcher routes from port of this interface's source, or
+  // dmx_universe_none.
+  uint16_t get_src_universe(const size_t port) const {
+    return src_universes[port].load(std::memory_order_relaxed);
+  }
+  // Whether send() would route frames of universe, so producers can skip
+  // building frames nothing reads.
+  bool is_src_routed(const uint16_t universe) const {
+    return get_src_port(universe) != dmx_universe_max;
+  }
+  // Frames dropped because nothing routes their universe.
+  uint32_t get_unrouted_count() const {
+    return unrouted_count.load(std::memory_order_relaxed);
+  }
+
 protected:
-  QueueHandle_t tx_queue;
-  QueueHandle_t rx_queue;
+  // dmx_universe_max if no port carries universe.
+  size_t get_src_port(const uint16_t universe) const {
+    if (universe == 0) {
+      return 0;
+    }
+    for (size_t port = 1; port < port_count; port++) {
+      if (src_universes[port].load(std::memory_order_relaxed) == universe) {
+        return port;
+      }
+    }
+    return dmx_universe_max;
+  }
+
+  const DmxSourceSink id;
+  const size_t port_count;
+  std::array<DmxFrameSlot, dmx_universe_max> tx_slots;
+  std::array<DmxFrameSlot, dmx_universe_max> rx_slots;
+  // Set by the switcher from the routing table.
+  std::array<std::atomic<uint16_t>, dmx_universe_max> src_universes{};
+  std::array<std::atomic<uint16_t>, dmx_universe_max> sink_universes{};
+  std::atomic<DmxFrameSlot *> tap{nullptr};
+  std::atomic<uint32_t> unrouted_count{0};
+  // Only touched by the sink task.
+  std::array<int64_t, dmx_universe_max> pickup_us{};
+  std::array<int64_t, dmx_universe_max> last_dispatch_us{};
 
   friend class DmxSwitcher;
 };
@@ -56,70 +155,323 @@ class DmxSwitcher : public SettingsChangeDelegate {
 public:
   esp_err_t init();
   void deinit();
-  void dispatch();
+  // Route waiting frames. notified holds the notification bits the switcher
+  // task woke with. Returns how long the switcher task may sleep if no
+  // notification arrives.
+  TickType_t dispatch(const uint32_t notified);
 
   // These functions should be thread-safe.
   esp_err_t set_src_sink(const DmxSourceSink src, const DmxSourceSink sink);
   esp_err_t set_output_en(const bool en);
+  // Also send everything routed to the active sink to these sinks (a mask of
+  // dmx_source_sink_bit). All sinks share one frame; none is copied.
+  esp_err_t set_fanout(const uint32_t sinks);
+  // Merge the sources in merge_srcs (a mask of dmx_source_sink_bit) together
+  // with the active source. DmxMergeMode::none routes the active source only.
+  esp_err_t set_merge(const DmxMergeMode mode, const uint32_t merge_srcs);
+  // 0 never times the source out of the merge.
+  esp_err_t set_merge_timeout(const DmxSourceSink src, const uint32_t ms);
+
+  // Compile rules into the patch applied to every routed frame. An empty
+  // list routes channels straight through.
+  esp_err_t set_patch(const std::vector<DmxPatchRule> &rules);
+  // Compile rules into the response curves applied after the patch.
+  esp_err_t set_curves(const std::vector<DmxCurveRule> &rules);
+  // What the route outputs once its sources go quiet.
+  esp_err_t set_loss_config(const DmxLossConfig &config);
+  // Route the first live source of this list, in priority order, instead of
+  // the one set by set_src_sink. Switching between them is automatic and
+  // never touches settings. An empty list turns failover off; it is also
+  // ignored while merging, which drops stale sources by itself.
+  esp_err_t set_sources(const std::vector<DmxSourceEntry> &entries);
+  // Crossfade over this long whenever the routed source changes, whether
+  // from set_src_sink or a failover. 0 cuts straight over.
+  esp_err_t set_crossfade(const uint32_t ms);
+  // Compile the routing table. Its routes forward further universes
+  // alongside the primary route, without the processing stages.
+  esp_err_t set_routes(const std::vector<DmxRoute> &routes);
+
+  struct Stats {
+    uint32_t wakeups;
+    uint32_t dispatched;
+    uint32_t merge_expiries;
+    uint32_t losses;
+    uint32_t switchovers;
+    // Seconds spent routing each source of the failover list, indexed by
+    // DmxSourceSink; none is the time with no listed source live.
+    std::array<uint32_t, dmx_source_sink_count> source_time_s;
+    // Time spent in each processing stage per frame.
+    LatencyHistogram::Summary merge_time;
+    LatencyHistogram::Summary crossfade_time;
+    LatencyHistogram::Summary patch_time;
+    LatencyHistogram::Summary curve_time;
+    // RPC updates to the RPC universe, and the frames they were published in.
+    uint32_t rpc_updates;
+    uint32_t rpc_frames;
+    // Publishes put off a period by a busy universe or an empty frame pool.
+    uint32_t rpc_retries;
+  };
 
   DmxSourceSink get_src() const { return active_src; }
   DmxSourceSink get_sink() const { return active_sink; }
 
   bool get_output_en() const { return output_en; }
 
+  uint32_t get_fanout() const { return fanout_sinks; }
+  DmxMergeMode get_merge_mode() const { return merge_mode; }
+  uint32_t get_merge_srcs() const { return merge_srcs; }
+
+  Stats get_stats() const {
+    std::array<uint32_t, dmx_source_sink_count> source_time_s;
+    for (size_t i = 0; i < dmx_source_sink_count; i++) {
+      source_time_s[i] =
+          failover.get_source_time_s(static_cast<DmxSourceSink>(i));
+    }
+    return Stats{
+        .wakeups = wakeup_count,
+        .dispatched = dispatch_count,
+        .merge_expiries = merge_expiry_count,
+        .losses = loss.get_loss_count(),
+        .switchovers = failover.get_switchover_count(),
+        .source_time_s = source_time_s,
+        .merge_time = merge_time.summarize(),
+        .crossfade_time = crossfade_time.summarize(),
+        .patch_time = patch_time.summarize(),
+        .curve_time = curve_time.summarize(),
+        .rpc_updates = rpc_update_count,
+        .rpc_frames = rpc_frame_count,
+        .rpc_retries = rpc_retry_count,
+    };
+  }
+
   static DmxSwitcher &get_switcher();
 
   DmxInterface &get_timo_interface() { return timo_interface; }
   DmxInterface &get_onboard_interface() { return onboard_interface; }
   DmxInterface &get_artnet_interface() { return artnet_interface; }
+  DmxInterface &get_playback_interface() { return playback_interface; }
+  DmxInterface &get_sacn_interface() { return sacn_interface; }
+  // nullptr for DmxSourceSink::none.
+  DmxInterface *get_interface(const DmxSourceSink io) {
+    switch (io) {
+    case DmxSourceSink::timo:
+      return &timo_interface;
+    case DmxSourceSink::onboard:
+      return &onboard_interface;
+    case DmxSourceSink::artnet:
+      return &artnet_interface;
+    case DmxSourceSink::playback:
+      return &playback_interface;
+    case DmxSourceSink::sacn:
+      return &sacn_interface;
+    case DmxSourceSink::none:
+    default:
+      return nullptr;
+    }
+  }
   
   // RPC interface for setting DMX values
   esp_err_t set_dmx_value(int dmx_address, int value);
+  // Edit the RPC universe and schedule it for the artnet source. edit gets a
+  // copy of the universe's slots and returns false to throw the whole update
+  // away; either every slot it wrote goes out together or none does.
+  // Updates only mark the universe dirty: it is published at most once per
+  // output period, so a burst of RPCs goes out as one frame with the latest
+  // levels.
+  template <typename Edit> esp_err_t update_rpc_universe(Edit &&edit) {
+    if (xSemaphoreTake(rpc_dmx_mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
+      return ESP_ERR_TIMEOUT;
+    }
+    rpc_dmx_edit = rpc_dmx_universe;
+    if (!edit(rpc_dmx_edit)) {
+      xSemaphoreGive(rpc_dmx_mutex);
+      return ESP_ERR_INVALID_ARG;
+    }
+    rpc_dmx_universe = rpc_dmx_edit;
+    rpc_update_count++;
+    // Only the first update since the last publish schedules the next one.
+    const bool schedule = !rpc_dmx_dirty;
+    rpc_dmx_dirty = true;
+    const int64_t wait_us =
+        rpc_last_publish_us + rpc_period_us - esp_timer_get_time();
+    xSemaphoreGive(rpc_dmx_mutex);
+
+    if (schedule) {
+      schedule_rpc_publish(wait_us);
+    }
+    return ESP_OK;
+  }
 
   // SettingsChangeDelegate
   void on_settings_update(const SettingsHandler &settings) override;
 
 protected:
-  QueueHandle_t get_src_queue() {
-    switch (active_src) {
-    case DmxSourceSink::timo:
-      return timo_interface.tx_queue;
-    case DmxSourceSink::onboard:
-      return onboard_interface.tx_queue;
-    case DmxSourceSink::artnet:
-      return artnet_interface.tx_queue;
-    case DmxSourceSink::none:
-    default:
-      return nullptr;
-    }
+  DmxFrameSlot *get_src_slot(const DmxSourceSink src, const size_t port = 0) {
+    DmxInterface *interface = get_interface(src);
+    return interface == nullptr || port >= interface->port_count
+               ? nullptr
+               : &interface->tx_slots[port];
   }
 
-  QueueHandle_t get_sink_queue() {
-    switch (active_sink) {
-    case DmxSourceSink::timo:
-      return timo_interface.rx_queue;
-    case DmxSourceSink::onboard:
-      return onboard_interface.rx_queue;
-    case DmxSourceSink::artnet:
-      return artnet_interface.rx_queue;
-    case DmxSourceSink::none:
-    default:
-      return nullptr;
+  DmxFrameSlot *get_sink_slot(const DmxSourceSink sink,
+                              const size_t port = 0) {
+    DmxInterface *interface = get_interface(sink);
+    return interface == nullptr || port >= interface->port_count
+               ? nullptr
+               : &interface->rx_slots[port];
+  }
+
+  // The frame waiting on a source port. Taken from the slot on first use in a
+  // dispatch, so every route reading the port sees the same frame; a route
+  // that needs it for itself moves it out.
+  DmxFrameRef &take_src(const DmxSourceSink src, const size_t port = 0);
+  // Drop whatever take_src picked up and nobody moved out.
+  void release_taken();
+
+  // Notification bits for the switcher task.
+  static constexpr uint32_t notify_frame = 0b01;
+  static constexpr uint32_t notify_route = 0b10;
+  static constexpr uint32_t notify_tick = 0b100;
+  // Loss timer callback, runs in the timer service task.
+  static void on_loss_tick(TimerHandle_t timer);
+
+  // Sources the switcher listens to: the active one, plus the merge set.
+  uint32_t get_src_mask() const {
+    uint32_t mask = dmx_source_sink_bit(active_src);
+    if (merge_mode != DmxMergeMode::none) {
+      mask |= merge_srcs;
+    }
+    return mask & ~dmx_source_sink_bit(DmxSourceSink::none);
+  }
+  // Sources whose universe 0 wakes the switcher: the routed ones, or the
+  // whole failover list, plus those the routing table reads.
+  uint32_t get_listen_mask() const {
+    uint32_t mask = pending_routing.get_src_mask();
+    if (merge_mode != DmxMergeMode::none || source_list.empty()) {
+      return mask | get_src_mask();
     }
+    for (const DmxSourceEntry &entry : source_list) {
+      mask |= dmx_source_sink_bit(entry.src);
+    }
+    return mask & ~dmx_source_sink_bit(DmxSourceSink::none);
+  }
+  // Sinks that get frames from the primary route: the active one, plus the
+  // fan-out set, less those the routing table feeds instead.
+  uint32_t get_sink_mask() const {
+    return (dmx_source_sink_bit(active_sink) | fanout_sinks) &
+           ~pending_routing.get_sink_mask() &
+           ~dmx_source_sink_bit(DmxSourceSink::none);
   }
+  // Call with inout_mutex held.
+  void update_src_listeners(const uint32_t old_mask);
+  // Hand the pending routing table's port universes to the interfaces. Call
+  // with inout_mutex held.
+  void update_ports();
+  void publish_to_sinks(DmxFrameRef &&frame, const uint32_t sink_mask);
+  // Returns whether a merged frame was routed.
+  bool dispatch_merged(const uint32_t sink_mask, const uint32_t src_mask,
+                       const bool _output_en, const int64_t now);
+  // Route the active source, or the failover list, when not merging.
+  void dispatch_single(const DmxSourceSink _active_src,
+                       const uint32_t sink_mask, const bool _output_en,
+                       const bool tick, const int64_t now);
+  // Forward the routing table's universes.
+  void dispatch_routes();
+  // Take the waiting frames of the failover list and return the one to route.
+  // src is set to its source when there is one.
+  DmxFrameRef take_failover(const int64_t now, DmxSourceSink &src);
+  // Starts the loss timer while a lost route has a last look to re-publish or
+  // a crossfade is moving, and stops it otherwise. routed says the sinks are
+  // fed from a source at all. Returns how long the switcher may sleep before
+  // the live route would count as lost.
+  TickType_t update_loss_timer(const bool routed, const int64_t now);
+  // Nothing was routed: on a tick, re-publish what the loss policy asks for.
+  void dispatch_loss(const uint32_t sink_mask, const bool tick,
+                     const int64_t now);
+  // Run the patch and curve stages. owned says frame is a private copy the
+  // stages may modify. Returns the processed frame, frame itself if every
+  // stage is straight through, or an empty reference if the pool ran out.
+  DmxFrameRef apply_stages(DmxFrameRef &&frame, bool owned);
+  // Publish the RPC universe now if wait_us has passed, else arm the publish
+  // timer for it.
+  void schedule_rpc_publish(const int64_t wait_us);
+  void publish_rpc_universe();
+  void retry_rpc_publish();
+  static void on_rpc_publish(TimerHandle_t timer);
 
   TaskHandle_t switcher_task;
+  TimerHandle_t loss_timer;
+  // Whether loss_timer is running; only touched by the switcher task.
+  bool loss_ticking = false;
+  std::atomic<uint32_t> wakeup_count{0};
+  std::atomic<uint32_t> dispatch_count{0};
+  std::atomic<uint32_t> merge_expiry_count{0};
+  LatencyHistogram merge_time;
+  LatencyHistogram crossfade_time;
+  LatencyHistogram patch_time;
+  LatencyHistogram curve_time;
 
   SemaphoreHandle_t inout_mutex;
   DmxSourceSink active_src;
   DmxSourceSink active_sink;
   bool output_en;
+  uint32_t fanout_sinks = 0;
+  DmxMergeMode merge_mode = DmxMergeMode::none;
+  uint32_t merge_srcs = 0;
+  // Timeouts set since dispatch last handed them to the merger.
+  std::array<uint32_t, dmx_source_sink_count> merge_timeouts_ms{};
+  uint32_t merge_timeouts_dirty = 0;
+
+  // Compiled by set_patch and set_curves, picked up by the switcher task on
+  // its next dispatch.
+  DmxPatch pending_patch;
+  bool patch_dirty = false;
+  DmxCurveMap pending_curves;
+  bool curves_dirty = false;
+  DmxLossConfig loss_config{.policy = DmxLossPolicy::hold,
+                            .timeout_ms = 1000,
+                            .hold_ms = 3000,
+                            .fade_ms = 2000};
+  bool loss_dirty = true;
+  std::vector<DmxSourceEntry> source_list;
+  bool sources_dirty = false;
+  uint32_t crossfade_ms = 0;
+  std::vector<DmxRoute> route_list;
+  DmxRoutingTable pending_routing;
+  bool routes_dirty = false;
+
+  // Only touched by the switcher task.
+  DmxMerger merger;
+  DmxPatch patch;
+  DmxCurveMap curves;
+  DmxLossHandler loss;
+  DmxFailover failover;
+  DmxCrossfade crossfade;
+  DmxRoutingTable routing;
+  std::array<std::array<DmxFrameRef, dmx_universe_max>, dmx_source_sink_count>
+      taken;
+  std::array<uint32_t, dmx_source_sink_count> taken_ports{};
 
-  DmxInterface timo_interface;
-  DmxInterface onboard_interface;
-  DmxInterface artnet_interface;
+  DmxInterface timo_interface{DmxSourceSink::timo};
+  DmxInterface onboard_interface{DmxSourceSink::onboard};
+  DmxInterface artnet_interface{DmxSourceSink::artnet, dmx_universe_max};
+  DmxInterface playback_interface{DmxSourceSink::playback};
+  DmxInterface sacn_interface{DmxSourceSink::sacn, dmx_universe_max};
   
-  // RPC DMX universe state
+  // RPC DMX universe state, guarded by rpc_dmx_mutex.
   std::array<uint8_t, dmx_packet_size> rpc_dmx_universe;
+  // Scratch copy an update edits before it is committed.
+  std::array<uint8_t, dmx_packet_size> rpc_dmx_edit;
+  // Updated since the last publish; a publish is scheduled while set.
+  bool rpc_dmx_dirty = false;
+  int64_t rpc_last_publish_us = 0;
+  // One full universe at the configured DMX timing. Not guarded, so the
+  // publish timer can read it without the mutex.
+  std::atomic<int64_t> rpc_period_us{
+      dmx_packet_time_us(dmx_packet_size, dmx_timing(DmxTimingProfile::standard))};
   SemaphoreHandle_t rpc_dmx_mutex;
+  TimerHandle_t rpc_timer;
+  std::atomic<uint32_t> rpc_update_count{0};
+  std::atomic<uint32_t> rpc_frame_count{0};
+  std::atomic<uint32_t> rpc_retry_count{0};
 };
@@ -0,0 +1,475 @@
+#include "NetworkSender.h"
+#include "DmxSwitcher.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/def.h"
+#include "lwip/ip.h"
+#include "lwip/netif.h"
+#include "tcpip_call.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+static const char *TAG = "NET_OUT";
+
+static const char source_name[] = "CRMX Bridge";
+static constexpr uint8_t sacn_priority = sacn_priority_default;
+// E1.31 CIDs are UUIDs; ours is a fixed prefix followed by the MAC, so it is
+// stable across reboots and unique per device.
+static constexpr uint8_t cid_prefix[10] = {0x6b, 0x1e, 0x2c, 0x4d, 0x9a,
+                                           0x0f, 0x43, 0x7e, 0x8d, 0x51};
+
+static NetworkSender network_sender;
+
+NetworkSender &NetworkSender::shared() { return network_sender; }
+
+static size_t header_size(const bool sacn) {
+  return sacn ? sizeof(SacnDataHeader) : sizeof(ArtDmxHeader);
+}
+
+// Art-Net data lengths must be even and at least 2; the slots past
+// slot_count are zero.
+static uint16_t artnet_length(const uint16_t slot_count) {
+  return std::max<uint16_t>(2, (slot_count + 1) & ~1);
+}
+
+static uint16_t sacn_flags_length(const size_t length) {
+  return lwip_htons(0x7000 | static_cast<uint16_t>(length));
+}
+
+esp_err_t NetworkSender::init(DmxInterface &_artnet, DmxInterface &_sacn) {
+  interfaces = {&_artnet, &_sacn};
+
+  transmit_done = xSemaphoreCreateBinary();
+  if (transmit_done == nullptr) {
+    ESP_LOGE(TAG, "Could not create semaphore!");
+    return ESP_ERR_NO_MEM;
+  }
+  transmit_msg = tcpip_callbackmsg_new(transmit_cb, this);
+  if (transmit_msg == nullptr) {
+    ESP_LOGE(TAG, "Could not create tcpip message");
+    return ESP_ERR_NO_MEM;
+  }
+
+  // Alongside the wired sink tasks; a send is short and never blocks.
+  bool success = xTaskCreate(task_entry, "net_out", 4096, this, 3, &task);
+  if (!success || task == nullptr) {
+    ESP_LOGE(TAG, "Could not create network output task");
+    return ESP_ERR_INVALID_STATE;
+  }
+  for (DmxInterface *_interface : interfaces) {
+    _interface->set_sink_listener(task, notify_frame);
+  }
+  return ESP_OK;
+}
+
+esp_err_t NetworkSender::start() {
+  if (task == nullptr || running) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  const err_t err = call_on_tcpip(*this, start_cb);
+  if (err != ERR_OK) {
+    ESP_LOGE(TAG, "Could not start network output: %d", err);
+    return ESP_FAIL;
+  }
+  running = true;
+  xTaskNotify(task, notify_settings, eSetBits);
+  ESP_LOGI(TAG, "Transmitting the artnet and sacn sinks");
+  return ESP_OK;
+}
+
+void NetworkSender::stop() {
+  if (!running) {
+    return;
+  }
+  running = false;
+  // Terminates the sACN streams and frees the pbufs.
+  call_on_tcpip(*this, stop_cb);
+}
+
+void NetworkSender::set_destination(const uint32_t ip) {
+  destination.store(ip, std::memory_order_relaxed);
+}
+
+void NetworkSender::on_settings_update(const SettingsHandler &settings) {
+  const uint8_t net = settings.artnet_net;
+  const uint8_t subnet = settings.artnet_subnet;
+  if (net <= 0x7F && subnet <= 0xF) {
+    artnet_base.store(static_cast<uint16_t>(net << 8 | subnet << 4),
+                      std::memory_order_relaxed);
+  }
+  const uint32_t universe = settings.sacn_universe;
+  if (universe >= sacn_universe_min && universe <= sacn_universe_max) {
+    sacn_primary.store(static_cast<uint16_t>(universe),
+                       std::memory_order_relaxed);
+  }
+  set_destination(settings.net_out_dest);
+  // Ports whose wire universe changed move over on the next pass.
+  if (task != nullptr) {
+    xTaskNotify(task, notify_settings, eSetBits);
+  }
+}
+
+NetworkSender::Stats NetworkSender::get_stats() const {
+  return Stats{
+      .frames = frames,
+      .unchanged = unchanged,
+      .changes = changes,
+      .keepalives = keepalives,
+      .terminations = terminations,
+      .unmapped = unmapped,
+      .busy = busy,
+      .send_errors = send_errors,
+  };
+}
+
+err_t NetworkSender::start_cb(NetworkSender &self) {
+  self.pcb = udp_new();
+  if (self.pcb == nullptr) {
+    return ERR_MEM;
+  }
+  ip_set_option(self.pcb, SOF_BROADCAST);
+
+  memcpy(self.cid, cid_prefix, sizeof(cid_prefix));
+  if (netif_default != nullptr) {
+    memcpy(self.cid + sizeof(cid_prefix), netif_default->hwaddr,
+           sizeof(self.cid) - sizeof(cid_prefix));
+  }
+
+  for (size_t p = 0; p < protocol_count; p++) {
+    const Protocol protocol = static_cast<Protocol>(p);
+    for (size_t port = 0; port < dmx_universe_max; port++) {
+      Output &out = self.output(protocol, port);
+      out = Output{};
+      out.buf = pbuf_alloc(
+          PBUF_TRANSPORT,
+          header_size(protocol == Protocol::sacn) + dmx_packet_size, PBUF_RAM);
+      if (out.buf == nullptr) {
+        stop_cb(self);
+        return ERR_MEM;
+      }
+      out.packet = static_cast<uint8_t *>(out.buf->payload);
+      self.fill_header(out, protocol, port);
+    }
+  }
+  return ERR_OK;
+}
+
+err_t NetworkSender::stop_cb(NetworkSender &self) {
+  for (size_t p = 0; p < protocol_count; p++) {
+    const Protocol protocol = static_cast<Protocol>(p);
+    for (Output &out : self.outputs[p]) {
+      if (out.active) {
+        self.retire(out, protocol);
+      }
+      if (out.buf != nullptr) {
+        pbuf_free(out.buf);
+      }
+      out = Output{};
+    }
+  }
+  if (self.pcb != nullptr) {
+    udp_remove(self.pcb);
+    self.pcb = nullptr;
+  }
+  return ERR_OK;
+}
+
+void NetworkSender::transmit_cb(void *ctx) {
+  NetworkSender &self = *static_cast<NetworkSender *>(ctx);
+  // stop() may have run since the sender task posted this.
+  self.next_due_us = self.pcb != nullptr
+                         ? self.transmit(esp_timer_get_time())
+                         : INT64_MAX;
+  xSemaphoreGive(self.transmit_done);
+}
+
+void NetworkSender::task_entry(void *param) {
+  static_cast<NetworkSender *>(param)->run();
+}
+
+void NetworkSender::run() {
+  TickType_t wait = portMAX_DELAY;
+  while (true) {
+    uint32_t notified = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &notified, wait);
+
+    if (!running) {
+      // Hand routed frames straight back to the pool.
+      for (DmxInterface *_interface : interfaces) {
+        for (size_t port = 0; port < _interface->get_port_count(); port++) {
+          _interface->recieve(0, port);
+        }
+      }
+      wait = portMAX_DELAY;
+      continue;
+    }
+
+    if (tcpip_callbackmsg_trycallback(transmit_msg) != ERR_OK) {
+      // The tcpip mailbox is full; try again shortly.
+      wait = 1;
+      continue;
+    }
+    xSemaphoreTake(transmit_done, portMAX_DELAY);
+
+    if (next_due_us == INT64_MAX) {
+      wait = portMAX_DELAY;
+    } else {
+      const int64_t delay_us = next_due_us - esp_timer_get_time();
+      const TickType_t ticks =
+          pdMS_TO_TICKS(static_cast<uint32_t>(std::max<int64_t>(
+              0, (delay_us + 999) / 1000)));
+      wait = std::max<TickType_t>(1, ticks);
+    }
+  }
+}
+
+int64_t NetworkSender::transmit(const int64_t now) {
+  int64_t next_due = INT64_MAX;
+  for (size_t p = 0; p < protocol_count; p++) {
+    const Protocol protocol = static_cast<Protocol>(p);
+    const int64_t keepalive_us =
+        protocol == Protocol::sacn ? sacn_keepalive_us : artnet_keepalive_us;
+    for (size_t port = 0; port < interfaces[p]->get_port_count(); port++) {
+      service(protocol, port, now);
+      const Output &out = outputs[p][port];
+      if (out.pending) {
+        // Waiting for the driver to release the pbuf.
+        next_due = now;
+      } else if (out.active) {
+        next_due = std::min({next_due, out.last_tx_us + keepalive_us,
+                             out.last_frame_us + network_output_idle_us});
+      }
+    }
+  }
+  return next_due;
+}
+
+void NetworkSender::service(const Protocol protocol, const size_t port,
+                            const int64_t now) {
+  Output &out = output(protocol, port);
+  DmxInterface &_interface = interface(protocol);
+  const uint16_t universe = wire_universe(protocol, port);
+
+  if (out.active && (universe != out.universe ||
+                     now - out.last_frame_us >= network_output_idle_us)) {
+    retire(out, protocol);
+  }
+
+  DmxFrameRef frame = _interface.recieve(0, port);
+  if (frame) {
+    frames.fetch_add(1, std::memory_order_relaxed);
+    if (universe == dmx_universe_none) {
+      unmapped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    if (!out.active) {
+      out.active = true;
+      out.universe = universe;
+      out.dirty = true;
+      out.last_tx_us = 0;
+    }
+    out.last_frame_us = now;
+    // Only the latest frame matters; a newer one replaces one still waiting.
+    out.pending = std::move(frame);
+  }
+  if (!out.active) {
+    return;
+  }
+
+  if (out.pending) {
+    if (!load(out, protocol, *out.pending)) {
+      busy.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+
+  if (out.dirty) {
+    send(out, protocol, 0, now);
+    changes.fetch_add(1, std::memory_order_relaxed);
+  } else if (now - out.last_tx_us >=
+             (protocol == Protocol::sacn ? sacn_keepalive_us
+                                         : artnet_keepalive_us)) {
+    // A pbuf still with the driver is refreshed on the next pass.
+    if (out.buf->ref == 1) {
+      send(out, protocol, 0, now);
+      keepalives.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  if (out.pending) {
+    _interface.complete(out.pending, port);
+    out.pending.reset();
+  }
+}
+
+uint16_t NetworkSender::wire_universe(const Protocol protocol,
+                                      const size_t port) const {
+  const uint16_t universe =
+      interfaces[static_cast<size_t>(protocol)]->get_sink_universe(port);
+  if (universe == dmx_universe_none) {
+    return dmx_universe_none;
+  }
+  if (protocol == Protocol::artnet) {
+    return universe < artnet_subnet_universes
+               ? artnet_base.load(std::memory_order_relaxed) + universe
+               : dmx_universe_none;
+  }
+  if (universe == 0) {
+    return sacn_primary.load(std::memory_order_relaxed);
+  }
+  return universe >= sacn_universe_min && universe <= sacn_universe_max
+             ? universe
+             : dmx_universe_none;
+}
+
+bool NetworkSender::load(Output &out, const Protocol protocol,
+                         const DmxPacket &frame) {
+  uint8_t *slots = out.packet + header_size(protocol == Protocol::sacn);
+  const uint16_t slot_count = frame.slot_count;
+  if (slot_count == out.slot_count &&
+      memcmp(slots, frame.full_packet.data.data(), slot_count) == 0) {
+    unchanged.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  // The driver may still be reading the last packet.
+  if (out.buf->ref != 1) {
+    return false;
+  }
+  // Copies the zeroed tail too when the universe shrinks, as Art-Net pads to
+  // an even length.
+  memcpy(slots, frame.full_packet.data.data(),
+         std::max(slot_count, out.slot_count));
+  out.slot_count = slot_count;
+  out.dirty = true;
+  return true;
+}
+
+void NetworkSender::send(Output &out, const Protocol protocol,
+                         const uint8_t options, const int64_t now) {
+  rewind(out, protocol);
+
+  const ip_addr_t to = destination_addr(protocol, out.universe);
+  if (protocol == Protocol::artnet) {
+    ArtDmxHeader &header = *reinterpret_cast<ArtDmxHeader *>(out.packet);
+    // Art-Net sequences run 1-255; 0 would turn reordering checks off.
+    out.sequence = out.sequence % 255 + 1;
+    header.sequence = out.sequence;
+    header.sub_uni = out.universe & 0xFF;
+    header.net = out.universe >> 8;
+  } else {
+    SacnDataHeader &header = *reinterpret_cast<SacnDataHeader *>(out.packet);
+    header.sequence = out.sequence++;
+    header.options = options;
+    header.universe = lwip_htons(out.universe);
+  }
+
+  const err_t err = udp_sendto(
+      pcb, out.buf, &to,
+      protocol == Protocol::sacn ? sacn_port : artnet_port);
+  if (err != ERR_OK) {
+    send_errors.fetch_add(1, std::memory_order_relaxed);
+  }
+  out.dirty = false;
+  out.last_tx_us = now;
+}
+
+void NetworkSender::retire(Output &out, const Protocol protocol) {
+  out.active = false;
+  out.dirty = false;
+  out.pending.reset();
+  terminations.fetch_add(1, std::memory_order_relaxed);
+  if (protocol != Protocol::sacn || out.last_tx_us == 0) {
+    return;
+  }
+
+  // Receivers drop the source at once instead of timing it out. The stream's
+  // pbuf is likely still with the driver after the first of these, so each
+  // goes out as a copy; this is the only path that allocates.
+  const uint16_t length = sizeof(SacnDataHeader) + out.slot_count;
+  const ip_addr_t to = destination_addr(protocol, out.universe);
+  for (size_t i = 0; i < sacn_terminate_count; i++) {
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, length, PBUF_RAM);
+    if (p == nullptr) {
+      send_errors.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    pbuf_take(p, out.packet, length);
+    SacnDataHeader &header = *static_cast<SacnDataHeader *>(p->payload);
+    header.sequence = out.sequence++;
+    header.options = sacn_options_terminated;
+    if (udp_sendto(pcb, p, &to, sacn_port) != ERR_OK) {
+      send_errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    pbuf_free(p);
+  }
+}
+
+ip_addr_t NetworkSender::destination_addr(const Protocol protocol,
+                                          const uint16_t universe) const {
+  const uint32_t unicast = destination.load(std::memory_order_relaxed);
+  if (unicast != 0) {
+    const ip_addr_t addr = IPADDR4_INIT(lwip_htonl(unicast));
+    return addr;
+  }
+  if (protocol == Protocol::artnet) {
+    return *IP_ADDR_BROADCAST;
+  }
+  const ip4_addr_t group = sacn_group(universe);
+  const ip_addr_t addr = IPADDR4_INIT(ip4_addr_get_u32(&group));
+  return addr;
+}
+
+void NetworkSender::rewind(Output &out, const Protocol protocol) {
+  uint16_t length;
+  if (protocol == Protocol::artnet) {
+    const uint16_t data_length = artnet_length(out.slot_count);
+    ArtDmxHeader &header = *reinterpret_cast<ArtDmxHeader *>(out.packet);
+    header.length_hi = data_length >> 8;
+    header.length_lo = data_length & 0xFF;
+    length = sizeof(ArtDmxHeader) + data_length;
+  } else {
+    SacnDataHeader &header = *reinterpret_cast<SacnDataHeader *>(out.packet);
+    length = sizeof(SacnDataHeader) + out.slot_count;
+    header.root_flags_length =
+        sacn_flags_length(length - offsetof(SacnDataHeader, root_flags_length));
+    header.frame_flags_length = sacn_flags_length(
+        length - offsetof(SacnDataHeader, frame_flags_length));
+    header.dmp_flags_length =
+        sacn_flags_length(length - offsetof(SacnDataHeader, dmp_flags_length));
+    header.property_count = lwip_htons(out.slot_count + 1);
+  }
+  // A single PBUF_RAM pbuf owned by us alone, so its length may be set
+  // directly within what was allocated.
+  out.buf->payload = out.packet;
+  out.buf->len = length;
+  out.buf->tot_len = length;
+}
+
+void NetworkSender::fill_header(Output &out, const Protocol protocol,
+                                const size_t port) {
+  memset(out.packet, 0, header_size(protocol == Protocol::sacn) +
+                            dmx_packet_size);
+  if (protocol == Protocol::artnet) {
+    ArtDmxHeader &header = *reinterpret_cast<ArtDmxHeader *>(out.packet);
+    memcpy(header.header.id, artnet_id, sizeof(artnet_id));
+    header.header.op_code = artnet_op_dmx;
+    header.prot_ver_lo = artnet_protocol_version;
+    header.physical = static_cast<uint8_t>(port);
+    return;
+  }
+
+  SacnDataHeader &header = *reinterpret_cast<SacnDataHeader *>(out.packet);
+  header.preamble_size = lwip_htons(sacn_preamble_size);
+  memcpy(header.acn_id, sacn_acn_id, sizeof(sacn_acn_id));
+  header.root_vector = lwip_htonl(sacn_vector_root_data);
+  memcpy(header.cid, cid, sizeof(cid));
+  header.frame_vector = lwip_htonl(sacn_vector_frame_data);
+  snprintf(header.source_name, sizeof(header.source_name), "%s", source_name);
+  header.priority = sacn_priority;
+  header.dmp_vector = sacn_vector_dmp_set_property;
+  header.address_data_type = sacn_address_data_type;
+  header.address_increment = lwip_htons(1);
+  header.start_code = 0;
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "ArtNetReceiver.h"
+#include "DmxFramePool.h"
+#include "SacnReceiver.h"
+#include "SettingsHandler.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "lwip/ip_addr.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcpip.h"
+#include "lwip/udp.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class DmxInterface;
+
+// Unchanged levels are re-sent this often: at 1 Hz for sACN, whose receivers
+// give up on a source after 2.5 s, and every 4 s for Art-Net.
+static constexpr int64_t sacn_keepalive_us = 1000 * 1000;
+static constexpr int64_t artnet_keepalive_us = 4000 * 1000;
+// A sink port nothing was routed to for this long stops transmitting. Long
+// enough to ride out an Art-Net source's own 4 s refresh.
+static constexpr int64_t network_output_idle_us = 10 * 1000 * 1000;
+// E1.31 asks for three stream-terminated packets when a source stops.
+static constexpr size_t sacn_terminate_count = 3;
+
+/**
+ * @brief Transmits the artnet and sacn sinks as Art-Net and sACN.
+ *
+ * Sink ports map to wire universes the way the receivers map them on the way
+ * in: port 0 is universe 0 of the configured Art-Net net and sub-net, and the
+ * primary sACN universe; any other port is the universe its route writes.
+ *
+ * A port only transmits when its levels change, plus a keep-alive refresh, so
+ * airtime follows the rate of change rather than the source's frame rate.
+ * Each port owns a pbuf allocated at start with its header filled in once.
+ * Frames are compared against the slots of the last packet sent and copied
+ * over them in place, so the steady state allocates nothing. The sender task
+ * waits for frames and deadlines and hands each batch to the tcpip thread
+ * through a preallocated callback message; the pbufs and output state are only
+ * touched there.
+ */
+class NetworkSender : public SettingsChangeDelegate {
+public:
+  struct Stats {
+    // Frames picked up from the sinks.
+    uint32_t frames;
+    // Frames with the same levels as the last packet sent.
+    uint32_t unchanged;
+    // Packets sent because levels changed, and refreshes of unchanged ones.
+    uint32_t changes;
+    uint32_t keepalives;
+    // Ports that stopped transmitting.
+    uint32_t terminations;
+    // Frames for a universe Art-Net or sACN cannot carry.
+    uint32_t unmapped;
+    // Changes held back because the driver still had the last packet.
+    uint32_t busy;
+    uint32_t send_errors;
+  };
+
+  static NetworkSender &shared();
+
+  // Creates the sender task. Frames routed to the sinks are dropped until
+  // start().
+  esp_err_t init(DmxInterface &_artnet, DmxInterface &_sacn);
+  // The network stack must be initialised.
+  esp_err_t start();
+  void stop();
+
+  // Thread-safe. ip is in host byte order; 0 broadcasts Art-Net and
+  // multicasts sACN.
+  void set_destination(const uint32_t ip);
+  Stats get_stats() const;
+
+  void on_settings_update(const SettingsHandler &settings) override;
+
+protected:
+  enum class Protocol : uint8_t { artnet, sacn };
+  static constexpr size_t protocol_count = 2;
+
+  static constexpr uint32_t notify_frame = 0b01;
+  static constexpr uint32_t notify_settings = 0b10;
+
+  struct Output {
+    struct pbuf *buf;
+    // Where the packet starts in buf. Sending may leave buf's payload on the
+    // headers lwIP prepended, so it is rewound before every write.
+    uint8_t *packet;
+    bool active;
+    // Levels changed since the last packet sent.
+    bool dirty;
+    // Wire universe the port transmits on while active.
+    uint16_t universe;
+    uint16_t slot_count;
+    uint8_t sequence;
+    int64_t last_tx_us;
+    int64_t last_frame_us;
+    // A changed frame waiting for buf to be released by the driver.
+    DmxFrameRef pending;
+  };
+
+  static err_t start_cb(NetworkSender &self);
+  static err_t stop_cb(NetworkSender &self);
+  static void transmit_cb(void *ctx);
+  static void task_entry(void *param);
+  void run();
+
+  // Only called on the tcpip thread.
+  // Services every port and returns when the next keep-alive or idle check
+  // is due.
+  int64_t transmit(const int64_t now);
+  void service(const Protocol protocol, const size_t port, const int64_t now);
+  // The wire universe port carries, or dmx_universe_none.
+  uint16_t wire_universe(const Protocol protocol, const size_t port) const;
+  // Copies frame's levels into out's packet if they differ. Returns false if
+  // they differ but the packet is still held by the driver.
+  bool load(Output &out, const Protocol protocol, const DmxPacket &frame);
+  void send(Output &out, const Protocol protocol, const uint8_t options,
+            const int64_t now);
+  void retire(Output &out, const Protocol protocol);
+  // Sets out's packet length for slot_count slots and rewinds its pbuf.
+  void rewind(Output &out, const Protocol protocol);
+  void fill_header(Output &out, const Protocol protocol, const size_t port);
+  // Unicast if a destination is set, else Art-Net broadcast or the sACN
+  // universe's multicast group.
+  ip_addr_t destination_addr(const Protocol protocol,
+                             const uint16_t universe) const;
+  DmxInterface &interface(const Protocol protocol) {
+    return *interfaces[static_cast<size_t>(protocol)];
+  }
+  Output &output(const Protocol protocol, const size_t port) {
+    return outputs[static_cast<size_t>(protocol)][port];
+  }
+
+  std::array<DmxInterface *, protocol_count> interfaces{};
+  TaskHandle_t task = nullptr;
+  struct tcpip_callback_msg *transmit_msg = nullptr;
+  SemaphoreHandle_t transmit_done = nullptr;
+  std::atomic<bool> running{false};
+  // Written by the tcpip thread for the sender task.
+  int64_t next_due_us = 0;
+
+  struct udp_pcb *pcb = nullptr;
+  // Port address of Art-Net universe 0, i.e. net << 8 | sub-net << 4.
+  std::atomic<uint16_t> artnet_base{0};
+  std::atomic<uint16_t> sacn_primary{sacn_universe_min};
+  // Host byte order; 0 for broadcast and multicast.
+  std::atomic<uint32_t> destination{0};
+  // E1.31 component identifier, derived from the MAC at start.
+  uint8_t cid[16] = {};
+
+  // Only touched by the tcpip thread.
+  std::array<std::array<Output, dmx_universe_max>, protocol_count> outputs{};
+
+  std::atomic<uint32_t> frames{0};
+  std::atomic<uint32_t> unchanged{0};
+  std::atomic<uint32_t> changes{0};
+  std::atomic<uint32_t> keepalives{0};
+  std::atomic<uint32_t> terminations{0};
+  std::atomic<uint32_t> unmapped{0};
+  std::atomic<uint32_t> busy{0};
+  std::atomic<uint32_t> send_errors{0};
+};
@@ -0,0 +1,359 @@
+#include "SacnReceiver.h"
+#include "DmxMerge.h"
+#include "DmxSwitcher.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/def.h"
+#include "lwip/igmp.h"
+#include "lwip/timeouts.h"
+#include "tcpip_call.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+
+static const char *TAG = "SACN";
+
+// A sequence this far behind the last one is a restarted source, not a
+// reordered packet (E1.31 6.7.2).
+static constexpr int8_t sacn_sequence_window = 20;
+
+static SacnReceiver sacn_receiver;
+
+SacnReceiver &SacnReceiver::shared() { return sacn_receiver; }
+
+esp_err_t SacnReceiver::start(DmxInterface &_interface) {
+  if (interface != nullptr) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  interface = &_interface;
+
+  const err_t err = call_on_tcpip(*this, start_cb);
+  if (err != ERR_OK) {
+    ESP_LOGE(TAG, "Could not bind port %" PRIu16 ": %d", sacn_port, err);
+    interface = nullptr;
+    return ESP_FAIL;
+  }
+  ESP_LOGI(TAG, "Listening on port %" PRIu16, sacn_port);
+  return ESP_OK;
+}
+
+void SacnReceiver::stop() {
+  if (interface == nullptr) {
+    return;
+  }
+  // Once this returns no callback can still be using the interface.
+  call_on_tcpip(*this, stop_cb);
+  interface = nullptr;
+}
+
+err_t SacnReceiver::start_cb(SacnReceiver &self) {
+  self.pcb = udp_new();
+  if (self.pcb == nullptr) {
+    return ERR_MEM;
+  }
+  const err_t err = udp_bind(self.pcb, IP_ADDR_ANY, sacn_port);
+  if (err != ERR_OK) {
+    udp_remove(self.pcb);
+    self.pcb = nullptr;
+    return err;
+  }
+  udp_recv(self.pcb, recv_cb, &self);
+
+  self.universes = {};
+  self.update_memberships();
+  sys_timeout(housekeeping_ms, housekeeping_cb, &self);
+  return ERR_OK;
+}
+
+err_t SacnReceiver::stop_cb(SacnReceiver &self) {
+  sys_untimeout(housekeeping_cb, &self);
+  for (Universe &universe : self.universes) {
+    if (universe.joined != 0) {
+      const ip4_addr_t group = sacn_group(universe.joined);
+      igmp_leavegroup(IP4_ADDR_ANY4, &group);
+      universe.joined = 0;
+    }
+  }
+  self.groups_joined = 0;
+  if (self.pcb != nullptr) {
+    udp_remove(self.pcb);
+    self.pcb = nullptr;
+  }
+  return ERR_OK;
+}
+
+esp_err_t SacnReceiver::set_primary_universe(const uint16_t universe) {
+  if (universe < sacn_universe_min || universe > sacn_universe_max) {
+    ESP_LOGE(TAG, "Invalid universe %" PRIu16, universe);
+    return ESP_ERR_INVALID_ARG;
+  }
+  primary_universe.store(universe, std::memory_order_relaxed);
+  return ESP_OK;
+}
+
+void SacnReceiver::on_settings_update(const SettingsHandler &settings) {
+  set_primary_universe(static_cast<uint16_t>(settings.sacn_universe.get()));
+  primary_in_use.store(settings.is_primary_input(DmxSourceSink::sacn),
+                       std::memory_order_relaxed);
+}
+
+SacnReceiver::Stats SacnReceiver::get_stats() const {
+  return Stats{
+      .packets = packets,
+      .dmx_frames = dmx_frames,
+      .filtered = filtered,
+      .out_of_order = out_of_order,
+      .malformed = malformed,
+      .ignored = ignored,
+      .sources_terminated = sources_terminated,
+      .sources_expired = sources_expired,
+      .sources_rejected = sources_rejected,
+      .groups_joined = groups_joined,
+      .no_frame = no_frame,
+      .parse_time = parse_time.summarize(),
+  };
+}
+
+uint16_t SacnReceiver::sacn_universe(const size_t port) const {
+  if (port == 0) {
+    return primary_in_use.load(std::memory_order_relaxed)
+               ? primary_universe.load(std::memory_order_relaxed)
+               : 0;
+  }
+  const uint16_t universe = interface->get_src_universe(port);
+  if (universe < sacn_universe_min || universe > sacn_universe_max) {
+    return 0;
+  }
+  return universe;
+}
+
+void SacnReceiver::update_memberships() {
+  uint32_t joined = 0;
+  for (size_t port = 0; port < universes.size(); port++) {
+    Universe &universe = universes[port];
+    const uint16_t want =
+        port < interface->get_port_count() ? sacn_universe(port) : 0;
+    if (universe.number != want) {
+      universe.number = 0;
+      for (Source &source : universe.sources) {
+        source.active = false;
+      }
+    }
+    if (universe.joined != want) {
+      if (universe.joined != 0) {
+        const ip4_addr_t group = sacn_group(universe.joined);
+        igmp_leavegroup(IP4_ADDR_ANY4, &group);
+        ESP_LOGI(TAG, "Left universe %" PRIu16, universe.joined);
+      }
+      universe.joined = 0;
+      if (want != 0) {
+        const ip4_addr_t group = sacn_group(want);
+        const err_t err = igmp_joingroup(IP4_ADDR_ANY4, &group);
+        if (err == ERR_OK) {
+          universe.joined = want;
+          ESP_LOGI(TAG, "Joined universe %" PRIu16, want);
+        } else {
+          ESP_LOGE(TAG, "Could not join universe %" PRIu16 ": %d", want, err);
+        }
+      }
+    }
+    joined += universe.joined != 0;
+  }
+  groups_joined = joined;
+}
+
+void SacnReceiver::expire_sources(const int64_t now) {
+  for (size_t port = 0; port < universes.size(); port++) {
+    bool expired = false;
+    for (Source &source : universes[port].sources) {
+      if (source.active &&
+          now - source.last_seen_us >= sacn_source_timeout_us) {
+        source.active = false;
+        expired = true;
+        sources_expired.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    // Hand over to whoever is left straight away rather than on their next
+    // packet.
+    if (expired) {
+      render(port, now);
+    }
+  }
+}
+
+void SacnReceiver::housekeeping_cb(void *arg) {
+  SacnReceiver &self = *static_cast<SacnReceiver *>(arg);
+  self.expire_sources(esp_timer_get_time());
+  self.update_memberships();
+  sys_timeout(housekeeping_ms, housekeeping_cb, &self);
+}
+
+void SacnReceiver::recv_cb(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+                           const ip_addr_t *addr, u16_t port) {
+  SacnReceiver &self = *static_cast<SacnReceiver *>(arg);
+  const int64_t start_us = esp_timer_get_time();
+  self.packets.fetch_add(1, std::memory_order_relaxed);
+  self.handle_data(p, start_us);
+  pbuf_free(p);
+}
+
+SacnReceiver::Source *SacnReceiver::find_source(Universe &universe,
+                                                const uint8_t *cid) {
+  for (Source &source : universe.sources) {
+    if (source.active && memcmp(source.cid, cid, sizeof(source.cid)) == 0) {
+      return &source;
+    }
+  }
+  return nullptr;
+}
+
+void SacnReceiver::handle_data(const struct pbuf *p, const int64_t start_us) {
+  SacnDataHeader header;
+  if (pbuf_copy_partial(p, &header, sizeof(header), 0) != sizeof(header) ||
+      lwip_ntohs(header.preamble_size) != sacn_preamble_size ||
+      memcmp(header.acn_id, sacn_acn_id, sizeof(sacn_acn_id)) != 0) {
+    malformed.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  // Synchronisation and discovery packets carry no levels.
+  if (lwip_ntohl(header.root_vector) != sacn_vector_root_data) {
+    ignored.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  const uint16_t property_count = lwip_ntohs(header.property_count);
+  if (lwip_ntohl(header.frame_vector) != sacn_vector_frame_data ||
+      header.dmp_vector != sacn_vector_dmp_set_property ||
+      header.address_data_type != sacn_address_data_type ||
+      lwip_ntohs(header.first_address) != 0 ||
+      lwip_ntohs(header.address_increment) != 1 || property_count == 0 ||
+      property_count > dmx_packet_size + 1 ||
+      p->tot_len < sizeof(header) - 1 + property_count ||
+      header.priority > sacn_priority_max) {
+    malformed.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  const uint16_t number = lwip_ntohs(header.universe);
+  size_t port = 0;
+  while (port < interface->get_port_count() && sacn_universe(port) != number) {
+    port++;
+  }
+  if (number == 0 || port == interface->get_port_count()) {
+    filtered.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  Universe &universe = universes[port];
+  if (universe.number != number) {
+    // The port was given another universe; its sources no longer apply.
+    universe.number = number;
+    for (Source &source : universe.sources) {
+      source.active = false;
+    }
+  }
+
+  Source *source = find_source(universe, header.cid);
+  if (header.options & sacn_options_terminated) {
+    if (source != nullptr) {
+      source->active = false;
+      sources_terminated.fetch_add(1, std::memory_order_relaxed);
+      render(port, start_us);
+    }
+    return;
+  }
+  if ((header.options & sacn_options_preview) || header.start_code != 0) {
+    ignored.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  if (source == nullptr) {
+    auto free_source =
+        std::find_if(universe.sources.begin(), universe.sources.end(),
+                     [](const Source &s) { return !s.active; });
+    if (free_source == universe.sources.end()) {
+      sources_rejected.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    source = &*free_source;
+    source->active = true;
+    memcpy(source->cid, header.cid, sizeof(source->cid));
+    source->slot_count = 0;
+    source->levels.fill(0);
+  } else {
+    const int8_t ahead = static_cast<int8_t>(header.sequence - source->sequence);
+    if (ahead <= 0 && ahead > -sacn_sequence_window) {
+      out_of_order.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+
+  const uint16_t slot_count = property_count - 1;
+  source->sequence = header.sequence;
+  source->priority = header.priority;
+  source->last_seen_us = start_us;
+  pbuf_copy_partial(p, source->levels.data(), slot_count, sizeof(header));
+  if (slot_count < source->slot_count) {
+    memset(source->levels.data() + slot_count, 0,
+           source->slot_count - slot_count);
+  }
+  source->slot_count = slot_count;
+
+  // A source below the winning priority changes nothing.
+  for (const Source &other : universe.sources) {
+    if (other.active && other.priority > source->priority) {
+      return;
+    }
+  }
+  if (render(port, start_us)) {
+    parse_time.record(esp_timer_get_time() - start_us);
+  }
+}
+
+bool SacnReceiver::render(const size_t port, const int64_t rx_us) {
+  const Universe &universe = universes[port];
+  uint8_t top = 0;
+  size_t winners = 0;
+  for (const Source &source : universe.sources) {
+    if (!source.active) {
+      continue;
+    }
+    if (winners == 0 || source.priority > top) {
+      top = source.priority;
+      winners = 1;
+    } else if (source.priority == top) {
+      winners++;
+    }
+  }
+  if (winners == 0) {
+    return false;
+  }
+
+  DmxFrameRef frame = DmxFramePool::shared().acquire();
+  if (!frame) {
+    no_frame.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  uint8_t *data = frame->full_packet.data.data();
+  uint16_t slot_count = 0;
+  bool first = true;
+  for (const Source &source : universe.sources) {
+    if (!source.active || source.priority != top) {
+      continue;
+    }
+    if (first) {
+      memcpy(data, source.levels.data(), dmx_packet_size);
+      first = false;
+    } else {
+      dmx_merge_htp(data, source.levels.data(), source.slot_count);
+    }
+    slot_count = std::max(slot_count, source.slot_count);
+  }
+
+  frame->source = DmxSourceSink::sacn;
+  frame->universe = port == 0 ? 0 : interface->get_src_universe(port);
+  frame->slot_count = std::max<uint16_t>(slot_count, 1);
+  frame->times = DmxFrameTimes{.rx_us = rx_us, .dispatch_us = 0};
+  frame->full_packet.start_code = 0;
+  interface->send(std::move(frame));
+  dmx_frames.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "DmxFramePool.h"
+#include "DmxLatency.h"
+#include "SettingsHandler.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "lwip/ip_addr.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class DmxInterface;
+
+static constexpr uint16_t sacn_port = 5568;
+static constexpr uint16_t sacn_universe_min = 1;
+static constexpr uint16_t sacn_universe_max = 63999;
+// Sources tracked per universe; further ones are ignored until one leaves.
+static constexpr size_t sacn_sources_max = 4;
+// E1.31 network data loss timeout.
+static constexpr int64_t sacn_source_timeout_us = 2500 * 1000;
+static constexpr uint8_t sacn_priority_default = 100;
+static constexpr uint8_t sacn_priority_max = 200;
+
+static constexpr char sacn_acn_id[12] = {'A', 'S', 'C', '-', 'E', '1',
+                                         '.', '1', '7', 0,   0,   0};
+static constexpr uint16_t sacn_preamble_size = 0x0010;
+static constexpr uint8_t sacn_address_data_type = 0xA1;
+static constexpr uint32_t sacn_vector_root_data = 0x00000004;
+static constexpr uint32_t sacn_vector_frame_data = 0x00000002;
+static constexpr uint8_t sacn_vector_dmp_set_property = 0x02;
+static constexpr uint8_t sacn_options_preview = 0x80;
+static constexpr uint8_t sacn_options_terminated = 0x40;
+
+// Root, framing and DMP layers of an E1.31 data packet, up to the property
+// values. Multi-byte fields are big endian.
+struct __attribute__((packed)) SacnDataHeader {
+  uint16_t preamble_size;
+  uint16_t postamble_size;
+  char acn_id[12];
+  uint16_t root_flags_length;
+  uint32_t root_vector;
+  uint8_t cid[16];
+  uint16_t frame_flags_length;
+  uint32_t frame_vector;
+  char source_name[64];
+  uint8_t priority;
+  uint16_t sync_address;
+  uint8_t sequence;
+  uint8_t options;
+  uint16_t universe;
+  uint16_t dmp_flags_length;
+  uint8_t dmp_vector;
+  uint8_t address_data_type;
+  uint16_t first_address;
+  uint16_t address_increment;
+  // The START code and the slots.
+  uint16_t property_count;
+  uint8_t start_code;
+};
+static_assert(sizeof(SacnDataHeader) == 126);
+
+// Multicast group of a universe: 239.255.hi.lo.
+static inline ip4_addr_t sacn_group(const uint16_t universe) {
+  ip4_addr_t group;
+  IP4_ADDR(&group, 239, 255, universe >> 8, universe & 0xFF);
+  return group;
+}
+
+/**
+ * @brief sACN (E1.31) receiver feeding the sacn DmxInterface.
+ *
+ * Like the Art-Net receiver it runs on lwIP's raw UDP API in the tcpip thread.
+ * It joins the multicast group of each universe the switcher routes from the
+ * sacn interface, and leaves groups once nothing routes them. Port 0 carries
+ * the configured primary sACN universe; every other routed universe is the
+ * sACN universe of the same number.
+ *
+ * Each universe has a fixed table of sources. A packet's slots are copied
+ * straight from the pbuf into its source's entry, so parsing never allocates.
+ * The highest priority wins, equal priorities merge HTP, and a source drops
+ * out when it terminates its stream or after 2.5 s of silence. Only packets
+ * from a winning source produce a frame, so a universe is published at the
+ * rate its winners send.
+ */
+class SacnReceiver : public SettingsChangeDelegate {
+public:
+  struct Stats {
+    uint32_t packets;
+    uint32_t dmx_frames;
+    // Data for a universe nothing routes.
+    uint32_t filtered;
+    uint32_t out_of_order;
+    uint32_t malformed;
+    // Preview data, or a START code other than 0.
+    uint32_t ignored;
+    uint32_t sources_terminated;
+    uint32_t sources_expired;
+    // Sources that found their universe's table full.
+    uint32_t sources_rejected;
+    uint32_t groups_joined;
+    uint32_t no_frame;
+    // Time from the callback being entered to the frame being published.
+    LatencyHistogram::Summary parse_time;
+  };
+
+  static SacnReceiver &shared();
+
+  // Binds the sACN port. The network stack must be initialised.
+  esp_err_t start(DmxInterface &_interface);
+  void stop();
+
+  // Thread-safe. Takes effect on the next membership check.
+  esp_err_t set_primary_universe(const uint16_t universe);
+  Stats get_stats() const;
+
+  void on_settings_update(const SettingsHandler &settings) override;
+
+protected:
+  // How often memberships and source timeouts are checked.
+  static constexpr uint32_t housekeeping_ms = 250;
+
+  struct Source {
+    bool active;
+    uint8_t cid[16];
+    uint8_t priority;
+    uint8_t sequence;
+    uint16_t slot_count;
+    int64_t last_seen_us;
+    alignas(4) std::array<uint8_t, dmx_packet_size> levels;
+  };
+
+  struct Universe {
+    // sACN universe the port's table belongs to; 0 if none.
+    uint16_t number;
+    uint16_t joined;
+    std::array<Source, sacn_sources_max> sources;
+  };
+
+  static err_t start_cb(SacnReceiver &self);
+  static err_t stop_cb(SacnReceiver &self);
+  static void recv_cb(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+                      const ip_addr_t *addr, u16_t port);
+  static void housekeeping_cb(void *arg);
+
+  // Only called on the tcpip thread.
+  void handle_data(const struct pbuf *p, const int64_t start_us);
+  // The sACN universe port carries, or 0.
+  uint16_t sacn_universe(const size_t port) const;
+  void update_memberships();
+  void expire_sources(const int64_t now);
+  Source *find_source(Universe &universe, const uint8_t *cid);
+  // Publishes the merge of the winning sources; returns false if there are
+  // none.
+  bool render(const size_t port, const int64_t rx_us);
+
+  DmxInterface *interface = nullptr;
+  struct udp_pcb *pcb = nullptr;
+  std::atomic<uint16_t> primary_universe{sacn_universe_min};
+  // Whether anything reads the sacn interface's universe 0, so the primary
+  // universe is worth joining.
+  std::atomic<bool> primary_in_use{false};
+
+  // Only touched by the tcpip thread.
+  std::array<Universe, dmx_universe_max> universes{};
+
+  std::atomic<uint32_t> packets{0};
+  std::atomic<uint32_t> dmx_frames{0};
+  std::atomic<uint32_t> filtered{0};
+  std::atomic<uint32_t> out_of_order{0};
+  std::atomic<uint32_t> malformed{0};
+  std::atomic<uint32_t> ignored{0};
+  std::atomic<uint32_t> sources_terminated{0};
+  std::atomic<uint32_t> sources_expired{0};
+  std::atomic<uint32_t> sources_rejected{0};
+  std::atomic<uint32_t> groups_joined{0};
+  std::atomic<uint32_t> no_frame{0};
+  LatencyHistogram parse_time;
+};
@@ -53,6 +53,23 @@ void SettingsHandler::init() {
     output_en.write(output_en.default_val);
     input.write(input.default_val);
     output.write(output.default_val);
+    fanout_sinks.write(fanout_sinks.default_val);
+    merge_mode.write(merge_mode.default_val);
+    merge_srcs.write(merge_srcs.default_val);
+    patch.write(patch.default_val);
+    curves.write(curves.default_val);
+    loss_policy.write(loss_policy.default_val);
+    loss_timeout_ms.write(loss_timeout_ms.default_val);
+    loss_hold_ms.write(loss_hold_ms.default_val);
+    loss_fade_ms.write(loss_fade_ms.default_val);
+    source_list.write(source_list.default_val);
+    crossfade_ms.write(crossfade_ms.default_val);
+    routes.write(routes.default_val);
+    dmx_timing.write(dmx_timing.default_val);
+    artnet_net.write(artnet_net.default_val);
+    artnet_subnet.write(artnet_subnet.default_val);
+    sacn_universe.write(sacn_universe.default_val);
+    net_out_dest.write(net_out_dest.default_val);
     tmo_opt_pwr.write(tmo_opt_pwr.default_val);
     rf_protocol.write(rf_protocol.default_val);
     univ_clr_r.write(univ_clr_r.default_val);
@@ -81,6 +98,23 @@ void SettingsHandler::read_all() {
   READ_SETTING(output_en);
   READ_SETTING(input);
   READ_SETTING(output);
+  READ_SETTING(fanout_sinks);
+  READ_SETTING(merge_mode);
+  READ_SETTING(merge_srcs);
+  READ_SETTING(patch);
+  READ_SETTING(curves);
+  READ_SETTING(loss_policy);
+  READ_SETTING(loss_timeout_ms);
+  READ_SETTING(loss_hold_ms);
+  READ_SETTING(loss_fade_ms);
+  READ_SETTING(source_list);
+  READ_SETTING(crossfade_ms);
+  READ_SETTING(routes);
+  READ_SETTING(dmx_timing);
+  READ_SETTING(artnet_net);
+  READ_SETTING(artnet_subnet);
+  READ_SETTING(sacn_universe);
+  READ_SETTING(net_out_dest);
   READ_SETTING(tmo_opt_pwr);
   READ_SETTING(rf_protocol);
   READ_SETTING(univ_clr_r);
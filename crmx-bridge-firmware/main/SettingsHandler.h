@@ -1,6 +1,11 @@
 #pragma once
 
 #include "Color.h"
+#include "DmxCurves.h"
+#include "DmxFailover.h"
+#include "DmxLoss.h"
+#include "DmxPatch.h"
+#include "DmxRouting.h"
 #include "TimoReg.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
@@ -9,6 +14,7 @@
 #include "nvs_handle.hpp"
 #include "util.h"
 #include <algorithm>
+#include <array>
 #include <cstring>
 #include <vector>
 
@@ -52,6 +58,48 @@ public:
     return err;
   }
 
+  // len is the buffer size on entry and the stored size on return.
+  esp_err_t read_blob(const char *const key, void *buf, size_t &len) {
+    if (!is_init || !nvs_handle) {
+      ESP_LOGE(TAG, "Read called before storage is initialized!");
+      return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    size_t stored_len = 0;
+    esp_err_t err =
+        nvs_handle->get_item_size(nvs::ItemType::BLOB, key, stored_len);
+    if (err == ESP_OK && stored_len > len) {
+      err = ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    if (err == ESP_OK) {
+      err = nvs_handle->get_blob(key, buf, stored_len);
+    }
+    if (err != ESP_OK) {
+      ESP_LOGE(TAG, "Error (%s) reading key %s!\n", esp_err_to_name(err), key);
+      return err;
+    }
+    len = stored_len;
+    return err;
+  }
+
+  esp_err_t write_blob(const char *const key, const void *buf,
+                       const size_t len) {
+    if (!is_init || !nvs_handle) {
+      ESP_LOGE(TAG, "Write called before storage is initialized!");
+      return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    esp_err_t err = nvs_handle->set_blob(key, buf, len);
+    if (err != ESP_OK) {
+      ESP_LOGE(TAG, "Error (%s) setting key %s!\n", esp_err_to_name(err), key);
+      return err;
+    }
+    err = nvs_handle->commit();
+    if (err != ESP_OK) {
+      ESP_LOGE(TAG, "Error (%s) committing write to key %s!\n",
+               esp_err_to_name(err), key);
+    }
+    return err;
+  }
+
 private:
   bool is_init = false;
 
@@ -69,21 +117,9 @@ template <typename _T> struct Setting {
     assert(strlen(key) < 15);
   }
 
-  esp_err_t read() {
-    T val_before = val;
-    esp_err_t res = handler.infra.read(key, val);
-    if (val_before != val) {
-      handler.notify_delegates();
-    }
-    return res;
-  }
-  esp_err_t write(const T _val) {
-    esp_err_t res = handler.infra.write(key, _val);
-    if (res == ESP_OK) {
-      val = _val;
-    }
-    return res;
-  }
+  // Defined after SettingsHandler, which they reach into.
+  esp_err_t read();
+  esp_err_t write(const T _val);
 
   T get() const { return val; }
   operator const T &() const { return val; }
@@ -96,6 +132,34 @@ protected:
   SettingsHandler &handler;
 };
 
+/**
+ * A setting holding up to max_len trivially copyable items, stored as one
+ * NVS blob.
+ */
+template <typename _T, size_t max_len> struct ListSetting {
+  using T = _T;
+  static_assert(std::is_trivially_copyable_v<T>);
+
+  ListSetting(SettingsHandler &_handler, const char *const _key)
+      : key(_key), default_val(), val(), handler(_handler) {
+    assert(strlen(key) < 15);
+  }
+
+  // Defined after SettingsHandler, which they reach into.
+  esp_err_t read();
+  esp_err_t write(const std::vector<T> &_val);
+
+  const std::vector<T> &get() const { return val; }
+  operator const std::vector<T> &() const { return val; }
+
+  const char *const key;
+  const std::vector<T> default_val;
+
+protected:
+  std::vector<T> val;
+  SettingsHandler &handler;
+};
+
 struct SettingsChangeDelegate {
   virtual void on_settings_update(const SettingsHandler &settings) = 0;
 };
@@ -104,6 +168,23 @@ class SettingsHandler {
   static constexpr const char *output_en_key = "output_en";
   static constexpr const char *input_key = "input";
   static constexpr const char *output_key = "output";
+  static constexpr const char *fanout_key = "fanout";
+  static constexpr const char *merge_mode_key = "merge_mode";
+  static constexpr const char *merge_srcs_key = "merge_srcs";
+  static constexpr const char *patch_key = "patch";
+  static constexpr const char *curves_key = "curves";
+  static constexpr const char *loss_policy_key = "loss_policy";
+  static constexpr const char *loss_tmo_key = "loss_tmo_ms";
+  static constexpr const char *loss_hold_key = "loss_hold_ms";
+  static constexpr const char *loss_fade_key = "loss_fade_ms";
+  static constexpr const char *source_list_key = "src_list";
+  static constexpr const char *crossfade_key = "xfade_ms";
+  static constexpr const char *routes_key = "routes";
+  static constexpr const char *dmx_timing_key = "dmx_timing";
+  static constexpr const char *artnet_net_key = "artnet_net";
+  static constexpr const char *artnet_subnet_key = "artnet_sub";
+  static constexpr const char *sacn_universe_key = "sacn_univ";
+  static constexpr const char *net_out_dest_key = "net_out_dest";
   static constexpr const char *timo_opt_pwr_key = "timo_opt_pwr";
   static constexpr const char *timo_rf_prot_key = "timo_rf_prot";
   static constexpr const char *univ_clr_r_key = "univ_clr_r";
@@ -120,6 +201,21 @@ public:
       : output_en(*this, output_en_key, false),
         input(*this, input_key, DmxSourceSink::none),
         output(*this, output_key, DmxSourceSink::none),
+        fanout_sinks(*this, fanout_key, 0),
+        merge_mode(*this, merge_mode_key, DmxMergeMode::none),
+        merge_srcs(*this, merge_srcs_key, 0), patch(*this, patch_key),
+        curves(*this, curves_key),
+        loss_policy(*this, loss_policy_key, DmxLossPolicy::hold),
+        loss_timeout_ms(*this, loss_tmo_key, 1000),
+        loss_hold_ms(*this, loss_hold_key, 3000),
+        loss_fade_ms(*this, loss_fade_key, 2000),
+        source_list(*this, source_list_key),
+        crossfade_ms(*this, crossfade_key, 0), routes(*this, routes_key),
+        dmx_timing(*this, dmx_timing_key, DmxTimingProfile::standard),
+        artnet_net(*this, artnet_net_key, 0),
+        artnet_subnet(*this, artnet_subnet_key, 0),
+        sacn_universe(*this, sacn_universe_key, 1),
+        net_out_dest(*this, net_out_dest_key, 0),
         tmo_opt_pwr(*this, timo_opt_pwr_key, RFPowerT::PWR_3_MW),
         rf_protocol(*this, timo_rf_prot_key, RfProtocolT::CRMX),
         univ_clr_r(*this, univ_clr_r_key, RGBColor::Red().red),
@@ -180,16 +276,57 @@ public:
   }
 
   // Computed setting values
+  bool is_output(const DmxSourceSink sink) const {
+    return output.get() == sink ||
+           (fanout_sinks.get() & dmx_source_sink_bit(sink)) != 0 ||
+           std::any_of(routes.get().begin(), routes.get().end(),
+                       [sink](const DmxRoute &route) {
+                         return route.sink == sink;
+                       });
+  }
+
+  bool is_input(const DmxSourceSink src) const {
+    return is_primary_input(src) ||
+           std::any_of(routes.get().begin(), routes.get().end(),
+                       [src](const DmxRoute &route) {
+                         return route.src == src;
+                       });
+  }
+
+  // Whether universe 0 of src is read, by the primary route or a table route.
+  bool is_primary_input(const DmxSourceSink src) const {
+    return input.get() == src ||
+           (merge_mode.get() != DmxMergeMode::none &&
+            (merge_srcs.get() & dmx_source_sink_bit(src)) != 0) ||
+           std::any_of(source_list.get().begin(), source_list.get().end(),
+                       [src](const DmxSourceEntry &entry) {
+                         return entry.src == src;
+                       }) ||
+           std::any_of(routes.get().begin(), routes.get().end(),
+                       [src](const DmxRoute &route) {
+                         return route.src == src && route.src_universe == 0;
+                       });
+  }
+
+  DmxLossConfig get_loss_config() const {
+    return DmxLossConfig{
+        .policy = loss_policy.get(),
+        .timeout_ms = loss_timeout_ms.get(),
+        .hold_ms = loss_hold_ms.get(),
+        .fade_ms = loss_fade_ms.get(),
+    };
+  }
+
   TxRxT get_timo_tx_rx() const {
-    if (output.get() == DmxSourceSink::timo) {
+    if (is_output(DmxSourceSink::timo)) {
       return TxRxT::TX;
     }
     return TxRxT::RX;
   }
 
   bool get_timo_radio_en() const {
-    if (output_en.get() && (output.get() == DmxSourceSink::timo ||
-                            input.get() == DmxSourceSink::timo)) {
+    if (output_en.get() && (is_output(DmxSourceSink::timo) ||
+                            is_input(DmxSourceSink::timo))) {
       return true;
     }
     return false;
@@ -207,6 +344,38 @@ public:
   Setting<bool> output_en;
   Setting<DmxSourceSink> input;
   Setting<DmxSourceSink> output;
+  // Extra outputs fed alongside output, and extra sources merged with input,
+  // as masks of dmx_source_sink_bit.
+  Setting<uint8_t> fanout_sinks;
+  Setting<DmxMergeMode> merge_mode;
+  Setting<uint8_t> merge_srcs;
+  // Channel patch applied to everything the switcher routes.
+  ListSetting<DmxPatchRule, dmx_patch_max_rules> patch;
+  // Per-channel response curves applied after the patch.
+  ListSetting<DmxCurveRule, dmx_curve_max_rules> curves;
+  // What the switcher outputs once its input goes quiet.
+  Setting<DmxLossPolicy> loss_policy;
+  Setting<uint32_t> loss_timeout_ms;
+  Setting<uint32_t> loss_hold_ms;
+  Setting<uint32_t> loss_fade_ms;
+  // Prioritised sources the switcher fails over between.
+  ListSetting<DmxSourceEntry, dmx_source_list_max> source_list;
+  // Crossfade time when the routed source changes; 0 cuts.
+  Setting<uint32_t> crossfade_ms;
+  // Further universes routed alongside input and output.
+  ListSetting<DmxRoute, dmx_route_max> routes;
+  // Break and mark after break of the wired output.
+  Setting<DmxTimingProfile> dmx_timing;
+  // Art-Net net (0-127) and sub-net (0-15) the receiver listens on and the
+  // sender transmits to.
+  Setting<uint8_t> artnet_net;
+  Setting<uint8_t> artnet_subnet;
+  // sACN universe the receiver maps to universe 0 of the sacn source, and
+  // the sender to universe 0 of the sacn sink.
+  Setting<uint32_t> sacn_universe;
+  // IPv4 address (host byte order) the network outputs unicast to; 0
+  // broadcasts Art-Net and multicasts sACN.
+  Setting<uint32_t> net_out_dest;
   // Timo Settings
   Setting<RFPowerT> tmo_opt_pwr;
   Setting<RfProtocolT> rf_protocol;
@@ -229,7 +398,64 @@ protected:
 
   friend class Setting<bool>;
   friend class Setting<DmxSourceSink>;
+  friend class Setting<DmxMergeMode>;
+  friend class Setting<DmxLossPolicy>;
+  friend class Setting<DmxTimingProfile>;
   friend class Setting<RFPowerT>;
   friend class Setting<RfProtocolT>;
   friend class Setting<uint8_t>;
+  friend class Setting<uint32_t>;
+  friend class ListSetting<DmxPatchRule, dmx_patch_max_rules>;
+  friend class ListSetting<DmxCurveRule, dmx_curve_max_rules>;
+  friend class ListSetting<DmxSourceEntry, dmx_source_list_max>;
+  friend class ListSetting<DmxRoute, dmx_route_max>;
 };
+
+template <typename _T> esp_err_t Setting<_T>::read() {
+  T val_before = val;
+  esp_err_t res = handler.infra.read(key, val);
+  if (val_before != val) {
+    handler.notify_delegates();
+  }
+  return res;
+}
+
+template <typename _T> esp_err_t Setting<_T>::write(const T _val) {
+  esp_err_t res = handler.infra.write(key, _val);
+  if (res == ESP_OK) {
+    val = _val;
+  }
+  return res;
+}
+
+template <typename _T, size_t max_len>
+esp_err_t ListSetting<_T, max_len>::read() {
+  std::array<T, max_len> buf;
+  size_t len = sizeof(buf);
+  esp_err_t res = handler.infra.read_blob(key, buf.data(), len);
+  if (res != ESP_OK) {
+    return res;
+  }
+  std::vector<T> val_read(buf.begin(), buf.begin() + len / sizeof(T));
+  if (!std::equal(val.begin(), val.end(), val_read.begin(), val_read.end(),
+                  [](const T &a, const T &b) {
+                    return memcmp(&a, &b, sizeof(T)) == 0;
+                  })) {
+    val = std::move(val_read);
+    handler.notify_delegates();
+  }
+  return res;
+}
+
+template <typename _T, size_t max_len>
+esp_err_t ListSetting<_T, max_len>::write(const std::vector<T> &_val) {
+  if (_val.size() > max_len) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  esp_err_t res =
+      handler.infra.write_blob(key, _val.data(), _val.size() * sizeof(T));
+  if (res == ESP_OK) {
+    val = _val;
+  }
+  return res;
+}
@@ -1,8 +1,11 @@
 #include "TimoInterface.h"
+#include "esp_attr.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include <algorithm>
+#include <inttypes.h>
 
 #define INIT_GUARD()                                                           \
   do {                                                                         \
@@ -21,14 +24,44 @@ bool TimoInterface::is_ready() {
   return is_init && !gpio_get_level(hw_config.nirq_pin);
 }
 
+void IRAM_ATTR TimoInterface::nirq_isr_handler(void *arg) {
+  TimoInterface *timo = static_cast<TimoInterface *>(arg);
+  BaseType_t higher_prio_woken = pdFALSE;
+  timo->irq_edges.fetch_add(1, std::memory_order_relaxed);
+  xSemaphoreGiveFromISR(timo->irq_sem, &higher_prio_woken);
+  TaskHandle_t listener = timo->irq_listener;
+  if (listener != nullptr) {
+    xTaskNotifyFromISR(listener, timo->irq_listener_bits, eSetBits,
+                       &higher_prio_woken);
+  }
+  portYIELD_FROM_ISR(higher_prio_woken);
+}
+
 bool TimoInterface::wait_for_ready(const int64_t timeout_ms) {
-  int64_t start_time = esp_timer_get_time();
-  while (!is_ready()) {
-    vTaskDelay(1);
-    if (esp_timer_get_time() - start_time > timeout_ms * 1000) {
+  const int64_t start_time = esp_timer_get_time();
+  const int64_t timeout_us = timeout_ms * 1000;
+
+  // Fast path: spin for the usual sub-tick response.
+  while (irq_edges.load(std::memory_order_relaxed) == cmd_edge_mark ||
+         !is_ready()) {
+    const int64_t elapsed_us = esp_timer_get_time() - start_time;
+    if (elapsed_us < ready_busy_wait_us) {
+      continue;
+    }
+
+    // Slow path: sleep until the falling edge. A give left over from an
+    // earlier edge only costs one extra pass through the loop.
+    if (elapsed_us > timeout_us) {
+      stats.ready_timeouts++;
       return false;
     }
+    stats.irq_sleeps++;
+    const TickType_t remaining =
+        pdMS_TO_TICKS((timeout_us - elapsed_us) / 1000) + 1;
+    xSemaphoreTake(irq_sem, remaining);
   }
+
+  stats.ready_wait.record(esp_timer_get_time() - start_time);
   return true;
 }
 
@@ -55,14 +88,17 @@ esp_err_t TimoInterface::send_cmd(const SpiCmd cmd, const uint8_t addr) {
   t.user = (void *)0;
   t.flags = SPI_TRANS_USE_TXDATA;
 
+  arm_ready();
   return ESP_ERROR_CHECK_WITHOUT_ABORT(spi_device_transmit(handle, &t));
 }
 
 esp_err_t TimoInterface::transact_spi(const bool write, const uint8_t addr,
-                                      const size_t len) {
+                                      const size_t len, const bool log_errors) {
   // Check params
   INIT_GUARD();
 
+  const int64_t start_time = esp_timer_get_time();
+
   if (len > max_reg_size) {
     ESP_LOGE(TAG, "Requested register size %zu is more than the maximum(%zu)",
              len, max_reg_size);
@@ -78,9 +114,11 @@ esp_err_t TimoInterface::transact_spi(const bool write, const uint8_t addr,
 
   // Wait for device ready for remainder of transaction.
   if (!wait_for_ready(transaction_timeout_ms)) {
-    std::string readwrite_str = write ? "write" : "read";
-    ESP_LOGE(TAG, "Timed out waiting for %s CMD response, addr 0x%x",
-             readwrite_str.c_str(), addr);
+    if (log_errors) {
+      std::string readwrite_str = write ? "write" : "read";
+      ESP_LOGE(TAG, "Timed out waiting for %s CMD response, addr 0x%x",
+               readwrite_str.c_str(), addr);
+    }
     return ESP_ERR_TIMEOUT;
   }
 
@@ -97,6 +135,7 @@ esp_err_t TimoInterface::transact_spi(const bool write, const uint8_t addr,
 
   // TODO: check IRQ SPI device busy flag and return an error if it's high
 
+  stats.reg_transaction.record(esp_timer_get_time() - start_time);
   return ESP_OK;
 }
 
@@ -113,96 +152,203 @@ esp_err_t TimoInterface::init(const spi_host_device_t bus) {
     return ret;
   }
 
+  irq_sem = xSemaphoreCreateBinary();
+  if (irq_sem == nullptr) {
+    ESP_LOGE(TAG, "Could not create nIRQ semaphore");
+    return ESP_ERR_NO_MEM;
+  }
+
+  // nIRQ falling edge means the device is ready for the rest of a transaction
+  // (or has an interrupt pending).
   gpio_config_t timo_io_conf = {
       .pin_bit_mask = (1ULL << hw_config.nirq_pin),
       .mode = GPIO_MODE_INPUT,
       .pull_up_en = GPIO_PULLUP_DISABLE,
       .pull_down_en = GPIO_PULLDOWN_DISABLE,
-      .intr_type = GPIO_INTR_DISABLE,
+      .intr_type = GPIO_INTR_NEGEDGE,
   };
   ret = ESP_ERROR_CHECK_WITHOUT_ABORT(gpio_config(&timo_io_conf));
   if (ret != ESP_OK) {
     return ret;
   }
 
+  // The ISR service is shared with other drivers and may already be running.
+  ret = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+  if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+    ESP_LOGE(TAG, "Could not install GPIO ISR service: %s",
+             esp_err_to_name(ret));
+    return ret;
+  }
+  ret = ESP_ERROR_CHECK_WITHOUT_ABORT(
+      gpio_isr_handler_add(hw_config.nirq_pin, nirq_isr_handler, this));
+  if (ret != ESP_OK) {
+    return ret;
+  }
+
+  // The bus rounds the requested clock down to what it can divide to.
+  int actual_freq_khz = 0;
+  if (spi_device_get_actual_freq(handle, &actual_freq_khz) == ESP_OK) {
+    ESP_LOGI(TAG, "SPI clock %d kHz (requested %d kHz)", actual_freq_khz,
+             hw_config.spi_devcfg.clock_speed_hz / 1000);
+  }
+
   is_init = true;
   return ESP_OK;
 }
 
-esp_err_t TimoInterface::set_sw_config(const TimoSoftwareConfig &_sw_config) {
-  static_assert(pdMS_TO_TICKS(10) > 2, "tick rate must be > 200Hz");
+esp_err_t TimoInterface::read_config_regs() {
+  // Everything set_sw_config() writes. Each read lands in the shadow.
+  CONFIG config;
+  RF_PROTOCOL rf_protocol;
+  RF_POWER rf_power;
+  UNIVERSE_COLOR universe_color;
+  DEVICE_NAME device_name;
+  DMX_SPEC dmx_spec;
+  DMX_WINDOW dmx_window;
+  IRQ_MASK irq_mask;
+  DMX_CONTROL dmx_control;
+  for (esp_err_t read_res :
+       {read_reg(config), read_reg(rf_protocol), read_reg(rf_power),
+        read_reg(universe_color), read_reg(device_name), read_reg(dmx_spec),
+        read_reg(dmx_window), read_reg(irq_mask), read_reg(dmx_control)}) {
+    if (read_res != ESP_OK) {
+      return read_res;
+    }
+  }
+  return ESP_OK;
+}
 
+esp_err_t TimoInterface::read_back_state() {
   INIT_GUARD();
 
+  // The module powers up alongside us, so poll until it answers at all.
+  CONFIG config;
+  esp_err_t res = ESP_ERR_TIMEOUT;
+  const int64_t start_time = esp_timer_get_time();
+  while (esp_timer_get_time() - start_time < boot_timeout_ms * 1000) {
+    res = read_reg(config, /* log_errors */ false);
+    if (res == ESP_OK) {
+      break;
+    }
+    vTaskDelay(reboot_poll_period);
+  }
+  if (res != ESP_OK) {
+    ESP_LOGE(TAG, "Module did not answer within %" PRId64 " ms",
+             boot_timeout_ms);
+    return res;
+  }
+
+  res = read_config_regs();
+  if (res != ESP_OK) {
+    return res;
+  }
+
+  RF_PROTOCOL rf_protocol;
+  RF_POWER rf_power;
+  UNIVERSE_COLOR universe_color;
+  DEVICE_NAME device_name;
+  shadow_get(rf_protocol);
+  shadow_get(rf_power);
+  shadow_get(universe_color);
+  shadow_get(device_name);
+
+  sw_config.radio_en = config.get(CONFIG::RADIO_ENABLE);
+  sw_config.tx_rx_mode = static_cast<CONFIG::RADIO_TX_RX_MODE_T>(
+      config.get(CONFIG::RADIO_TX_RX_MODE));
+  sw_config.rf_protocol = static_cast<RF_PROTOCOL::TX_PROTOCOL_T>(
+      rf_protocol.get(RF_PROTOCOL::TX_PROTOCOL));
+  sw_config.rf_power = static_cast<RF_POWER::OUTPUT_POWER_T>(
+      rf_power.get(RF_POWER::OUTPUT_POWER));
+  sw_config.universe_color = RGBColor{
+      .red = universe_color.get(UNIVERSE_COLOR::RED),
+      .green = universe_color.get(UNIVERSE_COLOR::GREEN),
+      .blue = universe_color.get(UNIVERSE_COLOR::BLUE),
+  };
+  sw_config.device_name.assign(
+      reinterpret_cast<const char *>(device_name.data.data()),
+      strnlen(reinterpret_cast<const char *>(device_name.data.data()),
+              device_name.data.size()));
+
+  ESP_LOGI(TAG, "Module answered after %" PRId64 " ms",
+           (esp_timer_get_time() - start_time) / 1000);
+  return ESP_OK;
+}
+
+esp_err_t TimoInterface::set_sw_config(const TimoSoftwareConfig &_sw_config) {
+  INIT_GUARD();
+
+  // Every write below is skipped when the register shadow already holds the
+  // value, so re-applying an unchanged config costs no SPI traffic.
   esp_err_t res = ESP_OK;
 
   CONFIG config;
   config.set(CONFIG::RADIO_ENABLE, _sw_config.radio_en)
       .set(CONFIG::RADIO_TX_RX_MODE, _sw_config.tx_rx_mode)
       .set(CONFIG::UART_EN, false);
-  // Writing the config register may cause a reboot, give it time...
-  res = ESP_ERROR_CHECK_WITHOUT_ABORT(write_reg(config, /* verify */ true, /* verify_delay */pdMS_TO_TICKS(2000)));
+  // Writing the config register may cause a reboot.
+  res = ESP_ERROR_CHECK_WITHOUT_ABORT(write_reboot_reg(config));
   if (res != ESP_OK) {
     return res;
   }
   sw_config.radio_en = _sw_config.radio_en;
   sw_config.tx_rx_mode = _sw_config.tx_rx_mode;
 
-  vTaskDelay(pdMS_TO_TICKS(10));
-
-  // Writing the rf_protocol register may cause a reboot, give it time...
-  res = ESP_ERROR_CHECK_WITHOUT_ABORT(write_reg(config, /* verify */ true, /* verify_delay */pdMS_TO_TICKS(2000)));
+  // Writing the rf_protocol register may cause a reboot.
+  RF_PROTOCOL rf_protocol;
+  rf_protocol.set(RF_PROTOCOL::TX_PROTOCOL, _sw_config.rf_protocol);
+  res = ESP_ERROR_CHECK_WITHOUT_ABORT(write_reboot_reg(rf_protocol));
   if (res != ESP_OK) {
     return res;
   }
-
-  vTaskDelay(pdMS_TO_TICKS(10));
+  sw_config.rf_protocol = _sw_config.rf_protocol;
 
   res = set_rf_power(_sw_config.rf_power);
   if (res != ESP_OK) {
     return res;
   }
 
-  vTaskDelay(pdMS_TO_TICKS(10));
-
   res = set_universe_color(_sw_config.universe_color);
   if (res != ESP_OK) {
     return res;
   }
 
-  vTaskDelay(pdMS_TO_TICKS(10));
-
   res = set_device_name(_sw_config.device_name);
   if (res != ESP_OK) {
     return res;
   }
 
-  vTaskDelay(pdMS_TO_TICKS(10));
-
-  // For now, assert DMX spec to default
-  DMX_SPEC dmx_spec;
-  dmx_spec.set(DMX_SPEC::N_CHANNELS_MSB, 0x02)
-      .set(DMX_SPEC::N_CHANNELS_LSB, 0x0)
-      .set(DMX_SPEC::INTERSLOT_TIME_MSB, 0x0)
-      .set(DMX_SPEC::INTERSLOT_TIME_LSB, 0x0)
-      .set(DMX_SPEC::REFRESH_PERIOD_MSB, 0x0)
-      .set(DMX_SPEC::REFRESH_PERIOD_B2, 0x0)
-      .set(DMX_SPEC::REFRESH_PERIOD_B1, 0x61)
-      .set(DMX_SPEC::REFRESH_PERIOD_LSB, 0xA8);
-  res = ESP_ERROR_CHECK_WITHOUT_ABORT(write_reg(dmx_spec));
+  res = write_dmx_spec();
   if (res != ESP_OK) {
     return res;
   }
 
-  //   vTaskDelay(pdMS_TO_TICKS(10));
-
   //   res =
   //   ESP_ERROR_CHECK_WITHOUT_ABORT(set_dmx_source(sw_config.dmx_source)); if
   //   (res != ESP_OK) {
   //     return res;
   //   }
 
-  vTaskDelay(pdMS_TO_TICKS(10));
+  // In RX mode, interrupt on every received frame and read the whole
+  // universe. In TX mode nIRQ only signals transaction readiness.
+  const bool rx_mode = _sw_config.tx_rx_mode == CONFIG::RADIO_TX_RX_MODE_T::RX;
+  if (rx_mode) {
+    DMX_WINDOW dmx_window;
+    dmx_window.set(DMX_WINDOW::WINDOW_SIZE_MSB, dmx_rx_window_size >> 8)
+        .set(DMX_WINDOW::WINDOW_SIZE_LSB, dmx_rx_window_size & 0xFF)
+        .set(DMX_WINDOW::START_ADDRESS_MSB, 0x0)
+        .set(DMX_WINDOW::START_ADDRESS_LSB, 0x0);
+    res = ESP_ERROR_CHECK_WITHOUT_ABORT(write_reg(dmx_window));
+    if (res != ESP_OK) {
+      return res;
+    }
+  }
+
+  IRQ_MASK irq_mask;
+  irq_mask.set(IRQ_MASK::RX_DMX_IRQ_EN, rx_mode);
+  res = ESP_ERROR_CHECK_WITHOUT_ABORT(write_reg(irq_mask));
+  if (res != ESP_OK) {
+    return res;
+  }
 
   // Finally, enable internal DMX from SPI
   DMX_CONTROL dmx_control;
@@ -212,7 +358,8 @@ esp_err_t TimoInterface::set_sw_config(const TimoSoftwareConfig &_sw_config) {
     return res;
   }
 
-  vTaskDelay(pdMS_TO_TICKS(10));
+  // A reboot above may have reset the DMX generation buffer.
+  dmx_frames_since_refresh = dmx_full_refresh_frames;
 
   return ESP_OK;
 }
@@ -371,51 +518,212 @@ TimoInterface::get_dmx_source(TIMO::DMX_SOURCE::DATA_SOURCE_T &dmx_source) {
   return ESP_OK;
 }
 
-esp_err_t TimoInterface::write_dmx(const std::array<uint8_t, 512> &data) {
+esp_err_t TimoInterface::read_irq_flags(IRQ_FLAGS &flags) {
+  INIT_GUARD();
+
+  return ESP_ERROR_CHECK_WITHOUT_ABORT(read_reg(flags));
+}
 
-  static constexpr size_t block_size = 128;
-  static constexpr size_t num_blocks = 4;
+esp_err_t TimoInterface::read_dmx(uint8_t *rx_buf) {
+  INIT_GUARD();
+
+  if (rx_buf == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  const int64_t start_time = esp_timer_get_time();
+
+  esp_err_t ret = send_cmd(SpiCmd::READ_DMX);
+  if (ret != ESP_OK) {
+    return ret;
+  }
+
+  // Wait for device ready for remainder of transaction.
+  if (!wait_for_ready(transaction_timeout_ms)) {
+    ESP_LOGE(TAG, "Timed out waiting for READ_DMX response");
+    return ESP_ERR_TIMEOUT;
+  }
+
+  // The whole window comes back in one payload, straight into the caller's
+  // buffer.
+  spi_transaction_t t;
+  memset(&t, 0, sizeof(t));
+  t.length = 8 * (dmx_rx_window_size + 1);
+  t.tx_buffer = nullptr;
+  t.rx_buffer = rx_buf;
+
+  ret = ESP_ERROR_CHECK_WITHOUT_ABORT(spi_device_transmit(handle, &t));
+  if (ret != ESP_OK) {
+    return ret;
+  }
+
+  stats.dmx_read.record(esp_timer_get_time() - start_time);
+  return ESP_OK;
+}
+
+esp_err_t TimoInterface::wait_for_trans(const spi_transaction_t *expected) {
+  // Results come back in queue order, so drain until the expected one.
+  spi_transaction_t *done = nullptr;
+  do {
+    esp_err_t ret = ESP_ERROR_CHECK_WITHOUT_ABORT(spi_device_get_trans_result(
+        handle, &done, pdMS_TO_TICKS(transaction_timeout_ms)));
+    if (ret != ESP_OK) {
+      return ret;
+    }
+  } while (done != expected);
+  return ESP_OK;
+}
+
+esp_err_t TimoInterface::set_dmx_slot_count(const uint16_t slot_count) {
+  INIT_GUARD();
+  if (slot_count == 0 || slot_count > dmx_shadow.size()) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (slot_count == dmx_slot_count) {
+    return ESP_OK;
+  }
+  const uint16_t old_slot_count = dmx_slot_count;
+  dmx_slot_count = slot_count;
+  const esp_err_t res = write_dmx_spec();
+  if (res != ESP_OK) {
+    dmx_slot_count = old_slot_count;
+  }
+  return res;
+}
+
+esp_err_t TimoInterface::write_dmx_spec() {
+  // Refresh as fast as a packet of this length allows; a short universe
+  // refreshes several times faster than a full one.
+  const uint32_t refresh_us = dmx_packet_time_us(
+      dmx_slot_count, dmx_timing(DmxTimingProfile::standard));
+  DMX_SPEC dmx_spec;
+  dmx_spec.set(DMX_SPEC::N_CHANNELS_MSB, dmx_slot_count >> 8)
+      .set(DMX_SPEC::N_CHANNELS_LSB, dmx_slot_count & 0xFF)
+      .set(DMX_SPEC::INTERSLOT_TIME_MSB, 0x0)
+      .set(DMX_SPEC::INTERSLOT_TIME_LSB, 0x0)
+      .set(DMX_SPEC::REFRESH_PERIOD_MSB, refresh_us >> 24)
+      .set(DMX_SPEC::REFRESH_PERIOD_B2, (refresh_us >> 16) & 0xFF)
+      .set(DMX_SPEC::REFRESH_PERIOD_B1, (refresh_us >> 8) & 0xFF)
+      .set(DMX_SPEC::REFRESH_PERIOD_LSB, refresh_us & 0xFF);
+  return ESP_ERROR_CHECK_WITHOUT_ABORT(write_reg(dmx_spec));
+}
+
+esp_err_t TimoInterface::write_dmx(const std::array<uint8_t, 512> &data,
+                                   const size_t slot_count) {
 
   static_assert(
-      std::tuple_size_v<std::remove_reference_t<decltype(data)>> / block_size ==
-          num_blocks &&
-      std::tuple_size_v<std::remove_reference_t<decltype(data)>> % block_size ==
-          0);
+      std::tuple_size_v<std::remove_reference_t<decltype(data)>> /
+                  dmx_block_size ==
+              dmx_num_blocks &&
+          std::tuple_size_v<std::remove_reference_t<decltype(data)>> %
+                  dmx_block_size ==
+              0);
 
   // Check params
   INIT_GUARD();
 
-  SpiTxRxBuf<block_size> tx_buf;
+  const int64_t start_time = esp_timer_get_time();
+
+  // WRITE_DMX has no start address: every write fills the generation buffer
+  // from slot 0 in command order. Unchanged blocks can therefore only be
+  // skipped at the end of the universe, so send up to the last dirty block.
+  // Blocks past the universe length are never sent.
+  const size_t used_blocks =
+      std::min((slot_count + dmx_block_size - 1) / dmx_block_size,
+               dmx_num_blocks);
+  size_t num_blocks = 0;
+  dmx_frames_since_refresh++;
+  if (dmx_frames_since_refresh >= dmx_full_refresh_frames) {
+    num_blocks = used_blocks;
+  } else {
+    for (size_t block_idx = used_blocks; block_idx > 0; block_idx--) {
+      const size_t offset = (block_idx - 1) * dmx_block_size;
+      if (memcmp(&data[offset], &dmx_shadow[offset], dmx_block_size) != 0) {
+        num_blocks = block_idx;
+        break;
+      }
+    }
+  }
+
+  stats.dmx_blocks_skipped += used_blocks - num_blocks;
+  if (num_blocks == 0) {
+    stats.dmx_write.record(esp_timer_get_time() - start_time);
+    return ESP_OK;
+  }
+
+  // Stage every block up front so each payload can be queued the moment the
+  // device is ready for it.
+  for (size_t block_idx = 0; block_idx < num_blocks; block_idx++) {
+    SpiTxRxBuf<dmx_block_size> &buf = dmx_tx_bufs[block_idx];
+    buf.prep_tx();
+    memcpy(buf.data.data(), &(data.data()[block_idx * dmx_block_size]),
+           dmx_block_size);
+
+    spi_transaction_t &cmd = dmx_cmd_trans[block_idx];
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.length = 8;
+    cmd.tx_data[0] = static_cast<uint8_t>(SpiCmd::WRITE_DMX);
+    cmd.flags = SPI_TRANS_USE_TXDATA;
+
+    spi_transaction_t &payload = dmx_data_trans[block_idx];
+    memset(&payload, 0, sizeof(payload));
+    payload.length = 8 * buf.spi_transaction_size(dmx_block_size);
+    payload.tx_buffer = buf.raw();
+    payload.rx_buffer = nullptr;
+  }
 
+  // Each block's command sits in the queue behind the previous payload, so
+  // the payload DMA overlaps with the next command instead of being waited on
+  // (and slept after) on its own.
+  esp_err_t ret = ESP_OK;
+  size_t queued_payloads = 0;
   for (size_t block_idx = 0; block_idx < num_blocks; block_idx++) {
-    esp_err_t ret = send_cmd(SpiCmd::WRITE_DMX);
+    arm_ready();
+    ret = ESP_ERROR_CHECK_WITHOUT_ABORT(spi_device_queue_trans(
+        handle, &dmx_cmd_trans[block_idx], portMAX_DELAY));
     if (ret != ESP_OK) {
-      return ret;
+      break;
+    }
+
+    // The device only answers a command once it has been clocked out.
+    ret = wait_for_trans(&dmx_cmd_trans[block_idx]);
+    if (ret != ESP_OK) {
+      break;
     }
 
     // Wait for device ready for remainder of transaction.
     if (!wait_for_ready(transaction_timeout_ms)) {
       ESP_LOGE(TAG, "Timed out waiting for DMX CMD response");
-      return ESP_ERR_TIMEOUT;
+      ret = ESP_ERR_TIMEOUT;
+      break;
     }
 
-    tx_buf.prep_tx();
-    memcpy(tx_buf.data.data(), &(data.data()[block_idx * block_size]),
-           block_size);
-
-    spi_transaction_t t;
-    memset(&t, 0, sizeof(t));
-    t.length = 8 * tx_buf.spi_transaction_size(block_size);
-    t.tx_buffer = tx_buf.raw();
-    t.rx_buffer = nullptr;
-
-    ret = ESP_ERROR_CHECK_WITHOUT_ABORT(spi_device_transmit(handle, &t));
+    ret = ESP_ERROR_CHECK_WITHOUT_ABORT(spi_device_queue_trans(
+        handle, &dmx_data_trans[block_idx], portMAX_DELAY));
     if (ret != ESP_OK) {
-      return ret;
+      break;
     }
+    queued_payloads = block_idx + 1;
+  }
 
-    vTaskDelay(pdMS_TO_TICKS(1));
+  // Leave the queue empty for the blocking register transactions.
+  if (queued_payloads > 0) {
+    esp_err_t drain_ret = wait_for_trans(&dmx_data_trans[queued_payloads - 1]);
+    if (ret == ESP_OK) {
+      ret = drain_ret;
+    }
+  }
+  if (ret != ESP_OK) {
+    // The device buffer is now unknown, resend everything next time.
+    dmx_frames_since_refresh = dmx_full_refresh_frames;
+    return ret;
   }
 
+  memcpy(dmx_shadow.data(), data.data(), num_blocks * dmx_block_size);
+  if (num_blocks == used_blocks) {
+    dmx_frames_since_refresh = 0;
+  }
+  stats.dmx_blocks_written += num_blocks;
+  stats.dmx_write.record(esp_timer_get_time() - start_time);
   return ESP_OK;
 }
@@ -5,7 +5,13 @@
 #include "driver/gpio.h"
 #include "driver/spi_master.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "util.h"
 #include <array>
+#include <atomic>
+#include <bitset>
 #include <cstring>
 #include <string>
 
@@ -58,6 +64,48 @@ struct TimoStatus {
   }
 };
 
+/**
+ * Count, total and worst case of a timed operation, in microseconds.
+ */
+struct TimoTimingStats {
+  uint32_t count;
+  uint64_t total_us;
+  uint32_t max_us;
+
+  void record(const int64_t duration_us) {
+    const uint32_t us = duration_us < 0 ? 0 : static_cast<uint32_t>(duration_us);
+    count++;
+    total_us += us;
+    if (us > max_us) {
+      max_us = us;
+    }
+  }
+
+  uint32_t avg_us() const {
+    return count == 0 ? 0 : static_cast<uint32_t>(total_us / count);
+  }
+};
+
+struct TimoStats {
+  // Full register read/write, command byte to payload complete.
+  TimoTimingStats reg_transaction;
+  // One write_dmx call; count is the number of universes sent.
+  TimoTimingStats dmx_write;
+  // One read_dmx call; count is the number of universes received.
+  TimoTimingStats dmx_read;
+  // Time spent waiting for the device to assert nIRQ.
+  TimoTimingStats ready_wait;
+  // Register writes sent, and left out because the shadow already matched.
+  uint32_t reg_writes;
+  uint32_t reg_writes_skipped;
+  // 128-slot DMX blocks sent, and left out because they were unchanged.
+  uint32_t dmx_blocks_written;
+  uint32_t dmx_blocks_skipped;
+  // Ready waits that outlasted the busy-wait and slept on the interrupt.
+  uint32_t irq_sleeps;
+  uint32_t ready_timeouts;
+};
+
 class TimoInterface {
 protected:
   // Device name register is 32 bytes
@@ -65,6 +113,26 @@ protected:
 
   static constexpr int64_t transaction_timeout_ms = 100;
 
+  // Upper bounds on the module answering SPI after power-up, and after a
+  // write that makes it reboot. Normally it answers much sooner.
+  static constexpr int64_t boot_timeout_ms = 2000;
+  static constexpr int64_t reboot_timeout_ms = 2000;
+  static constexpr TickType_t reboot_poll_period = pdMS_TO_TICKS(20);
+
+  // The TimoTwo normally asserts nIRQ within microseconds of a command, so
+  // spin this long before sleeping on the interrupt.
+  static constexpr int64_t ready_busy_wait_us = 100;
+
+  // WRITE_DMX moves the universe in blocks of up to 128 slots.
+  static constexpr size_t dmx_block_size = 128;
+  static constexpr size_t dmx_num_blocks = 512 / dmx_block_size;
+  // READ_DMX window; the whole universe.
+  static constexpr size_t dmx_rx_window_size = 512;
+
+  // Rewrite the whole universe at least this often (about once a second at
+  // 44 Hz) in case a write was lost or the module rebooted.
+  static constexpr uint32_t dmx_full_refresh_frames = 44;
+
   template <size_t data_size> struct __attribute__((packed)) SpiTxRxBuf {
     uint8_t irq_flags;
     std::array<uint8_t, data_size> data;
@@ -104,12 +172,25 @@ protected:
   // clang-format on
 
 public:
+  // A command and a payload transaction per DMX block can be in flight.
+  static constexpr int spi_queue_size = 2 * dmx_num_blocks;
+
   TimoInterface(const TimoHardwareConfig &_hw_config)
-      : hw_config(_hw_config), handle(nullptr), is_init(false), tx_buf(),
-        rx_buf() {}
+      : hw_config(_hw_config), handle(nullptr), is_init(false),
+        irq_sem(nullptr), irq_edges(0), cmd_edge_mark(0),
+        irq_listener(nullptr), irq_listener_bits(0), stats(), tx_buf(),
+        rx_buf(), dmx_cmd_trans(), dmx_data_trans(), dmx_tx_bufs(),
+        dmx_shadow(),
+        dmx_frames_since_refresh(dmx_full_refresh_frames),
+        dmx_slot_count(512), reg_shadow(),
+        reg_shadow_valid() {}
 
   esp_err_t init(const spi_host_device_t bus);
 
+  // Wait for the module to answer, then read its configuration into the
+  // register shadow and sw_config so set_sw_config() only writes differences.
+  esp_err_t read_back_state();
+
   // Config functions
   esp_err_t set_sw_config(const TimoSoftwareConfig &_sw_config);
   const TimoSoftwareConfig &get_sw_config() const { return sw_config; }
@@ -139,55 +220,155 @@ public:
   TimoStatus get_status();
 
   // DMX functions
-  esp_err_t write_dmx(const std::array<uint8_t, 512> &data);
+  // Set the universe length in DMX_SPEC, with the refresh period of a
+  // standard-timed packet that long. Costs no SPI traffic if unchanged.
+  esp_err_t set_dmx_slot_count(const uint16_t slot_count);
+  uint16_t get_dmx_slot_count() const { return dmx_slot_count; }
+  // Sends the blocks holding the first slot_count slots of data.
+  esp_err_t write_dmx(const std::array<uint8_t, 512> &data,
+                      const size_t slot_count = 512);
+
+  // Receive functions, for RX mode.
+  // Have task woken with notify_bits set on every nIRQ falling edge. Pass
+  // nullptr to stop notifying.
+  void set_irq_listener(TaskHandle_t task, const uint32_t notify_bits) {
+    irq_listener_bits = notify_bits;
+    irq_listener = task;
+  }
+  // Between transactions, a low nIRQ means an unmasked IRQ flag is set.
+  bool irq_pending() { return is_ready(); }
+  // Reads and clears IRQ_FLAGS.
+  esp_err_t read_irq_flags(TIMO::IRQ_FLAGS &flags);
+  // Reads the DMX_WINDOW into rx_buf, which must hold dmx_rx_window_size + 1
+  // bytes and be DMA capable. The first byte receives the IRQ flags, so
+  // callers can point it at a start code and read slots in place.
+  esp_err_t read_dmx(uint8_t *rx_buf);
+
+  const TimoStats &get_stats() const { return stats; }
 
 protected:
+  static void nirq_isr_handler(void *arg);
+
   bool is_ready();
   bool wait_for_ready(const int64_t timeout_ms);
   esp_err_t send_cmd(const SpiCmd cmd, const uint8_t addr = 0);
+  // Call before clocking out a command; wait_for_ready() then needs a fresh
+  // nIRQ edge, so a pending interrupt is not mistaken for the response.
+  void arm_ready() { cmd_edge_mark = irq_edges.load(); }
+  esp_err_t wait_for_trans(const spi_transaction_t *expected);
   esp_err_t transact_spi(const bool write, const uint8_t addr,
-                         const size_t len);
+                         const size_t len, const bool log_errors = true);
+
+  template <uint8_t addr, typename T, size_t len>
+  bool shadow_matches(const Register<addr, T, len> &reg) const {
+    return reg_shadow_valid[addr] &&
+           memcmp(reg_shadow[addr].data(), reg.raw(), reg.raw_len()) == 0;
+  }
+
+  template <uint8_t addr, typename T, size_t len>
+  void update_shadow(const Register<addr, T, len> &reg) {
+    static_assert(len * sizeof(T) <= max_reg_size);
+    memcpy(reg_shadow[addr].data(), reg.raw(), reg.raw_len());
+    reg_shadow_valid[addr] = true;
+  }
+
+  template <uint8_t addr, typename T, size_t len>
+  void shadow_get(Register<addr, T, len> &reg) const {
+    memcpy(reg.raw(), reg_shadow[addr].data(), reg.raw_len());
+  }
+
+  // Refresh the shadow of every register set_sw_config() writes.
+  esp_err_t read_config_regs();
+  // Write DMX_SPEC for dmx_slot_count.
+  esp_err_t write_dmx_spec();
 
   template <uint8_t addr, typename T, size_t len>
   esp_err_t write_reg(const Register<addr, T, len> &reg,
-                      const bool verify = true, TickType_t verify_delay = pdMS_TO_TICKS(10)) {
+                      const bool verify = true) {
+    // The device already holds this value.
+    if (shadow_matches(reg)) {
+      stats.reg_writes_skipped++;
+      return ESP_OK;
+    }
 
-    static_assert(pdMS_TO_TICKS(10) > 2, "Default delay should be more than 1 tick");
     memcpy(tx_buf.data.data(), reg.raw(), reg.raw_len());
     tx_buf.prep_tx();
     rx_buf.clear();
+    reg_shadow_valid[addr] = false;
     esp_err_t res = ESP_ERROR_CHECK_WITHOUT_ABORT(
         transact_spi(true, reg.address, reg.raw_len()));
     if (res != ESP_OK) {
       return res;
     }
+    stats.reg_writes++;
 
     if (verify) {
-      vTaskDelay(verify_delay);
+      // nIRQ readiness already waits out the write, so read straight back.
       Register<addr, T, len> readback;
       esp_err_t res = read_reg(readback);
-      if (res != ESP_OK || reg != readback) {
+      if (res != ESP_OK || readback != reg) {
         ESP_LOGE("TIMO", "Register %x verify failed: %x != %x", addr,
                  reg.data[0], readback.data[0]);
         return ESP_FAIL;
       }
+    } else {
+      update_shadow(reg);
     }
 
     return ESP_OK;
   }
 
+  /**
+   * Write a register that may reboot the module (CONFIG, RF_PROTOCOL), then
+   * poll until the module answers with the new value rather than sleeping for
+   * the worst-case reboot time.
+   */
+  template <uint8_t addr, typename T, size_t len>
+  esp_err_t write_reboot_reg(const Register<addr, T, len> &reg) {
+    if (shadow_matches(reg)) {
+      stats.reg_writes_skipped++;
+      return ESP_OK;
+    }
+
+    esp_err_t res = write_reg(reg, /* verify */ false);
+    if (res != ESP_OK) {
+      return res;
+    }
+
+    // A reboot may have reset other registers too; re-learn them once the
+    // module is back.
+    reg_shadow_valid.reset();
+
+    const int64_t start_time = esp_timer_get_time();
+    while (esp_timer_get_time() - start_time < reboot_timeout_ms * 1000) {
+      vTaskDelay(reboot_poll_period);
+      Register<addr, T, len> readback;
+      if (read_reg(readback, /* log_errors */ false) == ESP_OK &&
+          readback == reg) {
+        return read_config_regs();
+      }
+    }
+
+    ESP_LOGE("TIMO", "Register %x not applied after reboot", addr);
+    return ESP_ERR_TIMEOUT;
+  }
+
   template <uint8_t addr, typename T, size_t len>
-  esp_err_t read_reg(Register<addr, T, len> &reg) {
+  esp_err_t read_reg(Register<addr, T, len> &reg,
+                     const bool log_errors = true) {
     // If we're not writing, clear the tx buffer
     tx_buf.clear();
     tx_buf.prep_tx();
     rx_buf.clear();
-    esp_err_t res = ESP_ERROR_CHECK_WITHOUT_ABORT(
-        transact_spi(false, reg.address, reg.raw_len()));
+    esp_err_t res = transact_spi(false, reg.address, reg.raw_len(), log_errors);
     if (res != ESP_OK) {
+      if (log_errors) {
+        ESP_ERROR_CHECK_WITHOUT_ABORT(res);
+      }
       return res;
     }
     memcpy(reg.data.data(), rx_buf.data.data(), reg.raw_len());
+    update_shadow(reg);
     return ESP_OK;
   }
 
@@ -195,8 +376,32 @@ protected:
   TimoSoftwareConfig sw_config;
   spi_device_handle_t handle;
   bool is_init;
+  // Given from the nIRQ falling-edge interrupt.
+  SemaphoreHandle_t irq_sem;
+  std::atomic<uint32_t> irq_edges;
+  uint32_t cmd_edge_mark;
+  std::atomic<TaskHandle_t> irq_listener;
+  std::atomic<uint32_t> irq_listener_bits;
+  TimoStats stats;
   SpiTxRxBuf<max_reg_size> tx_buf;
   SpiTxRxBuf<max_reg_size> rx_buf;
+
+  // Preallocated ring for write_dmx, one command and one payload transaction
+  // per block. Members of a static object, so DMA capable.
+  std::array<spi_transaction_t, dmx_num_blocks> dmx_cmd_trans;
+  std::array<spi_transaction_t, dmx_num_blocks> dmx_data_trans;
+  std::array<SpiTxRxBuf<dmx_block_size>, dmx_num_blocks> dmx_tx_bufs;
+
+  // Last universe the device acknowledged, for dirty block tracking.
+  std::array<uint8_t, 512> dmx_shadow;
+  uint32_t dmx_frames_since_refresh;
+  // Universe length programmed into DMX_SPEC.
+  uint16_t dmx_slot_count;
+
+  // Last known device value of each register, indexed by address.
+  std::array<std::array<uint8_t, max_reg_size>, TIMO_REG_ADDR_MAX + 1>
+      reg_shadow;
+  std::bitset<TIMO_REG_ADDR_MAX + 1> reg_shadow_valid;
 };
 
 namespace {
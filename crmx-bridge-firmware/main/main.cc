@@ -1,5 +1,10 @@
 
+#include "ArtNetReceiver.h"
+#include "DmxRecorder.h"
 #include "DmxSwitcher.h"
+#include "SacnReceiver.h"
+#include "NetworkSender.h"
+#include "Enums.h"
 #include "SettingsHandler.h"
 #include "TimoInterface.h"
 #include "wifi_task.h"
@@ -28,6 +33,8 @@
 #include "soc/soc_caps.h"
 #include "ssd1106.h"
 #include "ui/ui.h"
+#include <algorithm>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -68,9 +75,9 @@ static constexpr TimoHardwareConfig timo_config = {
         {
             .mode = 0, // SPI mode 0 (CPOL 0, CPHA0)
             .cs_ena_pretrans = 6,
-            .clock_speed_hz = 1 * 1000 * 1000, // 1 MHz
+            .clock_speed_hz = 2 * 1000 * 1000, // 2 MHz, TimoTwo maximum
             .spics_io_num = GPIO_NUM_10,       // CS pin
-            .queue_size = 1,
+            .queue_size = TimoInterface::spi_queue_size,
         },
 };
 
@@ -117,6 +124,53 @@ static void set_led_color(const RGBColor &color) {
   ledc_set_duty_and_update(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_2, color.blue, 0);
 }
 
+static constexpr size_t full_packet_size =
+    decltype(DmxPacket::full_packet)::size();
+
+/**
+ * DMX output task for the physical output port. Sleeps until the switcher
+ * routes a frame to the onboard interface.
+ */
+extern "C" void onboard_dmx_tx_task(void *pvParameters) {
+  DmxInterface *interface = static_cast<DmxInterface *>(pvParameters);
+  DmxTimingProfile profile = DmxTimingProfile::standard;
+  DmxTiming timing = dmx_timing(profile);
+
+  while (true) {
+    DmxFrameRef tx_frame = interface->recieve(portMAX_DELAY);
+    if (!tx_frame) {
+      continue;
+    }
+
+    // Only the port's own task may change its timing between packets.
+    const DmxTimingProfile new_profile =
+        SettingsHandler::shared().dmx_timing.get();
+    if (new_profile != profile) {
+      profile = new_profile;
+      timing = dmx_timing(profile);
+      dmx_set_break_len(dmx_out_cfg.port, timing.break_us);
+      dmx_set_mab_len(dmx_out_cfg.port, timing.mab_us);
+    }
+
+    // Send only the slots in use, so short universes refresh faster. Very
+    // short ones are padded from the frame's zeroed tail to keep the packet
+    // at the DMX512-A minimum.
+    const size_t packet_size =
+        std::max<size_t>(tx_frame->slot_count, dmx_min_slot_count(timing)) +
+        1;
+    size_t written_len =
+        dmx_write(dmx_out_cfg.port, &tx_frame->full_packet, packet_size);
+    if (written_len != packet_size) {
+      ESP_LOGE(TAG, "Wrote short DMX Packet: %zu", written_len);
+    }
+    written_len = dmx_send_num(dmx_out_cfg.port, packet_size);
+    if (written_len != packet_size) {
+      ESP_LOGE(TAG, "Sent short DMX Packet: %zu", written_len);
+    }
+    interface->complete(tx_frame);
+  }
+}
+
 /**
  * DMX Task for physical DMX IO
  */
@@ -159,42 +213,57 @@ extern "C" void onboard_dmx_task(void *pvParameters) {
 
   dmx_packet_t rx_meta;
 
-  DmxPacket tx_packet;
-  DmxPacket rx_packet;
+  // Output runs in its own task so that each direction blocks only on its own
+  // event: the UART for input, a routed frame for output.
+  TaskHandle_t tx_task_handle = nullptr;
+  if (xTaskCreatePinnedToCore(onboard_dmx_tx_task, "onboard_dmx_tx", 4096,
+                              interface, 3, &tx_task_handle, 1) != pdPASS ||
+      tx_task_handle == nullptr) {
+    ESP_LOGE(TAG, "Failed to create onboard_dmx_tx task");
+  }
 
   ESP_LOGI(TAG, "Finished Onboard DMX Init");
 
   while (true) {
-    if (dmx_receive(dmx_in_cfg.port, &rx_meta, DMX_TIMEOUT_TICK)) {
-      if (rx_meta.err != DMX_OK ||
-          rx_meta.size > sizeof(rx_packet.full_packet)) {
-        ESP_LOGE(TAG, "DMX Packet Error: %d, %zu", rx_meta.err, rx_meta.size);
-      } else {
-        size_t data_len = dmx_read(dmx_in_cfg.port, &rx_packet.full_packet,
-                                   rx_packet.full_packet.size());
-        if (data_len == rx_packet.full_packet.size()) {
-          interface->send(rx_packet);
-        } else {
-          ESP_LOGE(TAG, "Recieved short DMX packet: %zu", data_len);
-        }
-      }
+    if (!dmx_receive(dmx_in_cfg.port, &rx_meta, DMX_TIMEOUT_TICK)) {
+      continue;
+    }
+    const int64_t rx_time_us = esp_timer_get_time();
+    // Universes shorter than 512 slots are fine; an empty one is not.
+    if (rx_meta.err != DMX_OK || rx_meta.size < 2 ||
+        rx_meta.size > full_packet_size) {
+      ESP_LOGE(TAG, "DMX Packet Error: %d, %zu", rx_meta.err, rx_meta.size);
+      continue;
     }
 
-    if (interface->recieve(tx_packet, 0)) {
-      size_t written_len = dmx_write(dmx_out_cfg.port, &tx_packet.full_packet,
-                                     tx_packet.full_packet.size());
-      if (written_len != tx_packet.full_packet.size()) {
-        ESP_LOGE(TAG, "Wrote short DMX Packet: %zu", written_len);
-      }
-      written_len = dmx_send(dmx_out_cfg.port);
-      if (written_len != tx_packet.full_packet.size()) {
-        ESP_LOGE(TAG, "Sent short DMX Packet: %zu", written_len);
-      }
+    // Read straight into a pool frame; the switcher passes it on by
+    // reference.
+    DmxFrameRef rx_frame = DmxFramePool::shared().acquire();
+    if (!rx_frame) {
+      ESP_LOGW(TAG, "No free DMX frame, dropping packet");
+      continue;
+    }
+    size_t data_len =
+        dmx_read(dmx_in_cfg.port, &rx_frame->full_packet, rx_meta.size);
+    if (data_len == rx_meta.size) {
+      const size_t slot_count = data_len - 1;
+      memset(rx_frame->full_packet.data.data() + slot_count, 0,
+             dmx_packet_size - slot_count);
+      rx_frame->slot_count = static_cast<uint16_t>(slot_count);
+      rx_frame->source = DmxSourceSink::onboard;
+      rx_frame->times.rx_us = rx_time_us;
+      interface->send(std::move(rx_frame));
+    } else {
+      ESP_LOGE(TAG, "Recieved short DMX packet: %zu", data_len);
     }
-    vTaskDelay(pdMS_TO_TICKS(2));
   }
 }
 
+// Notification bits used by tasks that react to settings changes.
+static constexpr uint32_t settings_changed_notify_bit = 0b01;
+static constexpr uint32_t dmx_frame_notify_bit = 0b10;
+static constexpr uint32_t timo_irq_notify_bit = 0b100;
+
 /**
  * Delegate implementation to notify a task when settings are changed
  */
@@ -205,7 +274,7 @@ public:
 
   void on_settings_update(const SettingsHandler &settings) override {
     if (task_handle != nullptr) {
-      xTaskNotify(task_handle, true, eSetValueWithOverwrite);
+      xTaskNotify(task_handle, settings_changed_notify_bit, eSetBits);
     }
   }
 
@@ -231,6 +300,41 @@ static TimoSoftwareConfig timo_config_from_settings() {
   };
 }
 
+/**
+ * Drain frames the TimoTwo has received over the air into the switcher.
+ */
+static void timo_receive_dmx(DmxInterface &interface) {
+  // nIRQ stays low while flags are set; bound the loop so a stuck line cannot
+  // starve settings updates.
+  static constexpr int max_reads_per_wake = 4;
+
+  for (int i = 0; i < max_reads_per_wake && timo_interface.irq_pending();
+       i++) {
+    TIMO::IRQ_FLAGS irq_flags;
+    if (timo_interface.read_irq_flags(irq_flags) != ESP_OK) {
+      return;
+    }
+    if (!irq_flags.get(TIMO::IRQ_FLAGS::RX_DMX_IRQ)) {
+      continue;
+    }
+
+    DmxFrameRef frame = DmxFramePool::shared().acquire();
+    if (!frame) {
+      ESP_LOGW(TAG, "No free frame for TIMO RX");
+      return;
+    }
+
+    // Read the window straight into the frame. The IRQ flags byte lands on
+    // the start code, which is then set to null.
+    if (timo_interface.read_dmx(&frame->full_packet.start_code) != ESP_OK) {
+      return;
+    }
+    frame->full_packet.start_code = 0;
+    frame->source = DmxSourceSink::timo;
+    interface.send(std::move(frame));
+  }
+}
+
 /**
  * Run the TimoTwo interface
  */
@@ -242,14 +346,15 @@ extern "C" void timo_dmx_task(void *pvParameters) {
     return;
   }
 
-  // Give TIMO a while to power on.
-  vTaskDelay(pdMS_TO_TICKS(2000));
-
   // Initialize the SPI bus
   ESP_ERROR_CHECK(
       spi_bus_initialize(timo_spi_bus, &spi_bus_cfg, SPI_DMA_CH_AUTO));
   ESP_ERROR_CHECK(timo_interface.init(timo_spi_bus));
 
+  // Waits for TIMO to power on, then learns its state so only settings that
+  // differ get written below.
+  ESP_ERROR_CHECK_WITHOUT_ABORT(timo_interface.read_back_state());
+
   // Settings are user-generated and therefore fallable. Allow boot to continue
   // even if setting settings fails.
   ESP_ERROR_CHECK_WITHOUT_ABORT(
@@ -259,28 +364,50 @@ extern "C" void timo_dmx_task(void *pvParameters) {
 
   int64_t last_print = esp_timer_get_time();
 
-  TickType_t xLastWakeTime = xTaskGetTickCount();
-  DmxPacket packet{};
+  // Wake on routed frames, received frames and settings changes.
+  interface->set_sink_listener(xTaskGetCurrentTaskHandle(),
+                               dmx_frame_notify_bit);
+  timo_interface.set_irq_listener(xTaskGetCurrentTaskHandle(),
+                                  timo_irq_notify_bit);
 
   // Loop over the recieved frames and transmit them
   while (true) {
-    // Interface -> recieve blocks
-    if (interface->recieve(packet, pdMS_TO_TICKS(5))) {
-      if (timo_interface.write_dmx(packet.full_packet.data) != ESP_OK) {
+    uint32_t notified = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &notified, portMAX_DELAY);
+
+    // Always check for a frame; one may have been routed before the listener
+    // was registered.
+    DmxFrameRef frame = interface->recieve(0);
+    if (frame) {
+      // Only rewrites DMX_SPEC when the universe length changes.
+      if (timo_interface.set_dmx_slot_count(frame->slot_count) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set DMX slot count %u",
+                 static_cast<unsigned>(frame->slot_count));
+      }
+      if (timo_interface.write_dmx(frame->full_packet.data,
+                                   frame->slot_count) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to write dmx from source %d",
-                 static_cast<int>(packet.source));
+                 static_cast<int>(frame->source));
       }
+      interface->complete(frame);
+      // Hand the frame back to the pool before sleeping.
+      frame.reset();
+    }
+
+    // nIRQ edges also fire during our own transactions, so go by the line
+    // level rather than the notification bit.
+    if (timo_interface.get_tx_rx_mode() ==
+        TIMO::CONFIG::RADIO_TX_RX_MODE_T::RX) {
+      timo_receive_dmx(*interface);
     }
 
-    // If a notification was recieved, a settings update occurred.
-    if (xTaskNotifyWait(0b1, 0, NULL, 0) == pdTRUE) {
+    // A settings update occurred.
+    if (notified & settings_changed_notify_bit) {
       TimoSoftwareConfig new_config = timo_config_from_settings();
       if (new_config != timo_interface.get_sw_config()) {
         timo_interface.set_sw_config(new_config);
       }
     }
-
-    vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(2));
   }
 }
 
@@ -441,7 +568,6 @@ void hmi_task(void *pvParameters) {
 
   // Encoder
   rotary_encoder_info_t encoder = {};
-  ESP_ERROR_CHECK(gpio_install_isr_service(0));
   ESP_ERROR_CHECK(rotary_encoder_init(&encoder, enc_a_pin, enc_b_pin));
   ESP_ERROR_CHECK(rotary_encoder_enable_half_steps(&encoder, false));
 
@@ -542,6 +668,162 @@ static void adc_calibration_deinit(adc_cali_handle_t handle) {
 #endif
 }
 
+static void log_latency_summary(const char *name,
+                                const LatencyHistogram::Summary &summary) {
+  if (summary.count == 0) {
+    return;
+  }
+  ESP_LOGI(TAG,
+           "LATENCY %s: %" PRIu32 " frames, p50 %" PRIu32 " us, p99 %" PRIu32
+           " us, max %" PRIu32 " us",
+           name, summary.count, summary.p50_us, summary.p99_us,
+           summary.max_us);
+}
+
+/**
+ * Log per-hop and end-to-end latency histograms for every path that has
+ * carried frames since boot.
+ */
+static void log_dmx_latency() {
+  using SourceSinkEnum = ui_enum<DmxSourceSink>;
+  const DmxLatencyTracker &tracker = DmxLatencyTracker::shared();
+  char name[48];
+
+  for (const DmxSourceSink src : SourceSinkEnum::as_list()) {
+    for (const DmxSourceSink sink : SourceSinkEnum::as_list()) {
+      snprintf(name, sizeof(name), "%s->%s rx->complete",
+               SourceSinkEnum::to_string(src), SourceSinkEnum::to_string(sink));
+      log_latency_summary(name, tracker.get_path(src, sink));
+    }
+  }
+  for (const DmxSourceSink io : SourceSinkEnum::as_list()) {
+    const char *io_name = SourceSinkEnum::to_string(io);
+    snprintf(name, sizeof(name), "%s rx->dispatch", io_name);
+    log_latency_summary(
+        name, tracker.get_hop(DmxLatencyTracker::Hop::rx_to_dispatch, io));
+    snprintf(name, sizeof(name), "%s dispatch->pickup", io_name);
+    log_latency_summary(
+        name, tracker.get_hop(DmxLatencyTracker::Hop::dispatch_to_pickup, io));
+    snprintf(name, sizeof(name), "%s pickup->complete", io_name);
+    log_latency_summary(
+        name, tracker.get_hop(DmxLatencyTracker::Hop::pickup_to_complete, io));
+  }
+}
+
+/**
+ * Periodically log data plane counters.
+ */
+static void log_dmx_stats(DmxSwitcher &switcher) {
+  static constexpr int64_t log_period_us = 10 * 1000 * 1000;
+  static int64_t last_log_us = esp_timer_get_time();
+  static DmxSwitcher::Stats last_stats = switcher.get_stats();
+  static uint32_t last_timo_writes = timo_interface.get_stats().dmx_write.count;
+
+  const int64_t now = esp_timer_get_time();
+  if (now - last_log_us < log_period_us) {
+    return;
+  }
+
+  const DmxSwitcher::Stats stats = switcher.get_stats();
+  const float seconds = (now - last_log_us) / 1e6f;
+
+  ESP_LOGI(TAG,
+           "DMX: switcher %.1f wakeups/s, %.1f frames/s, %" PRIu32
+           " sources expired, %" PRIu32 " losses, %" PRIu32 " switchovers",
+           (stats.wakeups - last_stats.wakeups) / seconds,
+           (stats.dispatched - last_stats.dispatched) / seconds,
+           stats.merge_expiries, stats.losses, stats.switchovers);
+  for (const DmxSourceSink src : ui_enum<DmxSourceSink>::as_list()) {
+    const uint32_t time_s = stats.source_time_s[static_cast<size_t>(src)];
+    if (time_s != 0) {
+      ESP_LOGI(TAG, "DMX: %" PRIu32 " s routing %s", time_s,
+               ui_enum<DmxSourceSink>::to_string(src));
+    }
+  }
+  log_latency_summary("merge stage", stats.merge_time);
+  log_latency_summary("crossfade stage", stats.crossfade_time);
+  log_latency_summary("patch stage", stats.patch_time);
+  log_latency_summary("curve stage", stats.curve_time);
+  if (stats.rpc_updates != 0) {
+    ESP_LOGI(TAG, "DMX: %" PRIu32 " RPC updates published in %" PRIu32
+                  " frames, %" PRIu32 " publishes retried",
+             stats.rpc_updates, stats.rpc_frames, stats.rpc_retries);
+  }
+  log_dmx_latency();
+
+  const DmxRecorder::Stats rec = DmxRecorder::shared().get_stats();
+  if (rec.recorded_frames != 0 || rec.played_frames != 0) {
+    ESP_LOGI(TAG,
+             "REC: %" PRIu32 " frames in %" PRIu32 " bytes, %" PRIu32
+             " dropped, %" PRIu32 " pages written, %" PRIu32 " played",
+             rec.recorded_frames, rec.recorded_bytes, rec.dropped_frames,
+             rec.pages_written, rec.played_frames);
+    log_latency_summary("recorder encode", rec.encode_time);
+    log_latency_summary("recorder page program", rec.program_time);
+    log_latency_summary("recorder sector erase", rec.erase_time);
+    log_latency_summary("playback lateness", rec.playback_lateness);
+  }
+
+  const ArtNetReceiver::Stats artnet = ArtNetReceiver::shared().get_stats();
+  if (artnet.packets != 0) {
+    ESP_LOGI(TAG,
+             "ARTNET: %" PRIu32 " packets, %" PRIu32 " frames, %" PRIu32
+             " polls, %" PRIu32 " filtered, %" PRIu32 " out of order, %" PRIu32
+             " malformed, %" PRIu32 " without a free frame",
+             artnet.packets, artnet.dmx_frames, artnet.polls, artnet.filtered,
+             artnet.out_of_order, artnet.malformed, artnet.no_frame);
+    log_latency_summary("artnet parse", artnet.parse_time);
+  }
+
+  const SacnReceiver::Stats sacn = SacnReceiver::shared().get_stats();
+  if (sacn.packets != 0) {
+    ESP_LOGI(TAG,
+             "SACN: %" PRIu32 " packets, %" PRIu32 " frames, %" PRIu32
+             " groups, %" PRIu32 " filtered, %" PRIu32 " out of order, %" PRIu32
+             " malformed, %" PRIu32 " ignored, sources %" PRIu32
+             " terminated %" PRIu32 " expired %" PRIu32 " rejected, %" PRIu32
+             " without a free frame",
+             sacn.packets, sacn.dmx_frames, sacn.groups_joined, sacn.filtered,
+             sacn.out_of_order, sacn.malformed, sacn.ignored,
+             sacn.sources_terminated, sacn.sources_expired,
+             sacn.sources_rejected, sacn.no_frame);
+    log_latency_summary("sacn parse", sacn.parse_time);
+  }
+
+  const NetworkSender::Stats net_out = NetworkSender::shared().get_stats();
+  if (net_out.frames != 0) {
+    ESP_LOGI(TAG,
+             "NET OUT: %" PRIu32 " frames, %" PRIu32 " unchanged, %" PRIu32
+             " changes sent, %" PRIu32 " keepalives, %" PRIu32
+             " terminated, %" PRIu32 " unmapped, %" PRIu32 " busy, %" PRIu32
+             " send errors",
+             net_out.frames, net_out.unchanged, net_out.changes,
+             net_out.keepalives, net_out.terminations, net_out.unmapped,
+             net_out.busy, net_out.send_errors);
+  }
+
+  // Read without locking; the counters are only for trend watching.
+  const TimoStats &timo = timo_interface.get_stats();
+  ESP_LOGI(TAG,
+           "TIMO: %.1f frames/s, dmx write avg %" PRIu32 " us max %" PRIu32
+           " us, reg avg %" PRIu32 " us max %" PRIu32 " us, ready avg %" PRIu32
+           " us max %" PRIu32 " us, %" PRIu32 " irq sleeps, %" PRIu32
+           " timeouts, %" PRIu32 " blocks written, %" PRIu32
+           " skipped, %" PRIu32 " frames received, %" PRIu32
+           " reg writes, %" PRIu32 " skipped",
+           (timo.dmx_write.count - last_timo_writes) / seconds,
+           timo.dmx_write.avg_us(), timo.dmx_write.max_us,
+           timo.reg_transaction.avg_us(), timo.reg_transaction.max_us,
+           timo.ready_wait.avg_us(), timo.ready_wait.max_us, timo.irq_sleeps,
+           timo.ready_timeouts, timo.dmx_blocks_written,
+           timo.dmx_blocks_skipped, timo.dmx_read.count, timo.reg_writes,
+           timo.reg_writes_skipped);
+
+  last_stats = stats;
+  last_timo_writes = timo.dmx_write.count;
+  last_log_us = now;
+}
+
 /**
  * Finally, the main app
  */
@@ -576,6 +858,12 @@ extern "C" void app_main(void) {
   // Hold up the power rail
   gpio_set_level(pwr_in_ctrl_pin, true);
 
+  // The encoder and the TIMO nIRQ line both need the GPIO ISR service, install
+  // it once before either task starts. In IRAM, so the nIRQ edge is still
+  // taken while a flash erase has the cache disabled; every handler on it
+  // must be IRAM-safe.
+  ESP_ERROR_CHECK(gpio_install_isr_service(ESP_INTR_FLAG_IRAM));
+
   // Multiple drivers need NVS, settings infrastructure will initialize it.
   SettingsHandler &settings = SettingsHandler::shared();
   settings.init();
@@ -587,6 +875,34 @@ extern "C" void app_main(void) {
   // Immediately set the source and sync to the cached value.
   switcher.set_src_sink(settings.input, settings.output);
   switcher.set_output_en(settings.output_en);
+  switcher.set_fanout(settings.fanout_sinks);
+  switcher.set_merge(settings.merge_mode, settings.merge_srcs);
+  switcher.set_patch(settings.patch);
+  switcher.set_curves(settings.curves);
+  switcher.set_loss_config(settings.get_loss_config());
+  switcher.set_sources(settings.source_list);
+  switcher.set_crossfade(settings.crossfade_ms);
+  switcher.set_routes(settings.routes);
+
+  // The Art-Net receiver starts listening once WiFi is up; give it its
+  // address now and keep it in sync with settings.
+  ArtNetReceiver &artnet_receiver = ArtNetReceiver::shared();
+  artnet_receiver.set_address(settings.artnet_net, settings.artnet_subnet);
+  settings.add_delegate(&artnet_receiver);
+  SacnReceiver &sacn_receiver = SacnReceiver::shared();
+  sacn_receiver.on_settings_update(settings);
+  settings.add_delegate(&sacn_receiver);
+  // Whatever is routed to the artnet and sacn sinks goes back out on the
+  // network once WiFi is up.
+  NetworkSender &network_sender = NetworkSender::shared();
+  ESP_ERROR_CHECK_WITHOUT_ABORT(network_sender.init(
+      switcher.get_artnet_interface(), switcher.get_sacn_interface()));
+  network_sender.on_settings_update(settings);
+  settings.add_delegate(&network_sender);
+
+  // Recordings play back through the switcher's playback source.
+  ESP_ERROR_CHECK_WITHOUT_ABORT(
+      DmxRecorder::shared().init(switcher.get_playback_interface()));
 
   // Start onboard DMX
   TaskHandle_t onboard_dmx_task_handle;
@@ -660,6 +976,8 @@ extern "C" void app_main(void) {
       }
     }
 
+    log_dmx_stats(switcher);
+
     vTaskDelay(pdMS_TO_TICKS(100));
   }
 
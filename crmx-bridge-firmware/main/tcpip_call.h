@@ -0,0 +1,25 @@
+#pragma once
+
+#include "lwip/err.h"
+#include "lwip/priv/tcpip_priv.h"
+
+/**
+ * Runs fn(self) on the tcpip thread, which owns the raw API, and returns its
+ * result once it has run. Wraps lwIP's tcpip_api_call() for the receivers and
+ * senders that start and stop their pcbs from other tasks.
+ */
+template <typename T> err_t call_on_tcpip(T &self, err_t (*fn)(T &)) {
+  struct Call {
+    // First, so lwIP's pointer to it is a pointer to the whole call.
+    tcpip_api_call_data base;
+    T *self;
+    err_t (*fn)(T &);
+  };
+  Call call{.base = {}, .self = &self, .fn = fn};
+  return tcpip_api_call(
+      [](tcpip_api_call_data *data) -> err_t {
+        Call &c = *reinterpret_cast<Call *>(data);
+        return c.fn(*c.self);
+      },
+      &call.base);
+}
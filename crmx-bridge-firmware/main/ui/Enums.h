@@ -173,9 +173,10 @@ template <> struct ui_enum<TIMO::LINKING_KEY_RX::MODE_T> {
 template <> struct ui_enum<DmxSourceSink> {
   static constexpr bool is_ui_enum = true;
 
-  static constexpr std::array<DmxSourceSink, 4> as_list() {
-    return {DmxSourceSink::none, DmxSourceSink::timo, DmxSourceSink::onboard,
-            DmxSourceSink::artnet};
+  static constexpr std::array<DmxSourceSink, 6> as_list() {
+    return {DmxSourceSink::none,   DmxSourceSink::timo,
+            DmxSourceSink::onboard, DmxSourceSink::artnet,
+            DmxSourceSink::playback, DmxSourceSink::sacn};
   }
 
   static constexpr char const *to_string(const DmxSourceSink src_sink) {
@@ -188,6 +189,10 @@ template <> struct ui_enum<DmxSourceSink> {
       return "DMX";
     case DmxSourceSink::artnet:
       return "ARTNET";
+    case DmxSourceSink::playback:
+      return "PLAYBACK";
+    case DmxSourceSink::sacn:
+      return "SACN";
     default:
       return unknown_enum_str;
     }
@@ -203,6 +208,10 @@ template <> struct ui_enum<DmxSourceSink> {
       return {DmxSourceSink::onboard};
     } else if (str == "ARTNET") {
       return {DmxSourceSink::artnet};
+    } else if (str == "PLAYBACK") {
+      return {DmxSourceSink::playback};
+    } else if (str == "SACN") {
+      return {DmxSourceSink::sacn};
     }
     return {};
   }
@@ -2,6 +2,8 @@
 
 #include "limits.h"
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
 template <typename T, size_t Sz>
@@ -14,4 +16,78 @@ enum class DmxSourceSink : uint32_t {
   timo,
   onboard,
   artnet,
+  // Frames played back from the flash recorder.
+  playback,
+  // sACN (E1.31) over WiFi.
+  sacn,
 };
+static constexpr size_t dmx_source_sink_count = 6;
+
+static constexpr uint32_t dmx_source_sink_bit(const DmxSourceSink io) {
+  return 1u << static_cast<uint32_t>(io);
+}
+
+enum class DmxMergeMode : uint32_t {
+  // Only the selected input is routed.
+  none,
+  // Highest takes precedence.
+  htp,
+  // Latest takes precedence.
+  ltp,
+};
+
+// What a route outputs once its source goes quiet.
+enum class DmxLossPolicy : uint32_t {
+  // Keep sending the last look.
+  hold,
+  // Hold the last look for a while, then fade it to black.
+  fade,
+};
+
+// Break and mark-after-break lengths of the wired DMX output.
+enum class DmxTimingProfile : uint32_t {
+  // esp_dmx's defaults: 176 us break, 12 us mark after break.
+  standard,
+  // The shortest DMX512-A allows: 92 us break, 12 us mark after break.
+  fast,
+  // Long break and mark after break for older receivers.
+  relaxed,
+};
+
+struct DmxTiming {
+  uint32_t break_us;
+  uint32_t mab_us;
+};
+
+static constexpr DmxTiming dmx_timing(const DmxTimingProfile profile) {
+  switch (profile) {
+  case DmxTimingProfile::fast:
+    return DmxTiming{.break_us = 92, .mab_us = 12};
+  case DmxTimingProfile::relaxed:
+    return DmxTiming{.break_us = 352, .mab_us = 88};
+  case DmxTimingProfile::standard:
+  default:
+    return DmxTiming{.break_us = 176, .mab_us = 12};
+  }
+}
+
+// One slot is 11 bits at 250 kbaud.
+static constexpr uint32_t dmx_slot_us = 44;
+// DMX512-A's shortest break-to-break time.
+static constexpr uint32_t dmx_packet_min_us = 1204;
+
+// Break-to-break time of a packet of slot_count data slots.
+static constexpr uint32_t dmx_packet_time_us(const size_t slot_count,
+                                             const DmxTiming timing) {
+  const uint32_t time_us = timing.break_us + timing.mab_us +
+                           static_cast<uint32_t>(slot_count + 1) * dmx_slot_us;
+  return time_us < dmx_packet_min_us ? dmx_packet_min_us : time_us;
+}
+
+// Fewest data slots that fill dmx_packet_min_us without an idle gap.
+static constexpr size_t dmx_min_slot_count(const DmxTiming timing) {
+  const uint32_t header_us = timing.break_us + timing.mab_us + dmx_slot_us;
+  return header_us >= dmx_packet_min_us
+             ? 1
+             : (dmx_packet_min_us - header_us + dmx_slot_us - 1) / dmx_slot_us;
+}
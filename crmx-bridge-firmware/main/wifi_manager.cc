@@ -110,6 +110,9 @@ esp_err_t wifi_manager_connect(void)
 
     s_retry_num = 0;
     ESP_ERROR_CHECK(esp_wifi_start());
+    // Modem sleep holds broadcast traffic until the next DTIM beacon, which
+    // turns a 44 Hz Art-Net stream into bursts every few hundred ms.
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_wifi_set_ps(WIFI_PS_NONE));
     
     ESP_LOGI(TAG, "Attempting WiFi connection...");
     return ESP_OK;
@@ -1,8 +1,13 @@
 #include "wifi_task.h"
+#include "ArtNetReceiver.h"
+#include "SacnReceiver.h"
+#include "NetworkSender.h"
 #include "wifi_manager.h"
 #include "device_config.h"
 #include "SettingsHandler.h"
 #include "DmxSwitcher.h"
+#include "DmxRecorder.h"
+#include "Enums.h"
 #include "golioth_nvs.h"
 #include "golioth_credentials.h"
 #include "esp_log.h"
@@ -12,8 +17,12 @@
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "cJSON.h"
+#include "lwip/ip4_addr.h"
 #include <golioth/client.h>
 #include <golioth/rpc.h>
+#include <golioth/stream.h>
+#include <algorithm>
+#include <inttypes.h>
 #include <string.h>
 
 static const char* TAG = "wifi_task";
@@ -27,6 +36,72 @@ static struct golioth_client *s_client = nullptr;
 static struct golioth_rpc *s_rpc = nullptr;
 static SemaphoreHandle_t s_golioth_connected_sem = nullptr;
 
+// How often DMX latency histograms are streamed to Golioth
+static constexpr int64_t telemetry_period_us = 60 * 1000 * 1000;
+
+static void add_latency_summary(cJSON *parent, const char *name,
+                                const LatencyHistogram::Summary &summary)
+{
+    if (summary.count == 0) {
+        return;
+    }
+    cJSON *item = cJSON_AddObjectToObject(parent, name);
+    if (item == nullptr) {
+        return;
+    }
+    cJSON_AddNumberToObject(item, "count", summary.count);
+    cJSON_AddNumberToObject(item, "p50_us", summary.p50_us);
+    cJSON_AddNumberToObject(item, "p99_us", summary.p99_us);
+    cJSON_AddNumberToObject(item, "max_us", summary.max_us);
+}
+
+// Stream per-path and per-hop DMX latency to Golioth
+static void send_latency_telemetry()
+{
+    const DmxLatencyTracker &tracker = DmxLatencyTracker::shared();
+    using SourceSinkEnum = ui_enum<DmxSourceSink>;
+
+    cJSON *root = cJSON_CreateObject();
+    if (root == nullptr) {
+        return;
+    }
+    cJSON *paths = cJSON_AddObjectToObject(root, "paths");
+    cJSON *rx_to_dispatch = cJSON_AddObjectToObject(root, "rx_to_dispatch");
+    cJSON *dispatch_to_pickup = cJSON_AddObjectToObject(root, "dispatch_to_pickup");
+    cJSON *pickup_to_complete = cJSON_AddObjectToObject(root, "pickup_to_complete");
+
+    for (const DmxSourceSink io : SourceSinkEnum::as_list()) {
+        const char *io_name = SourceSinkEnum::to_string(io);
+        add_latency_summary(rx_to_dispatch, io_name,
+                            tracker.get_hop(DmxLatencyTracker::Hop::rx_to_dispatch, io));
+        add_latency_summary(dispatch_to_pickup, io_name,
+                            tracker.get_hop(DmxLatencyTracker::Hop::dispatch_to_pickup, io));
+        add_latency_summary(pickup_to_complete, io_name,
+                            tracker.get_hop(DmxLatencyTracker::Hop::pickup_to_complete, io));
+        for (const DmxSourceSink sink : SourceSinkEnum::as_list()) {
+            char path_name[32];
+            snprintf(path_name, sizeof(path_name), "%s_to_%s", io_name,
+                     SourceSinkEnum::to_string(sink));
+            add_latency_summary(paths, path_name, tracker.get_path(io, sink));
+        }
+    }
+
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (json == nullptr) {
+        ESP_LOGE(TAG, "Failed to serialize latency telemetry");
+        return;
+    }
+
+    enum golioth_status status = golioth_stream_set_async(
+        s_client, "dmx_latency", GOLIOTH_CONTENT_TYPE_JSON,
+        reinterpret_cast<const uint8_t *>(json), strlen(json), NULL, NULL);
+    if (status != GOLIOTH_OK) {
+        ESP_LOGW(TAG, "Failed to stream latency telemetry: %d", status);
+    }
+    cJSON_free(json);
+}
+
 // RPC callback for setting DMX values
 static enum golioth_rpc_status on_set_dmx_channel(zcbor_state_t *request_params_array,
                                                    zcbor_state_t *response_detail_map,
@@ -48,7 +123,7 @@ static enum golioth_rpc_status on_set_dmx_channel(zcbor_state_t *request_params_
     int dmx_address = (int)dmx_address_double;
     int value = (int)value_double;
 
-    ESP_LOGI(TAG, "RPC: Set DMX channel %d to value %d", dmx_address, value);
+    ESP_LOGD(TAG, "RPC: Set DMX channel %d to value %d", dmx_address, value);
 
     // Call the DMX switcher to set the value
     DmxSwitcher &switcher = DmxSwitcher::get_switcher();
@@ -76,6 +151,866 @@ static enum golioth_rpc_status on_set_dmx_channel(zcbor_state_t *request_params_
     return GOLIOTH_RPC_OK;
 }
 
+// Golioth hands JSON numbers over as floats; CBOR clients may send integers.
+static bool decode_number(zcbor_state_t *state, double *result)
+{
+    int32_t integer;
+    if (zcbor_int32_decode(state, &integer))
+    {
+        *result = integer;
+        return true;
+    }
+    return zcbor_float_decode(state, result);
+}
+
+static bool decode_level(zcbor_state_t *state, uint8_t *level)
+{
+    double value;
+    if (!decode_number(state, &value) || value < 0 || value > 255)
+    {
+        return false;
+    }
+    *level = static_cast<uint8_t>(value);
+    return true;
+}
+
+// A DMX address (1-512) as a map key: a number, or its digits in a text
+// string, since JSON object keys are always strings.
+static bool decode_address(zcbor_state_t *state, uint16_t *address)
+{
+    double number;
+    if (!decode_number(state, &number))
+    {
+        struct zcbor_string digits;
+        if (!zcbor_tstr_decode(state, &digits) || digits.len == 0 || digits.len > 3)
+        {
+            return false;
+        }
+        number = 0;
+        for (size_t i = 0; i < digits.len; i++)
+        {
+            if (digits.value[i] < '0' || digits.value[i] > '9')
+            {
+                return false;
+            }
+            number = number * 10 + (digits.value[i] - '0');
+        }
+    }
+    if (number < 1 || number > dmx_packet_size)
+    {
+        return false;
+    }
+    *address = static_cast<uint16_t>(number);
+    return true;
+}
+
+static enum golioth_rpc_status put_dmx_update_response(zcbor_state_t *response_detail_map,
+                                                       const size_t count)
+{
+    bool ok = zcbor_tstr_put_lit(response_detail_map, "status")
+        && zcbor_tstr_put_lit(response_detail_map, "success")
+        && zcbor_tstr_put_lit(response_detail_map, "count")
+        && zcbor_uint32_put(response_detail_map, count);
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to encode response");
+        return GOLIOTH_RPC_RESOURCE_EXHAUSTED;
+    }
+    return GOLIOTH_RPC_OK;
+}
+
+// RPC callback for consecutive channels in one frame: set_dmx_range(1, h'FF80')
+// writes the bytes from address 1 on, so a whole universe is one call. JSON
+// callers cannot send bytes and pass a list instead: set_dmx_range(10, [255, 128]).
+// Levels are decoded straight into the outgoing frame.
+static enum golioth_rpc_status on_set_dmx_range(zcbor_state_t *request_params_array,
+                                                zcbor_state_t *response_detail_map,
+                                                void *callback_arg)
+{
+    double start;
+    if (!decode_number(request_params_array, &start) || start < 1 || start > dmx_packet_size)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to decode DMX start address");
+        return GOLIOTH_RPC_INVALID_ARGUMENT;
+    }
+
+    const size_t offset = static_cast<size_t>(start) - 1;
+    size_t count = 0;
+    esp_err_t err = DmxSwitcher::get_switcher().update_rpc_universe(
+        [&](std::array<uint8_t, dmx_packet_size> &slots) {
+            struct zcbor_string bytes;
+            if (zcbor_bstr_decode(request_params_array, &bytes))
+            {
+                if (bytes.len > slots.size() - offset)
+                {
+                    return false;
+                }
+                memcpy(&slots[offset], bytes.value, bytes.len);
+                count = bytes.len;
+                return true;
+            }
+
+            if (!zcbor_list_start_decode(request_params_array))
+            {
+                return false;
+            }
+            while (!zcbor_array_at_end(request_params_array))
+            {
+                if (offset + count >= slots.size()
+                    || !decode_level(request_params_array, &slots[offset + count]))
+                {
+                    return false;
+                }
+                count++;
+            }
+            return zcbor_list_end_decode(request_params_array);
+        });
+    if (err == ESP_ERR_INVALID_ARG)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to decode DMX levels");
+        return GOLIOTH_RPC_INVALID_ARGUMENT;
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to set DMX range: %s", esp_err_to_name(err));
+        return GOLIOTH_RPC_INTERNAL;
+    }
+
+    ESP_LOGD(TAG, "RPC: Set %zu DMX channels from %zu", count, offset + 1);
+    return put_dmx_update_response(response_detail_map, count);
+}
+
+// RPC callback for scattered channels in one frame:
+// set_dmx_channels({"1": 255, "24": 128, "300": 0}). Integer keys work too.
+static enum golioth_rpc_status on_set_dmx_channels(zcbor_state_t *request_params_array,
+                                                   zcbor_state_t *response_detail_map,
+                                                   void *callback_arg)
+{
+    size_t count = 0;
+    esp_err_t err = DmxSwitcher::get_switcher().update_rpc_universe(
+        [&](std::array<uint8_t, dmx_packet_size> &slots) {
+            if (!zcbor_map_start_decode(request_params_array))
+            {
+                return false;
+            }
+            while (!zcbor_array_at_end(request_params_array))
+            {
+                uint16_t address;
+                if (!decode_address(request_params_array, &address)
+                    || !decode_level(request_params_array, &slots[address - 1]))
+                {
+                    return false;
+                }
+                count++;
+            }
+            return zcbor_map_end_decode(request_params_array);
+        });
+    if (err == ESP_ERR_INVALID_ARG)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to decode DMX channel map");
+        return GOLIOTH_RPC_INVALID_ARGUMENT;
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to set DMX channels: %s", esp_err_to_name(err));
+        return GOLIOTH_RPC_INTERNAL;
+    }
+
+    ESP_LOGD(TAG, "RPC: Set %zu DMX channels", count);
+    return put_dmx_update_response(response_detail_map, count);
+}
+
+// RPC callback for merging DMX sources: set_dmx_merge("htp", "DMX", "ARTNET")
+static enum golioth_rpc_status on_set_dmx_merge(zcbor_state_t *request_params_array,
+                                                zcbor_state_t *response_detail_map,
+                                                void *callback_arg)
+{
+    struct zcbor_string mode_str;
+    if (!zcbor_tstr_decode(request_params_array, &mode_str))
+    {
+        ESP_LOGE(TAG, "RPC: Failed to decode merge mode");
+        return GOLIOTH_RPC_INVALID_ARGUMENT;
+    }
+
+    const std::string mode_name(reinterpret_cast<const char *>(mode_str.value), mode_str.len);
+    DmxMergeMode mode;
+    if (mode_name == "off") {
+        mode = DmxMergeMode::none;
+    } else if (mode_name == "htp") {
+        mode = DmxMergeMode::htp;
+    } else if (mode_name == "ltp") {
+        mode = DmxMergeMode::ltp;
+    } else {
+        ESP_LOGE(TAG, "RPC: Unknown merge mode %s", mode_name.c_str());
+        return GOLIOTH_RPC_INVALID_ARGUMENT;
+    }
+
+    // Remaining parameters name the sources merged with the input
+    uint32_t srcs = 0;
+    struct zcbor_string src_str;
+    while (zcbor_tstr_decode(request_params_array, &src_str))
+    {
+        const std::string src_name(reinterpret_cast<const char *>(src_str.value), src_str.len);
+        const std::optional<DmxSourceSink> src = ui_enum<DmxSourceSink>::from_string(src_name);
+        if (!src) {
+            ESP_LOGE(TAG, "RPC: Unknown merge source %s", src_name.c_str());
+            return GOLIOTH_RPC_INVALID_ARGUMENT;
+        }
+        srcs |= dmx_source_sink_bit(*src);
+    }
+
+    SettingsHandler &settings = SettingsHandler::shared();
+    settings.merge_mode.write(mode);
+    settings.merge_srcs.write(static_cast<uint8_t>(srcs));
+
+    esp_err_t err = DmxSwitcher::get_switcher().set_merge(mode, srcs);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to set DMX merge: %s", esp_err_to_name(err));
+        return GOLIOTH_RPC_INTERNAL;
+    }
+
+    ESP_LOGI(TAG, "RPC: DMX merge %s, sources 0x%02" PRIx32, mode_name.c_str(), srcs);
+
+    bool ok = zcbor_tstr_put_lit(response_detail_map, "status")
+        && zcbor_tstr_put_lit(response_detail_map, "success");
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to encode response");
+        return GOLIOTH_RPC_RESOURCE_EXHAUSTED;
+    }
+
+    return GOLIOTH_RPC_OK;
+}
+
+// RPC callback for the route change crossfade: set_dmx_crossfade(2.5), in
+// seconds; 0 cuts.
+static enum golioth_rpc_status on_set_dmx_crossfade(zcbor_state_t *request_params_array,
+                                                    zcbor_state_t *response_detail_map,
+                                                    void *callback_arg)
+{
+    double fade_s;
+    if (!zcbor_float_decode(request_params_array, &fade_s) || fade_s < 0)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to decode crossfade time");
+        return GOLIOTH_RPC_INVALID_ARGUMENT;
+    }
+    const uint32_t fade_ms = static_cast<uint32_t>(fade_s * 1000);
+
+    esp_err_t err = DmxSwitcher::get_switcher().set_crossfade(fade_ms);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to set DMX crossfade: %s", esp_err_to_name(err));
+        return GOLIOTH_RPC_INTERNAL;
+    }
+    SettingsHandler::shared().crossfade_ms.write(fade_ms);
+
+    ESP_LOGI(TAG, "RPC: DMX crossfade %" PRIu32 " ms", fade_ms);
+
+    bool ok = zcbor_tstr_put_lit(response_detail_map, "status")
+        && zcbor_tstr_put_lit(response_detail_map, "success");
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to encode response");
+        return GOLIOTH_RPC_RESOURCE_EXHAUSTED;
+    }
+
+    return GOLIOTH_RPC_OK;
+}
+
+// RPC callback for the Art-Net address: set_artnet_address(net, sub_net).
+// The receiver takes universes 0-15 of that sub-net.
+static enum golioth_rpc_status on_set_artnet_address(zcbor_state_t *request_params_array,
+                                                     zcbor_state_t *response_detail_map,
+                                                     void *callback_arg)
+{
+    double net, subnet;
+    bool ok = zcbor_float_decode(request_params_array, &net)
+        && zcbor_float_decode(request_params_array, &subnet);
+    if (!ok || net < 0 || net > 127 || subnet < 0 || subnet > 15)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to decode Art-Net net and sub-net");
+        return GOLIOTH_RPC_INVALID_ARGUMENT;
+    }
+
+    SettingsHandler &settings = SettingsHandler::shared();
+    esp_err_t err = ArtNetReceiver::shared().set_address(static_cast<uint8_t>(net),
+                                                         static_cast<uint8_t>(subnet));
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to set Art-Net address: %s", esp_err_to_name(err));
+        return GOLIOTH_RPC_INTERNAL;
+    }
+    settings.artnet_net.write(static_cast<uint8_t>(net));
+    settings.artnet_subnet.write(static_cast<uint8_t>(subnet));
+
+    ESP_LOGI(TAG, "RPC: Art-Net net %d sub-net %d", static_cast<int>(net), static_cast<int>(subnet));
+
+    ok = zcbor_tstr_put_lit(response_detail_map, "status")
+        && zcbor_tstr_put_lit(response_detail_map, "success");
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to encode response");
+        return GOLIOTH_RPC_RESOURCE_EXHAUSTED;
+    }
+
+    return GOLIOTH_RPC_OK;
+}
+
+// RPC callback for the sACN universe read as universe 0 of the SACN source:
+// set_sacn_universe(1). Routes name any other sACN universe by its number,
+// so the primary one should not also appear as a route's source universe.
+static enum golioth_rpc_status on_set_sacn_universe(zcbor_state_t *request_params_array,
+                                                    zcbor_state_t *response_detail_map,
+                                                    void *callback_arg)
+{
+    double universe;
+    if (!zcbor_float_decode(request_params_array, &universe)
+        || universe < sacn_universe_min || universe > sacn_universe_max)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to decode sACN universe");
+        return GOLIOTH_RPC_INVALID_ARGUMENT;
+    }
+
+    const uint16_t number = static_cast<uint16_t>(universe);
+    esp_err_t err = SacnReceiver::shared().set_primary_universe(number);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to set sACN universe: %s", esp_err_to_name(err));
+        return GOLIOTH_RPC_INTERNAL;
+    }
+    SettingsHandler::shared().sacn_universe.write(number);
+
+    ESP_LOGI(TAG, "RPC: sACN universe %" PRIu16, number);
+
+    bool ok = zcbor_tstr_put_lit(response_detail_map, "status")
+        && zcbor_tstr_put_lit(response_detail_map, "success");
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to encode response");
+        return GOLIOTH_RPC_RESOURCE_EXHAUSTED;
+    }
+
+    return GOLIOTH_RPC_OK;
+}
+
+// RPC callback for where the network outputs send to:
+// set_net_out_dest("192.168.1.20") unicasts both Art-Net and sACN to one node,
+// set_net_out_dest("") goes back to Art-Net broadcast and sACN multicast.
+static enum golioth_rpc_status on_set_net_out_dest(zcbor_state_t *request_params_array,
+                                                   zcbor_state_t *response_detail_map,
+                                                   void *callback_arg)
+{
+    struct zcbor_string dest_str;
+    if (!zcbor_tstr_decode(request_params_array, &dest_str))
+    {
+        ESP_LOGE(TAG, "RPC: Failed to decode destination");
+        return GOLIOTH_RPC_INVALID_ARGUMENT;
+    }
+
+    const std::string dest(reinterpret_cast<const char *>(dest_str.value), dest_str.len);
+    uint32_t ip = 0;
+    if (!dest.empty())
+    {
+        ip4_addr_t addr;
+        if (!ip4addr_aton(dest.c_str(), &addr))
+        {
+            ESP_LOGE(TAG, "RPC: Invalid destination %s", dest.c_str());
+            return GOLIOTH_RPC_INVALID_ARGUMENT;
+        }
+        ip = lwip_ntohl(ip4_addr_get_u32(&addr));
+    }
+    NetworkSender::shared().set_destination(ip);
+    SettingsHandler::shared().net_out_dest.write(ip);
+
+    ESP_LOGI(TAG, "RPC: Network output to %s", dest.empty() ? "broadcast" : dest.c_str());
+
+    bool ok = zcbor_tstr_put_lit(response_detail_map, "status")
+        && zcbor_tstr_put_lit(response_detail_map, "success");
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to encode response");
+        return GOLIOTH_RPC_RESOURCE_EXHAUSTED;
+    }
+
+    return GOLIOTH_RPC_OK;
+}
+
+// RPC callback for the wired output break/MAB profile:
+// set_dmx_timing("standard"|"fast"|"relaxed"). Applied by the TX task on its
+// next frame.
+static enum golioth_rpc_status on_set_dmx_timing(zcbor_state_t *request_params_array,
+                                                 zcbor_state_t *response_detail_map,
+                                                 void *callback_arg)
+{
+    struct zcbor_string profile_str;
+    if (!zcbor_tstr_decode(request_params_array, &profile_str))
+    {
+        ESP_LOGE(TAG, "RPC: Failed to decode timing profile");
+        return GOLIOTH_RPC_INVALID_ARGUMENT;
+    }
+
+    const std::string profile_name(reinterpret_cast<const char *>(profile_str.value), profile_str.len);
+    DmxTimingProfile profile;
+    if (profile_name == "standard") {
+        profile = DmxTimingProfile::standard;
+    } else if (profile_name == "fast") {
+        profile = DmxTimingProfile::fast;
+    } else if (profile_name == "relaxed") {
+        profile = DmxTimingProfile::relaxed;
+    } else {
+        ESP_LOGE(TAG, "RPC: Unknown timing profile %s", profile_name.c_str());
+        return GOLIOTH_RPC_INVALID_ARGUMENT;
+    }
+    SettingsHandler::shared().dmx_timing.write(profile);
+
+    ESP_LOGI(TAG, "RPC: DMX timing profile %s", profile_name.c_str());
+
+    bool ok = zcbor_tstr_put_lit(response_detail_map, "status")
+        && zcbor_tstr_put_lit(response_detail_map, "success");
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to encode response");
+        return GOLIOTH_RPC_RESOURCE_EXHAUSTED;
+    }
+
+    return GOLIOTH_RPC_OK;
+}
+
+// RPC callback for the flash recorder: dmx_recorder("record", "DMX") records
+// a source, dmx_recorder("play", 12.5, true) plays from the keyframe at or
+// before 12.5 s, optionally looping, and dmx_recorder("stop") stops either.
+static enum golioth_rpc_status on_dmx_recorder(zcbor_state_t *request_params_array,
+                                               zcbor_state_t *response_detail_map,
+                                               void *callback_arg)
+{
+    struct zcbor_string cmd_str;
+    if (!zcbor_tstr_decode(request_params_array, &cmd_str))
+    {
+        ESP_LOGE(TAG, "RPC: Failed to decode recorder command");
+        return GOLIOTH_RPC_INVALID_ARGUMENT;
+    }
+    const std::string cmd(reinterpret_cast<const char *>(cmd_str.value), cmd_str.len);
+
+    DmxRecorder &recorder = DmxRecorder::shared();
+    esp_err_t err;
+    if (cmd == "record")
+    {
+        struct zcbor_string src_str;
+        if (!zcbor_tstr_decode(request_params_array, &src_str))
+        {
+            ESP_LOGE(TAG, "RPC: Failed to decode recorder source");
+            return GOLIOTH_RPC_INVALID_ARGUMENT;
+        }
+        const std::string src_name(reinterpret_cast<const char *>(src_str.value), src_str.len);
+        const std::optional<DmxSourceSink> src = ui_enum<DmxSourceSink>::from_string(src_name);
+        DmxInterface *interface =
+            src ? DmxSwitcher::get_switcher().get_interface(*src) : nullptr;
+        if (interface == nullptr || *src == DmxSourceSink::playback)
+        {
+            ESP_LOGE(TAG, "RPC: Invalid recorder source %s", src_name.c_str());
+            return GOLIOTH_RPC_INVALID_ARGUMENT;
+        }
+        err = recorder.start_recording(*interface);
+    }
+    else if (cmd == "play")
+    {
+        double seek_s = 0;
+        bool loop = false;
+        if (zcbor_float_decode(request_params_array, &seek_s))
+        {
+            zcbor_bool_decode(request_params_array, &loop);
+        }
+        if (seek_s < 0)
+        {
+            ESP_LOGE(TAG, "RPC: Invalid seek time");
+            return GOLIOTH_RPC_INVALID_ARGUMENT;
+        }
+        err = recorder.start_playback(static_cast<uint32_t>(seek_s * 1000), loop);
+    }
+    else if (cmd == "stop")
+    {
+        err = recorder.stop();
+    }
+    else
+    {
+        ESP_LOGE(TAG, "RPC: Unknown recorder command %s", cmd.c_str());
+        return GOLIOTH_RPC_INVALID_ARGUMENT;
+    }
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "RPC: Recorder %s failed: %s", cmd.c_str(), esp_err_to_name(err));
+        return GOLIOTH_RPC_INTERNAL;
+    }
+
+    ESP_LOGI(TAG, "RPC: DMX recorder %s", cmd.c_str());
+
+    bool ok = zcbor_tstr_put_lit(response_detail_map, "status")
+        && zcbor_tstr_put_lit(response_detail_map, "success");
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to encode response");
+        return GOLIOTH_RPC_RESOURCE_EXHAUSTED;
+    }
+
+    return GOLIOTH_RPC_OK;
+}
+
+// RPC callback for the failover source list, highest priority first:
+// set_dmx_sources("DMX", 1.0, "ARTNET", 2.5, "CRMX", 1.0) with each source's
+// liveness timeout in seconds. No parameters turns failover off.
+static enum golioth_rpc_status on_set_dmx_sources(zcbor_state_t *request_params_array,
+                                                  zcbor_state_t *response_detail_map,
+                                                  void *callback_arg)
+{
+    std::vector<DmxSourceEntry> entries;
+    struct zcbor_string src_str;
+    while (zcbor_tstr_decode(request_params_array, &src_str))
+    {
+        const std::string src_name(reinterpret_cast<const char *>(src_str.value), src_str.len);
+        const std::optional<DmxSourceSink> src = ui_enum<DmxSourceSink>::from_string(src_name);
+        double timeout_s;
+        if (!src || !zcbor_float_decode(request_params_array, &timeout_s) || timeout_s <= 0)
+        {
+            ESP_LOGE(TAG, "RPC: Invalid failover source %s", src_name.c_str());
+            return GOLIOTH_RPC_INVALID_ARGUMENT;
+        }
+        entries.push_back(DmxSourceEntry{
+            .src = *src,
+            .timeout_ms = static_cast<uint32_t>(timeout_s * 1000),
+        });
+    }
+
+    esp_err_t err = DmxSwitcher::get_switcher().set_sources(entries);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to set DMX sources: %s", esp_err_to_name(err));
+        return err == ESP_ERR_INVALID_ARG ? GOLIOTH_RPC_INVALID_ARGUMENT : GOLIOTH_RPC_INTERNAL;
+    }
+    SettingsHandler::shared().source_list.write(entries);
+
+    ESP_LOGI(TAG, "RPC: %zu DMX failover sources", entries.size());
+
+    bool ok = zcbor_tstr_put_lit(response_detail_map, "status")
+        && zcbor_tstr_put_lit(response_detail_map, "success");
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to encode response");
+        return GOLIOTH_RPC_RESOURCE_EXHAUSTED;
+    }
+
+    return GOLIOTH_RPC_OK;
+}
+
+// RPC callback for the routing table: set_dmx_routes("ARTNET", 1, "CRMX", 0,
+// "ARTNET", 2, "DMX", 0) routes Art-Net universe 1 to CRMX and universe 2 to
+// the wired port. Each route is source, source universe, sink, sink universe;
+// no parameters clears the table.
+static enum golioth_rpc_status on_set_dmx_routes(zcbor_state_t *request_params_array,
+                                                 zcbor_state_t *response_detail_map,
+                                                 void *callback_arg)
+{
+    std::vector<DmxRoute> routes;
+    struct zcbor_string src_str;
+    while (zcbor_tstr_decode(request_params_array, &src_str))
+    {
+        const std::string src_name(reinterpret_cast<const char *>(src_str.value), src_str.len);
+        const std::optional<DmxSourceSink> src = ui_enum<DmxSourceSink>::from_string(src_name);
+        double src_universe;
+        struct zcbor_string sink_str;
+        double sink_universe;
+        bool ok = zcbor_float_decode(request_params_array, &src_universe)
+            && zcbor_tstr_decode(request_params_array, &sink_str)
+            && zcbor_float_decode(request_params_array, &sink_universe);
+        if (!ok || !src || src_universe < 0 || src_universe >= dmx_universe_none
+            || sink_universe < 0 || sink_universe >= dmx_universe_none)
+        {
+            ESP_LOGE(TAG, "RPC: Invalid route from %s", src_name.c_str());
+            return GOLIOTH_RPC_INVALID_ARGUMENT;
+        }
+        const std::string sink_name(reinterpret_cast<const char *>(sink_str.value), sink_str.len);
+        const std::optional<DmxSourceSink> sink = ui_enum<DmxSourceSink>::from_string(sink_name);
+        if (!sink)
+        {
+            ESP_LOGE(TAG, "RPC: Invalid route sink %s", sink_name.c_str());
+            return GOLIOTH_RPC_INVALID_ARGUMENT;
+        }
+        routes.push_back(DmxRoute{
+            .src = *src,
+            .src_universe = static_cast<uint16_t>(src_universe),
+            .sink = *sink,
+            .sink_universe = static_cast<uint16_t>(sink_universe),
+        });
+    }
+
+    esp_err_t err = DmxSwitcher::get_switcher().set_routes(routes);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to set DMX routes: %s", esp_err_to_name(err));
+        return err == ESP_ERR_INVALID_ARG ? GOLIOTH_RPC_INVALID_ARGUMENT : GOLIOTH_RPC_INTERNAL;
+    }
+    SettingsHandler::shared().routes.write(routes);
+
+    ESP_LOGI(TAG, "RPC: %zu DMX routes", routes.size());
+
+    bool ok = zcbor_tstr_put_lit(response_detail_map, "status")
+        && zcbor_tstr_put_lit(response_detail_map, "success");
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to encode response");
+        return GOLIOTH_RPC_RESOURCE_EXHAUSTED;
+    }
+
+    return GOLIOTH_RPC_OK;
+}
+
+// RPC callback for the input loss policy: set_dmx_loss("hold") or
+// set_dmx_loss("fade", hold_s, fade_s), optionally followed by the loss
+// timeout in seconds.
+static enum golioth_rpc_status on_set_dmx_loss(zcbor_state_t *request_params_array,
+                                               zcbor_state_t *response_detail_map,
+                                               void *callback_arg)
+{
+    struct zcbor_string policy_str;
+    if (!zcbor_tstr_decode(request_params_array, &policy_str))
+    {
+        ESP_LOGE(TAG, "RPC: Failed to decode loss policy");
+        return GOLIOTH_RPC_INVALID_ARGUMENT;
+    }
+
+    SettingsHandler &settings = SettingsHandler::shared();
+    DmxLossConfig config = settings.get_loss_config();
+    const std::string policy_name(reinterpret_cast<const char *>(policy_str.value), policy_str.len);
+    if (policy_name == "hold") {
+        config.policy = DmxLossPolicy::hold;
+    } else if (policy_name == "fade") {
+        config.policy = DmxLossPolicy::fade;
+        double hold_s, fade_s;
+        if (!zcbor_float_decode(request_params_array, &hold_s)
+            || !zcbor_float_decode(request_params_array, &fade_s)
+            || hold_s < 0 || fade_s < 0)
+        {
+            ESP_LOGE(TAG, "RPC: Fade needs hold and fade times");
+            return GOLIOTH_RPC_INVALID_ARGUMENT;
+        }
+        config.hold_ms = static_cast<uint32_t>(hold_s * 1000);
+        config.fade_ms = static_cast<uint32_t>(fade_s * 1000);
+    } else {
+        ESP_LOGE(TAG, "RPC: Unknown loss policy %s", policy_name.c_str());
+        return GOLIOTH_RPC_INVALID_ARGUMENT;
+    }
+
+    double timeout_s;
+    if (zcbor_float_decode(request_params_array, &timeout_s))
+    {
+        if (timeout_s <= 0) {
+            ESP_LOGE(TAG, "RPC: Invalid loss timeout %f", timeout_s);
+            return GOLIOTH_RPC_INVALID_ARGUMENT;
+        }
+        config.timeout_ms = static_cast<uint32_t>(timeout_s * 1000);
+    }
+
+    esp_err_t err = DmxSwitcher::get_switcher().set_loss_config(config);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to set DMX loss policy: %s", esp_err_to_name(err));
+        return GOLIOTH_RPC_INTERNAL;
+    }
+
+    settings.loss_policy.write(config.policy);
+    settings.loss_timeout_ms.write(config.timeout_ms);
+    settings.loss_hold_ms.write(config.hold_ms);
+    settings.loss_fade_ms.write(config.fade_ms);
+
+    ESP_LOGI(TAG, "RPC: DMX loss policy %s, timeout %" PRIu32 " ms", policy_name.c_str(),
+             config.timeout_ms);
+
+    bool ok = zcbor_tstr_put_lit(response_detail_map, "status")
+        && zcbor_tstr_put_lit(response_detail_map, "success");
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to encode response");
+        return GOLIOTH_RPC_RESOURCE_EXHAUSTED;
+    }
+
+    return GOLIOTH_RPC_OK;
+}
+
+// RPC callback for the channel patch: set_dmx_patch(dst, src, count, ...)
+// with one triple per rule, 1-based channels, src 0 to block. No parameters
+// clears the patch.
+static enum golioth_rpc_status on_set_dmx_patch(zcbor_state_t *request_params_array,
+                                                zcbor_state_t *response_detail_map,
+                                                void *callback_arg)
+{
+    std::vector<DmxPatchRule> rules;
+    double dst, src, count;
+    while (zcbor_float_decode(request_params_array, &dst))
+    {
+        if (!zcbor_float_decode(request_params_array, &src)
+            || !zcbor_float_decode(request_params_array, &count)
+            || rules.size() >= dmx_patch_max_rules)
+        {
+            ESP_LOGE(TAG, "RPC: Patch must be up to %zu (dst, src, count) triples",
+                     dmx_patch_max_rules);
+            return GOLIOTH_RPC_INVALID_ARGUMENT;
+        }
+        rules.push_back(DmxPatchRule{
+            .dst = static_cast<uint16_t>(dst),
+            .src = static_cast<uint16_t>(src),
+            .count = static_cast<uint16_t>(count),
+        });
+    }
+
+    // Compile first so a bad patch is never stored
+    esp_err_t err = DmxSwitcher::get_switcher().set_patch(rules);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to set DMX patch: %s", esp_err_to_name(err));
+        return GOLIOTH_RPC_INVALID_ARGUMENT;
+    }
+    SettingsHandler::shared().patch.write(rules);
+
+    ESP_LOGI(TAG, "RPC: DMX patch of %zu rules", rules.size());
+
+    bool ok = zcbor_tstr_put_lit(response_detail_map, "status")
+        && zcbor_tstr_put_lit(response_detail_map, "success");
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to encode response");
+        return GOLIOTH_RPC_RESOURCE_EXHAUSTED;
+    }
+
+    return GOLIOTH_RPC_OK;
+}
+
+// Store a new curve rule list and hand it to the switcher
+static enum golioth_rpc_status apply_dmx_curves(const std::vector<DmxCurveRule> &rules,
+                                                zcbor_state_t *response_detail_map)
+{
+    // Compile first so a bad rule set is never stored
+    esp_err_t err = DmxSwitcher::get_switcher().set_curves(rules);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to set DMX curves: %s", esp_err_to_name(err));
+        return GOLIOTH_RPC_INVALID_ARGUMENT;
+    }
+    SettingsHandler::shared().curves.write(rules);
+
+    bool ok = zcbor_tstr_put_lit(response_detail_map, "status")
+        && zcbor_tstr_put_lit(response_detail_map, "success")
+        && zcbor_tstr_put_lit(response_detail_map, "rules")
+        && zcbor_uint32_put(response_detail_map, rules.size());
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to encode response");
+        return GOLIOTH_RPC_RESOURCE_EXHAUSTED;
+    }
+
+    return GOLIOTH_RPC_OK;
+}
+
+// RPC callback adding a response curve:
+// add_dmx_curve(start, count, type[, invert, min, max[, 9 custom points]])
+// with type one of linear, square, root, s_curve, custom. Replaces any rule
+// with the same start and count.
+static enum golioth_rpc_status on_add_dmx_curve(zcbor_state_t *request_params_array,
+                                                zcbor_state_t *response_detail_map,
+                                                void *callback_arg)
+{
+    double start, count;
+    struct zcbor_string type_str;
+    bool ok = zcbor_float_decode(request_params_array, &start)
+        && zcbor_float_decode(request_params_array, &count)
+        && zcbor_tstr_decode(request_params_array, &type_str);
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "RPC: Failed to decode curve parameters");
+        return GOLIOTH_RPC_INVALID_ARGUMENT;
+    }
+
+    DmxCurveRule rule = {
+        .start = static_cast<uint16_t>(start),
+        .count = static_cast<uint16_t>(count),
+        .type = DmxCurveType::linear,
+        .invert = 0,
+        .min = 0,
+        .max = UINT8_MAX,
+        .points = {},
+    };
+
+    const std::string type_name(reinterpret_cast<const char *>(type_str.value), type_str.len);
+    if (type_name == "linear") {
+        rule.type = DmxCurveType::linear;
+    } else if (type_name == "square") {
+        rule.type = DmxCurveType::square;
+    } else if (type_name == "root") {
+        rule.type = DmxCurveType::root;
+    } else if (type_name == "s_curve") {
+        rule.type = DmxCurveType::s_curve;
+    } else if (type_name == "custom") {
+        rule.type = DmxCurveType::custom;
+    } else {
+        ESP_LOGE(TAG, "RPC: Unknown curve type %s", type_name.c_str());
+        return GOLIOTH_RPC_INVALID_ARGUMENT;
+    }
+
+    double invert, min, max;
+    if (zcbor_float_decode(request_params_array, &invert))
+    {
+        if (!zcbor_float_decode(request_params_array, &min)
+            || !zcbor_float_decode(request_params_array, &max))
+        {
+            ESP_LOGE(TAG, "RPC: Curve needs invert, min and max together");
+            return GOLIOTH_RPC_INVALID_ARGUMENT;
+        }
+        rule.invert = invert != 0;
+        rule.min = static_cast<uint8_t>(min);
+        rule.max = static_cast<uint8_t>(max);
+    }
+
+    if (rule.type == DmxCurveType::custom)
+    {
+        for (uint8_t &point : rule.points)
+        {
+            double value;
+            if (!zcbor_float_decode(request_params_array, &value))
+            {
+                ESP_LOGE(TAG, "RPC: Custom curve needs %zu points", dmx_curve_points);
+                return GOLIOTH_RPC_INVALID_ARGUMENT;
+            }
+            point = static_cast<uint8_t>(value);
+        }
+    }
+
+    std::vector<DmxCurveRule> rules = SettingsHandler::shared().curves.get();
+    rules.erase(std::remove_if(rules.begin(), rules.end(),
+                               [&rule](const DmxCurveRule &existing) {
+                                   return existing.start == rule.start
+                                       && existing.count == rule.count;
+                               }),
+                rules.end());
+    if (rules.size() >= dmx_curve_max_rules)
+    {
+        ESP_LOGE(TAG, "RPC: At most %zu curve rules", dmx_curve_max_rules);
+        return GOLIOTH_RPC_RESOURCE_EXHAUSTED;
+    }
+    rules.push_back(rule);
+
+    ESP_LOGI(TAG, "RPC: DMX curve %s on %u x %u", type_name.c_str(), rule.start, rule.count);
+    return apply_dmx_curves(rules, response_detail_map);
+}
+
+// RPC callback removing every response curve
+static enum golioth_rpc_status on_clear_dmx_curves(zcbor_state_t *request_params_array,
+                                                   zcbor_state_t *response_detail_map,
+                                                   void *callback_arg)
+{
+    ESP_LOGI(TAG, "RPC: Clear DMX curves");
+    return apply_dmx_curves({}, response_detail_map);
+}
+
 // Golioth client event callback
 static void on_client_event(struct golioth_client *client,
                             enum golioth_client_event event,
@@ -124,6 +1059,14 @@ extern "C" void wifi_task(void *pvParameters)
         }
         s_wifi_connected = true;
         ESP_LOGI(TAG, "WiFi connected!");
+
+        // Art-Net and sACN are independent of Golioth; listen and transmit as
+        // soon as there is a network.
+        ESP_ERROR_CHECK_WITHOUT_ABORT(ArtNetReceiver::shared().start(
+            DmxSwitcher::get_switcher().get_artnet_interface()));
+        ESP_ERROR_CHECK_WITHOUT_ABORT(SacnReceiver::shared().start(
+            DmxSwitcher::get_switcher().get_sacn_interface()));
+        ESP_ERROR_CHECK_WITHOUT_ABORT(NetworkSender::shared().start());
         
         // Initialize Golioth client
         const struct golioth_client_config *config = golioth_sample_credentials_get();
@@ -154,6 +1097,111 @@ extern "C" void wifi_task(void *pvParameters)
                         } else {
                             ESP_LOGE(TAG, "Failed to register DMX RPC: %d", err);
                         }
+
+                        err = golioth_rpc_register(s_rpc, "set_dmx_range", on_set_dmx_range, NULL);
+                        if (err == 0) {
+                            ESP_LOGI(TAG, "DMX RPC 'set_dmx_range' successfully registered");
+                        } else {
+                            ESP_LOGE(TAG, "Failed to register DMX range RPC: %d", err);
+                        }
+
+                        err = golioth_rpc_register(s_rpc, "set_dmx_channels", on_set_dmx_channels, NULL);
+                        if (err == 0) {
+                            ESP_LOGI(TAG, "DMX RPC 'set_dmx_channels' successfully registered");
+                        } else {
+                            ESP_LOGE(TAG, "Failed to register DMX channels RPC: %d", err);
+                        }
+
+                        err = golioth_rpc_register(s_rpc, "set_dmx_merge", on_set_dmx_merge, NULL);
+                        if (err == 0) {
+                            ESP_LOGI(TAG, "DMX RPC 'set_dmx_merge' successfully registered");
+                        } else {
+                            ESP_LOGE(TAG, "Failed to register DMX merge RPC: %d", err);
+                        }
+
+                        err = golioth_rpc_register(s_rpc, "set_dmx_loss", on_set_dmx_loss, NULL);
+                        if (err == 0) {
+                            ESP_LOGI(TAG, "DMX RPC 'set_dmx_loss' successfully registered");
+                        } else {
+                            ESP_LOGE(TAG, "Failed to register DMX loss RPC: %d", err);
+                        }
+
+                        err = golioth_rpc_register(s_rpc, "set_dmx_sources", on_set_dmx_sources, NULL);
+                        if (err == 0) {
+                            ESP_LOGI(TAG, "DMX RPC 'set_dmx_sources' successfully registered");
+                        } else {
+                            ESP_LOGE(TAG, "Failed to register DMX sources RPC: %d", err);
+                        }
+
+                        err = golioth_rpc_register(s_rpc, "set_dmx_routes", on_set_dmx_routes, NULL);
+                        if (err == 0) {
+                            ESP_LOGI(TAG, "DMX RPC 'set_dmx_routes' successfully registered");
+                        } else {
+                            ESP_LOGE(TAG, "Failed to register DMX routes RPC: %d", err);
+                        }
+
+                        err = golioth_rpc_register(s_rpc, "set_dmx_crossfade", on_set_dmx_crossfade, NULL);
+                        if (err == 0) {
+                            ESP_LOGI(TAG, "DMX RPC 'set_dmx_crossfade' successfully registered");
+                        } else {
+                            ESP_LOGE(TAG, "Failed to register DMX crossfade RPC: %d", err);
+                        }
+
+                        err = golioth_rpc_register(s_rpc, "set_dmx_timing", on_set_dmx_timing, NULL);
+                        if (err == 0) {
+                            ESP_LOGI(TAG, "DMX RPC 'set_dmx_timing' successfully registered");
+                        } else {
+                            ESP_LOGE(TAG, "Failed to register DMX timing RPC: %d", err);
+                        }
+
+                        err = golioth_rpc_register(s_rpc, "set_artnet_address", on_set_artnet_address, NULL);
+                        if (err == 0) {
+                            ESP_LOGI(TAG, "DMX RPC 'set_artnet_address' successfully registered");
+                        } else {
+                            ESP_LOGE(TAG, "Failed to register Art-Net address RPC: %d", err);
+                        }
+
+                        err = golioth_rpc_register(s_rpc, "set_sacn_universe", on_set_sacn_universe, NULL);
+                        if (err == 0) {
+                            ESP_LOGI(TAG, "DMX RPC 'set_sacn_universe' successfully registered");
+                        } else {
+                            ESP_LOGE(TAG, "Failed to register sACN universe RPC: %d", err);
+                        }
+
+                        err = golioth_rpc_register(s_rpc, "set_net_out_dest", on_set_net_out_dest, NULL);
+                        if (err == 0) {
+                            ESP_LOGI(TAG, "DMX RPC 'set_net_out_dest' successfully registered");
+                        } else {
+                            ESP_LOGE(TAG, "Failed to register network output RPC: %d", err);
+                        }
+
+                        err = golioth_rpc_register(s_rpc, "dmx_recorder", on_dmx_recorder, NULL);
+                        if (err == 0) {
+                            ESP_LOGI(TAG, "DMX RPC 'dmx_recorder' successfully registered");
+                        } else {
+                            ESP_LOGE(TAG, "Failed to register DMX recorder RPC: %d", err);
+                        }
+
+                        err = golioth_rpc_register(s_rpc, "set_dmx_patch", on_set_dmx_patch, NULL);
+                        if (err == 0) {
+                            ESP_LOGI(TAG, "DMX RPC 'set_dmx_patch' successfully registered");
+                        } else {
+                            ESP_LOGE(TAG, "Failed to register DMX patch RPC: %d", err);
+                        }
+
+                        err = golioth_rpc_register(s_rpc, "add_dmx_curve", on_add_dmx_curve, NULL);
+                        if (err == 0) {
+                            ESP_LOGI(TAG, "DMX RPC 'add_dmx_curve' successfully registered");
+                        } else {
+                            ESP_LOGE(TAG, "Failed to register DMX curve RPC: %d", err);
+                        }
+
+                        err = golioth_rpc_register(s_rpc, "clear_dmx_curves", on_clear_dmx_curves, NULL);
+                        if (err == 0) {
+                            ESP_LOGI(TAG, "DMX RPC 'clear_dmx_curves' successfully registered");
+                        } else {
+                            ESP_LOGE(TAG, "Failed to register DMX curve RPC: %d", err);
+                        }
                     } else {
                         ESP_LOGW(TAG, "Failed to connect to Golioth within timeout");
                     }
@@ -187,6 +1235,13 @@ extern "C" void wifi_task(void *pvParameters)
                      s_golioth_connected ? "OK" : "DISCONNECTED");
         }
 
+        const int64_t now = esp_timer_get_time();
+        if (s_golioth_connected &&
+            now - s_last_telemetry_time >= telemetry_period_us) {
+            s_last_telemetry_time = now;
+            send_latency_telemetry();
+        }
+
         vTaskDelay(pdMS_TO_TICKS(1000));
     }
 }
\ No newline at end of file